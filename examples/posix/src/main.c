@@ -210,6 +210,7 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packe
                     btstack_tlv_posix_deinit(&tlv_context);
                     if (!shutdown_triggered)
                         break;
+                    my_platform_deinit();
                     // reset stdin
                     btstack_stdin_reset();
                     log_info("Good bye, see you.\n");
@@ -257,12 +258,14 @@ void hal_led_toggle(void) {
     printf("LED State %u\n", led_state);
 }
 
-static char short_options[] = "hu:l:r";
+static char short_options[] = "hu:l:rg:v:";
 
 static struct option long_options[] = {{"help", no_argument, NULL, 'h'},
                                        {"logfile", required_argument, NULL, 'l'},
                                        {"reset-tlv", no_argument, NULL, 'r'},
                                        {"usbpath", required_argument, NULL, 'u'},
+                                       {"gpiochip", required_argument, NULL, 'g'},
+                                       {"vcd", required_argument, NULL, 'v'},
                                        {0, 0, 0, 0}};
 
 static char* help_options[] = {
@@ -270,6 +273,8 @@ static char* help_options[] = {
     "set file to store debug output and HCI trace.",
     "reset bonding information stored in TLV.",
     "set USB path to Bluetooth Controller.",
+    "drive a joystick port with the lines of a GPIO chip.",
+    "on exit, write the joystick port waveforms to VCDFILE.",
 };
 
 static char* option_arg_name[] = {
@@ -277,6 +282,8 @@ static char* option_arg_name[] = {
     "LOGFILE",
     "",
     "USBPATH",
+    "GPIOCHIP",
+    "VCDFILE",
 };
 
 static void usage(const char* name) {
@@ -295,6 +302,8 @@ int main(int argc, const char* argv[]) {
     int usb_path_len = 0;
     const char* usb_path_string = NULL;
     const char* log_file_path = NULL;
+    const char* gpiochip = NULL;
+    const char* vcd_path = NULL;
 
     // parse command line parameters
     while (true) {
@@ -315,6 +324,12 @@ int main(int argc, const char* argv[]) {
             case 'r':
                 tlv_reset = true;
                 break;
+            case 'g':
+                gpiochip = optarg;
+                break;
+            case 'v':
+                vcd_path = optarg;
+                break;
             case 'h':
             default:
                 usage(argv[0]);
@@ -392,6 +407,7 @@ int main(int argc, const char* argv[]) {
 
     // Must be called before uni_init()
     uni_platform_set_custom(get_my_platform());
+    my_platform_set_retro_port(gpiochip, vcd_path);
     uni_init(argc, argv);
 
     // go: does not return
@@ -6,11 +6,15 @@
 
 #include <uni.h>
 
+#include "my_retro_port.h"
+
 //
 // Globals
 //
 static int g_enhanced_mode = 0;
 static int g_delete_keys = 0;
+static const char* g_gpiochip;
+static const char* g_vcd_path;
 
 enum {
     TRIGGER_EFFECT_VIBRATION,
@@ -104,6 +108,9 @@ static void posix_on_init_complete(void) {
 
     uni_property_dump_all();
 
+    if (g_gpiochip && my_retro_port_init(g_gpiochip) != 0)
+        loge("posix: failed to drive retro port with %s\n", g_gpiochip);
+
     // Start scanning
     uni_bt_start_scanning_and_autoconnect_unsafe();
 }
@@ -130,12 +137,29 @@ static void posix_on_device_connected(uni_hid_device_t* d) {
 
 static void posix_on_device_disconnected(uni_hid_device_t* d) {
     logi("posix: device disconnected: %p\n", d);
+    posix_instance_t* ins = get_posix_instance(d);
+    my_retro_port_release(ins->gamepad_seat);
+    ins->gamepad_seat = GAMEPAD_SEAT_NONE;
 }
 
 static uni_error_t posix_on_device_ready(uni_hid_device_t* d) {
     logi("posix: device ready: %p\n", d);
     posix_instance_t* ins = get_posix_instance(d);
-    ins->gamepad_seat = GAMEPAD_SEAT_A;
+    uint32_t used_seats = 0;
+
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        uni_hid_device_t* tmp_d = uni_hid_device_get_instance_for_idx(i);
+        if (tmp_d != d)
+            used_seats |= get_posix_instance(tmp_d)->gamepad_seat;
+    }
+
+    // First free port. Past the second controller, seat C: it doesn't drive any port.
+    if (!(used_seats & GAMEPAD_SEAT_A))
+        ins->gamepad_seat = GAMEPAD_SEAT_A;
+    else if (!(used_seats & GAMEPAD_SEAT_B))
+        ins->gamepad_seat = GAMEPAD_SEAT_B;
+    else
+        ins->gamepad_seat = GAMEPAD_SEAT_C;
 
     trigger_event_on_gamepad(d);
     return UNI_ERROR_SUCCESS;
@@ -150,6 +174,9 @@ static void posix_on_controller_data(uni_hid_device_t* d, uni_controller_t* ctl)
     static bool trigger_left_in_progress = false, trigger_right_in_progress = false;
     uni_gamepad_t* gp;
 
+    // Every report: repeated mouse reports are still movement.
+    my_retro_port_on_controller_data(get_posix_instance(d)->gamepad_seat, ctl);
+
     if (memcmp(&prev, ctl, sizeof(*ctl)) == 0) {
         return;
     }
@@ -283,6 +310,7 @@ static void posix_on_oob_event(uni_platform_oob_event_t event, void* data) {
             }
 
             posix_instance_t* ins = get_posix_instance(d);
+            my_retro_port_release(ins->gamepad_seat);
             ins->gamepad_seat = ins->gamepad_seat == GAMEPAD_SEAT_A ? GAMEPAD_SEAT_B : GAMEPAD_SEAT_A;
 
             trigger_event_on_gamepad(d);
@@ -330,6 +358,15 @@ static void trigger_event_on_gamepad(uni_hid_device_t* d) {
 //
 // Entry Point
 //
+void my_platform_set_retro_port(const char* gpiochip, const char* vcd_path) {
+    g_gpiochip = gpiochip;
+    g_vcd_path = vcd_path;
+}
+
+void my_platform_deinit(void) {
+    my_retro_port_deinit(g_vcd_path);
+}
+
 struct uni_platform* get_my_platform(void) {
     static struct uni_platform plat = {
         .name = "Posix",
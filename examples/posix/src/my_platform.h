@@ -4,5 +4,10 @@
 #include <uni.h>
 
 struct uni_platform* get_my_platform(void);
+// Drives a retro joystick port with the lines of "gpiochip". Must be called before uni_init().
+// The waveforms are written to "vcd_path" on shutdown, if not NULL.
+void my_platform_set_retro_port(const char* gpiochip, const char* vcd_path);
+// Called on shutdown.
+void my_platform_deinit(void);
 
 #endif  // MY_PLATFORM
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "my_retro_port.h"
+
+#include <stdio.h>
+
+#include <uni.h>
+
+#include "uni_autofire.h"
+#include "uni_common.h"
+#include "uni_gpio_hal.h"
+#include "uni_gpio_port.h"
+#include "uni_rt_timer.h"
+
+#define LINE(__line) BIT(MY_RETRO_PORT_LINE_##__line)
+#define LINES_DIRECTIONS (LINE(UP) | LINE(DOWN) | LINE(LEFT) | LINE(RIGHT))
+#define LINES_BUTTONS (LINE(FIRE) | LINE(BUTTON2) | LINE(BUTTON3))
+#define LINES_ALL (BIT(MY_RETRO_PORT_LINE_MAX) - 1)
+
+// GPIO of a line: line N of the chip.
+#define GPIO(__port_idx, __line) ((__port_idx) * MY_RETRO_PORT_LINE_MAX + MY_RETRO_PORT_LINE_##__line)
+
+typedef struct {
+    uni_gpio_port_t port;
+    // UNI_MOUSE_QUADRATURE_PORT_ of the port.
+    int quadrature_port;
+    int autofire_channel;
+    // Direction lines are driven by the quadrature encoder.
+    bool mouse_mode;
+} retro_port_t;
+
+static retro_port_t ports[MY_RETRO_PORT_COUNT];
+static bool initialized;
+
+static void stop_mouse(retro_port_t* p) {
+    if (!p->mouse_mode)
+        return;
+    uni_mouse_quadrature_pause(p->quadrature_port);
+    // Written by the encoder, outside the port.
+    uni_gpio_port_invalidate(&p->port, LINES_DIRECTIONS);
+    p->mouse_mode = false;
+}
+
+static void process_gamepad(retro_port_t* p, const uni_gamepad_t* gp) {
+    uni_joystick_t joy = {0};
+    uint32_t levels = 0;
+    uint32_t mask = LINES_ALL;
+
+    stop_mouse(p);
+
+    uni_joy_to_single_joy_from_gamepad(gp, &joy, true);
+    levels |= joy.up ? LINE(UP) : 0;
+    levels |= joy.down ? LINE(DOWN) : 0;
+    levels |= joy.left ? LINE(LEFT) : 0;
+    levels |= joy.right ? LINE(RIGHT) : 0;
+    levels |= joy.fire ? LINE(FIRE) : 0;
+    levels |= joy.button2 ? LINE(BUTTON2) : 0;
+    levels |= joy.button3 ? LINE(BUTTON3) : 0;
+
+    // Autofire owns the fire line while it is running.
+    // Stopped before the port update, so that fire gets its real value.
+    if (joy.auto_fire)
+        mask &= ~LINE(FIRE);
+    else
+        uni_autofire_stop(p->autofire_channel);
+
+    uni_gpio_port_write(&p->port, levels, mask);
+
+    if (joy.auto_fire)
+        uni_autofire_start(p->autofire_channel);
+}
+
+static void process_mouse(retro_port_t* p, const uni_mouse_t* ms) {
+    uint32_t levels = 0;
+
+    if (!p->mouse_mode) {
+        uni_autofire_stop(p->autofire_channel);
+        uni_mouse_quadrature_start(p->quadrature_port);
+        p->mouse_mode = true;
+    }
+
+    uni_mouse_quadrature_update(p->quadrature_port, ms->delta_x, ms->delta_y);
+    uni_gpio_port_invalidate(&p->port, LINES_DIRECTIONS);
+
+    if (ms->buttons & BUTTON_A)
+        levels |= LINE(FIRE);
+    if (ms->buttons & BUTTON_B)
+        levels |= LINE(BUTTON2);
+    if (ms->buttons & BUTTON_X)
+        levels |= LINE(BUTTON3);
+    uni_gpio_port_write(&p->port, levels, LINES_BUTTONS);
+}
+
+int my_retro_port_init(const char* gpiochip) {
+    uint64_t lines = 0;
+
+    uni_mouse_quadrature_init(0);
+    uni_autofire_init();
+
+    for (int i = 0; i < MY_RETRO_PORT_COUNT; i++) {
+        retro_port_t* p = &ports[i];
+        // Amiga pinout, same as Unijoysticle.
+        struct uni_mouse_quadrature_encoder_gpios h = {
+            .a = GPIO(i, DOWN),   // H-pulse
+            .b = GPIO(i, RIGHT),  // HQ-pulse
+        };
+        struct uni_mouse_quadrature_encoder_gpios v = {
+            .a = GPIO(i, LEFT),  // V-pulse
+            .b = GPIO(i, UP),    // VQ-pulse
+        };
+
+        uni_gpio_port_init(&p->port);
+        for (int j = 0; j < MY_RETRO_PORT_LINE_MAX; j++) {
+            uni_gpio_port_add_line(&p->port, i * MY_RETRO_PORT_LINE_MAX + j);
+            lines |= 1ULL << (i * MY_RETRO_PORT_LINE_MAX + j);
+        }
+
+        p->quadrature_port = (i == 0) ? UNI_MOUSE_QUADRATURE_PORT_0 : UNI_MOUSE_QUADRATURE_PORT_1;
+        uni_mouse_quadrature_setup_port(p->quadrature_port, h, v);
+        p->autofire_channel = uni_autofire_add_channel(&p->port, MY_RETRO_PORT_LINE_FIRE);
+        p->mouse_mode = false;
+    }
+
+    if (uni_gpio_hal_chardev_open(gpiochip, lines) != 0) {
+        uni_mouse_quadrature_deinit();
+        return -1;
+    }
+
+    for (int i = 0; i < MY_RETRO_PORT_COUNT; i++)
+        uni_gpio_port_write(&ports[i].port, 0, LINES_ALL);
+
+    initialized = true;
+    logi("retro_port: driving joystick ports A and B with %s\n", gpiochip);
+    return 0;
+}
+
+void my_retro_port_on_controller_data(uni_gamepad_seat_t seat, const uni_controller_t* ctl) {
+    if (!initialized)
+        return;
+
+    for (int i = 0; i < MY_RETRO_PORT_COUNT; i++) {
+        // Bit N of the seat is port N.
+        if (!(seat & BIT(i)))
+            continue;
+
+        switch (ctl->klass) {
+            case UNI_CONTROLLER_CLASS_GAMEPAD:
+                process_gamepad(&ports[i], &ctl->gamepad);
+                break;
+            case UNI_CONTROLLER_CLASS_MOUSE:
+                process_mouse(&ports[i], &ctl->mouse);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void my_retro_port_release(uni_gamepad_seat_t seat) {
+    if (!initialized)
+        return;
+
+    for (int i = 0; i < MY_RETRO_PORT_COUNT; i++) {
+        if (!(seat & BIT(i)))
+            continue;
+        stop_mouse(&ports[i]);
+        uni_autofire_stop(ports[i].autofire_channel);
+        uni_gpio_port_write(&ports[i].port, 0, LINES_ALL);
+    }
+}
+
+void my_retro_port_deinit(const char* vcd_path) {
+    FILE* f;
+
+    if (!initialized)
+        return;
+
+    my_retro_port_release(GAMEPAD_SEAT_A | GAMEPAD_SEAT_B);
+    uni_mouse_quadrature_deinit();
+    uni_gpio_port_dump(&ports[0].port, "retro_port A");
+    uni_gpio_port_dump(&ports[1].port, "retro_port B");
+    uni_autofire_dump();
+    uni_rt_timer_dump();
+    uni_gpio_hal_chardev_close();
+
+    if (vcd_path != NULL) {
+        f = fopen(vcd_path, "w");
+        if (f == NULL) {
+            loge("retro_port: failed to open %s\n", vcd_path);
+        } else {
+            uni_gpio_hal_trace_write_vcd(f);
+            fclose(f);
+            logi("retro_port: waveforms written to %s\n", vcd_path);
+        }
+    }
+    initialized = false;
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef MY_RETRO_PORT_H
+#define MY_RETRO_PORT_H
+
+#include <uni.h>
+
+// Drives two retro joystick ports (DB9) with the lines of a Linux GPIO chip, like the ones of a Raspberry Pi.
+// Line N of the chip is line N of port A, and line MY_RETRO_PORT_LINE_MAX + N is line N of port B: see the
+// MY_RETRO_PORT_LINE_ enum.
+// Each port is driven by the controller in its seat. Gamepads drive it as a joystick, with autofire, and mice as
+// an Amiga quadrature mouse: each port has its own quadrature encoders.
+
+enum {
+    MY_RETRO_PORT_LINE_UP,       // Pin 1
+    MY_RETRO_PORT_LINE_DOWN,     // Pin 2
+    MY_RETRO_PORT_LINE_LEFT,     // Pin 3
+    MY_RETRO_PORT_LINE_RIGHT,    // Pin 4
+    MY_RETRO_PORT_LINE_FIRE,     // Pin 6
+    MY_RETRO_PORT_LINE_BUTTON2,  // Pin 9
+    MY_RETRO_PORT_LINE_BUTTON3,  // Pin 5
+
+    MY_RETRO_PORT_LINE_MAX,
+};
+
+// Port A: GAMEPAD_SEAT_A, port B: GAMEPAD_SEAT_B.
+#define MY_RETRO_PORT_COUNT 2
+
+// Should be called from the BTstack thread, once Bluepad32 was initialized. Returns 0 on success.
+int my_retro_port_init(const char* gpiochip);
+// Only the ports of "seat" are updated. Reports from a seat without a port are ignored.
+void my_retro_port_on_controller_data(uni_gamepad_seat_t seat, const uni_controller_t* ctl);
+// Releases the lines of the ports of "seat". E.g: its controller was disconnected, or changed seats.
+void my_retro_port_release(uni_gamepad_seat_t seat);
+// Dumps the stats, and writes the recorded waveforms to "vcd_path", if not NULL.
+void my_retro_port_deinit(const char* vcd_path);
+
+#endif  // MY_RETRO_PORT_H
@@ -86,6 +86,11 @@ static struct {
     struct arg_end* end;
 } getprop_args;
 
+static struct {
+    struct arg_lit* reset;
+    struct arg_end* end;
+} bt_profile_args;
+
 static int list_devices(int argc, char** argv) {
     // FIXME: Should not belong to "bluetooth"
     uni_bt_dump_devices_safe();
@@ -96,6 +101,30 @@ static int list_devices(int argc, char** argv) {
     return 0;
 }
 
+static int conn_trace(int argc, char** argv) {
+    uni_bt_dump_conn_trace_safe();
+
+    // This function prints to console. print bp32> after a delay
+    TickType_t ticks = pdMS_TO_TICKS(250);
+    vTaskDelay(ticks);
+    return 0;
+}
+
+static int bt_profile(int argc, char** argv) {
+    int nerrors = arg_parse(argc, argv, (void**)&bt_profile_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, bt_profile_args.end, argv[0]);
+        return 1;
+    }
+
+    uni_bt_dump_profiler_safe(bt_profile_args.reset->count > 0);
+
+    // This function prints to console. print bp32> after a delay
+    TickType_t ticks = pdMS_TO_TICKS(250);
+    vTaskDelay(ticks);
+    return 0;
+}
+
 static void print_mouse_scale(void) {
     char buf[32];
     float scale = uni_mouse_quadrature_get_scale_factor();
@@ -222,6 +251,14 @@ static int ble_enable(int argc, char** argv) {
     return 0;
 }
 
+static int reconnect_bluetooth(int argc, char** argv) {
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    uni_bt_reconnect_safe();
+    return 0;
+}
+
 static int list_bluetooth_keys(int argc, char** argv) {
     ARG_UNUSED(argc);
     ARG_UNUSED(argv);
@@ -267,7 +304,7 @@ static int allowlist_list(int argc, char** argv) {
 }
 
 static int allowlist_add_addr(int argc, char** argv) {
-    bd_addr_t addr;
+    uni_bt_allowlist_rule_t rule;
 
     int nerrors = arg_parse(argc, argv, (void**)&allowlist_addr_args);
     if (nerrors != 0) {
@@ -275,13 +312,17 @@ static int allowlist_add_addr(int argc, char** argv) {
         return 1;
     }
 
-    sscanf_bd_addr(allowlist_addr_args.addr->sval[0], addr);
-    uni_bt_allowlist_add_addr(addr);
+    if (!uni_bt_allowlist_parse_rule(allowlist_addr_args.addr->sval[0], &rule)) {
+        logi("Invalid rule: %s\n", allowlist_addr_args.addr->sval[0]);
+        return 1;
+    }
+    if (!uni_bt_allowlist_add_rule_safe(&rule))
+        return 1;
     return 0;
 }
 
 static int allowlist_remove_addr(int argc, char** argv) {
-    bd_addr_t addr;
+    uni_bt_allowlist_rule_t rule;
 
     int nerrors = arg_parse(argc, argv, (void**)&allowlist_addr_args);
     if (nerrors != 0) {
@@ -289,8 +330,12 @@ static int allowlist_remove_addr(int argc, char** argv) {
         return 1;
     }
 
-    sscanf_bd_addr(allowlist_addr_args.addr->sval[0], addr);
-    uni_bt_allowlist_remove_addr(addr);
+    if (!uni_bt_allowlist_parse_rule(allowlist_addr_args.addr->sval[0], &rule)) {
+        logi("Invalid rule: %s\n", allowlist_addr_args.addr->sval[0]);
+        return 1;
+    }
+    if (!uni_bt_allowlist_remove_rule_safe(&rule))
+        return 1;
     return 0;
 }
 
@@ -308,7 +353,8 @@ static int allowlist_enable(int argc, char** argv) {
 
     enabled = allowlist_enable_args.enabled->ival[0];
 
-    uni_bt_allowlist_set_enabled(enabled);
+    if (!uni_bt_allowlist_set_enabled_safe(enabled))
+        return 1;
     return 0;
 }
 
@@ -384,7 +430,8 @@ static void register_bluepad32() {
     disconnect_device_args.idx = arg_int1(NULL, NULL, buf_disconnect, "Device index to disconnect");
     disconnect_device_args.end = arg_end(2);
 
-    allowlist_addr_args.addr = arg_str1(NULL, NULL, "<address>", "format: 01:23:45:67:89:ab");
+    allowlist_addr_args.addr =
+        arg_str1(NULL, NULL, "<rule>", "address: 01:23:45:67:89:ab, OUI: 01:23:45, or VID/PID in hex: 054c/05c4");
     allowlist_addr_args.end = arg_end(2);
     allowlist_enable_args.enabled = arg_int1(NULL, NULL, "<0 | 1>", "Whether allowlist should be enforced");
     allowlist_enable_args.end = arg_end(2);
@@ -395,6 +442,9 @@ static void register_bluepad32() {
     getprop_args.prop = arg_str1(NULL, NULL, "<property_name>", "Return property value");
     getprop_args.end = arg_end(2);
 
+    bt_profile_args.reset = arg_lit0("r", "reset", "Reset the stats after printing them");
+    bt_profile_args.end = arg_end(2);
+
     const esp_console_cmd_t cmd_list_devices = {
         .command = "list_devices",
         .help = "List info about connected devices",
@@ -402,6 +452,23 @@ static void register_bluepad32() {
         .func = &list_devices,
     };
 
+    const esp_console_cmd_t cmd_conn_trace = {
+        .command = "conn_trace",
+        .help = "Setup timeline of the last connections: p50 / p90 / max of each step",
+        .hint = NULL,
+        .func = &conn_trace,
+    };
+
+    const esp_console_cmd_t cmd_bt_profile = {
+        .command = "bt_profile",
+        .help =
+            "Time spent in each Bluetooth handler, timer and callback. Needs CONFIG_BLUEPAD32_RUN_LOOP_PROFILER\n"
+            "  Example: bt_profile --reset",
+        .hint = NULL,
+        .func = &bt_profile,
+        .argtable = &bt_profile_args,
+    };
+
     const esp_console_cmd_t cmd_mouse_scale = {
         .command = "mouse_scale",
         .help =
@@ -465,6 +532,13 @@ static void register_bluepad32() {
         .func = &list_bluetooth_keys,
     };
 
+    const esp_console_cmd_t cmd_reconnect = {
+        .command = "reconnect",
+        .help = "Pages the bonded BR/EDR controllers",
+        .hint = NULL,
+        .func = &reconnect_bluetooth,
+    };
+
     const esp_console_cmd_t cmd_del_bluetooth_keys = {
         .command = "del_bluetooth_keys",
         .help = "Delete stored Bluetooth keys. 'Unpairs' devices",
@@ -482,14 +556,14 @@ static void register_bluepad32() {
 
     const esp_console_cmd_t cmd_allowlist_list = {
         .command = "allowlist_list",
-        .help = "List allowlist addresses",
+        .help = "List allowlist rules",
         .hint = NULL,
         .func = &allowlist_list,
     };
 
     const esp_console_cmd_t cmd_allowlist_add = {
         .command = "allowlist_add",
-        .help = "Add address to allowlist list",
+        .help = "Add address, OUI or VID/PID to allowlist list",
         .hint = NULL,
         .func = &allowlist_add_addr,
         .argtable = &allowlist_addr_args,
@@ -497,7 +571,7 @@ static void register_bluepad32() {
 
     const esp_console_cmd_t cmd_allowlist_remove = {
         .command = "allowlist_remove",
-        .help = "Remove address from allowlist list",
+        .help = "Remove address, OUI or VID/PID from allowlist list",
         .hint = NULL,
         .func = &allowlist_remove_addr,
         .argtable = &allowlist_addr_args,
@@ -528,11 +602,14 @@ static void register_bluepad32() {
     };
 
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_list_devices));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_conn_trace));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_bt_profile));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_disconnect_device));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_gap_security_level));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_gap_periodic_inquiry));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_list_bluetooth_keys));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_del_bluetooth_keys));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_reconnect));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_incoming_connections_enable));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_scan_and_autoconnect));
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_ble_enable));
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_gpio_hal.h"
+
+#include <driver/gpio.h>
+
+#include "sdkconfig.h"
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+#include <soc/gpio_struct.h>
+#endif
+
+int uni_gpio_hal_set_level(int gpio, bool level) {
+    if (gpio == -1)
+        return 0;
+    return gpio_set_level(gpio, level);
+}
+
+bool uni_gpio_hal_get_level(int gpio) {
+    if (gpio == -1)
+        return false;
+    return gpio_get_level(gpio);
+}
+
+void uni_gpio_hal_write_mask(uint64_t set, uint64_t clear) {
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    // Back-to-back register writes: all the lines change within a few cycles.
+    if ((uint32_t)set)
+        GPIO.out_w1ts = (uint32_t)set;
+    if ((uint32_t)clear)
+        GPIO.out_w1tc = (uint32_t)clear;
+    if (set >> 32)
+        GPIO.out1_w1ts.val = set >> 32;
+    if (clear >> 32)
+        GPIO.out1_w1tc.val = clear >> 32;
+#else
+    // No direct access to the registers in this target: one call per GPIO.
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (set & BIT64(i))
+            gpio_set_level(i, 1);
+        else if (clear & BIT64(i))
+            gpio_set_level(i, 0);
+    }
+#endif
+}
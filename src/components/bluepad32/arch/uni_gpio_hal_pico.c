@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_gpio_hal.h"
+
+// Pico W doesn't drive any retro port: the GPIO numbers are the ESP32 ones.
+// Simulated register. Bit N is GPIO N.
+static uint64_t sim_output;
+
+int uni_gpio_hal_set_level(int gpio, bool level) {
+    if (gpio < 0 || gpio >= UNI_GPIO_HAL_MAX_GPIOS)
+        return gpio == -1 ? 0 : -1;
+    if (level)
+        sim_output |= 1ULL << gpio;
+    else
+        sim_output &= ~(1ULL << gpio);
+    return 0;
+}
+
+bool uni_gpio_hal_get_level(int gpio) {
+    if (gpio < 0 || gpio >= UNI_GPIO_HAL_MAX_GPIOS)
+        return false;
+    return (sim_output >> gpio) & 1;
+}
+
+void uni_gpio_hal_write_mask(uint64_t set, uint64_t clear) {
+    sim_output = (sim_output | set) & ~clear;
+}
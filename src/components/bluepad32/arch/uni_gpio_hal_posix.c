@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_gpio_hal.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include "uni_log.h"
+
+typedef struct {
+    // Since the trace was reset.
+    uint64_t time_ns;
+    uint8_t gpio;
+    bool level;
+} trace_event_t;
+
+#ifdef __linux__
+// Line request of the GPIO chip.
+typedef struct {
+    // -1 if there is no line request.
+    int fd;
+    // Bit N: GPIO N is part of the request.
+    uint64_t lines;
+    // Position of each GPIO in the request. Bit N of the request values is the line at position N.
+    uint8_t index[UNI_GPIO_HAL_MAX_GPIOS];
+    // Stats
+    uint32_t writes;
+    uint32_t errors;
+} chardev_t;
+
+static chardev_t chardev = {
+    .fd = -1,
+};
+#endif  // __linux__
+
+// Written from the BTstack thread and the realtime timer thread.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Simulated register. Bit N is GPIO N.
+static uint64_t sim_output;
+
+static trace_event_t trace_events[UNI_GPIO_HAL_TRACE_MAX_EVENTS];
+static int trace_count;
+static uint64_t trace_start_ns;
+// Levels when the trace was reset.
+static uint64_t trace_start_output;
+static bool trace_full_reported;
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void trace_reset(void) {
+    trace_count = 0;
+    trace_full_reported = false;
+    trace_start_ns = get_time_ns();
+    trace_start_output = sim_output;
+}
+
+#ifdef __linux__
+// Converts a GPIO mask into a mask of positions in the line request.
+static uint64_t chardev_get_bits(uint64_t gpios) {
+    uint64_t bits = 0;
+    int gpio;
+
+    gpios &= chardev.lines;
+    while (gpios) {
+        gpio = __builtin_ctzll(gpios);
+        bits |= 1ULL << chardev.index[gpio];
+        gpios &= gpios - 1;
+    }
+    return bits;
+}
+
+static void chardev_write(uint64_t output, uint64_t changed) {
+    struct gpio_v2_line_values values;
+
+    if (chardev.fd < 0 || !(changed & chardev.lines))
+        return;
+
+    // Whole port at once.
+    values.mask = chardev_get_bits(changed);
+    values.bits = chardev_get_bits(output & changed);
+    chardev.writes++;
+    if (ioctl(chardev.fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0) {
+        // Only the first one, to prevent flooding the log.
+        if (chardev.errors == 0)
+            loge("gpio_hal: failed to set line values: %s\n", strerror(errno));
+        chardev.errors++;
+    }
+}
+#endif  // __linux__
+
+// Records the GPIOs that changed, and updates the register.
+// Should be called with the mutex held.
+static void update_output(uint64_t new_output) {
+    uint64_t changed = sim_output ^ new_output;
+    uint64_t now;
+
+    // Starts recording with the first change, if it was never reset.
+    if (trace_start_ns == 0)
+        trace_reset();
+
+    sim_output = new_output;
+    if (!changed)
+        return;
+
+#ifdef __linux__
+    chardev_write(new_output, changed);
+#endif  // __linux__
+
+    // Same timestamp for all of them: they changed at once.
+    now = get_time_ns() - trace_start_ns;
+    for (int i = 0; i < UNI_GPIO_HAL_MAX_GPIOS; i++) {
+        if (!(changed & (1ULL << i)))
+            continue;
+        if (trace_count >= UNI_GPIO_HAL_TRACE_MAX_EVENTS) {
+            if (!trace_full_reported)
+                logi("gpio_hal: trace is full, not recording more changes\n");
+            trace_full_reported = true;
+            return;
+        }
+        trace_events[trace_count++] = (trace_event_t){
+            .time_ns = now,
+            .gpio = i,
+            .level = (new_output >> i) & 1,
+        };
+    }
+}
+
+int uni_gpio_hal_set_level(int gpio, bool level) {
+    if (gpio < 0 || gpio >= UNI_GPIO_HAL_MAX_GPIOS)
+        return gpio == -1 ? 0 : -1;
+    pthread_mutex_lock(&mutex);
+    if (level)
+        update_output(sim_output | (1ULL << gpio));
+    else
+        update_output(sim_output & ~(1ULL << gpio));
+    pthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+bool uni_gpio_hal_get_level(int gpio) {
+    bool level;
+
+    if (gpio < 0 || gpio >= UNI_GPIO_HAL_MAX_GPIOS)
+        return false;
+    pthread_mutex_lock(&mutex);
+    level = (sim_output >> gpio) & 1;
+    pthread_mutex_unlock(&mutex);
+    return level;
+}
+
+void uni_gpio_hal_write_mask(uint64_t set, uint64_t clear) {
+    pthread_mutex_lock(&mutex);
+    update_output((sim_output | set) & ~clear);
+    pthread_mutex_unlock(&mutex);
+}
+
+void uni_gpio_hal_trace_reset(void) {
+    pthread_mutex_lock(&mutex);
+    trace_reset();
+    pthread_mutex_unlock(&mutex);
+}
+
+int uni_gpio_hal_trace_get_count(void) {
+    int count;
+
+    pthread_mutex_lock(&mutex);
+    count = trace_count;
+    pthread_mutex_unlock(&mutex);
+    return count;
+}
+
+void uni_gpio_hal_trace_write_vcd(FILE* f) {
+    uint64_t used = 0;
+    uint64_t last_time = 0;
+
+    pthread_mutex_lock(&mutex);
+
+    for (int i = 0; i < trace_count; i++)
+        used |= 1ULL << trace_events[i].gpio;
+
+    fprintf(f, "$timescale 1 ns $end\n");
+    fprintf(f, "$scope module bluepad32 $end\n");
+    // One printable identifier per GPIO: '!' + GPIO number.
+    for (int i = 0; i < UNI_GPIO_HAL_MAX_GPIOS; i++) {
+        if (used & (1ULL << i))
+            fprintf(f, "$var wire 1 %c gpio%d $end\n", '!' + i, i);
+    }
+    fprintf(f, "$upscope $end\n");
+    fprintf(f, "$enddefinitions $end\n");
+
+    // Initial levels
+    fprintf(f, "#0\n$dumpvars\n");
+    for (int i = 0; i < UNI_GPIO_HAL_MAX_GPIOS; i++) {
+        if (used & (1ULL << i))
+            fprintf(f, "%d%c\n", (int)((trace_start_output >> i) & 1), '!' + i);
+    }
+    fprintf(f, "$end\n");
+
+    for (int i = 0; i < trace_count; i++) {
+        const trace_event_t* e = &trace_events[i];
+        if (e->time_ns != last_time) {
+            fprintf(f, "#%llu\n", (unsigned long long)e->time_ns);
+            last_time = e->time_ns;
+        }
+        fprintf(f, "%d%c\n", e->level, '!' + e->gpio);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+#ifdef __linux__
+int uni_gpio_hal_chardev_open(const char* path, uint64_t lines) {
+    struct gpio_v2_line_request req;
+    int chip_fd;
+    int ret = -1;
+    int n = 0;
+
+    uni_gpio_hal_chardev_close();
+
+    memset(&req, 0, sizeof(req));
+    pthread_mutex_lock(&mutex);
+
+    for (int i = 0; i < UNI_GPIO_HAL_MAX_GPIOS; i++) {
+        if (!(lines & (1ULL << i)))
+            continue;
+        req.offsets[n] = i;
+        chardev.index[i] = n;
+        n++;
+    }
+    chardev.lines = lines;
+
+    req.num_lines = n;
+    strncpy(req.consumer, "bluepad32", sizeof(req.consumer) - 1);
+    req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    // Same levels as the simulated register, so that they don't glitch when requested.
+    req.config.num_attrs = 1;
+    req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    req.config.attrs[0].attr.values = chardev_get_bits(sim_output);
+    req.config.attrs[0].mask = chardev_get_bits(lines);
+
+    if (n == 0) {
+        loge("gpio_hal: no lines to request\n");
+        goto out;
+    }
+
+    chip_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (chip_fd < 0) {
+        loge("gpio_hal: failed to open %s: %s\n", path, strerror(errno));
+        goto out;
+    }
+    ret = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+    if (ret < 0)
+        loge("gpio_hal: failed to request lines from %s: %s\n", path, strerror(errno));
+    // The line request has its own fd.
+    close(chip_fd);
+    if (ret < 0)
+        goto out;
+
+    chardev.fd = req.fd;
+    chardev.writes = 0;
+    chardev.errors = 0;
+    logi("gpio_hal: driving %d lines of %s\n", n, path);
+
+out:
+    if (ret < 0)
+        chardev.lines = 0;
+    pthread_mutex_unlock(&mutex);
+    return ret < 0 ? -1 : 0;
+}
+
+void uni_gpio_hal_chardev_close(void) {
+    pthread_mutex_lock(&mutex);
+    if (chardev.fd >= 0) {
+        logi("gpio_hal: releasing lines, writes=%u, errors=%u\n", (unsigned int)chardev.writes,
+             (unsigned int)chardev.errors);
+        close(chardev.fd);
+    }
+    chardev.fd = -1;
+    chardev.lines = 0;
+    pthread_mutex_unlock(&mutex);
+}
+#else
+int uni_gpio_hal_chardev_open(const char* path, uint64_t lines) {
+    (void)lines;
+    loge("gpio_hal: cannot open %s, GPIO character devices are only supported in Linux\n", path);
+    return -1;
+}
+
+void uni_gpio_hal_chardev_close(void) {}
+#endif  // __linux__
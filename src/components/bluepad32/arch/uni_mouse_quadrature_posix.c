@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Posix version of uni_mouse_quadrature.c
+// Same generator, but the steps are paced by the realtime timer thread instead of hardware timers.
+#include "uni_mouse_quadrature.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "uni_log.h"
+#include "uni_property.h"
+#include "uni_quadrature_gen.h"
+#include "uni_rt_timer.h"
+
+// A mouse has two encoders.
+struct quadrature_state {
+    int port_idx;
+
+    // GPIOs used
+    struct uni_mouse_quadrature_encoder_gpios gpios;
+
+    // Emits the waveform. Stepped from the timer thread.
+    uni_quadrature_gen_t gen;
+    uni_rt_timer_t timer;
+    // Period between steps, in microseconds. Set on every report.
+    atomic_uint period_us;
+};
+
+static struct quadrature_state s_quadratures[UNI_MOUSE_QUADRATURE_PORT_MAX][UNI_MOUSE_QUADRATURE_ENCODER_MAX];
+static atomic_bool timer_started[UNI_MOUSE_QUADRATURE_PORT_MAX];
+// Report interval of the mouse of each port.
+static uni_quadrature_rate_t s_rates[UNI_MOUSE_QUADRATURE_PORT_MAX];
+
+// "Scale factor" for mouse movement. To make the mouse move faster or slower.
+static float s_scale_factor;
+// Same, in 8.8 fixed point.
+static uint32_t s_scale_fixed;
+
+static bool initialized;
+
+static void timer_callback(void* arg) {
+    struct quadrature_state* q = arg;
+
+    // Paused while the callback was pending.
+    if (!atomic_load(&timer_started[q->port_idx]))
+        return;
+    // Nothing left: the next report arms it again.
+    if (!uni_quadrature_gen_step(&q->gen))
+        return;
+    uni_rt_timer_arm(&q->timer, atomic_load(&q->period_us));
+}
+
+static void process_update(struct quadrature_state* q, bool started, int32_t delta, uint32_t interval_us) {
+    uint32_t period_us;
+
+    period_us = uni_quadrature_gen_add_motion(&q->gen, delta, s_scale_fixed, interval_us);
+    if (period_us == 0)
+        return;
+    atomic_store(&q->period_us, period_us);
+
+    // Otherwise, the new period is used from the next step.
+    if (started && !uni_rt_timer_is_armed(&q->timer))
+        uni_rt_timer_arm(&q->timer, period_us);
+}
+
+static void set_scale(float scale) {
+    s_scale_factor = scale;
+    // Only converted when it changes. Reports are processed in fixed point.
+    s_scale_fixed = lroundf(scale * UNI_QUADRATURE_GEN_SCALE_ONE);
+}
+
+void uni_mouse_quadrature_init(int cpu_id) {
+    // There is no CPU affinity: all the encoders share the timer thread.
+    (void)cpu_id;
+
+    memset(s_quadratures, 0, sizeof(s_quadratures));
+
+    for (int i = 0; i < UNI_MOUSE_QUADRATURE_PORT_MAX; i++) {
+        atomic_init(&timer_started[i], false);
+        uni_quadrature_rate_init(&s_rates[i]);
+        for (int j = 0; j < UNI_MOUSE_QUADRATURE_ENCODER_MAX; j++) {
+            s_quadratures[i][j].port_idx = i;
+            atomic_init(&s_quadratures[i][j].period_us, 0);
+            uni_rt_timer_init(&s_quadratures[i][j].timer, timer_callback, &s_quadratures[i][j]);
+        }
+    }
+
+    // Default value that can be overridden from the console
+    s_scale_factor = uni_mouse_quadrature_get_scale_factor();
+
+    initialized = true;
+}
+
+void uni_mouse_quadrature_setup_port(int port_idx,
+                                     struct uni_mouse_quadrature_encoder_gpios h,
+                                     struct uni_mouse_quadrature_encoder_gpios v) {
+    if (port_idx < 0 || port_idx >= UNI_MOUSE_QUADRATURE_PORT_MAX) {
+        loge("%s: Invalid port idx=%d\n", __func__, port_idx);
+        return;
+    }
+    s_quadratures[port_idx][UNI_MOUSE_QUADRATURE_ENCODER_H].gpios = h;
+    s_quadratures[port_idx][UNI_MOUSE_QUADRATURE_ENCODER_V].gpios = v;
+    uni_quadrature_gen_init(&s_quadratures[port_idx][UNI_MOUSE_QUADRATURE_ENCODER_H].gen, h.a, h.b);
+    uni_quadrature_gen_init(&s_quadratures[port_idx][UNI_MOUSE_QUADRATURE_ENCODER_V].gen, v.a, v.b);
+}
+
+void uni_mouse_quadrature_deinit(void) {
+    for (int i = 0; i < UNI_MOUSE_QUADRATURE_PORT_MAX; i++)
+        uni_mouse_quadrature_pause(i);
+
+    initialized = false;
+}
+
+void uni_mouse_quadrature_start(int port_idx) {
+    if (!initialized) {
+        loge("%s: Error, Not initialized\n", __func__);
+        return;
+    }
+
+    if (port_idx < 0 || port_idx >= UNI_MOUSE_QUADRATURE_PORT_MAX) {
+        loge("%s: Invalid port idx=%d\n", __func__, port_idx);
+        return;
+    }
+
+    if (atomic_exchange(&timer_started[port_idx], true))
+        return;
+
+    // Timers are armed on demand, when there are steps to emit.
+    for (int j = 0; j < UNI_MOUSE_QUADRATURE_ENCODER_MAX; j++) {
+        struct quadrature_state* q = &s_quadratures[port_idx][j];
+        if (atomic_load(&q->gen.pending) != 0)
+            uni_rt_timer_arm(&q->timer, atomic_load(&q->period_us));
+    }
+}
+
+void uni_mouse_quadrature_pause(int port_idx) {
+    if (!initialized) {
+        loge("%s: Error, Not initialized\n", __func__);
+        return;
+    }
+
+    if (port_idx < 0 || port_idx >= UNI_MOUSE_QUADRATURE_PORT_MAX) {
+        loge("%s: Invalid port idx=%d\n", __func__, port_idx);
+        return;
+    }
+
+    if (!atomic_exchange(&timer_started[port_idx], false))
+        return;
+
+    for (int j = 0; j < UNI_MOUSE_QUADRATURE_ENCODER_MAX; j++)
+        uni_rt_timer_disarm(&s_quadratures[port_idx][j].timer);
+}
+
+// Should be called everytime that mouse report is received.
+void uni_mouse_quadrature_update(int port_idx, int32_t dx, int32_t dy) {
+    uint32_t interval_us;
+    bool started;
+
+    if (!initialized) {
+        loge("%s: Error, Not initialized\n", __func__);
+        return;
+    }
+    if (port_idx < 0 || port_idx >= UNI_MOUSE_QUADRATURE_PORT_MAX) {
+        loge("%s: Invalid port idx=%d\n", __func__, port_idx);
+        return;
+    }
+    interval_us = uni_quadrature_rate_update(&s_rates[port_idx], uni_rt_timer_get_time_us());
+    started = atomic_load(&timer_started[port_idx]);
+
+    process_update(&s_quadratures[port_idx][UNI_MOUSE_QUADRATURE_ENCODER_H], started, dx, interval_us);
+    // Invert delta Y so that mouse goes the right direction. Same as ESP32.
+    process_update(&s_quadratures[port_idx][UNI_MOUSE_QUADRATURE_ENCODER_V], started, -dy, interval_us);
+}
+
+void uni_mouse_quadrature_set_scale_factor(float scale) {
+    uni_property_value_t value;
+    value.f32 = scale;
+
+    set_scale(scale);
+    uni_property_set(UNI_PROPERTY_IDX_MOUSE_SCALE, value);
+}
+
+float uni_mouse_quadrature_get_scale_factor(void) {
+    uni_property_value_t value;
+
+    value = uni_property_get(UNI_PROPERTY_IDX_MOUSE_SCALE);
+    set_scale(value.f32);
+    return value.f32;
+}
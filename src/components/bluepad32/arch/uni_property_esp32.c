@@ -52,6 +52,9 @@ void uni_property_set_with_property(const uni_property_t* p, uni_property_value_
         case UNI_PROPERTY_TYPE_STRING:
             err = nvs_set_str(nvs_handle, p->name, value.str);
             break;
+        case UNI_PROPERTY_TYPE_BLOB:
+            err = nvs_set_blob(nvs_handle, p->name, value.blob.data, value.blob.size);
+            break;
     }
 
     if (err != ESP_OK) {
@@ -104,6 +107,10 @@ uni_property_value_t uni_property_get_with_property(const uni_property_t* p) {
             memset(str_ret, 0, sizeof(str_ret));
             err = nvs_get_str(nvs_handle, p->name, str_ret, &str_len);
             break;
+        case UNI_PROPERTY_TYPE_BLOB:
+            // Use uni_property_get_blob_with_property() instead.
+            ret = p->default_value;
+            break;
     }
 
     if (err != ESP_OK) {
@@ -117,6 +124,34 @@ uni_property_value_t uni_property_get_with_property(const uni_property_t* p) {
     return ret;
 }
 
+int uni_property_get_blob_with_property(const uni_property_t* p, void* buf, int size) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+    size_t len = size;
+
+    if (!p) {
+        loge("Cannot get invalid property\n");
+        return 0;
+    }
+
+    err = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        // Might be valid if no bp32 keys were stored
+        logd("Could not open readonly NVS storage, key:'%s'\n", p->name);
+        return 0;
+    }
+
+    err = nvs_get_blob(nvs_handle, p->name, buf, &len);
+    if (err != ESP_OK) {
+        // Might be valid if the key was not previously stored
+        logd("could not read property '%s' from NVS, err=%#x\n", p->name, err);
+        len = 0;
+    }
+
+    nvs_close(nvs_handle);
+    return len;
+}
+
 void uni_property_init() {
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
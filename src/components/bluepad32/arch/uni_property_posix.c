@@ -68,6 +68,10 @@ void uni_property_set_with_property(const uni_property_t* p, uni_property_value_
             data = (uint8_t*)&value.f32;
             size = sizeof(value.f32);
             break;
+        case UNI_PROPERTY_TYPE_BLOB:
+            data = (uint8_t*)value.blob.data;
+            size = value.blob.size;
+            break;
         default:
             loge("uni_property_set_with_property: unsupported type %d\n", p->type);
             return;
@@ -89,6 +93,11 @@ uni_property_value_t uni_property_get_with_property(const uni_property_t* p) {
         return value;
     }
 
+    if (p->type == UNI_PROPERTY_TYPE_BLOB) {
+        // Use uni_property_get_blob_with_property() instead.
+        return p->default_value;
+    }
+
     if (p->type == UNI_PROPERTY_TYPE_STRING) {
         loge("No TLV for %s, returning default value\n", p->name);
         return p->default_value;
@@ -121,6 +130,26 @@ uni_property_value_t uni_property_get_with_property(const uni_property_t* p) {
     return value;
 }
 
+int uni_property_get_blob_with_property(const uni_property_t* p, void* buf, int size) {
+    int read;
+
+    if (!p) {
+        loge("Invalid get property\n");
+        return 0;
+    }
+
+    read = tlv_impl->get_tag(tlv_context_ptr, posix_get_tag_for_index(p->idx), (uint8_t*)buf, size);
+    if (read == 0) {
+        logd("Property %s not found in DB\n", p->name);
+        return 0;
+    }
+    if (read > size) {
+        loge("Property %s too big: %d > %d\n", p->name, read, size);
+        return 0;
+    }
+    return read;
+}
+
 void uni_property_init(void) {
     get_or_create_instance_tlv();
     uni_property_init_debug();
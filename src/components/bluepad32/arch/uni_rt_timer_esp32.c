@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_rt_timer.h"
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "uni_log.h"
+
+// esp_timer already runs the callbacks from a high priority task. This only adds the bookkeeping that the
+// Posix implementation has: "is armed", and the stats.
+
+static uni_rt_timer_t* timers[UNI_RT_TIMER_MAX];
+static int timers_count;
+
+// Protects the deadlines. The esp_timer task might run on the other core.
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+// uni_rt_timer_lock()
+static SemaphoreHandle_t callback_mutex;
+
+// Stats
+static uint32_t fired;
+// How late a timer fired, in the worst case.
+static uint32_t max_late_us;
+
+static void timer_callback(void* arg) {
+    uni_rt_timer_t* t = arg;
+    int64_t now = esp_timer_get_time();
+    int64_t deadline;
+
+    portENTER_CRITICAL(&mux);
+    deadline = t->deadline_us;
+    // Disarmed, or re-armed, after esp_timer dispatched it. The re-armed one fires later.
+    if (deadline == 0 || now < deadline) {
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+    if (now - deadline > max_late_us)
+        max_late_us = (uint32_t)(now - deadline);
+    fired++;
+    // Disarmed before the callback, so that it can re-arm itself.
+    t->deadline_us = 0;
+    portEXIT_CRITICAL(&mux);
+
+    t->callback(t->arg);
+}
+
+int uni_rt_timer_init(uni_rt_timer_t* t, uni_rt_timer_callback_t callback, void* arg) {
+    esp_err_t err;
+    const esp_timer_create_args_t args = {
+        .callback = timer_callback,
+        .arg = t,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "bp.rt_timer",
+    };
+
+    // Called from the BTstack thread, while the platform is being initialized.
+    if (callback_mutex == NULL)
+        callback_mutex = xSemaphoreCreateMutex();
+
+    t->callback = callback;
+    t->arg = arg;
+    t->deadline_us = 0;
+
+    // Already registered ?
+    for (int i = 0; i < timers_count; i++) {
+        if (timers[i] == t)
+            return 0;
+    }
+
+    if (timers_count >= UNI_RT_TIMER_MAX) {
+        loge("rt_timer: no free timers\n");
+        return -1;
+    }
+    err = esp_timer_create(&args, &t->handle);
+    if (err != ESP_OK) {
+        loge("rt_timer: could not create timer: %s\n", esp_err_to_name(err));
+        return -1;
+    }
+    timers[timers_count++] = t;
+    return 0;
+}
+
+void uni_rt_timer_arm(uni_rt_timer_t* t, int64_t delay_us) {
+    if (delay_us < 0)
+        delay_us = 0;
+
+    portENTER_CRITICAL(&mux);
+    // 0 means "not armed".
+    t->deadline_us = esp_timer_get_time() + delay_us;
+    if (t->deadline_us == 0)
+        t->deadline_us = 1;
+    portEXIT_CRITICAL(&mux);
+
+    // esp_timer_start_once() fails if it is already armed. Stopping a timer that is not armed fails as well:
+    // safe to ignore.
+    esp_timer_stop(t->handle);
+    esp_timer_start_once(t->handle, delay_us);
+}
+
+void uni_rt_timer_disarm(uni_rt_timer_t* t) {
+    portENTER_CRITICAL(&mux);
+    t->deadline_us = 0;
+    portEXIT_CRITICAL(&mux);
+    esp_timer_stop(t->handle);
+}
+
+bool uni_rt_timer_is_armed(uni_rt_timer_t* t) {
+    bool armed;
+
+    portENTER_CRITICAL(&mux);
+    armed = (t->deadline_us != 0);
+    portEXIT_CRITICAL(&mux);
+    return armed;
+}
+
+int64_t uni_rt_timer_get_time_us(void) {
+    return esp_timer_get_time();
+}
+
+void uni_rt_timer_lock(void) {
+    xSemaphoreTake(callback_mutex, portMAX_DELAY);
+}
+
+void uni_rt_timer_unlock(void) {
+    xSemaphoreGive(callback_mutex);
+}
+
+void uni_rt_timer_dump(void) {
+    logi("\tRT timers: %d, fired=%u, max late=%u us\n", timers_count, (unsigned int)fired,
+         (unsigned int)max_late_us);
+}
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_rt_timer.h"
+
+#include <pico/critical_section.h>
+#include <pico/time.h>
+
+#include "uni_log.h"
+
+// Uses the default alarm pool: the callbacks are called from its timer IRQ.
+
+// Used when the deadline was already past when arming it.
+#define MIN_DELAY_US 10
+
+static uni_rt_timer_t* timers[UNI_RT_TIMER_MAX];
+static int timers_count;
+static bool initialized;
+
+// Protects the deadlines and the alarm IDs.
+static critical_section_t cs;
+// uni_rt_timer_lock(). Taken by the callbacks, so it can't be the one above.
+static critical_section_t callback_cs;
+
+// Stats
+static uint32_t fired;
+// How late a timer fired, in the worst case.
+static uint32_t max_late_us;
+
+static int64_t alarm_callback(alarm_id_t id, void* user_data) {
+    uni_rt_timer_t* t = user_data;
+    int64_t now = (int64_t)time_us_64();
+
+    critical_section_enter_blocking(&cs);
+    // Disarmed, or re-armed, after the alarm fired. The re-armed one fires later.
+    if (t->alarm_id != id || t->deadline_us == 0) {
+        critical_section_exit(&cs);
+        return 0;
+    }
+    if (now - t->deadline_us > max_late_us)
+        max_late_us = (uint32_t)(now - t->deadline_us);
+    fired++;
+    // Disarmed before the callback, so that it can re-arm itself.
+    t->deadline_us = 0;
+    t->alarm_id = 0;
+    critical_section_exit(&cs);
+
+    t->callback(t->arg);
+    // Not rescheduled.
+    return 0;
+}
+
+int uni_rt_timer_init(uni_rt_timer_t* t, uni_rt_timer_callback_t callback, void* arg) {
+    // Called from the BTstack loop, while the platform is being initialized.
+    if (!initialized) {
+        critical_section_init(&cs);
+        critical_section_init(&callback_cs);
+        initialized = true;
+    }
+
+    t->callback = callback;
+    t->arg = arg;
+    t->deadline_us = 0;
+    t->alarm_id = 0;
+
+    // Already registered ?
+    for (int i = 0; i < timers_count; i++) {
+        if (timers[i] == t)
+            return 0;
+    }
+
+    if (timers_count >= UNI_RT_TIMER_MAX) {
+        loge("rt_timer: no free timers\n");
+        return -1;
+    }
+    timers[timers_count++] = t;
+    return 0;
+}
+
+void uni_rt_timer_arm(uni_rt_timer_t* t, int64_t delay_us) {
+    alarm_id_t id;
+
+    if (delay_us < 0)
+        delay_us = 0;
+
+    // Held while the alarm is added: otherwise it could fire before its ID is stored, and be ignored.
+    critical_section_enter_blocking(&cs);
+    if (t->alarm_id > 0)
+        cancel_alarm(t->alarm_id);
+    t->alarm_id = 0;
+
+    // 0 means "not armed".
+    t->deadline_us = (int64_t)time_us_64() + delay_us;
+    if (t->deadline_us == 0)
+        t->deadline_us = 1;
+
+    // Not "fire_if_past": it would call the callback from here, with the locks taken.
+    // It returns 0 if the deadline is already past: it is moved forward instead.
+    id = add_alarm_in_us(delay_us, alarm_callback, t, false);
+    if (id == 0)
+        id = add_alarm_in_us(MIN_DELAY_US, alarm_callback, t, false);
+    if (id > 0)
+        t->alarm_id = id;
+    else
+        t->deadline_us = 0;
+    critical_section_exit(&cs);
+
+    if (id <= 0)
+        loge("rt_timer: could not add alarm: %d\n", (int)id);
+}
+
+void uni_rt_timer_disarm(uni_rt_timer_t* t) {
+    critical_section_enter_blocking(&cs);
+    if (t->alarm_id > 0)
+        cancel_alarm(t->alarm_id);
+    t->alarm_id = 0;
+    t->deadline_us = 0;
+    critical_section_exit(&cs);
+}
+
+bool uni_rt_timer_is_armed(uni_rt_timer_t* t) {
+    bool armed;
+
+    critical_section_enter_blocking(&cs);
+    armed = (t->deadline_us != 0);
+    critical_section_exit(&cs);
+    return armed;
+}
+
+int64_t uni_rt_timer_get_time_us(void) {
+    return (int64_t)time_us_64();
+}
+
+void uni_rt_timer_lock(void) {
+    critical_section_enter_blocking(&callback_cs);
+}
+
+void uni_rt_timer_unlock(void) {
+    critical_section_exit(&callback_cs);
+}
+
+void uni_rt_timer_dump(void) {
+    logi("\tRT timers: %d, fired=%u, max late=%u us\n", timers_count, (unsigned int)fired,
+         (unsigned int)max_late_us);
+}
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_rt_timer.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "uni_log.h"
+
+static uni_rt_timer_t* timers[UNI_RT_TIMER_MAX];
+static int timers_count;
+
+// Protects the timers. Not held while the callbacks are called.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+// uni_rt_timer_lock(). Taken by the callbacks, so it can't be the one above.
+static pthread_mutex_t callback_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Signaled when a timer is armed, since it might expire before the one being waited for.
+static pthread_cond_t cond;
+static pthread_t thread;
+static bool thread_started;
+static bool thread_realtime;
+
+// Stats
+static uint32_t fired;
+// How late a timer fired, in the worst case.
+static uint32_t max_late_us;
+
+static void* thread_main(void* arg) {
+    uni_rt_timer_t* due;
+    uni_rt_timer_callback_t callback;
+    void* callback_arg;
+    int64_t now;
+    struct timespec ts;
+
+    (void)arg;
+
+    pthread_mutex_lock(&mutex);
+    while (true) {
+        // Earliest armed timer.
+        due = NULL;
+        for (int i = 0; i < timers_count; i++) {
+            if (timers[i]->deadline_us == 0)
+                continue;
+            if (due == NULL || timers[i]->deadline_us < due->deadline_us)
+                due = timers[i];
+        }
+
+        if (due == NULL) {
+            pthread_cond_wait(&cond, &mutex);
+            continue;
+        }
+
+        now = uni_rt_timer_get_time_us();
+        if (due->deadline_us > now) {
+            // Might be woken up before: a timer was armed.
+            ts.tv_sec = due->deadline_us / 1000000;
+            ts.tv_nsec = (due->deadline_us % 1000000) * 1000;
+            pthread_cond_timedwait(&cond, &mutex, &ts);
+            continue;
+        }
+
+        if (now - due->deadline_us > max_late_us)
+            max_late_us = (uint32_t)(now - due->deadline_us);
+        fired++;
+
+        // Disarmed before the callback, so that it can re-arm itself.
+        due->deadline_us = 0;
+        callback = due->callback;
+        callback_arg = due->arg;
+
+        pthread_mutex_unlock(&mutex);
+        callback(callback_arg);
+        pthread_mutex_lock(&mutex);
+    }
+    return NULL;
+}
+
+static void start_thread(void) {
+    pthread_condattr_t cond_attr;
+    pthread_attr_t attr;
+    struct sched_param param = {
+        .sched_priority = UNI_RT_TIMER_PRIORITY,
+    };
+    int err;
+
+    // Deadlines are in CLOCK_MONOTONIC: wall clock changes must not affect them.
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+    err = pthread_create(&thread, &attr, thread_main, NULL);
+    pthread_attr_destroy(&attr);
+
+    thread_realtime = (err == 0);
+    if (err != 0) {
+        // Needs CAP_SYS_NICE, or an RLIMIT_RTPRIO big enough.
+        logi("rt_timer: could not create a realtime thread (%s), using a normal one\n", strerror(err));
+        err = pthread_create(&thread, NULL, thread_main, NULL);
+    }
+    if (err != 0) {
+        loge("rt_timer: could not create thread: %s\n", strerror(err));
+        return;
+    }
+    thread_started = true;
+}
+
+int uni_rt_timer_init(uni_rt_timer_t* t, uni_rt_timer_callback_t callback, void* arg) {
+    int ret = 0;
+
+    pthread_mutex_lock(&mutex);
+    if (!thread_started)
+        start_thread();
+
+    t->callback = callback;
+    t->arg = arg;
+    t->deadline_us = 0;
+
+    // Already registered ?
+    for (int i = 0; i < timers_count; i++) {
+        if (timers[i] == t)
+            goto out;
+    }
+
+    if (timers_count >= UNI_RT_TIMER_MAX) {
+        loge("rt_timer: no free timers\n");
+        ret = -1;
+        goto out;
+    }
+    timers[timers_count++] = t;
+
+out:
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+void uni_rt_timer_arm(uni_rt_timer_t* t, int64_t delay_us) {
+    pthread_mutex_lock(&mutex);
+    // 0 means "not armed".
+    t->deadline_us = uni_rt_timer_get_time_us() + delay_us;
+    if (t->deadline_us == 0)
+        t->deadline_us = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+void uni_rt_timer_disarm(uni_rt_timer_t* t) {
+    pthread_mutex_lock(&mutex);
+    t->deadline_us = 0;
+    pthread_mutex_unlock(&mutex);
+}
+
+bool uni_rt_timer_is_armed(uni_rt_timer_t* t) {
+    bool armed;
+
+    pthread_mutex_lock(&mutex);
+    armed = (t->deadline_us != 0);
+    pthread_mutex_unlock(&mutex);
+    return armed;
+}
+
+int64_t uni_rt_timer_get_time_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void uni_rt_timer_lock(void) {
+    pthread_mutex_lock(&callback_mutex);
+}
+
+void uni_rt_timer_unlock(void) {
+    pthread_mutex_unlock(&callback_mutex);
+}
+
+void uni_rt_timer_dump(void) {
+    pthread_mutex_lock(&mutex);
+    logi("\tRT timers: %d, realtime=%d, fired=%u, max late=%u us\n", timers_count, thread_realtime,
+         (unsigned int)fired, (unsigned int)max_late_us);
+    pthread_mutex_unlock(&mutex);
+}
@@ -5,7 +5,12 @@
 #include "uni_system.h"
 
 #include <hardware/watchdog.h>
+#include <pico/time.h>
 
 void uni_system_reboot(void) {
     watchdog_reboot(0 /* pc */, 0 /* sp */, 0 /* delay ms */);
+}
+
+uint32_t uni_system_get_time_us(void) {
+    return time_us_32();
 }
\ No newline at end of file
@@ -62,8 +62,16 @@
 #include "sdkconfig.h"
 
 #include "bt/uni_bt_bredr.h"
+#include "bt/uni_bt_cmd_queue.h"
+#include "bt/uni_bt_conn_policy.h"
 #include "bt/uni_bt_hci_cmd.h"
 #include "bt/uni_bt_le.h"
+#include "bt/uni_bt_le_conn_params.h"
+#include "bt/uni_bt_profiler.h"
+#include "bt/uni_bt_reconnect.h"
+#include "bt/uni_bt_reject_cache.h"
+#include "bt/uni_bt_scan_policy.h"
+#include "bt/uni_bt_sched.h"
 #include "bt/uni_bt_service.h"
 #include "bt/uni_bt_setup.h"
 #include "platform/uni_platform.h"
@@ -76,12 +84,6 @@
 // globals
 bd_addr_t uni_local_bd_addr;
 
-// Used to implement connection timeout and reconnect timer
-// User can schedule up to "MAX" safe calls per loop.
-#define CMD_CALLBACK_MAX 8
-static btstack_context_callback_registration_t cmd_callback_registration[CMD_CALLBACK_MAX];
-static int cmd_callback_idx = 0;
-
 static bool bt_scanning_enabled;
 static bool bt_allow_incoming_connections = true;
 
@@ -95,13 +97,18 @@ enum {
     CMD_BT_STOP_SCANNING,
     CMD_DUMP_DEVICES,
     CMD_DISCONNECT_DEVICE,
-    CMD_BLE_SERVICE_ENABLE,
-    CMD_BLE_SERVICE_DISABLE,
+    CMD_BLE_SERVICE_SET_ENABLED,
+    CMD_DUMP_CONN_TRACE,
+    CMD_DUMP_PROFILER,
+    CMD_BT_RECONNECT,
 };
 
 static void bluetooth_del_keys(void) {
-    if (IS_ENABLED(UNI_ENABLE_BREDR))
+    if (IS_ENABLED(UNI_ENABLE_BREDR)) {
+        // Don't page controllers that are not bonded anymore.
+        uni_bt_reconnect_stop();
         uni_bt_bredr_delete_bonded_keys();
+    }
     if (IS_ENABLED(UNI_ENABLE_BLE))
         uni_bt_le_delete_bonded_keys();
 }
@@ -116,19 +123,17 @@ static void bluetooth_list_keys(void) {
 static void start_scan(void) {
     logd("--> Scanning for new controllers\n");
 
-    if (IS_ENABLED(UNI_ENABLE_BREDR))
-        uni_bt_bredr_scan_start();
-    if (IS_ENABLED(UNI_ENABLE_BLE))
-        uni_bt_le_scan_start();
+    // The scan policy decides the duty cycle.
+    uni_bt_scan_policy_start();
 }
 
 static void stop_scan(void) {
     logd("--> Stop scanning for new controllers\n");
 
+    uni_bt_scan_policy_stop();
+    // Autoconnect is disabled as well.
     if (IS_ENABLED(UNI_ENABLE_BREDR))
-        uni_bt_bredr_scan_stop();
-    if (IS_ENABLED(UNI_ENABLE_BLE))
-        uni_bt_le_scan_stop();
+        uni_bt_reconnect_stop();
 }
 
 static void start_scanning(bool enabled) {
@@ -139,6 +144,9 @@ static void start_scanning(bool enabled) {
             start_scan();
         else
             stop_scan();
+    } else if (enabled) {
+        // User asked to scan again. Ramp up the scan.
+        uni_bt_scan_policy_on_activity();
     }
 
     uni_get_platform()->on_oob_event(UNI_PLATFORM_OOB_BLUETOOTH_ENABLED, (void*)enabled);
@@ -181,13 +189,10 @@ static void on_hci_disconnection_complete(uint16_t channel, const uint8_t* packe
     }
 }
 
-static void cmd_callback(void* context) {
+static void cmd_handler(const uni_bt_cmd_t* cmd) {
     uni_hid_device_t* d;
-    unsigned long ctx = (unsigned long)context;
-    uint16_t cmd = ctx & 0xffff;
-    uint16_t args = (ctx >> 16) & 0xffff;
 
-    switch (cmd) {
+    switch (cmd->cmd) {
         case CMD_BT_DEL_KEYS:
             bluetooth_del_keys();
             break;
@@ -202,30 +207,56 @@ static void cmd_callback(void* context) {
             break;
         case CMD_DUMP_DEVICES:
             uni_hid_device_dump_all();
+            uni_bt_reject_cache_dump();
+            uni_bt_cmd_queue_dump();
+            if (IS_ENABLED(UNI_ENABLE_BREDR)) {
+                uni_bt_sched_dump();
+                uni_bt_reconnect_dump();
+            }
+            break;
+        case CMD_DUMP_CONN_TRACE:
+            uni_bt_conn_trace_dump_stats();
+            uni_bt_conn_policy_dump();
+            if (IS_ENABLED(UNI_ENABLE_BLE))
+                uni_bt_le_conn_params_dump();
+            break;
+        case CMD_DUMP_PROFILER:
+            uni_bt_profiler_dump();
+            if (cmd->args.value)
+                uni_bt_profiler_reset();
             break;
         case CMD_DISCONNECT_DEVICE:
-            d = uni_hid_device_get_instance_for_idx(args);
+            d = uni_hid_device_get_instance_for_idx(cmd->args.value);
             if (!d) {
-                loge("cmd_callback: Invalid device index: %d\n", args);
+                loge("cmd_handler: Invalid device index: %d\n", (int)cmd->args.value);
                 return;
             }
             uni_hid_device_disconnect(d);
             uni_hid_device_delete(d);
             break;
-        case CMD_BLE_SERVICE_ENABLE:
-            uni_bt_service_set_enabled(true);
+        case CMD_BLE_SERVICE_SET_ENABLED:
+            uni_bt_service_set_enabled(cmd->args.enabled);
             break;
-        case CMD_BLE_SERVICE_DISABLE:
-            uni_bt_service_set_enabled(false);
+        case CMD_BT_RECONNECT:
+            if (IS_ENABLED(UNI_ENABLE_BREDR) && uni_bt_bredr_is_enabled())
+                uni_bt_reconnect_start();
+            else
+                logi("Reconnect: BR/EDR not enabled\n");
             break;
         default:
-            loge("Unknown command: %#x\n", cmd);
+            loge("Unknown command: %#x\n", cmd->cmd);
             break;
     }
 }
-static btstack_context_callback_registration_t* get_next_callback_registration() {
-    cmd_callback_idx = (cmd_callback_idx + 1) % CMD_CALLBACK_MAX;
-    return &cmd_callback_registration[cmd_callback_idx];
+
+static void push_cmd(uint16_t cmd, int32_t value) {
+    uni_bt_cmd_t c = {
+        .handler = &cmd_handler,
+        .cmd = cmd,
+        .args.value = value,
+    };
+    if (!uni_bt_cmd_queue_push(&c))
+        loge("Command %d dropped: queue full\n", cmd);
 }
 
 //
@@ -233,10 +264,7 @@ static btstack_context_callback_registration_t* get_next_callback_registration()
 //
 
 void uni_bt_del_keys_safe(void) {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)CMD_BT_DEL_KEYS;
-    btstack_run_loop_execute_on_main_thread(cmd);
+    push_cmd(CMD_BT_DEL_KEYS, 0);
 }
 
 void uni_bt_del_keys_unsafe(void) {
@@ -244,10 +272,7 @@ void uni_bt_del_keys_unsafe(void) {
 }
 
 void uni_bt_list_keys_safe(void) {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)CMD_BT_LIST_KEYS;
-    btstack_run_loop_execute_on_main_thread(cmd);
+    push_cmd(CMD_BT_LIST_KEYS, 0);
 }
 
 void uni_bt_list_keys_unsafe(void) {
@@ -262,17 +287,11 @@ void uni_bt_enable_new_connections_safe(bool enabled) {
 }
 
 void uni_bt_start_scanning_and_autoconnect_safe() {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)CMD_BT_START_SCANNING;
-    btstack_run_loop_execute_on_main_thread(cmd);
+    push_cmd(CMD_BT_START_SCANNING, 0);
 }
 
 void uni_bt_stop_scanning_safe() {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)CMD_BT_STOP_SCANNING;
-    btstack_run_loop_execute_on_main_thread(cmd);
+    push_cmd(CMD_BT_STOP_SCANNING, 0);
 }
 
 void uni_bt_enable_new_connections_unsafe(bool enabled) {
@@ -307,28 +326,36 @@ bool uni_bt_incoming_connections_is_allowed(void) {
 }
 
 void uni_bt_dump_devices_safe() {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)CMD_DUMP_DEVICES;
-    btstack_run_loop_execute_on_main_thread(cmd);
+    push_cmd(CMD_DUMP_DEVICES, 0);
+}
+
+void uni_bt_dump_conn_trace_safe(void) {
+    push_cmd(CMD_DUMP_CONN_TRACE, 0);
+}
+
+void uni_bt_dump_profiler_safe(bool reset) {
+    push_cmd(CMD_DUMP_PROFILER, reset);
+}
+
+void uni_bt_reconnect_safe(void) {
+    push_cmd(CMD_BT_RECONNECT, 0);
 }
 
 void uni_bt_disconnect_device_safe(int device_idx) {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    unsigned long idx = (unsigned long)device_idx;
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)(CMD_DISCONNECT_DEVICE | (idx << 16));
-    btstack_run_loop_execute_on_main_thread(cmd);
+    push_cmd(CMD_DISCONNECT_DEVICE, device_idx);
 }
 
 void uni_bt_enable_service_safe(bool enabled) {
-    btstack_context_callback_registration_t* cmd = get_next_callback_registration();
-    cmd->callback = &cmd_callback;
-    cmd->context = (void*)(enabled ? (intptr_t)CMD_BLE_SERVICE_ENABLE : (intptr_t)CMD_BLE_SERVICE_DISABLE);
-    btstack_run_loop_execute_on_main_thread(cmd);
+    uni_bt_cmd_t c = {
+        .handler = &cmd_handler,
+        .cmd = CMD_BLE_SERVICE_SET_ENABLED,
+        .args.enabled = enabled,
+    };
+    if (!uni_bt_cmd_queue_push(&c))
+        loge("Command %d dropped: queue full\n", CMD_BLE_SERVICE_SET_ENABLED);
 }
 
-void uni_bt_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {
+static void hci_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {
     uint8_t event;
     uni_hid_device_t* device;
     uint8_t status;
@@ -534,6 +561,12 @@ void uni_bt_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packe
     }
 }
 
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(hci_packet_handler)
+
+void uni_bt_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {
+    UNI_BT_PROFILER_PACKET_HANDLER(hci_packet_handler)(packet_type, channel, packet, size);
+}
+
 // Properties
 void uni_bt_set_gap_security_level(int gap) {
     uni_property_value_t val;
@@ -4,50 +4,264 @@
 
 #include "bt/uni_bt_allowlist.h"
 
+#include <stdio.h>
+#include <string.h>
+
 #include "sdkconfig.h"
 
+#include "bt/uni_bt_cmd_queue.h"
+#include "bt/uni_bt_reject_cache.h"
 #include "uni_common.h"
 #include "uni_log.h"
 #include "uni_property.h"
 
-static bd_addr_t addr_allow_list[CONFIG_BLUEPAD32_MAX_ALLOWLIST];
+// Rules are indexed by a hash table: open addressing with linear probing.
+// It is at most half full, so lookups take one or two probes.
+#define ALLOWLIST_SLOTS (CONFIG_BLUEPAD32_MAX_ALLOWLIST * 2)
+
+// Rules are compared by type + key.
+// Key: address, OUI (3 bytes) or VID/PID (little endian). Unused bytes are zero.
+#define ALLOWLIST_KEY_LEN 6
+
+// Binary format, stored in the UNI_PROPERTY_IDX_ALLOWLIST_RULES property:
+//  - header: version (u8), reserved (u8), total rules (u16, little endian)
+//  - one record per rule: type (u8), key (6 bytes)
+#define ALLOWLIST_BLOB_VERSION 1
+#define ALLOWLIST_BLOB_HEADER_LEN 4
+#define ALLOWLIST_BLOB_RECORD_LEN (1 + ALLOWLIST_KEY_LEN)
+#define ALLOWLIST_BLOB_MAX_LEN (ALLOWLIST_BLOB_HEADER_LEN + CONFIG_BLUEPAD32_MAX_ALLOWLIST * ALLOWLIST_BLOB_RECORD_LEN)
+
+// Commands from other threads. The rule is sent as a blob record: type + key.
+enum {
+    CMD_ADD_RULE,
+    CMD_REMOVE_RULE,
+    CMD_SET_ENABLED,
+};
+_Static_assert(sizeof(((uni_bt_cmd_t*)0)->args.device.data) >= ALLOWLIST_BLOB_RECORD_LEN, "Rule doesn't fit in cmd");
+
+static uni_bt_allowlist_rule_t rules[CONFIG_BLUEPAD32_MAX_ALLOWLIST];
+static int rules_total;
+// Index + 1 of the rule. 0 means empty slot.
+static uint16_t slots[ALLOWLIST_SLOTS];
+// VID/PID rules can only be evaluated once the device is connected.
+static int vid_pid_rules_total;
 static bool enforced = false;
-static const bd_addr_t zero_addr = {0, 0, 0, 0, 0, 0};
+static uint8_t blob[ALLOWLIST_BLOB_MAX_LEN];
 
 //
 // Private functions
 //
+static bool is_valid_type(uint8_t type) {
+    return type == UNI_BT_ALLOWLIST_RULE_ADDR || type == UNI_BT_ALLOWLIST_RULE_OUI ||
+           type == UNI_BT_ALLOWLIST_RULE_VID_PID;
+}
+
+static void rule_to_key(const uni_bt_allowlist_rule_t* rule, uint8_t* key) {
+    memset(key, 0, ALLOWLIST_KEY_LEN);
+    switch (rule->type) {
+        case UNI_BT_ALLOWLIST_RULE_ADDR:
+            memcpy(key, rule->addr, sizeof(rule->addr));
+            break;
+        case UNI_BT_ALLOWLIST_RULE_OUI:
+            memcpy(key, rule->oui, sizeof(rule->oui));
+            break;
+        case UNI_BT_ALLOWLIST_RULE_VID_PID:
+            little_endian_store_16(key, 0, rule->vid_pid.vid);
+            little_endian_store_16(key, 2, rule->vid_pid.pid);
+            break;
+        default:
+            break;
+    }
+}
+
+static void key_to_rule(uint8_t type, const uint8_t* key, uni_bt_allowlist_rule_t* rule) {
+    memset(rule, 0, sizeof(*rule));
+    rule->type = type;
+    switch (type) {
+        case UNI_BT_ALLOWLIST_RULE_ADDR:
+            memcpy(rule->addr, key, sizeof(rule->addr));
+            break;
+        case UNI_BT_ALLOWLIST_RULE_OUI:
+            memcpy(rule->oui, key, sizeof(rule->oui));
+            break;
+        case UNI_BT_ALLOWLIST_RULE_VID_PID:
+            rule->vid_pid.vid = little_endian_read_16(key, 0);
+            rule->vid_pid.pid = little_endian_read_16(key, 2);
+            break;
+        default:
+            break;
+    }
+}
+
+static uint32_t get_slot(uint8_t type, const uint8_t* key) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    hash = (hash ^ type) * 16777619u;
+    for (int i = 0; i < ALLOWLIST_KEY_LEN; i++)
+        hash = (hash ^ key[i]) * 16777619u;
+    return hash % ALLOWLIST_SLOTS;
+}
+
+// Returns the index of the rule, or -1 if not found.
+static int find_rule(uint8_t type, const uint8_t* key) {
+    uint8_t rule_key[ALLOWLIST_KEY_LEN];
+    uint32_t slot = get_slot(type, key);
+
+    for (int i = 0; i < ALLOWLIST_SLOTS; i++) {
+        uint16_t idx = slots[slot];
+        if (idx == 0)
+            return -1;
+        idx--;
+        // If another task is modifying the table, "idx" could be stale. But it is always inside "rules".
+        if (rules[idx].type == type) {
+            rule_to_key(&rules[idx], rule_key);
+            if (memcmp(rule_key, key, ALLOWLIST_KEY_LEN) == 0)
+                return idx;
+        }
+        slot = (slot + 1) % ALLOWLIST_SLOTS;
+    }
+    return -1;
+}
+
+static void insert_slot(int idx) {
+    uint8_t key[ALLOWLIST_KEY_LEN];
+    uint32_t slot;
+
+    rule_to_key(&rules[idx], key);
+    slot = get_slot(rules[idx].type, key);
+    // There is always a free slot, since the table is at most half full.
+    while (slots[slot] != 0)
+        slot = (slot + 1) % ALLOWLIST_SLOTS;
+    slots[slot] = idx + 1;
+}
+
+static void rebuild_slots(void) {
+    memset(slots, 0, sizeof(slots));
+    vid_pid_rules_total = 0;
+    for (int i = 0; i < rules_total; i++) {
+        insert_slot(i);
+        if (rules[i].type == UNI_BT_ALLOWLIST_RULE_VID_PID)
+            vid_pid_rules_total++;
+    }
+}
+
+static bool add_rule(const uni_bt_allowlist_rule_t* rule) {
+    uint8_t key[ALLOWLIST_KEY_LEN];
+
+    if (!is_valid_type(rule->type)) {
+        loge("Allowlist: invalid rule type %d\n", rule->type);
+        return false;
+    }
+
+    rule_to_key(rule, key);
+    // Don't add duplicate entries
+    if (find_rule(rule->type, key) >= 0)
+        return false;
+
+    if (rules_total >= CONFIG_BLUEPAD32_MAX_ALLOWLIST) {
+        loge("Allowlist: full, cannot add more than %d rules\n", CONFIG_BLUEPAD32_MAX_ALLOWLIST);
+        return false;
+    }
+
+    // Store it normalized: unused bytes are zero.
+    key_to_rule(rule->type, key, &rules[rules_total]);
+    insert_slot(rules_total);
+    rules_total++;
+    if (rule->type == UNI_BT_ALLOWLIST_RULE_VID_PID)
+        vid_pid_rules_total++;
+    return true;
+}
+
+static bool remove_rule(const uni_bt_allowlist_rule_t* rule) {
+    uint8_t key[ALLOWLIST_KEY_LEN];
+    int idx;
+
+    rule_to_key(rule, key);
+    idx = find_rule(rule->type, key);
+    if (idx < 0)
+        return false;
+
+    // Move the last one to the hole. Removing is not frequent, so just rebuild the slots.
+    rules_total--;
+    rules[idx] = rules[rules_total];
+    rebuild_slots();
+    return true;
+}
+
+static bool is_addr_in_allowlist(bd_addr_t addr) {
+    uint8_t key[ALLOWLIST_KEY_LEN];
+
+    if (find_rule(UNI_BT_ALLOWLIST_RULE_ADDR, addr) >= 0)
+        return true;
+
+    memset(key, 0, sizeof(key));
+    memcpy(key, addr, 3);
+    return find_rule(UNI_BT_ALLOWLIST_RULE_OUI, key) >= 0;
+}
+
 static void update_allowlist_to_property(void) {
-    // Convert binary address to a string list
-    // Example of a list of two elements:
-    // 00:22:33:44:55:66,11:AB:8B:99:44:8A
     uni_property_value_t val;
+    uint8_t key[ALLOWLIST_KEY_LEN];
+    int offset;
 
-    char str[128];
+    blob[0] = ALLOWLIST_BLOB_VERSION;
+    blob[1] = 0;
+    little_endian_store_16(blob, 2, rules_total);
+    offset = ALLOWLIST_BLOB_HEADER_LEN;
+    for (int i = 0; i < rules_total; i++) {
+        rule_to_key(&rules[i], key);
+        blob[offset] = rules[i].type;
+        memcpy(&blob[offset + 1], key, ALLOWLIST_KEY_LEN);
+        offset += ALLOWLIST_BLOB_RECORD_LEN;
+    }
+
+    val.blob.data = blob;
+    val.blob.size = offset;
+    uni_property_set(UNI_PROPERTY_IDX_ALLOWLIST_RULES, val);
+
+    // Previously rejected addresses might be allowed now.
+    uni_bt_reject_cache_invalidate();
+}
 
-    str[0] = 0;
+// Returns false if the property was not found.
+static bool update_allowlist_from_property(void) {
+    uni_bt_allowlist_rule_t rule;
+    int len;
+    int total;
+    int offset;
+
+    len = uni_property_get_blob(UNI_PROPERTY_IDX_ALLOWLIST_RULES, blob, sizeof(blob));
+    if (len == 0)
+        return false;
 
-    for (size_t i = 0; i < ARRAY_SIZE(addr_allow_list); i++) {
-        if (bd_addr_cmp(addr_allow_list[i], zero_addr) == 0)
-            continue;
-        char* tmp_str = bd_addr_to_str(addr_allow_list[i]);
-        strcat(str, tmp_str);
-        // Append delimeter between addresses
-        strcat(str, ",");
+    if (len < ALLOWLIST_BLOB_HEADER_LEN || blob[0] != ALLOWLIST_BLOB_VERSION) {
+        loge("Allowlist: invalid stored rules, len=%d, version=%d\n", len, blob[0]);
+        return true;
+    }
+    total = little_endian_read_16(blob, 2);
+    if (len != ALLOWLIST_BLOB_HEADER_LEN + total * ALLOWLIST_BLOB_RECORD_LEN) {
+        loge("Allowlist: invalid stored rules, len=%d, total=%d\n", len, total);
+        return true;
     }
 
-    val.str = str;
-    uni_property_set(UNI_PROPERTY_IDX_ALLOWLIST_LIST, val);
+    offset = ALLOWLIST_BLOB_HEADER_LEN;
+    for (int i = 0; i < total; i++) {
+        key_to_rule(blob[offset], &blob[offset + 1], &rule);
+        add_rule(&rule);
+        offset += ALLOWLIST_BLOB_RECORD_LEN;
+    }
+    return true;
 }
 
-static void update_allowlist_from_property(void) {
-    // Parses the list from the property and stored it locally.
+// Previous versions stored the allowlist as a comma-separated list of addresses.
+static void update_allowlist_from_legacy_property(void) {
     uni_property_value_t val;
     bd_addr_t addr;
     int offset;
     size_t len;
+    bool added = false;
 
-    // Whether it is enabled.
     val = uni_property_get(UNI_PROPERTY_IDX_ALLOWLIST_LIST);
 
     if (val.str == NULL)
@@ -59,22 +273,64 @@ static void update_allowlist_from_property(void) {
     while (offset < len) {
         if (!sscanf_bd_addr(&val.str[offset], addr)) {
             loge("Failed to parse allowlist: '%s' ('%s')\n", &val.str[offset], val.str);
-            return;
+            break;
         }
-        uni_bt_allowlist_add_addr(addr);
+        uni_bt_allowlist_rule_t rule = {.type = UNI_BT_ALLOWLIST_RULE_ADDR};
+        bd_addr_copy(rule.addr, addr);
+        added |= add_rule(&rule);
         // Each address takes 18 bytes:
         // 00:11:22:33:44:55,
         offset += 6 * 2 + 5 + 1;
     }
+
+    if (added) {
+        logi("Allowlist: migrated %d addresses\n", rules_total);
+        update_allowlist_to_property();
+    }
 }
 
-static bool is_address_in_allowlist(bd_addr_t addr) {
-    for (size_t i = 0; i < ARRAY_SIZE(addr_allow_list); i++) {
-        if (bd_addr_cmp(addr, addr_allow_list[i]) == 0)
-            return true;
+static void cmd_handler(const uni_bt_cmd_t* cmd) {
+    uni_bt_allowlist_rule_t rule;
+
+    switch (cmd->cmd) {
+        case CMD_ADD_RULE:
+            key_to_rule(cmd->args.device.data[0], &cmd->args.device.data[1], &rule);
+            uni_bt_allowlist_add_rule(&rule);
+            break;
+        case CMD_REMOVE_RULE:
+            key_to_rule(cmd->args.device.data[0], &cmd->args.device.data[1], &rule);
+            uni_bt_allowlist_remove_rule(&rule);
+            break;
+        case CMD_SET_ENABLED:
+            uni_bt_allowlist_set_enabled(cmd->args.enabled);
+            break;
+        default:
+            loge("Allowlist: unknown command: %#x\n", cmd->cmd);
+            break;
     }
+}
 
-    return false;
+static bool push_cmd(uni_bt_cmd_t* c) {
+    c->handler = &cmd_handler;
+    if (!uni_bt_cmd_queue_push(c)) {
+        loge("Allowlist: command %d dropped: queue full\n", c->cmd);
+        return false;
+    }
+    return true;
+}
+
+static bool push_rule_cmd(uint16_t cmd, const uni_bt_allowlist_rule_t* rule) {
+    uni_bt_cmd_t c = {
+        .cmd = cmd,
+    };
+
+    if (!is_valid_type(rule->type)) {
+        loge("Allowlist: invalid rule type %d\n", rule->type);
+        return false;
+    }
+    c.args.device.data[0] = rule->type;
+    rule_to_key(rule, &c.args.device.data[1]);
+    return push_cmd(&c);
 }
 
 //
@@ -85,55 +341,134 @@ bool uni_bt_allowlist_is_allowed_addr(bd_addr_t addr) {
     if (!enforced)
         return true;
 
-    return is_address_in_allowlist(addr);
+    if (is_addr_in_allowlist(addr))
+        return true;
+
+    // Might be allowed by VID/PID. Checked once it is known.
+    return vid_pid_rules_total > 0;
 }
 
-bool uni_bt_allowlist_add_addr(bd_addr_t addr) {
-    // Don't add duplicate entries
-    if (is_address_in_allowlist(addr))
+bool uni_bt_allowlist_is_allowed(bd_addr_t addr, uint16_t vid, uint16_t pid) {
+    uint8_t key[ALLOWLIST_KEY_LEN] = {0};
+
+    if (!enforced)
+        return true;
+
+    if (is_addr_in_allowlist(addr))
+        return true;
+
+    if (vid_pid_rules_total == 0)
         return false;
 
-    for (size_t i = 0; i < ARRAY_SIZE(addr_allow_list); i++) {
-        if (bd_addr_cmp(addr_allow_list[i], zero_addr) == 0) {
-            bd_addr_copy(addr_allow_list[i], addr);
-            update_allowlist_to_property();
-            return true;
-        }
-    }
-    return false;
+    little_endian_store_16(key, 0, vid);
+    little_endian_store_16(key, 2, pid);
+    return find_rule(UNI_BT_ALLOWLIST_RULE_VID_PID, key) >= 0;
+}
+
+bool uni_bt_allowlist_add_addr(bd_addr_t addr) {
+    uni_bt_allowlist_rule_t rule = {.type = UNI_BT_ALLOWLIST_RULE_ADDR};
+
+    bd_addr_copy(rule.addr, addr);
+    return uni_bt_allowlist_add_rule(&rule);
 }
 
 bool uni_bt_allowlist_remove_addr(bd_addr_t addr) {
-    for (size_t i = 0; i < ARRAY_SIZE(addr_allow_list); i++) {
-        if (bd_addr_cmp(addr_allow_list[i], addr) == 0) {
-            bd_addr_copy(addr_allow_list[i], zero_addr);
-            update_allowlist_to_property();
-            return true;
-        }
+    uni_bt_allowlist_rule_t rule = {.type = UNI_BT_ALLOWLIST_RULE_ADDR};
+
+    bd_addr_copy(rule.addr, addr);
+    return uni_bt_allowlist_remove_rule(&rule);
+}
+
+bool uni_bt_allowlist_add_rule(const uni_bt_allowlist_rule_t* rule) {
+    if (!add_rule(rule))
+        return false;
+    update_allowlist_to_property();
+    return true;
+}
+
+bool uni_bt_allowlist_remove_rule(const uni_bt_allowlist_rule_t* rule) {
+    if (!remove_rule(rule))
+        return false;
+    update_allowlist_to_property();
+    return true;
+}
+
+int uni_bt_allowlist_add_rules(const uni_bt_allowlist_rule_t* new_rules, int total) {
+    int added = 0;
+
+    for (int i = 0; i < total; i++) {
+        if (add_rule(&new_rules[i]))
+            added++;
     }
-    return false;
+    if (added > 0)
+        update_allowlist_to_property();
+    return added;
 }
 
 bool uni_bt_allowlist_remove_all(void) {
-    for (size_t i = 0; i < ARRAY_SIZE(addr_allow_list); i++) {
-        bd_addr_copy(addr_allow_list[i], zero_addr);
-    }
+    rules_total = 0;
+    rebuild_slots();
     update_allowlist_to_property();
     return true;
 }
 
+bool uni_bt_allowlist_add_rule_safe(const uni_bt_allowlist_rule_t* rule) {
+    return push_rule_cmd(CMD_ADD_RULE, rule);
+}
+
+bool uni_bt_allowlist_remove_rule_safe(const uni_bt_allowlist_rule_t* rule) {
+    return push_rule_cmd(CMD_REMOVE_RULE, rule);
+}
+
 void uni_bt_allowlist_list(void) {
-    logi("Bluetooth allowlist addresses:\n");
-    for (size_t i = 0; i < ARRAY_SIZE(addr_allow_list); i++) {
-        if (bd_addr_cmp(addr_allow_list[i], zero_addr) == 0)
-            continue;
-        logi(" - %s\n", bd_addr_to_str(addr_allow_list[i]));
+    logi("Bluetooth allowlist rules (%d/%d):\n", rules_total, CONFIG_BLUEPAD32_MAX_ALLOWLIST);
+    for (int i = 0; i < rules_total; i++) {
+        const uni_bt_allowlist_rule_t* rule = &rules[i];
+        switch (rule->type) {
+            case UNI_BT_ALLOWLIST_RULE_ADDR:
+                logi(" - address: %s\n", bd_addr_to_str(rule->addr));
+                break;
+            case UNI_BT_ALLOWLIST_RULE_OUI:
+                logi(" - OUI: %02X:%02X:%02X\n", rule->oui[0], rule->oui[1], rule->oui[2]);
+                break;
+            case UNI_BT_ALLOWLIST_RULE_VID_PID:
+                logi(" - VID/PID: %04x/%04x\n", rule->vid_pid.vid, rule->vid_pid.pid);
+                break;
+            default:
+                break;
+        }
     }
 }
 
-void uni_bt_allowlist_get_all(const bd_addr_t** addresses, int* total) {
-    *addresses = addr_allow_list;
-    *total = CONFIG_BLUEPAD32_MAX_ALLOWLIST;
+void uni_bt_allowlist_get_rules(const uni_bt_allowlist_rule_t** out_rules, int* total) {
+    *out_rules = rules;
+    *total = rules_total;
+}
+
+bool uni_bt_allowlist_parse_rule(const char* str, uni_bt_allowlist_rule_t* rule) {
+    unsigned int a, b, c;
+    char extra;
+
+    memset(rule, 0, sizeof(*rule));
+
+    if (strlen(str) == 17) {
+        rule->type = UNI_BT_ALLOWLIST_RULE_ADDR;
+        return sscanf_bd_addr(str, rule->addr) != 0;
+    }
+    if (sscanf(str, "%2x:%2x:%2x%c", &a, &b, &c, &extra) == 3) {
+        rule->type = UNI_BT_ALLOWLIST_RULE_OUI;
+        rule->oui[0] = a;
+        rule->oui[1] = b;
+        rule->oui[2] = c;
+        return true;
+    }
+    if (sscanf(str, "%4x/%4x%c", &a, &b, &extra) == 2) {
+        rule->type = UNI_BT_ALLOWLIST_RULE_VID_PID;
+        rule->vid_pid.vid = a;
+        rule->vid_pid.pid = b;
+        return true;
+    }
+    return false;
 }
 
 bool uni_bt_allowlist_is_enabled(void) {
@@ -145,12 +480,21 @@ void uni_bt_allowlist_set_enabled(bool enabled) {
 
     if (enabled != enforced) {
         enforced = enabled;
+        uni_bt_reject_cache_invalidate();
 
         val.u8 = enforced;
         uni_property_set(UNI_PROPERTY_IDX_ALLOWLIST_ENABLED, val);
     }
 }
 
+bool uni_bt_allowlist_set_enabled_safe(bool enabled) {
+    uni_bt_cmd_t c = {
+        .cmd = CMD_SET_ENABLED,
+        .args.enabled = enabled,
+    };
+    return push_cmd(&c);
+}
+
 void uni_bt_allowlist_init(void) {
     uni_property_value_t val;
 
@@ -158,11 +502,12 @@ void uni_bt_allowlist_init(void) {
     val = uni_property_get(UNI_PROPERTY_IDX_ALLOWLIST_ENABLED);
     enforced = val.u8;
 
-    // The list of allowed-list addresses.
+    // The list of allowed rules.
     // Need to fetch it, even if it is not enabled.
-    update_allowlist_from_property();
+    if (!update_allowlist_from_property())
+        update_allowlist_from_legacy_property();
 
     logi("Bluetooth Allowlist: %s\n", enforced ? "Enabled" : "Disabled");
     if (enforced)
         uni_bt_allowlist_list();
-}
\ No newline at end of file
+}
@@ -13,7 +13,13 @@
 
 #include "bt/uni_bt.h"
 #include "bt/uni_bt_allowlist.h"
+#include "bt/uni_bt_conn_policy.h"
 #include "bt/uni_bt_defines.h"
+#include "bt/uni_bt_profiler.h"
+#include "bt/uni_bt_reconnect.h"
+#include "bt/uni_bt_reject_cache.h"
+#include "bt/uni_bt_scan_policy.h"
+#include "bt/uni_bt_sched.h"
 #include "bt/uni_bt_sdp.h"
 #include "platform/uni_platform.h"
 #include "uni_common.h"
@@ -25,19 +31,52 @@
 #error "This file can only be compiled for ESP32, Pico W, or Posix"
 #endif
 
-#define INQUIRY_REMOTE_NAME_TIMEOUT_MS 4500
-_Static_assert(INQUIRY_REMOTE_NAME_TIMEOUT_MS < HID_DEVICE_CONNECTION_TIMEOUT_MS, "Timeout too big");
+// Devices paged by the reconnect manager might be off. Wait for the page timeout (5.12s by default).
+#define RECONNECT_REMOTE_NAME_TIMEOUT_MS 6000
+_Static_assert(RECONNECT_REMOTE_NAME_TIMEOUT_MS < HID_DEVICE_CONNECTION_TIMEOUT_MS, "Timeout too big");
 
 static bool bt_bredr_enabled = true;
 
+static void inquiry_remote_name_timeout_callback(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(inquiry_remote_name_timeout_callback)
+static void l2cap_timeout_callback(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(l2cap_timeout_callback)
+static void setup_retry_callback(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(setup_retry_callback)
+
+// Resources needed to talk to the device: paging is needed when there is no ACL connection yet.
+static uint8_t sched_resources_for_device(const uni_hid_device_t* d) {
+    return (d->conn.handle == UNI_BT_CONN_HANDLE_INVALID) ? UNI_BT_SCHED_RESOURCE_PAGE : 0;
+}
+
+// Failures worth retrying. Others, like security ones, need a new pairing.
+static bool is_l2cap_status_transient(uint8_t status) {
+    switch (status) {
+        case L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_RESOURCES:
+        case L2CAP_CONNECTION_RESPONSE_RESULT_RTX_TIMEOUT:
+        case L2CAP_CONNECTION_BASEBAND_DISCONNECT:
+            return true;
+        default:
+            return false;
+    }
+}
+
 static void l2cap_create_control_connection(uni_hid_device_t* d) {
     uint8_t status;
     status = l2cap_create_channel(uni_bt_packet_handler, d->conn.btaddr, BLUETOOTH_PSM_HID_CONTROL,
                                   UNI_BT_L2CAP_CHANNEL_MTU, &d->conn.control_cid);
     if (status) {
         loge("\nConnecting or Auth to HID Control failed: 0x%02x", status);
+        uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_PAGE);
+        if (!uni_bt_bredr_retry_stage(d, UNI_BT_CONN_STAGE_L2CAP)) {
+            uni_hid_device_disconnect(d);
+            uni_hid_device_delete(d);
+            /* 'd' is destroyed after this call, don't use it */
+        }
     } else {
         uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_L2CAP_CONTROL_CONNECTION_REQUESTED);
+        uni_hid_device_start_setup_timer(d, uni_bt_conn_policy_get_timeout_ms(d, UNI_BT_CONN_STAGE_L2CAP),
+                                         UNI_BT_PROFILER_TIMER(l2cap_timeout_callback));
     }
 }
 
@@ -47,13 +86,88 @@ static void l2cap_create_interrupt_connection(uni_hid_device_t* d) {
                                   UNI_BT_L2CAP_CHANNEL_MTU, &d->conn.interrupt_cid);
     if (status) {
         loge("\nConnecting or Auth to HID Interrupt failed: 0x%02x", status);
+        if (!uni_bt_bredr_retry_stage(d, UNI_BT_CONN_STAGE_L2CAP)) {
+            uni_hid_device_disconnect(d);
+            uni_hid_device_delete(d);
+            /* 'd' is destroyed after this call, don't use it */
+        }
     } else {
         uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_L2CAP_INTERRUPT_CONNECTION_REQUESTED);
+        uni_hid_device_start_setup_timer(d, uni_bt_conn_policy_get_timeout_ms(d, UNI_BT_CONN_STAGE_L2CAP),
+                                         UNI_BT_PROFILER_TIMER(l2cap_timeout_callback));
+    }
+}
+
+static void request_l2cap_control_connection(uni_hid_device_t* d) {
+    uni_bt_sched_request(d, sched_resources_for_device(d), &l2cap_create_control_connection);
+    /* 'd' might be invalid */
+}
+
+static void l2cap_timeout_callback(btstack_timer_source_t* ts) {
+    uni_hid_device_t* d = btstack_run_loop_get_timer_context(ts);
+
+    // A pending L2CAP channel can't be cancelled, so it can't be retried. Give up sooner than the connection timeout.
+    uni_bt_conn_policy_on_stage_timeout(UNI_BT_CONN_STAGE_L2CAP);
+    loge("L2CAP connection timeout for %s, deleting it\n", bd_addr_to_str(d->conn.btaddr));
+    uni_hid_device_disconnect(d);
+    uni_hid_device_delete(d);
+    /* 'd' is destroyed after this call, don't use it */
+}
+
+static void setup_retry_callback(btstack_timer_source_t* ts) {
+    uni_hid_device_t* d = btstack_run_loop_get_timer_context(ts);
+
+    switch (d->setup_retry_stage) {
+        case UNI_BT_CONN_STAGE_NAME:
+            // Back to the state that requests the name.
+            uni_bt_conn_set_state(&d->conn, uni_hid_device_is_incoming(d) ? UNI_BT_CONN_STATE_L2CAP_INTERRUPT_CONNECTED
+                                                                          : UNI_BT_CONN_STATE_DEVICE_DISCOVERED);
+            uni_bt_bredr_process_fsm(d);
+            break;
+        case UNI_BT_CONN_STAGE_SDP:
+            uni_bt_sdp_query_start(d);
+            break;
+        case UNI_BT_CONN_STAGE_L2CAP:
+            if (uni_bt_conn_get_state(&d->conn) == UNI_BT_CONN_STATE_L2CAP_INTERRUPT_CONNECTION_REQUESTED ||
+                uni_bt_conn_get_state(&d->conn) == UNI_BT_CONN_STATE_L2CAP_CONTROL_CONNECTED)
+                l2cap_create_interrupt_connection(d);
+            else
+                request_l2cap_control_connection(d);
+            break;
+        default:
+            loge("setup_retry_callback: unexpected stage %d\n", d->setup_retry_stage);
+            break;
     }
+    /* 'd' might be invalid */
+}
+
+static void remote_name_request(uni_hid_device_t* d) {
+    if (d->conn.clock_offset & UNI_BT_CLOCK_OFFSET_VALID)
+        gap_remote_name_request(d->conn.btaddr, d->conn.page_scan_repetition_mode, d->conn.clock_offset);
+    else
+        gap_remote_name_request(d->conn.btaddr, 0x02, 0x0000);
+
+    uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_REMOTE_NAME_INQUIRED);
+
+    // Some devices might not respond to the name request
+    btstack_run_loop_set_timer(&d->inquiry_remote_name_timer,
+                               d->conn.reconnecting ? RECONNECT_REMOTE_NAME_TIMEOUT_MS
+                                                    : uni_bt_conn_policy_get_timeout_ms(d, UNI_BT_CONN_STAGE_NAME));
+    btstack_run_loop_set_timer_context(&d->inquiry_remote_name_timer, d);
+    btstack_run_loop_set_timer_handler(&d->inquiry_remote_name_timer,
+                                       UNI_BT_PROFILER_TIMER(inquiry_remote_name_timeout_callback));
+    btstack_run_loop_add_timer(&d->inquiry_remote_name_timer);
 }
 
 static void inquiry_remote_name_timeout_callback(btstack_timer_source_t* ts) {
     uni_hid_device_t* d = btstack_run_loop_get_timer_context(ts);
+    uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_PAGE);
+    if (uni_bt_reconnect_on_page_failed(d)) {
+        /* 'd' is destroyed after this call, don't use it */
+        return;
+    }
+    // Not retried: the name request might still be in progress.
+    uni_bt_conn_policy_on_stage_timeout(UNI_BT_CONN_STAGE_NAME);
     loge("Failed to inquiry name for %s, using a fake one\n", bd_addr_to_str(d->conn.btaddr));
     // The device has no name. Just fake one
     uni_hid_device_set_name(d, "Controller without name");
@@ -61,14 +175,13 @@ static void inquiry_remote_name_timeout_callback(btstack_timer_source_t* ts) {
     uni_bt_bredr_process_fsm(d);
 }
 
-void uni_bt_bredr_scan_start(void) {
+void uni_bt_bredr_scan_start_with_params(uint16_t max_periodic_len, uint16_t min_periodic_len, uint8_t inquiry_len) {
     uint8_t status;
 
-    status = gap_inquiry_periodic_start(uni_bt_get_gap_inquiry_length(), uni_bt_get_gap_max_periodic_length(),
-                                        uni_bt_get_gap_min_periodic_length());
+    status = gap_inquiry_periodic_start(inquiry_len, max_periodic_len, min_periodic_len);
     if (status)
         loge("Failed to start period inquiry, error=0x%02x\n", status);
-    logi("BR/EDR scan -> 1\n");
+    logi("BR/EDR scan -> 1 (max=%d, min=%d, len=%d)\n", max_periodic_len, min_periodic_len, inquiry_len);
 }
 
 void uni_bt_bredr_scan_stop(void) {
@@ -177,6 +290,8 @@ void uni_bt_bredr_setup(void) {
     // try to become master on incoming connections
     hci_set_master_slave_policy(HCI_ROLE_MASTER);
 
+    uni_bt_reconnect_init();
+
     logi("Gap security level: %d\n", security_level);
     logi("Periodic Inquiry: max=%d, min=%d, len=%d\n", uni_bt_get_gap_max_periodic_length(),
          uni_bt_get_gap_min_periodic_length(), uni_bt_get_gap_inquiry_length());
@@ -190,6 +305,49 @@ bool uni_bt_bredr_is_enabled(void) {
     return bt_bredr_enabled;
 }
 
+bool uni_bt_bredr_retry_stage(uni_hid_device_t* d, uni_bt_conn_stage_t stage) {
+    uint32_t backoff_ms;
+
+    if (!uni_bt_conn_policy_next_retry(d, stage, &backoff_ms))
+        return false;
+
+    uni_bt_bredr_delay_stage(d, stage, backoff_ms);
+    return true;
+}
+
+bool uni_bt_bredr_restart_stage(uni_hid_device_t* d, uni_bt_conn_stage_t stage) {
+    hci_con_handle_t handle = d->conn.handle;
+
+    // The device opened the connection: it will open it again by itself.
+    if (uni_hid_device_is_incoming(d))
+        return false;
+    if (!uni_bt_bredr_retry_stage(d, stage))
+        return false;
+
+    logi("Closing connection to %s, to restart stage '%s'\n", bd_addr_to_str(d->conn.btaddr),
+         uni_bt_conn_stage_to_str(stage));
+    // Forget the handle and the channels first: their "closed" events must not delete the device.
+    d->conn.handle = UNI_BT_CONN_HANDLE_INVALID;
+    d->conn.control_cid = 0;
+    d->conn.interrupt_cid = 0;
+    if (uni_bt_conn_is_connected(&d->conn)) {
+        uni_bt_conn_set_connected(&d->conn, false);
+        uni_hid_device_on_connected(d, false);
+    }
+    // The L2CAP channels are opened again once the SDP query finishes.
+    if (stage == UNI_BT_CONN_STAGE_SDP)
+        d->sdp_query_type = SDP_QUERY_BEFORE_CONNECT;
+
+    if (gap_get_connection_type(handle) != GAP_CONNECTION_INVALID)
+        gap_disconnect(handle);
+    return true;
+}
+
+void uni_bt_bredr_delay_stage(uni_hid_device_t* d, uni_bt_conn_stage_t stage, uint32_t delay_ms) {
+    d->setup_retry_stage = stage;
+    uni_hid_device_start_setup_timer(d, delay_ms, UNI_BT_PROFILER_TIMER(setup_retry_callback));
+}
+
 void uni_bt_bredr_process_fsm(uni_hid_device_t* d) {
     // TODO: Move to uni_bt_bredr.c
 
@@ -208,6 +366,8 @@ void uni_bt_bredr_process_fsm(uni_hid_device_t* d) {
         loge("uni_bt_process_fsm: Invalid device\n");
         return;
     }
+    // For the setup stats. Only the first call counts.
+    uni_bt_conn_policy_on_setup_started(d);
     // Two possible flows:
     // - Incoming (initiated by gamepad)
     // - Or discovered (initiated by Bluepad32).
@@ -223,19 +383,8 @@ void uni_bt_bredr_process_fsm(uni_hid_device_t* d) {
     if (!uni_hid_device_has_name(d) &&
         ((state == UNI_BT_CONN_STATE_DEVICE_DISCOVERED) || state == UNI_BT_CONN_STATE_L2CAP_INTERRUPT_CONNECTED)) {
         logi("uni_bt_process_fsm: requesting name\n");
-
-        if (d->conn.clock_offset & UNI_BT_CLOCK_OFFSET_VALID)
-            gap_remote_name_request(d->conn.btaddr, d->conn.page_scan_repetition_mode, d->conn.clock_offset);
-        else
-            gap_remote_name_request(d->conn.btaddr, 0x02, 0x0000);
-
-        uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_REMOTE_NAME_INQUIRED);
-
-        // Some devices might not respond to the name request
-        btstack_run_loop_set_timer(&d->inquiry_remote_name_timer, INQUIRY_REMOTE_NAME_TIMEOUT_MS);
-        btstack_run_loop_set_timer_context(&d->inquiry_remote_name_timer, d);
-        btstack_run_loop_set_timer_handler(&d->inquiry_remote_name_timer, &inquiry_remote_name_timeout_callback);
-        btstack_run_loop_add_timer(&d->inquiry_remote_name_timer);
+        // Only one device can be paged at a time. If busy, the request is queued.
+        uni_bt_sched_request(d, sched_resources_for_device(d), &remote_name_request);
         return;
     }
 
@@ -268,7 +417,7 @@ void uni_bt_bredr_process_fsm(uni_hid_device_t* d) {
         }
         // else, not an incoming connection
         logi("uni_bt_process_fsm: Starting L2CAP connection\n");
-        l2cap_create_control_connection(d);
+        request_l2cap_control_connection(d);
         return;
     }
 
@@ -287,7 +436,7 @@ void uni_bt_bredr_process_fsm(uni_hid_device_t* d) {
         // Not incoming
         if (d->sdp_query_type == SDP_QUERY_BEFORE_CONNECT) {
             logi("uni_bt_process_fsm: Starting L2CAP connection\n");
-            l2cap_create_control_connection(d);
+            request_l2cap_control_connection(d);
         } else {
             logi("uni_bt_process_fsm: Device is ready\n");
             uni_hid_device_set_ready(d);
@@ -420,9 +569,15 @@ void uni_bt_bredr_on_l2cap_channel_opened(uint16_t channel, const uint8_t* packe
         return;
     }
 
+    // Channel opened or failed: the L2CAP deadline is not needed anymore.
+    uni_hid_device_stop_setup_timer(device);
+
     status = l2cap_event_channel_opened_get_status(packet);
     if (status) {
         logi("L2CAP Connection failed: 0x%02x.\n", status);
+        if (!l2cap_event_channel_opened_get_incoming(packet) && is_l2cap_status_transient(status) &&
+            uni_bt_bredr_retry_stage(device, UNI_BT_CONN_STAGE_L2CAP))
+            return;
         // Practice showed that if the connection fails, just disconnect/remove
         // so that the connection can start again.
         if (status == L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_SECURITY) {
@@ -461,6 +616,7 @@ void uni_bt_bredr_on_l2cap_channel_opened(uint16_t channel, const uint8_t* packe
 
             // Set "connected" only after PSM_HID_INTERRUPT.
             uni_hid_device_connect(device);
+            uni_bt_conn_policy_on_stage_completed(device, UNI_BT_CONN_STAGE_L2CAP);
             break;
         default:
             logi("Unknown PSM = 0x%02x\n", psm);
@@ -543,6 +699,9 @@ void uni_bt_bredr_on_gap_inquiry_result(uint16_t channel, const uint8_t* packet,
     ARG_UNUSED(size);
 
     gap_event_inquiry_result_get_bd_addr(packet, addr);
+    if (uni_bt_reject_cache_contains(addr))
+        return;
+
     uint8_t page_scan_repetition_mode = gap_event_inquiry_result_get_page_scan_repetition_mode(packet);
     uint16_t clock_offset = gap_event_inquiry_result_get_clock_offset(packet);
     uint32_t cod = gap_event_inquiry_result_get_class_of_device(packet);
@@ -580,6 +739,7 @@ void uni_bt_bredr_on_gap_inquiry_result(uint16_t channel, const uint8_t* packet,
                 loge("\nError: cannot create device, no more available slots\n");
                 return;
             }
+            uni_bt_scan_policy_on_activity();
             uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_DEVICE_DISCOVERED);
             uni_hid_device_set_cod(d, cod);
             d->conn.page_scan_repetition_mode = page_scan_repetition_mode;
@@ -592,6 +752,8 @@ void uni_bt_bredr_on_gap_inquiry_result(uint16_t channel, const uint8_t* packet,
             }
         }
         uni_bt_bredr_process_fsm(d);
+    } else {
+        uni_bt_reject_cache_add(addr);
     }
 }
 
@@ -630,12 +792,17 @@ void uni_bt_bredr_on_hci_connection_complete(uint16_t channel, const uint8_t* pa
 
     hci_event_connection_complete_get_bd_addr(packet, event_addr);
     status = hci_event_connection_complete_get_status(packet);
+    d = uni_hid_device_get_instance_for_address(event_addr);
+
+    // Page finished, successfully or not. Let the other devices page.
+    if (d)
+        uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_PAGE);
+
     if (status) {
         logi("on_hci_connection_complete failed (0x%02x) for %s\n", status, bd_addr_to_str(event_addr));
         return;
     }
 
-    d = uni_hid_device_get_instance_for_address(event_addr);
     if (d == NULL) {
         logi("on_hci_connection_complete: failed to get device for %s\n", bd_addr_to_str(event_addr));
         return;
@@ -732,11 +899,24 @@ void uni_bt_bredr_on_hci_remote_name_request_complete(uint16_t channel, const ui
         const char* name = NULL;
         status = hci_event_remote_name_request_complete_get_status(packet);
         if (status) {
+            // A bonded device paged by the reconnect manager is not around. Don't try to connect to it.
+            btstack_run_loop_remove_timer(&d->inquiry_remote_name_timer);
+            uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_PAGE);
+            if (uni_bt_reconnect_on_page_failed(d)) {
+                /* 'd' is destroyed after this call, don't use it */
+                return;
+            }
+            // Page timeout: the device is not around. Other errors might be transient.
+            if (status != ERROR_CODE_PAGE_TIMEOUT && uni_bt_bredr_retry_stage(d, UNI_BT_CONN_STAGE_NAME))
+                return;
+
             // Failed to get the name, just fake one
             logi("Failed to fetch name for %s, error = 0x%02x\n", bd_addr_to_str(event_addr), status);
             name = "Controller without name";
         } else {
             name = hci_event_remote_name_request_complete_get_remote_name(packet);
+            uni_bt_reconnect_on_page_succeeded(d);
+            uni_bt_conn_policy_on_stage_completed(d, UNI_BT_CONN_STAGE_NAME);
         }
         logi("Name: '%s'\n", name);
         uni_hid_device_set_name(d, name);
@@ -751,5 +931,6 @@ void uni_bt_bredr_on_hci_remote_name_request_complete(uint16_t channel, const ui
 
         // Remove timer
         btstack_run_loop_remove_timer(&d->inquiry_remote_name_timer);
+        uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_PAGE);
     }
 }
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_cmd_queue.h"
+
+#include <stdatomic.h>
+
+#include <btstack.h>
+
+#include "sdkconfig.h"
+
+#include "bt/uni_bt_profiler.h"
+#include "uni_common.h"
+#include "uni_log.h"
+
+#ifdef CONFIG_BLUEPAD32_CMD_QUEUE_SIZE
+#define CMD_QUEUE_SIZE CONFIG_BLUEPAD32_CMD_QUEUE_SIZE
+#else
+#define CMD_QUEUE_SIZE 32
+#endif
+#define CMD_QUEUE_MASK (CMD_QUEUE_SIZE - 1)
+_Static_assert((CMD_QUEUE_SIZE & CMD_QUEUE_MASK) == 0, "CMD_QUEUE_SIZE must be a power of 2");
+
+// Bounded queue based on Dmitry Vyukov's MPMC queue: each cell has a sequence number
+// that tells whether it is free for the producer at "pos", or ready for the consumer at "pos".
+// Producers reserve a cell with a CAS on "enqueue_pos". There is only one consumer: the BTstack thread.
+//
+// The sequence is stored minus the cell index, so that the zero-initialized queue is valid
+// and doesn't need an init function that must be called before any producer.
+typedef struct {
+    atomic_uint sequence;
+    uni_bt_cmd_t cmd;
+} cell_t;
+
+static cell_t cells[CMD_QUEUE_SIZE];
+static atomic_uint enqueue_pos;
+// Only used by the consumer.
+static unsigned int dequeue_pos;
+
+// Only one drain callback is scheduled at a time, so the registration is never added twice.
+static atomic_bool drain_scheduled;
+static btstack_context_callback_registration_t drain_registration;
+
+// Updated by producers.
+static atomic_uint stats_pushed;
+static atomic_uint stats_overflows;
+// Updated by the consumer.
+static uint32_t stats_executed;
+static uint32_t stats_wakeups;
+static uint32_t stats_max_batch;
+
+static void drain(void* context);
+UNI_BT_PROFILER_DECLARE_CALLBACK(drain)
+
+static unsigned int load_sequence(unsigned int idx, memory_order order) {
+    return atomic_load_explicit(&cells[idx].sequence, order) + idx;
+}
+
+static void store_sequence(unsigned int idx, unsigned int seq, memory_order order) {
+    atomic_store_explicit(&cells[idx].sequence, seq - idx, order);
+}
+
+static void schedule_drain(void) {
+    // Pairs with the fence in drain(): either the consumer sees the new command, or the producer sees the flag cleared.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&drain_scheduled, true))
+        return;
+    drain_registration.callback = UNI_BT_PROFILER_CALLBACK(drain);
+    drain_registration.context = NULL;
+    btstack_run_loop_execute_on_main_thread(&drain_registration);
+}
+
+static void drain(void* context) {
+    ARG_UNUSED(context);
+
+    uni_bt_cmd_t cmd;
+    unsigned int idx;
+    unsigned int seq;
+    uint32_t batch = 0;
+
+    // Cleared before reading the queue: a command pushed from now on schedules a new drain,
+    // or it is read in this one.
+    atomic_store(&drain_scheduled, false);
+    atomic_thread_fence(memory_order_seq_cst);
+    stats_wakeups++;
+
+    // Bounded, so that a flood of commands doesn't starve the rest of BTstack.
+    while (batch < CMD_QUEUE_SIZE) {
+        idx = dequeue_pos & CMD_QUEUE_MASK;
+        seq = load_sequence(idx, memory_order_acquire);
+        if ((int)(seq - (dequeue_pos + 1)) < 0)
+            break;
+
+        cmd = cells[idx].cmd;
+        // Frees the cell for the producer, one lap later.
+        store_sequence(idx, dequeue_pos + CMD_QUEUE_SIZE, memory_order_release);
+        dequeue_pos++;
+
+        cmd.handler(&cmd);
+        batch++;
+    }
+
+    stats_executed += batch;
+    if (batch > stats_max_batch)
+        stats_max_batch = batch;
+
+    // There might be more.
+    if (batch == CMD_QUEUE_SIZE)
+        schedule_drain();
+}
+
+bool uni_bt_cmd_queue_push(const uni_bt_cmd_t* cmd) {
+    unsigned int pos;
+    unsigned int idx;
+    unsigned int seq;
+    int diff;
+
+    if (cmd->handler == NULL) {
+        loge("Cmd queue: invalid command, no handler\n");
+        return false;
+    }
+
+    pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    while (true) {
+        idx = pos & CMD_QUEUE_MASK;
+        seq = load_sequence(idx, memory_order_acquire);
+        diff = (int)(seq - pos);
+        if (diff == 0) {
+            // Free cell. Try to reserve it. On failure "pos" is updated.
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // Cell not consumed yet: full.
+            atomic_fetch_add_explicit(&stats_overflows, 1, memory_order_relaxed);
+            return false;
+        } else {
+            // Another producer took it.
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    cells[idx].cmd = *cmd;
+    // Publishes the command to the consumer.
+    store_sequence(idx, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&stats_pushed, 1, memory_order_relaxed);
+
+    schedule_drain();
+    return true;
+}
+
+void uni_bt_cmd_queue_get_stats(uni_bt_cmd_queue_stats_t* stats) {
+    stats->pushed = atomic_load_explicit(&stats_pushed, memory_order_relaxed);
+    stats->overflows = atomic_load_explicit(&stats_overflows, memory_order_relaxed);
+    stats->executed = stats_executed;
+    stats->wakeups = stats_wakeups;
+    stats->max_batch = stats_max_batch;
+}
+
+void uni_bt_cmd_queue_dump(void) {
+    uni_bt_cmd_queue_stats_t stats;
+
+    uni_bt_cmd_queue_get_stats(&stats);
+    logi("Cmd queue: pushed=%u, executed=%u, overflows=%u, wakeups=%u, max batch=%u (size=%d)\n",
+         (unsigned int)stats.pushed, (unsigned int)stats.executed, (unsigned int)stats.overflows,
+         (unsigned int)stats.wakeups, (unsigned int)stats.max_batch, CMD_QUEUE_SIZE);
+}
@@ -6,15 +6,69 @@
 
 #include <string.h>
 
+#include "uni_common.h"
 #include "uni_log.h"
 
+// Number of setup timelines kept to calculate the percentiles.
+#define TRACE_HISTORY_LEN 16
+
+static uint16_t trace_history[TRACE_HISTORY_LEN][UNI_BT_CONN_STATE_COUNT];
+static int trace_history_idx;
+static int trace_history_count;
+
+static const char* state_names[] = {
+    [UNI_BT_CONN_STATE_DEVICE_NONE] = "none",
+    [UNI_BT_CONN_STATE_DEVICE_DISCOVERED] = "discovered",
+    [UNI_BT_CONN_STATE_REMOTE_NAME_REQUEST] = "name request",
+    [UNI_BT_CONN_STATE_REMOTE_NAME_INQUIRED] = "name inquired",
+    [UNI_BT_CONN_STATE_REMOTE_NAME_FETCHED] = "name fetched",
+    [UNI_BT_CONN_STATE_SDP_VENDOR_REQUESTED] = "sdp vendor requested",
+    [UNI_BT_CONN_STATE_SDP_VENDOR_FETCHED] = "sdp vendor fetched",
+    [UNI_BT_CONN_STATE_SDP_HID_DESCRIPTOR_REQUESTED] = "sdp descriptor requested",
+    [UNI_BT_CONN_STATE_SDP_HID_DESCRIPTOR_FETCHED] = "sdp descriptor fetched",
+    [UNI_BT_CONN_STATE_L2CAP_CONTROL_CONNECTION_REQUESTED] = "l2cap control requested",
+    [UNI_BT_CONN_STATE_L2CAP_CONTROL_CONNECTED] = "l2cap control connected",
+    [UNI_BT_CONN_STATE_L2CAP_INTERRUPT_CONNECTION_REQUESTED] = "l2cap interrupt requested",
+    [UNI_BT_CONN_STATE_L2CAP_INTERRUPT_CONNECTED] = "l2cap interrupt connected",
+    [UNI_BT_CONN_STATE_DEVICE_PENDING_READY] = "parser setup",
+    [UNI_BT_CONN_STATE_DEVICE_READY] = "ready",
+};
+_Static_assert(ARRAY_SIZE(state_names) == UNI_BT_CONN_STATE_COUNT, "Update state_names");
+
+static void trace_state(uni_bt_conn_t* conn, uni_bt_conn_state_t state) {
+    uint32_t elapsed;
+
+    if (state <= UNI_BT_CONN_STATE_DEVICE_NONE || state >= UNI_BT_CONN_STATE_COUNT)
+        return;
+
+    // In case the device was not created with uni_hid_device_create(). E.g: virtual devices.
+    if (conn->trace_start_ms == 0)
+        uni_bt_conn_trace_start(conn);
+
+    // Only the first time the state is reached is recorded.
+    if (conn->trace_ms[state] != UNI_BT_CONN_TRACE_NOT_REACHED)
+        return;
+
+    elapsed = btstack_run_loop_get_time_ms() - conn->trace_start_ms;
+    conn->trace_ms[state] = btstack_min(elapsed, UNI_BT_CONN_TRACE_NOT_REACHED - 1);
+
+    if (state == UNI_BT_CONN_STATE_DEVICE_READY) {
+        memcpy(trace_history[trace_history_idx], conn->trace_ms, sizeof(conn->trace_ms));
+        trace_history_idx = (trace_history_idx + 1) % TRACE_HISTORY_LEN;
+        trace_history_count = btstack_min(trace_history_count + 1, TRACE_HISTORY_LEN);
+        logi("Device %s setup took %d ms\n", bd_addr_to_str(conn->btaddr), conn->trace_ms[state]);
+    }
+}
+
 void uni_bt_conn_init(uni_bt_conn_t* conn) {
     memset(conn, 0, sizeof(*conn));
     conn->handle = UNI_BT_CONN_HANDLE_INVALID;
+    memset(conn->trace_ms, 0xff, sizeof(conn->trace_ms));
 }
 
 void uni_bt_conn_set_state(uni_bt_conn_t* conn, uni_bt_conn_state_t state) {
     conn->state = state;
+    trace_state(conn, state);
 }
 
 void uni_bt_conn_set_protocol(uni_bt_conn_t* conn, uni_bt_conn_protocol_t protocol) {
@@ -48,3 +102,74 @@ bool uni_bt_conn_is_connected(const uni_bt_conn_t* conn) {
 void uni_bt_conn_disconnect(uni_bt_conn_t* conn) {
     uni_bt_conn_set_connected(conn, false);
 }
+
+void uni_bt_conn_trace_start(uni_bt_conn_t* conn) {
+    memset(conn->trace_ms, 0xff, sizeof(conn->trace_ms));
+    conn->trace_start_ms = btstack_run_loop_get_time_ms();
+    // Zero means "not started".
+    if (conn->trace_start_ms == 0)
+        conn->trace_start_ms = 1;
+}
+
+int32_t uni_bt_conn_trace_get_state_ms(const uni_bt_conn_t* conn, uni_bt_conn_state_t state) {
+    if (state >= UNI_BT_CONN_STATE_COUNT || conn->trace_ms[state] == UNI_BT_CONN_TRACE_NOT_REACHED)
+        return -1;
+    return conn->trace_ms[state];
+}
+
+int32_t uni_bt_conn_trace_get_percentile(uni_bt_conn_state_t state, int percentile) {
+    uint16_t values[TRACE_HISTORY_LEN];
+    uint16_t v;
+    int count = 0;
+    int j;
+
+    if (state >= UNI_BT_CONN_STATE_COUNT || percentile < 0 || percentile > 100)
+        return -1;
+
+    // Insertion sort. There are only a few values.
+    for (int i = 0; i < trace_history_count; i++) {
+        v = trace_history[i][state];
+        if (v == UNI_BT_CONN_TRACE_NOT_REACHED)
+            continue;
+        for (j = count; j > 0 && values[j - 1] > v; j--)
+            values[j] = values[j - 1];
+        values[j] = v;
+        count++;
+    }
+    if (count == 0)
+        return -1;
+
+    // Nearest-rank method
+    j = (percentile * count + 99) / 100;
+    return values[j > 0 ? j - 1 : 0];
+}
+
+const char* uni_bt_conn_state_to_str(uni_bt_conn_state_t state) {
+    if (state >= UNI_BT_CONN_STATE_COUNT)
+        return "unknown";
+    return state_names[state];
+}
+
+void uni_bt_conn_trace_dump(const uni_bt_conn_t* conn) {
+    int32_t prev = 0;
+    int32_t ms;
+
+    logi("\tsetup timeline (ms since start / ms since previous):\n");
+    for (int i = UNI_BT_CONN_STATE_DEVICE_NONE + 1; i < UNI_BT_CONN_STATE_COUNT; i++) {
+        ms = uni_bt_conn_trace_get_state_ms(conn, i);
+        if (ms < 0)
+            continue;
+        logi("\t\t%-26s %6d / %6d\n", state_names[i], ms, ms - prev);
+        prev = ms;
+    }
+}
+
+void uni_bt_conn_trace_dump_stats(void) {
+    logi("Setup timeline of the last %d connections (ms since start). p50 / p90 / max:\n", trace_history_count);
+    for (int i = UNI_BT_CONN_STATE_DEVICE_NONE + 1; i < UNI_BT_CONN_STATE_COUNT; i++) {
+        if (uni_bt_conn_trace_get_percentile(i, 100) < 0)
+            continue;
+        logi("\t%-26s %6d / %6d / %6d\n", state_names[i], uni_bt_conn_trace_get_percentile(i, 50),
+             uni_bt_conn_trace_get_percentile(i, 90), uni_bt_conn_trace_get_percentile(i, 100));
+    }
+}
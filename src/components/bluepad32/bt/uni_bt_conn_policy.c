@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_conn_policy.h"
+
+#include <btstack.h>
+
+#include "controller/uni_controller_type.h"
+#include "uni_common.h"
+#include "uni_log.h"
+
+typedef struct {
+    uint32_t timeouts;
+    uint32_t retries;
+    // Completed after one or more retries.
+    uint32_t recovered;
+} stage_stats_t;
+
+// Controller families that need a different policy than the default one.
+typedef enum {
+    FAMILY_DEFAULT,
+    // Parser setup can't be re-run: it registers rumble timers. See uni_hid_parser_ds4.c
+    FAMILY_DUALSHOCK,
+    // Parser setup has its own state machine and retries, and takes several seconds.
+    FAMILY_SELF_RETRY,
+    // Old devices like "ThinkGeek 8-bitty Game Controller" take a lot of time to respond to SDP queries: 13s.
+    FAMILY_SLOW_SDP,
+
+    FAMILY_COUNT,
+} family_t;
+
+typedef struct {
+    uint16_t vendor_id;
+    uint16_t product_id;
+    family_t family;
+} family_id_t;
+
+// A lost SDP query is aborted by closing the connection, and retried. See uni_bt_sdp.c
+// So the first SDP attempt can be short. The deadline is doubled on each retry.
+static const uni_bt_conn_stage_policy_t default_policies[UNI_BT_CONN_STAGE_COUNT] = {
+    [UNI_BT_CONN_STAGE_NAME] = {.timeout_ms = 4500, .max_retries = 2, .backoff_ms = 100},
+    [UNI_BT_CONN_STAGE_SDP] = {.timeout_ms = 3000, .max_retries = 2, .backoff_ms = 200},
+    [UNI_BT_CONN_STAGE_L2CAP] = {.timeout_ms = 8000, .max_retries = 2, .backoff_ms = 250},
+    [UNI_BT_CONN_STAGE_PARSER] = {.timeout_ms = 4000, .max_retries = 1, .backoff_ms = 0},
+};
+
+// Stages not listed here (timeout_ms == 0) use the default policy.
+static const uni_bt_conn_stage_policy_t family_policies[FAMILY_COUNT][UNI_BT_CONN_STAGE_COUNT] = {
+    [FAMILY_DUALSHOCK] =
+        {
+            [UNI_BT_CONN_STAGE_PARSER] = {.timeout_ms = 5000, .max_retries = 0, .backoff_ms = 0},
+        },
+    [FAMILY_SELF_RETRY] =
+        {
+            [UNI_BT_CONN_STAGE_PARSER] = {.timeout_ms = 10000, .max_retries = 0, .backoff_ms = 0},
+        },
+    [FAMILY_SLOW_SDP] =
+        {
+            [UNI_BT_CONN_STAGE_SDP] = {.timeout_ms = 13000, .max_retries = 1, .backoff_ms = 200},
+        },
+};
+
+// The controller type is not known until the VID/PID SDP query finishes. The VID/PID is enough for the deadline of
+// the HID descriptor query. The VID/PID query itself uses the default one.
+static const family_id_t family_ids[] = {
+    // iCade 8-Bitty, a.k.a. "ThinkGeek 8-bitty Game Controller"
+    {.vendor_id = 0x0a5c, .product_id = 0x8502, .family = FAMILY_SLOW_SDP},
+};
+
+static const char* stage_names[UNI_BT_CONN_STAGE_COUNT] = {
+    [UNI_BT_CONN_STAGE_NAME] = "name",
+    [UNI_BT_CONN_STAGE_SDP] = "sdp",
+    [UNI_BT_CONN_STAGE_L2CAP] = "l2cap",
+    [UNI_BT_CONN_STAGE_PARSER] = "parser",
+};
+
+static stage_stats_t stage_stats[UNI_BT_CONN_STAGE_COUNT];
+static uint32_t setups_ok;
+static uint32_t setups_failed;
+// Of the successful setups.
+static uint32_t setup_total_ms;
+static uint32_t setup_max_ms;
+
+static family_t get_family(const uni_hid_device_t* d) {
+    switch (d->controller_type) {
+        case CONTROLLER_TYPE_PS4Controller:
+        case CONTROLLER_TYPE_PS5Controller:
+            return FAMILY_DUALSHOCK;
+        case CONTROLLER_TYPE_SwitchProController:
+        case CONTROLLER_TYPE_SwitchJoyConLeft:
+        case CONTROLLER_TYPE_SwitchJoyConRight:
+        case CONTROLLER_TYPE_SwitchJoyConPair:
+        case CONTROLLER_TYPE_SwitchInputOnlyController:
+        case CONTROLLER_TYPE_WiiController:
+        case CONTROLLER_TYPE_SteamController:
+        case CONTROLLER_TYPE_SteamControllerV2:
+            return FAMILY_SELF_RETRY;
+        case CONTROLLER_TYPE_iCadeController:
+            return FAMILY_SLOW_SDP;
+        default:
+            break;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(family_ids); i++) {
+        if (d->vendor_id == family_ids[i].vendor_id && d->product_id == family_ids[i].product_id)
+            return family_ids[i].family;
+    }
+    return FAMILY_DEFAULT;
+}
+
+const uni_bt_conn_stage_policy_t* uni_bt_conn_policy_get(const uni_hid_device_t* d, uni_bt_conn_stage_t stage) {
+    const uni_bt_conn_stage_policy_t* policy = &family_policies[get_family(d)][stage];
+
+    if (policy->timeout_ms == 0)
+        return &default_policies[stage];
+    return policy;
+}
+
+uint32_t uni_bt_conn_policy_get_timeout_ms(const uni_hid_device_t* d, uni_bt_conn_stage_t stage) {
+    uint32_t timeout_ms = uni_bt_conn_policy_get(d, stage)->timeout_ms << d->conn.stage_retries[stage];
+
+    // A stage deadline longer than the whole connection timeout is useless.
+    return btstack_min(timeout_ms, HID_DEVICE_CONNECTION_TIMEOUT_MS);
+}
+
+bool uni_bt_conn_policy_next_retry(uni_hid_device_t* d, uni_bt_conn_stage_t stage, uint32_t* backoff_ms) {
+    const uni_bt_conn_stage_policy_t* policy = uni_bt_conn_policy_get(d, stage);
+    uint8_t retries = d->conn.stage_retries[stage];
+
+    if (retries >= policy->max_retries) {
+        logi("%s: no more retries for stage '%s' (%d)\n", bd_addr_to_str(d->conn.btaddr), stage_names[stage],
+             retries);
+        return false;
+    }
+
+    *backoff_ms = (uint32_t)policy->backoff_ms << retries;
+    d->conn.stage_retries[stage] = retries + 1;
+    stage_stats[stage].retries++;
+    logi("%s: retrying stage '%s' in %u ms (%d/%d)\n", bd_addr_to_str(d->conn.btaddr), stage_names[stage],
+         (unsigned int)*backoff_ms, retries + 1, policy->max_retries);
+    return true;
+}
+
+void uni_bt_conn_policy_on_stage_timeout(uni_bt_conn_stage_t stage) {
+    stage_stats[stage].timeouts++;
+}
+
+void uni_bt_conn_policy_on_stage_completed(const uni_hid_device_t* d, uni_bt_conn_stage_t stage) {
+    if (d->conn.stage_retries[stage] > 0)
+        stage_stats[stage].recovered++;
+}
+
+void uni_bt_conn_policy_on_setup_started(uni_hid_device_t* d) {
+    if (d->conn.setup_started)
+        return;
+    d->conn.setup_started = true;
+    d->conn.setup_start_ms = btstack_run_loop_get_time_ms();
+}
+
+void uni_bt_conn_policy_on_setup_finished(uni_hid_device_t* d, bool success) {
+    uint32_t elapsed_ms;
+
+    if (!d->conn.setup_started)
+        return;
+    d->conn.setup_started = false;
+
+    if (!success) {
+        setups_failed++;
+        return;
+    }
+    setups_ok++;
+    elapsed_ms = btstack_run_loop_get_time_ms() - d->conn.setup_start_ms;
+    setup_total_ms += elapsed_ms;
+    if (elapsed_ms > setup_max_ms)
+        setup_max_ms = elapsed_ms;
+}
+
+void uni_bt_conn_policy_get_stats(uni_bt_conn_policy_stats_t* stats) {
+    stats->setups_ok = setups_ok;
+    stats->setups_failed = setups_failed;
+    stats->setup_avg_ms = setups_ok ? setup_total_ms / setups_ok : 0;
+    stats->setup_max_ms = setup_max_ms;
+    for (int i = 0; i < UNI_BT_CONN_STAGE_COUNT; i++) {
+        stats->stage_timeouts[i] = stage_stats[i].timeouts;
+        stats->stage_retries[i] = stage_stats[i].retries;
+        stats->stage_recovered[i] = stage_stats[i].recovered;
+    }
+}
+
+const char* uni_bt_conn_stage_to_str(uni_bt_conn_stage_t stage) {
+    if (stage >= UNI_BT_CONN_STAGE_COUNT)
+        return "unknown";
+    return stage_names[stage];
+}
+
+void uni_bt_conn_policy_dump(void) {
+    uint32_t total = setups_ok + setups_failed;
+
+    logi("Setups: %u ok, %u failed (success rate %u%%), time avg %u ms, max %u ms\n", (unsigned int)setups_ok,
+         (unsigned int)setups_failed, total ? (unsigned int)(setups_ok * 100 / total) : 0,
+         setups_ok ? (unsigned int)(setup_total_ms / setups_ok) : 0, (unsigned int)setup_max_ms);
+    logi("\t%-8s %8s %8s %9s\n", "stage", "timeouts", "retries", "recovered");
+    for (int i = 0; i < UNI_BT_CONN_STAGE_COUNT; i++) {
+        logi("\t%-8s %8u %8u %9u\n", stage_names[i], (unsigned int)stage_stats[i].timeouts,
+             (unsigned int)stage_stats[i].retries, (unsigned int)stage_stats[i].recovered);
+    }
+}
@@ -67,6 +67,10 @@
 
 #include "bt/uni_bt_conn.h"
 #include "bt/uni_bt_defines.h"
+#include "bt/uni_bt_le_conn_params.h"
+#include "bt/uni_bt_profiler.h"
+#include "bt/uni_bt_reject_cache.h"
+#include "bt/uni_bt_scan_policy.h"
 #include "parser/uni_hid_parser.h"
 #include "uni_common.h"
 #include "uni_config.h"
@@ -295,6 +299,7 @@ static void uni_hids_client_packet_handler(uint8_t packet_type, uint16_t channel
 
                     uni_hid_device_guess_controller_type_from_pid_vid(device);
                     uni_hid_device_connect(device);
+                    uni_bt_le_conn_params_on_device_connected(device);
                     uni_hid_device_set_ready(device);
 
                     resume_scanning_hint();
@@ -345,6 +350,8 @@ static void uni_hids_client_packet_handler(uint8_t packet_type, uint16_t channel
     }
 }
 
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(uni_hids_client_packet_handler)
+
 static void uni_device_information_packet_handler(uint8_t packet_type,
                                                   uint16_t channel,
                                                   uint8_t* packet,
@@ -395,8 +402,9 @@ static void uni_device_information_packet_handler(uint8_t packet_type,
 
                     // Continue - query primary services.
                     logi("Search for HID service, con_handle: %#x\n", con_handle);
-                    status = hids_client_connect(con_handle, uni_hids_client_packet_handler, HID_PROTOCOL_MODE_REPORT,
-                                                 &hids_cid);
+                    status = hids_client_connect(con_handle,
+                                                 UNI_BT_PROFILER_PACKET_HANDLER(uni_hids_client_packet_handler),
+                                                 HID_PROTOCOL_MODE_REPORT, &hids_cid);
                     if (status == ERROR_CODE_COMMAND_DISALLOWED) {
                         logi("HID client connection failed with COMMAND_DISALLOWED, ignoring \n");
                         // Means that a HIDS client connection is already present.
@@ -535,6 +543,8 @@ static void uni_device_information_packet_handler(uint8_t packet_type,
     }
 }
 
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(uni_device_information_packet_handler)
+
 /* HCI packet handler
  *
  * text The SM packet handler receives Security Manager Events required for
@@ -672,13 +682,16 @@ static void uni_sm_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t
             return;
         }
         logi("Requesting device information\n");
-        status = device_information_service_client_query(con_handle, uni_device_information_packet_handler);
+        status = device_information_service_client_query(
+            con_handle, UNI_BT_PROFILER_PACKET_HANDLER(uni_device_information_packet_handler));
         if (status != ERROR_CODE_SUCCESS) {
             loge("Failed to set device information client: %#x\n", status);
         }
     }
 }
 
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(uni_sm_packet_handler)
+
 void uni_bt_le_on_hci_event_le_meta(const uint8_t* packet, uint16_t size) {
     uni_hid_device_t* device;
     hci_con_handle_t con_handle;
@@ -701,12 +714,17 @@ void uni_bt_le_on_hci_event_le_meta(const uint8_t* packet, uint16_t size) {
             logi("Using con_handle: %#x\n", con_handle);
 
             uni_hid_device_set_connection_handle(device, con_handle);
+            uni_bt_le_conn_params_on_connection_complete(device, packet);
             sm_request_pairing(con_handle);
 
             // Resume scanning
             // gap_start_scan();
             break;
 
+        case HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE:
+            uni_bt_le_conn_params_on_connection_update_complete(packet);
+            break;
+
         case HCI_SUBEVENT_LE_ADVERTISING_REPORT:
             // Safely ignore it, we handle the GAP advertising report instead
             break;
@@ -761,6 +779,9 @@ void uni_bt_le_on_gap_event_advertising_report(const uint8_t* packet, uint16_t s
     ARG_UNUSED(size);
 
     gap_event_advertising_report_get_address(packet, addr);
+    // Checked first: in crowded places most of the reports come from rejected devices.
+    if (uni_bt_reject_cache_contains(addr))
+        return;
     if (uni_hid_device_get_instance_for_address(addr)) {
         // Ignore, address already found
         return;
@@ -773,6 +794,7 @@ void uni_bt_le_on_gap_event_advertising_report(const uint8_t* packet, uint16_t s
         // Don't log it. There too many devices advertising themselves.
         if (appearance != 0 || strlen(name) != 0)
             logd("Not a HID controller, appearance: %#x, name =%s\n", appearance, name);
+        uni_bt_reject_cache_add(addr);
         return;
     }
 
@@ -802,14 +824,17 @@ void uni_bt_le_on_gap_event_advertising_report(const uint8_t* packet, uint16_t s
     logi(", rssi %u dBm", rssi);
     logi(", name '%s'\n", name);
 
-    if (uni_hid_device_on_device_discovered(addr, name, cod, rssi) != UNI_ERROR_SUCCESS)
+    if (uni_hid_device_on_device_discovered(addr, name, cod, rssi) != UNI_ERROR_SUCCESS) {
+        uni_bt_reject_cache_add(addr);
         return;
+    }
 
     uni_hid_device_t* d = uni_hid_device_create(addr);
     if (!d) {
         loge("Error: no more available device slots\n");
         return;
     }
+    uni_bt_scan_policy_on_activity();
 
     // FIXME: Using CODs to make it compatible with legacy BR/EDR code.
     uni_hid_device_set_cod(d, cod);
@@ -826,6 +851,8 @@ void uni_bt_le_on_hci_disconnection_complete(uint16_t channel, const uint8_t* pa
     ARG_UNUSED(packet);
     ARG_UNUSED(size);
 
+    // The remaining links can use the air time of the disconnected one.
+    uni_bt_le_conn_params_rebalance();
     resume_scanning_hint();
 }
 
@@ -876,7 +903,7 @@ void uni_bt_le_delete_bonded_keys(void) {
 
 void uni_bt_le_setup(void) {
     // register for events from Security Manager
-    sm_event_callback_registration.callback = &uni_sm_packet_handler;
+    sm_event_callback_registration.callback = UNI_BT_PROFILER_PACKET_HANDLER(uni_sm_packet_handler);
     sm_add_event_handler(&sm_event_callback_registration);
 
     // Setup LE device db
@@ -922,6 +949,15 @@ void uni_bt_le_setup(void) {
     device_information_service_client_init();
 
     gap_set_scan_parameters(0 /* type: passive */, 48 /* interval */, 48 /* window */);
+    uni_bt_le_conn_params_setup();
+}
+
+void uni_bt_le_scan_start_with_params(uint16_t interval, uint16_t window) {
+    if (!ble_enabled)
+        return;
+
+    gap_set_scan_parameters(0 /* type: passive */, interval, window);
+    uni_bt_le_scan_start();
 }
 
 void uni_bt_le_scan_start(void) {
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_le_conn_params.h"
+
+#include <btstack.h>
+
+#include "sdkconfig.h"
+
+#include "bt/uni_bt_conn.h"
+#include "controller/uni_controller_type.h"
+#include "uni_common.h"
+#include "uni_log.h"
+
+// Intervals in 1.25ms units, supervision timeouts in 10ms units.
+// 7.5ms is the minimum interval allowed by the spec.
+#define INTERVAL_MIN 6
+// Air time reserved per active LE link: 3.75ms.
+#define INTERVAL_PER_LINK 3
+// After that, the parameters negotiated by the peripheral are kept.
+#define MAX_UPDATE_FAILURES 2
+
+// Used when creating the connection, before knowing what kind of device it is.
+#define INITIAL_INTERVAL_MIN 6
+#define INITIAL_INTERVAL_MAX 12
+#define INITIAL_LATENCY 0
+#define INITIAL_SUPERVISION_TIMEOUT 200
+// Same values as BTstack defaults.
+#define INITIAL_SCAN_INTERVAL 0x0060
+#define INITIAL_SCAN_WINDOW 0x0030
+#define INITIAL_CE_LENGTH_MIN 0x0002
+#define INITIAL_CE_LENGTH_MAX 0x0030
+
+typedef struct {
+    uint16_t interval_min;
+    uint16_t interval_max;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+} conn_params_t;
+
+static const conn_params_t profiles[] = {
+    // Report every connection event: 7.5ms, 2s supervision timeout.
+    [UNI_BT_LE_CONN_PROFILE_LOW_LATENCY] = {.interval_min = INTERVAL_MIN,
+                                            .interval_max = INTERVAL_MIN,
+                                            .latency = 0,
+                                            .supervision_timeout = 200},
+    // 15-30ms, the peripheral can skip up to 4 events when idle. 4s supervision timeout.
+    [UNI_BT_LE_CONN_PROFILE_RELAXED] = {.interval_min = 12,
+                                        .interval_max = 24,
+                                        .latency = 4,
+                                        .supervision_timeout = 400},
+};
+
+static const char* profile_names[] = {
+    [UNI_BT_LE_CONN_PROFILE_LOW_LATENCY] = "low-latency",
+    [UNI_BT_LE_CONN_PROFILE_RELAXED] = "relaxed",
+};
+
+static uint32_t stats_requested;
+static uint32_t stats_rejected;
+static uint32_t stats_rebalances;
+
+static bool is_le_link(const uni_hid_device_t* d) {
+    return d->conn.protocol == UNI_BT_CONN_PROTOCOL_BLE && d->conn.handle != UNI_BT_CONN_HANDLE_INVALID &&
+           gap_get_connection_type(d->conn.handle) == GAP_CONNECTION_LE;
+}
+
+static uint8_t get_active_links(void) {
+    uint8_t links = 0;
+
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (is_le_link(uni_hid_device_get_instance_for_idx(i)))
+            links++;
+    }
+    return links;
+}
+
+static void get_params(const uni_hid_device_t* d, uint8_t links, conn_params_t* out) {
+    uni_bt_le_conn_profile_t profile = uni_bt_le_conn_params_get_profile(d);
+
+    *out = profiles[profile];
+    if (profile != UNI_BT_LE_CONN_PROFILE_LOW_LATENCY)
+        return;
+
+    // Make room for the rest of the links.
+    out->interval_min = btstack_max(out->interval_min, INTERVAL_PER_LINK * links);
+    out->interval_max = btstack_max(out->interval_max, out->interval_min);
+
+    // The peripheral rejected an exact interval. Give it some room.
+    if (d->conn.le_update_failures > 0)
+        out->interval_max = out->interval_min * 2;
+}
+
+static void request_params(uni_hid_device_t* d, uint8_t links) {
+    conn_params_t p;
+    int status;
+
+    if (d->conn.le_update_failures >= MAX_UPDATE_FAILURES)
+        return;
+
+    get_params(d, links, &p);
+
+    // Already in use.
+    if (d->conn.le_interval >= p.interval_min && d->conn.le_interval <= p.interval_max &&
+        d->conn.le_latency == p.latency)
+        return;
+    // Already requested, waiting for the update to complete.
+    if (d->conn.le_requested_interval_max == p.interval_max)
+        return;
+
+    status = gap_update_connection_parameters(d->conn.handle, p.interval_min, p.interval_max, p.latency,
+                                              p.supervision_timeout);
+    if (status != ERROR_CODE_SUCCESS) {
+        loge("%s: failed to update connection parameters, status=%#x\n", bd_addr_to_str(d->conn.btaddr), status);
+        return;
+    }
+    d->conn.le_requested_interval_max = p.interval_max;
+    stats_requested++;
+    logi("%s: requesting %s connection parameters: interval=%d-%d, latency=%d, links=%d\n",
+         bd_addr_to_str(d->conn.btaddr), profile_names[uni_bt_le_conn_params_get_profile(d)], p.interval_min,
+         p.interval_max, p.latency, links);
+}
+
+void uni_bt_le_conn_params_setup(void) {
+    gap_set_connection_parameters(INITIAL_SCAN_INTERVAL, INITIAL_SCAN_WINDOW, INITIAL_INTERVAL_MIN,
+                                  INITIAL_INTERVAL_MAX, INITIAL_LATENCY, INITIAL_SUPERVISION_TIMEOUT,
+                                  INITIAL_CE_LENGTH_MIN, INITIAL_CE_LENGTH_MAX);
+}
+
+uni_bt_le_conn_profile_t uni_bt_le_conn_params_get_profile(const uni_hid_device_t* d) {
+    switch (d->controller_type) {
+        case k_eControllerType_SmartTVRemoteController:
+        case k_eControllertype_GenericKeyboard:
+            return UNI_BT_LE_CONN_PROFILE_RELAXED;
+        default:
+            break;
+    }
+    if (uni_hid_device_is_keyboard(d))
+        return UNI_BT_LE_CONN_PROFILE_RELAXED;
+    return UNI_BT_LE_CONN_PROFILE_LOW_LATENCY;
+}
+
+void uni_bt_le_conn_params_on_device_connected(uni_hid_device_t* d) {
+    if (!uni_bt_conn_is_connected(&d->conn)) {
+        loge("%s: device not connected, not requesting connection parameters\n", bd_addr_to_str(d->conn.btaddr));
+        return;
+    }
+    // Requests the parameters of the new device, and makes room for it in the rest of the links.
+    uni_bt_le_conn_params_rebalance();
+}
+
+void uni_bt_le_conn_params_rebalance(void) {
+    uint8_t links = get_active_links();
+
+    stats_rebalances++;
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        uni_hid_device_t* d = uni_hid_device_get_instance_for_idx(i);
+        // Relaxed links don't depend on the number of links: only requested once.
+        if (is_le_link(d) && uni_bt_conn_is_connected(&d->conn))
+            request_params(d, links);
+    }
+}
+
+void uni_bt_le_conn_params_on_connection_complete(uni_hid_device_t* d, const uint8_t* packet) {
+    d->conn.le_interval = hci_subevent_le_connection_complete_get_conn_interval(packet);
+    d->conn.le_latency = hci_subevent_le_connection_complete_get_conn_latency(packet);
+    d->conn.le_supervision_timeout = hci_subevent_le_connection_complete_get_supervision_timeout(packet);
+}
+
+void uni_bt_le_conn_params_on_connection_update_complete(const uint8_t* packet) {
+    hci_con_handle_t handle;
+    uni_hid_device_t* d;
+    uint8_t status;
+
+    handle = hci_subevent_le_connection_update_complete_get_connection_handle(packet);
+    d = uni_hid_device_get_instance_for_connection_handle(handle);
+    if (!d)
+        return;
+
+    status = hci_subevent_le_connection_update_complete_get_status(packet);
+    d->conn.le_requested_interval_max = 0;
+    if (status != ERROR_CODE_SUCCESS) {
+        stats_rejected++;
+        d->conn.le_update_failures++;
+        logi("%s: connection parameters rejected, status=%#x\n", bd_addr_to_str(d->conn.btaddr), status);
+        // Try again with a wider range.
+        request_params(d, get_active_links());
+        return;
+    }
+
+    d->conn.le_interval = hci_subevent_le_connection_update_complete_get_conn_interval(packet);
+    d->conn.le_latency = hci_subevent_le_connection_update_complete_get_conn_latency(packet);
+    d->conn.le_supervision_timeout = hci_subevent_le_connection_update_complete_get_supervision_timeout(packet);
+    logi("%s: connection parameters updated: interval=%d, latency=%d, supervision timeout=%d\n",
+         bd_addr_to_str(d->conn.btaddr), d->conn.le_interval, d->conn.le_latency, d->conn.le_supervision_timeout);
+}
+
+void uni_bt_le_conn_params_dump_device(const uni_hid_device_t* d) {
+    // Interval in 1.25ms units.
+    logi("\tble: profile=%s, interval=%d.%02d ms, latency=%d, supervision timeout=%d ms, rejected=%d\n",
+         profile_names[uni_bt_le_conn_params_get_profile(d)], d->conn.le_interval * 125 / 100,
+         d->conn.le_interval * 125 % 100, d->conn.le_latency, d->conn.le_supervision_timeout * 10,
+         d->conn.le_update_failures);
+}
+
+void uni_bt_le_conn_params_dump(void) {
+    logi("LE connection parameters: links=%d, requested=%u, rejected=%u, rebalances=%u\n", get_active_links(),
+         (unsigned int)stats_requested, (unsigned int)stats_rejected, (unsigned int)stats_rebalances);
+}
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_profiler.h"
+
+#include <string.h>
+
+#include "uni_common.h"
+#include "uni_log.h"
+#include "uni_system.h"
+
+// Distinct handler / event pairs that are tracked. Must be a power of 2.
+#define PROFILER_MAX_ENTRIES 64
+// Invocations that take longer than this are considered stalls.
+#define PROFILER_STALL_US 10000
+// Number of worst stalls that are kept.
+#define PROFILER_WORST_STALLS 4
+// Packet event of HCI meta events: event in bits 8-15, sub-event in bits 0-7.
+#define PACKET_EVENT_META (1u << 24)
+
+_Static_assert((PROFILER_MAX_ENTRIES & (PROFILER_MAX_ENTRIES - 1)) == 0, "PROFILER_MAX_ENTRIES must be a power of 2");
+
+typedef struct {
+    // NULL means free. Points to a string literal.
+    const char* name;
+    uint8_t kind;  // uni_bt_profiler_kind_t
+    uint32_t event;
+    uint32_t count;
+    uint32_t stalls;
+    uint32_t max_us;
+    uint64_t total_us;
+} profiler_entry_t;
+
+typedef struct {
+    const char* name;
+    uint8_t kind;
+    uint32_t event;
+    uint32_t duration_us;
+    uint32_t when_ms;
+} profiler_stall_t;
+
+static profiler_entry_t entries[PROFILER_MAX_ENTRIES];
+static profiler_stall_t worst_stalls[PROFILER_WORST_STALLS];
+static uint64_t busy_us;
+static uint32_t reset_ms;
+static uint32_t dropped;
+
+static profiler_entry_t* get_entry(const char* name, uni_bt_profiler_kind_t kind, uint32_t event) {
+    // Names are string literals: the pointer is enough to identify them.
+    uint32_t hash = ((uint32_t)(uintptr_t)name >> 2) * 2654435761u ^ (event * 40503u) ^ kind;
+    profiler_entry_t* e;
+
+    for (int i = 0; i < PROFILER_MAX_ENTRIES; i++) {
+        e = &entries[(hash + i) & (PROFILER_MAX_ENTRIES - 1)];
+        if (e->name == NULL) {
+            e->name = name;
+            e->kind = kind;
+            e->event = event;
+            return e;
+        }
+        if (e->name == name && e->kind == kind && e->event == event)
+            return e;
+    }
+    return NULL;
+}
+
+static void record_stall(const char* name, uni_bt_profiler_kind_t kind, uint32_t event, uint32_t duration_us) {
+    profiler_stall_t* victim = &worst_stalls[0];
+
+    // Replace the smallest one, if the new one is bigger.
+    for (int i = 1; i < PROFILER_WORST_STALLS; i++) {
+        if (worst_stalls[i].duration_us < victim->duration_us)
+            victim = &worst_stalls[i];
+    }
+    if (duration_us <= victim->duration_us)
+        return;
+
+    victim->name = name;
+    victim->kind = kind;
+    victim->event = event;
+    victim->duration_us = duration_us;
+    victim->when_ms = btstack_run_loop_get_time_ms();
+}
+
+uint32_t uni_bt_profiler_begin(void) {
+    return uni_system_get_time_us();
+}
+
+void uni_bt_profiler_end(const char* name, uni_bt_profiler_kind_t kind, uint32_t event, uint32_t start_us) {
+    uint32_t duration_us = uni_system_get_time_us() - start_us;
+    profiler_entry_t* e;
+
+    busy_us += duration_us;
+
+    e = get_entry(name, kind, event);
+    if (e == NULL) {
+        dropped++;
+    } else {
+        e->count++;
+        e->total_us += duration_us;
+        if (duration_us > e->max_us)
+            e->max_us = duration_us;
+        if (duration_us >= PROFILER_STALL_US)
+            e->stalls++;
+    }
+
+    if (duration_us >= PROFILER_STALL_US)
+        record_stall(name, kind, event, duration_us);
+}
+
+uint32_t uni_bt_profiler_get_packet_event(uint8_t packet_type, const uint8_t* packet, uint16_t size) {
+    uint8_t event;
+
+    if (packet_type != HCI_EVENT_PACKET || size < 1)
+        return packet_type << 16;
+
+    event = hci_event_packet_get_type(packet);
+    switch (event) {
+        case HCI_EVENT_LE_META:
+        case HCI_EVENT_GATTSERVICE_META:
+        case HCI_EVENT_HID_META:
+            // Sub-event is what matters. E.g: advertising reports vs. connection complete.
+            if (size >= 3)
+                return PACKET_EVENT_META | (packet_type << 16) | (event << 8) | packet[2];
+            break;
+        default:
+            break;
+    }
+    return (packet_type << 16) | event;
+}
+
+void uni_bt_profiler_reset(void) {
+    memset(entries, 0, sizeof(entries));
+    memset(worst_stalls, 0, sizeof(worst_stalls));
+    busy_us = 0;
+    dropped = 0;
+    reset_ms = btstack_run_loop_get_time_ms();
+}
+
+#ifdef CONFIG_BLUEPAD32_RUN_LOOP_PROFILER
+static void format_event(char* buf, size_t len, uni_bt_profiler_kind_t kind, uint32_t event) {
+    if (kind == UNI_BT_PROFILER_KIND_PACKET) {
+        // See uni_bt_profiler_get_packet_event()
+        if (((event >> 16) & 0xff) == HCI_EVENT_PACKET) {
+            if (event & PACKET_EVENT_META)
+                snprintf(buf, len, "evt 0x%02x/0x%02x", (unsigned int)(event >> 8) & 0xff,
+                         (unsigned int)event & 0xff);
+            else
+                snprintf(buf, len, "evt 0x%02x", (unsigned int)event & 0xff);
+        } else {
+            snprintf(buf, len, "pkt 0x%02x", (unsigned int)(event >> 16) & 0xff);
+        }
+    } else if (kind == UNI_BT_PROFILER_KIND_CALLBACK) {
+        snprintf(buf, len, "callback");
+    } else {
+        snprintf(buf, len, "timer");
+    }
+}
+
+void uni_bt_profiler_dump(void) {
+    uint8_t order[PROFILER_MAX_ENTRIES];
+    int total = 0;
+    uint32_t elapsed_ms;
+    char event[24];
+
+    // Sort by total time, most expensive first. Insertion sort is good enough for a console command.
+    for (int i = 0; i < PROFILER_MAX_ENTRIES; i++) {
+        if (entries[i].name == NULL)
+            continue;
+        int j = total++;
+        while (j > 0 && entries[order[j - 1]].total_us < entries[i].total_us) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    elapsed_ms = btstack_run_loop_get_time_ms() - reset_ms;
+    logi("Run-loop profile of the last %u ms: busy %u ms (%u%%), %d handlers, %u not tracked\n",
+         (unsigned int)elapsed_ms, (unsigned int)(busy_us / 1000),
+         elapsed_ms ? (unsigned int)(busy_us / 10 / elapsed_ms) : 0, total, (unsigned int)dropped);
+    logi("\t%-38s %-14s %8s %10s %8s %8s %6s\n", "handler", "event", "count", "total ms", "avg us", "max us",
+         "stalls");
+    for (int i = 0; i < total; i++) {
+        const profiler_entry_t* e = &entries[order[i]];
+        format_event(event, sizeof(event), e->kind, e->event);
+        logi("\t%-38s %-14s %8u %10u %8u %8u %6u\n", e->name, event, (unsigned int)e->count,
+             (unsigned int)(e->total_us / 1000), (unsigned int)(e->total_us / e->count), (unsigned int)e->max_us,
+             (unsigned int)e->stalls);
+    }
+
+    logi("Worst stalls (>= %d us):\n", PROFILER_STALL_US);
+    for (int i = 0; i < PROFILER_WORST_STALLS; i++) {
+        const profiler_stall_t* s = &worst_stalls[i];
+        if (s->name == NULL)
+            continue;
+        format_event(event, sizeof(event), s->kind, s->event);
+        logi("\t%-38s %-14s %8u us, at %u ms\n", s->name, event, (unsigned int)s->duration_us,
+             (unsigned int)s->when_ms);
+    }
+}
+#else  // !CONFIG_BLUEPAD32_RUN_LOOP_PROFILER
+void uni_bt_profiler_dump(void) {
+    logi("Run-loop profiler not enabled. See CONFIG_BLUEPAD32_RUN_LOOP_PROFILER\n");
+}
+#endif  // !CONFIG_BLUEPAD32_RUN_LOOP_PROFILER
@@ -0,0 +1,366 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_reconnect.h"
+
+#include <string.h>
+
+#include <btstack.h>
+
+#include "sdkconfig.h"
+
+#include "bt/uni_bt_allowlist.h"
+#include "bt/uni_bt_bredr.h"
+#include "bt/uni_bt_defines.h"
+#include "bt/uni_bt_profiler.h"
+#include "bt/uni_bt_scan_policy.h"
+#include "uni_common.h"
+#include "uni_log.h"
+#include "uni_property.h"
+
+// Bonded controllers that are paged in one session.
+#define RECONNECT_MAX_CANDIDATES 8
+// Recently used controllers whose page hints are persisted.
+#define RECONNECT_MAX_HINTS 8
+// Each round pages all the candidates once. Between rounds, the scan runs for a while.
+#define RECONNECT_ROUNDS 3
+#define RECONNECT_ROUND_INTERVAL_MS 10000
+// The scan is held only while paging. Between pages it runs for about one inquiry.
+#define RECONNECT_PAGE_INTERVAL_MS (UNI_BT_INQUIRY_LENGTH * 1280)
+// In case the paged device gets deleted without a page result. E.g: connection timeout.
+#define RECONNECT_PAGE_GUARD_MS 15000
+
+#define RECONNECT_BLOB_VERSION 1
+#define RECONNECT_BLOB_HEADER_LEN 2
+// Address, page scan repetition mode, clock offset
+#define RECONNECT_BLOB_RECORD_LEN (BD_ADDR_LEN + 1 + 2)
+#define RECONNECT_BLOB_MAX_LEN (RECONNECT_BLOB_HEADER_LEN + RECONNECT_MAX_HINTS * RECONNECT_BLOB_RECORD_LEN)
+
+typedef struct {
+    bd_addr_t addr;
+    uint8_t page_scan_repetition_mode;
+    // UNI_BT_CLOCK_OFFSET_VALID is set if known.
+    uint16_t clock_offset;
+} reconnect_hint_t;
+
+typedef struct {
+    bd_addr_t addr;
+    bool done;
+} reconnect_candidate_t;
+
+// Most recently used first.
+static reconnect_hint_t hints[RECONNECT_MAX_HINTS];
+static int hints_total;
+
+static reconnect_candidate_t candidates[RECONNECT_MAX_CANDIDATES];
+static int candidates_total;
+static bool is_active;
+static int round;
+// Device being paged. Only one at a time.
+static uni_hid_device_t* paging_device;
+static btstack_timer_source_t next_timer;
+
+static uint32_t stats_pages;
+static uint32_t stats_reconnected;
+
+static void next_timer_callback(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(next_timer_callback)
+
+static int get_hint_idx(const bd_addr_t addr) {
+    for (int i = 0; i < hints_total; i++) {
+        if (bd_addr_cmp(hints[i].addr, addr) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void store_hints(void) {
+    uint8_t blob[RECONNECT_BLOB_MAX_LEN];
+    uni_property_value_t val;
+    int offset;
+
+    blob[0] = RECONNECT_BLOB_VERSION;
+    blob[1] = hints_total;
+    offset = RECONNECT_BLOB_HEADER_LEN;
+    for (int i = 0; i < hints_total; i++) {
+        memcpy(&blob[offset], hints[i].addr, BD_ADDR_LEN);
+        blob[offset + BD_ADDR_LEN] = hints[i].page_scan_repetition_mode;
+        little_endian_store_16(blob, offset + BD_ADDR_LEN + 1, hints[i].clock_offset);
+        offset += RECONNECT_BLOB_RECORD_LEN;
+    }
+
+    val.blob.data = blob;
+    val.blob.size = offset;
+    uni_property_set(UNI_PROPERTY_IDX_BT_RECONNECT_HINTS, val);
+}
+
+static void load_hints(void) {
+    uint8_t blob[RECONNECT_BLOB_MAX_LEN];
+    int len;
+    int offset;
+
+    hints_total = 0;
+    len = uni_property_get_blob(UNI_PROPERTY_IDX_BT_RECONNECT_HINTS, blob, sizeof(blob));
+    if (len == 0)
+        return;
+    if (len < RECONNECT_BLOB_HEADER_LEN || blob[0] != RECONNECT_BLOB_VERSION ||
+        len != RECONNECT_BLOB_HEADER_LEN + blob[1] * RECONNECT_BLOB_RECORD_LEN) {
+        loge("Reconnect: invalid stored hints, len=%d\n", len);
+        return;
+    }
+
+    offset = RECONNECT_BLOB_HEADER_LEN;
+    for (int i = 0; i < blob[1] && i < RECONNECT_MAX_HINTS; i++) {
+        memcpy(hints[i].addr, &blob[offset], BD_ADDR_LEN);
+        hints[i].page_scan_repetition_mode = blob[offset + BD_ADDR_LEN];
+        hints[i].clock_offset = little_endian_read_16(blob, offset + BD_ADDR_LEN + 1);
+        offset += RECONNECT_BLOB_RECORD_LEN;
+        hints_total++;
+    }
+}
+
+// Bonded addresses, sorted by most recently used. The ones without hints go last.
+static void load_candidates(void) {
+    btstack_link_key_iterator_t it;
+    link_key_t link_key;
+    link_key_type_t type;
+    bd_addr_t addr;
+    int rank;
+    int j;
+
+    candidates_total = 0;
+    if (!gap_link_key_iterator_init(&it)) {
+        loge("Reconnect: link key iterator not implemented\n");
+        return;
+    }
+    while (candidates_total < RECONNECT_MAX_CANDIDATES && gap_link_key_iterator_get_next(&it, addr, link_key, &type)) {
+        if (!uni_bt_allowlist_is_allowed_addr(addr))
+            continue;
+
+        // Insertion sort by hint rank.
+        rank = get_hint_idx(addr);
+        rank = rank < 0 ? RECONNECT_MAX_HINTS : rank;
+        j = candidates_total++;
+        while (j > 0) {
+            int prev_rank = get_hint_idx(candidates[j - 1].addr);
+            if ((prev_rank < 0 ? RECONNECT_MAX_HINTS : prev_rank) <= rank)
+                break;
+            candidates[j] = candidates[j - 1];
+            j--;
+        }
+        bd_addr_copy(candidates[j].addr, addr);
+        candidates[j].done = false;
+    }
+    gap_link_key_iterator_done(&it);
+}
+
+static bool are_all_seats_taken(void) {
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        uni_hid_device_t* d = uni_hid_device_get_instance_for_idx(i);
+        if (d && uni_bt_conn_get_state(&d->conn) == UNI_BT_CONN_STATE_DEVICE_NONE)
+            return false;
+    }
+    return true;
+}
+
+static void schedule_next(uint32_t delay_ms) {
+    btstack_run_loop_remove_timer(&next_timer);
+    btstack_run_loop_set_timer_handler(&next_timer, UNI_BT_PROFILER_TIMER(next_timer_callback));
+    btstack_run_loop_set_timer(&next_timer, delay_ms);
+    btstack_run_loop_add_timer(&next_timer);
+}
+
+// Lets the scan run before paging the next candidate, so that new controllers can be discovered
+// while reconnecting several of them.
+static void page_finished(void) {
+    paging_device = NULL;
+    uni_bt_scan_policy_set_hold(false);
+    schedule_next(RECONNECT_PAGE_INTERVAL_MS);
+}
+
+static void finish(const char* reason) {
+    logi("Reconnect: finished (%s). Paged=%u, reconnected=%u\n", reason, (unsigned int)stats_pages,
+         (unsigned int)stats_reconnected);
+    is_active = false;
+    paging_device = NULL;
+    btstack_run_loop_remove_timer(&next_timer);
+    uni_bt_scan_policy_set_hold(false);
+}
+
+static void page_device(const bd_addr_t addr) {
+    uni_hid_device_t* d;
+    int idx;
+
+    d = uni_hid_device_create((uint8_t*)addr);
+    if (d == NULL) {
+        finish("no free slots");
+        return;
+    }
+
+    uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_DEVICE_DISCOVERED);
+    d->conn.reconnecting = true;
+    idx = get_hint_idx(addr);
+    if (idx >= 0) {
+        d->conn.page_scan_repetition_mode = hints[idx].page_scan_repetition_mode;
+        d->conn.clock_offset = hints[idx].clock_offset;
+    }
+
+    logi("Reconnect: paging %s (round %d)\n", bd_addr_to_str(addr), round + 1);
+    // Inquiry and page don't get along: hold the scan until the page finishes.
+    uni_bt_scan_policy_set_hold(true);
+    paging_device = d;
+    stats_pages++;
+    schedule_next(RECONNECT_PAGE_GUARD_MS);
+    // Same path as a discovered device: the name request is the page.
+    // Then SDP and L2CAP, which use the stored link key.
+    uni_bt_bredr_process_fsm(d);
+    /* 'd' might be invalid */
+}
+
+static void page_next(void) {
+    if (!is_active)
+        return;
+
+    if (paging_device != NULL) {
+        // Guard timer fired: no page result for the device.
+        logi("Reconnect: no page result for %s, skipping it\n", bd_addr_to_str(paging_device->conn.btaddr));
+        paging_device->conn.reconnecting = false;
+        page_finished();
+        return;
+    }
+
+    if (are_all_seats_taken()) {
+        finish("all seats taken");
+        return;
+    }
+
+    for (int i = 0; i < candidates_total; i++) {
+        if (candidates[i].done)
+            continue;
+        candidates[i].done = true;
+
+        // Already connected, or connecting by itself.
+        if (uni_hid_device_get_instance_for_address(candidates[i].addr) != NULL)
+            continue;
+
+        page_device(candidates[i].addr);
+        return;
+    }
+
+    // Round finished.
+    round++;
+    if (round >= RECONNECT_ROUNDS) {
+        finish("no more rounds");
+        return;
+    }
+    for (int i = 0; i < candidates_total; i++)
+        candidates[i].done = false;
+
+    schedule_next(RECONNECT_ROUND_INTERVAL_MS);
+}
+
+static void next_timer_callback(btstack_timer_source_t* ts) {
+    ARG_UNUSED(ts);
+    page_next();
+}
+
+void uni_bt_reconnect_init(void) {
+    load_hints();
+}
+
+void uni_bt_reconnect_start(void) {
+    if (is_active) {
+        logi("Reconnect: already active\n");
+        return;
+    }
+
+    load_candidates();
+    if (candidates_total == 0) {
+        logi("Reconnect: no bonded controllers\n");
+        return;
+    }
+
+    logi("Reconnect: started, %d bonded controllers\n", candidates_total);
+    is_active = true;
+    round = 0;
+    paging_device = NULL;
+    stats_pages = 0;
+    stats_reconnected = 0;
+    schedule_next(0);
+}
+
+void uni_bt_reconnect_stop(void) {
+    if (!is_active)
+        return;
+    // The device being paged, if any, continues its setup.
+    if (paging_device)
+        paging_device->conn.reconnecting = false;
+    finish("stopped");
+}
+
+bool uni_bt_reconnect_on_page_failed(uni_hid_device_t* d) {
+    if (!d->conn.reconnecting || uni_hid_device_is_incoming(d))
+        return false;
+
+    logi("Reconnect: %s not responding\n", bd_addr_to_str(d->conn.btaddr));
+    uni_hid_device_delete(d);
+    /* 'd' is destroyed after this call, don't use it */
+
+    if (paging_device == d)
+        page_finished();
+    return true;
+}
+
+void uni_bt_reconnect_on_page_succeeded(uni_hid_device_t* d) {
+    if (!d->conn.reconnecting)
+        return;
+
+    logi("Reconnect: %s responded\n", bd_addr_to_str(d->conn.btaddr));
+    d->conn.reconnecting = false;
+    stats_reconnected++;
+
+    if (paging_device == d)
+        page_finished();
+}
+
+void uni_bt_reconnect_on_device_ready(uni_hid_device_t* d) {
+    reconnect_hint_t hint;
+    int idx;
+
+    if (gap_get_connection_type(d->conn.handle) != GAP_CONNECTION_ACL)
+        return;
+
+    idx = get_hint_idx(d->conn.btaddr);
+    memset(&hint, 0, sizeof(hint));
+    bd_addr_copy(hint.addr, d->conn.btaddr);
+    if (d->conn.clock_offset & UNI_BT_CLOCK_OFFSET_VALID) {
+        hint.page_scan_repetition_mode = d->conn.page_scan_repetition_mode;
+        hint.clock_offset = d->conn.clock_offset;
+    } else if (idx >= 0) {
+        // Incoming connections don't report it. Keep the previous one.
+        hint = hints[idx];
+    }
+
+    // Already the most recent one, with the same hints: don't write to flash.
+    if (idx == 0 && memcmp(&hints[0], &hint, sizeof(hint)) == 0)
+        return;
+
+    // Move it to the front. If it is new, the least recently used one is dropped.
+    if (idx < 0)
+        idx = btstack_min(hints_total, RECONNECT_MAX_HINTS - 1);
+    memmove(&hints[1], &hints[0], idx * sizeof(hints[0]));
+    hints[0] = hint;
+    hints_total = btstack_min(hints_total + (idx == hints_total ? 1 : 0), RECONNECT_MAX_HINTS);
+
+    store_hints();
+}
+
+void uni_bt_reconnect_dump(void) {
+    logi("Reconnect: active=%d, round=%d/%d, paged=%u, reconnected=%u\n", is_active, round + 1, RECONNECT_ROUNDS,
+         (unsigned int)stats_pages, (unsigned int)stats_reconnected);
+    for (int i = 0; i < hints_total; i++) {
+        logi("  %s: page scan mode=%d, clock offset=%#06x\n", bd_addr_to_str(hints[i].addr),
+             hints[i].page_scan_repetition_mode, hints[i].clock_offset);
+    }
+}
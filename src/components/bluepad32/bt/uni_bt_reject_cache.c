@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_reject_cache.h"
+
+#include <string.h>
+
+#include "uni_common.h"
+#include "uni_log.h"
+
+// 8 sets x 4 ways: 32 addresses.
+#define REJECT_CACHE_SETS 8
+#define REJECT_CACHE_WAYS 4
+// Short enough so that devices that change their advertisement (e.g: entering pairing mode)
+// or their "too far away" RSSI are not ignored for long.
+#define REJECT_CACHE_EXPIRE_MS 5000
+
+_Static_assert((REJECT_CACHE_SETS & (REJECT_CACHE_SETS - 1)) == 0, "REJECT_CACHE_SETS must be a power of 2");
+
+typedef struct {
+    bd_addr_t addr;
+    bool valid;
+    uint32_t added_ms;
+    uint32_t used_ms;
+} reject_entry_t;
+
+static reject_entry_t entries[REJECT_CACHE_SETS][REJECT_CACHE_WAYS];
+// Incremented from any thread. Compared from BTstack thread.
+static volatile uint32_t generation;
+static uint32_t cache_generation;
+static uint32_t hits;
+static uint32_t adds;
+
+static void check_generation(void) {
+    uint32_t gen = generation;
+
+    if (gen == cache_generation)
+        return;
+    cache_generation = gen;
+    memset(entries, 0, sizeof(entries));
+}
+
+static reject_entry_t* get_set(const bd_addr_t addr) {
+    uint8_t hash = 0;
+
+    // Random addresses differ in all bytes, public ones mostly in the lower ones.
+    for (int i = 0; i < BD_ADDR_LEN; i++)
+        hash ^= addr[i];
+    hash ^= hash >> 4;
+    return entries[hash & (REJECT_CACHE_SETS - 1)];
+}
+
+static bool is_expired(const reject_entry_t* e, uint32_t now) {
+    return now - e->added_ms >= REJECT_CACHE_EXPIRE_MS;
+}
+
+bool uni_bt_reject_cache_contains(const bd_addr_t addr) {
+    reject_entry_t* set;
+    uint32_t now;
+
+    check_generation();
+    set = get_set(addr);
+    for (int i = 0; i < REJECT_CACHE_WAYS; i++) {
+        reject_entry_t* e = &set[i];
+        if (!e->valid || bd_addr_cmp(e->addr, addr) != 0)
+            continue;
+
+        now = btstack_run_loop_get_time_ms();
+        if (is_expired(e, now)) {
+            e->valid = false;
+            return false;
+        }
+        e->used_ms = now;
+        hits++;
+        return true;
+    }
+    return false;
+}
+
+void uni_bt_reject_cache_add(const bd_addr_t addr) {
+    reject_entry_t* set;
+    reject_entry_t* victim = NULL;
+    bool victim_free = false;
+    uint32_t now;
+
+    check_generation();
+    set = get_set(addr);
+    now = btstack_run_loop_get_time_ms();
+
+    for (int i = 0; i < REJECT_CACHE_WAYS; i++) {
+        reject_entry_t* e = &set[i];
+        if (e->valid && bd_addr_cmp(e->addr, addr) == 0) {
+            victim = e;
+            break;
+        }
+        // Prefer free or expired entries. Otherwise, the least recently used one.
+        if (!e->valid || is_expired(e, now)) {
+            if (!victim_free) {
+                victim = e;
+                victim_free = true;
+            }
+            continue;
+        }
+        if (!victim_free && (victim == NULL || (int32_t)(e->used_ms - victim->used_ms) < 0))
+            victim = e;
+    }
+
+    bd_addr_copy(victim->addr, addr);
+    victim->valid = true;
+    victim->added_ms = now;
+    victim->used_ms = now;
+    adds++;
+}
+
+void uni_bt_reject_cache_invalidate(void) {
+    generation++;
+}
+
+void uni_bt_reject_cache_dump(void) {
+    int used = 0;
+    uint32_t now = btstack_run_loop_get_time_ms();
+
+    check_generation();
+    for (int i = 0; i < REJECT_CACHE_SETS; i++) {
+        for (int j = 0; j < REJECT_CACHE_WAYS; j++) {
+            if (entries[i][j].valid && !is_expired(&entries[i][j], now))
+                used++;
+        }
+    }
+    logi("Reject cache: %d/%d entries, hits=%u, adds=%u\n", used, REJECT_CACHE_SETS * REJECT_CACHE_WAYS,
+         (unsigned int)hits, (unsigned int)adds);
+}
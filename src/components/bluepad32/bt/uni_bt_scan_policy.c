@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_scan_policy.h"
+
+#include <btstack.h>
+
+#include "sdkconfig.h"
+
+#include "bt/uni_bt.h"
+#include "bt/uni_bt_bredr.h"
+#include "bt/uni_bt_cmd_queue.h"
+#include "bt/uni_bt_le.h"
+#include "bt/uni_bt_profiler.h"
+#include "platform/uni_platform.h"
+#include "uni_common.h"
+#include "uni_config.h"
+#include "uni_hid_device.h"
+#include "uni_log.h"
+#include "uni_property.h"
+
+// How often the level is re-evaluated. E.g: a seat might get free.
+#define SCAN_POLICY_TICK_MS 1000
+
+// Low duty cycle values.
+// BR/EDR periodic inquiry, in 1.28s units: one 2.56s inquiry every ~15-20s.
+#define SCAN_LOW_BREDR_MAX_PERIODIC_LENGTH 16
+#define SCAN_LOW_BREDR_MIN_PERIODIC_LENGTH 12
+#define SCAN_LOW_BREDR_INQUIRY_LENGTH 2
+// BLE, in 0.625ms units: 30ms window every 1.28s.
+#define SCAN_LOW_BLE_INTERVAL 0x0800
+#define SCAN_LOW_BLE_WINDOW 0x0030
+// Default BLE values. Same as uni_bt_le_setup().
+#define SCAN_HIGH_BLE_INTERVAL 48
+#define SCAN_HIGH_BLE_WINDOW 48
+
+enum {
+    CMD_SET_POLICY,
+    CMD_SET_IDLE_TIMEOUT,
+};
+
+static bool is_started;
+static bool is_held;
+// Cached properties, to avoid reading them on every tick.
+static uni_bt_scan_policy_t policy = UNI_BT_SCAN_POLICY_ADAPTIVE;
+static int idle_timeout_s;
+static uni_bt_scan_level_t current_level = UNI_BT_SCAN_LEVEL_OFF;
+static uint32_t last_activity_ms;
+static btstack_timer_source_t tick_timer;
+
+static void tick(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(tick)
+
+static bool are_all_seats_taken(void) {
+    struct uni_platform* platform = uni_get_platform();
+
+    if (platform->get_free_seats)
+        return platform->get_free_seats() <= 0;
+
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        uni_hid_device_t* d = uni_hid_device_get_instance_for_idx(i);
+        if (d && uni_bt_conn_get_state(&d->conn) == UNI_BT_CONN_STATE_DEVICE_NONE)
+            return false;
+    }
+    return true;
+}
+
+static uni_bt_scan_level_t desired_level(void) {
+    if (!is_started || is_held)
+        return UNI_BT_SCAN_LEVEL_OFF;
+    if (policy == UNI_BT_SCAN_POLICY_ALWAYS_ON)
+        return UNI_BT_SCAN_LEVEL_HIGH;
+    if (are_all_seats_taken())
+        return UNI_BT_SCAN_LEVEL_OFF;
+    if (btstack_run_loop_get_time_ms() - last_activity_ms >= (uint32_t)idle_timeout_s * 1000)
+        return UNI_BT_SCAN_LEVEL_LOW;
+    return UNI_BT_SCAN_LEVEL_HIGH;
+}
+
+static void apply_level(uni_bt_scan_level_t level) {
+    if (level == current_level)
+        return;
+
+    logi("Scan policy: level %d -> %d\n", current_level, level);
+
+    // Scan parameters can't be changed while scanning.
+    if (current_level != UNI_BT_SCAN_LEVEL_OFF) {
+        if (IS_ENABLED(UNI_ENABLE_BREDR))
+            uni_bt_bredr_scan_stop();
+        if (IS_ENABLED(UNI_ENABLE_BLE))
+            uni_bt_le_scan_stop();
+    }
+    current_level = level;
+
+    switch (level) {
+        case UNI_BT_SCAN_LEVEL_HIGH:
+            if (IS_ENABLED(UNI_ENABLE_BREDR))
+                uni_bt_bredr_scan_start_with_params(uni_bt_get_gap_max_periodic_length(),
+                                                    uni_bt_get_gap_min_periodic_length(),
+                                                    uni_bt_get_gap_inquiry_length());
+            if (IS_ENABLED(UNI_ENABLE_BLE))
+                uni_bt_le_scan_start_with_params(SCAN_HIGH_BLE_INTERVAL, SCAN_HIGH_BLE_WINDOW);
+            break;
+        case UNI_BT_SCAN_LEVEL_LOW:
+            if (IS_ENABLED(UNI_ENABLE_BREDR))
+                uni_bt_bredr_scan_start_with_params(SCAN_LOW_BREDR_MAX_PERIODIC_LENGTH,
+                                                    SCAN_LOW_BREDR_MIN_PERIODIC_LENGTH, SCAN_LOW_BREDR_INQUIRY_LENGTH);
+            if (IS_ENABLED(UNI_ENABLE_BLE))
+                uni_bt_le_scan_start_with_params(SCAN_LOW_BLE_INTERVAL, SCAN_LOW_BLE_WINDOW);
+            break;
+        case UNI_BT_SCAN_LEVEL_OFF:
+        default:
+            break;
+    }
+}
+
+static void tick(btstack_timer_source_t* ts) {
+    apply_level(desired_level());
+
+    if (!is_started)
+        return;
+    btstack_run_loop_set_timer(ts, SCAN_POLICY_TICK_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+void uni_bt_scan_policy_start(void) {
+    if (is_started)
+        return;
+    is_started = true;
+    last_activity_ms = btstack_run_loop_get_time_ms();
+    policy = uni_bt_scan_policy_get_policy();
+    idle_timeout_s = uni_bt_scan_policy_get_idle_timeout();
+
+    btstack_run_loop_set_timer_handler(&tick_timer, UNI_BT_PROFILER_TIMER(tick));
+    tick(&tick_timer);
+}
+
+void uni_bt_scan_policy_stop(void) {
+    if (!is_started)
+        return;
+    is_started = false;
+    btstack_run_loop_remove_timer(&tick_timer);
+    apply_level(UNI_BT_SCAN_LEVEL_OFF);
+}
+
+void uni_bt_scan_policy_on_activity(void) {
+    last_activity_ms = btstack_run_loop_get_time_ms();
+    if (is_started)
+        apply_level(desired_level());
+}
+
+void uni_bt_scan_policy_set_hold(bool hold) {
+    if (hold == is_held)
+        return;
+    is_held = hold;
+    apply_level(desired_level());
+}
+
+uni_bt_scan_level_t uni_bt_scan_policy_get_level(void) {
+    return current_level;
+}
+
+static void cmd_handler(const uni_bt_cmd_t* cmd) {
+    switch (cmd->cmd) {
+        case CMD_SET_POLICY:
+            policy = cmd->args.value;
+            break;
+        case CMD_SET_IDLE_TIMEOUT:
+            idle_timeout_s = cmd->args.value;
+            break;
+        default:
+            loge("Scan policy: unknown command: %#x\n", cmd->cmd);
+            return;
+    }
+    if (is_started)
+        apply_level(desired_level());
+}
+
+static void push_cmd(uint16_t cmd, int32_t value) {
+    uni_bt_cmd_t c = {
+        .handler = &cmd_handler,
+        .cmd = cmd,
+        .args.value = value,
+    };
+    if (!uni_bt_cmd_queue_push(&c))
+        loge("Scan policy: command %d dropped: queue full\n", cmd);
+}
+
+void uni_bt_scan_policy_set_policy(uni_bt_scan_policy_t new_policy) {
+    uni_property_value_t val;
+
+    if (new_policy >= UNI_BT_SCAN_POLICY_COUNT) {
+        loge("Scan policy: invalid policy %d\n", new_policy);
+        return;
+    }
+    val.u8 = new_policy;
+    uni_property_set(UNI_PROPERTY_IDX_SCAN_POLICY, val);
+    push_cmd(CMD_SET_POLICY, new_policy);
+}
+
+uni_bt_scan_policy_t uni_bt_scan_policy_get_policy(void) {
+    uni_property_value_t val;
+
+    val = uni_property_get(UNI_PROPERTY_IDX_SCAN_POLICY);
+    return val.u8;
+}
+
+void uni_bt_scan_policy_set_idle_timeout(int seconds) {
+    uni_property_value_t val;
+
+    // Stored as u8.
+    if (seconds < 0 || seconds > UINT8_MAX) {
+        loge("Scan policy: invalid idle timeout %d, must be between 0 and %d seconds\n", seconds, UINT8_MAX);
+        return;
+    }
+    val.u8 = seconds;
+    uni_property_set(UNI_PROPERTY_IDX_SCAN_IDLE_TIMEOUT, val);
+    push_cmd(CMD_SET_IDLE_TIMEOUT, val.u8);
+}
+
+int uni_bt_scan_policy_get_idle_timeout(void) {
+    uni_property_value_t val;
+
+    val = uni_property_get(UNI_PROPERTY_IDX_SCAN_IDLE_TIMEOUT);
+    return val.u8;
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "bt/uni_bt_sched.h"
+
+#include <string.h>
+
+#include <btstack.h>
+
+#include "sdkconfig.h"
+
+#include "bt/uni_bt_profiler.h"
+#include "uni_common.h"
+#include "uni_log.h"
+
+// Every SCHED_AGING_MS that a step waits, it gets the same priority as a device one state closer to "ready".
+// Prevents that a device that just started the setup waits forever when others keep arriving.
+#define SCHED_AGING_MS 2000
+
+#define SCHED_RESOURCE_COUNT 2
+_Static_assert(UNI_BT_SCHED_RESOURCE_PAGE == (1 << (SCHED_RESOURCE_COUNT - 1)), "Update SCHED_RESOURCE_COUNT");
+
+typedef struct {
+    uni_hid_device_t* device;
+    uni_bt_sched_step_t step;
+    uint8_t resources;
+    uint32_t enqueued_ms;
+} sched_entry_t;
+
+static sched_entry_t entries[CONFIG_BLUEPAD32_MAX_DEVICES];
+static uni_hid_device_t* holders[SCHED_RESOURCE_COUNT];
+static btstack_timer_source_t dispatch_timer;
+static bool dispatch_pending;
+
+static void dispatch(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(dispatch)
+
+// Resources already held by the device are considered free.
+static bool are_resources_free(const uni_hid_device_t* d, uint8_t resources) {
+    for (int i = 0; i < SCHED_RESOURCE_COUNT; i++) {
+        if ((resources & (1 << i)) && holders[i] != NULL && holders[i] != d)
+            return false;
+    }
+    return true;
+}
+
+static void acquire_resources(uni_hid_device_t* d, uint8_t resources) {
+    for (int i = 0; i < SCHED_RESOURCE_COUNT; i++) {
+        if (resources & (1 << i))
+            holders[i] = d;
+    }
+}
+
+static uint32_t entry_priority(const sched_entry_t* e, uint32_t now) {
+    return uni_bt_conn_get_state(&e->device->conn) + (now - e->enqueued_ms) / SCHED_AGING_MS;
+}
+
+// Steps are dispatched from a timer, and not from the callback that released the resource,
+// since it could be called from a BTstack handler that is not reentrant, like the SDP client one.
+static void schedule_dispatch(void) {
+    if (dispatch_pending)
+        return;
+    dispatch_pending = true;
+    btstack_run_loop_set_timer_handler(&dispatch_timer, UNI_BT_PROFILER_TIMER(dispatch));
+    btstack_run_loop_set_timer(&dispatch_timer, 0);
+    btstack_run_loop_add_timer(&dispatch_timer);
+}
+
+static void dispatch(btstack_timer_source_t* ts) {
+    ARG_UNUSED(ts);
+
+    sched_entry_t* best;
+    sched_entry_t* e;
+    uni_hid_device_t* d;
+    uni_bt_sched_step_t step;
+    uint32_t now;
+    uint32_t prio;
+    uint32_t best_prio;
+
+    dispatch_pending = false;
+
+    // Run as many steps as possible. Each step might free or take resources.
+    while (true) {
+        now = btstack_run_loop_get_time_ms();
+        best = NULL;
+        best_prio = 0;
+        for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+            e = &entries[i];
+            if (e->device == NULL || !are_resources_free(e->device, e->resources))
+                continue;
+            prio = entry_priority(e, now);
+            // On equal priority, the oldest one wins.
+            if (best == NULL || prio > best_prio ||
+                (prio == best_prio && (int32_t)(e->enqueued_ms - best->enqueued_ms) < 0)) {
+                best = e;
+                best_prio = prio;
+            }
+        }
+        if (best == NULL)
+            return;
+
+        d = best->device;
+        step = best->step;
+        logi("Sched: running step for %s, waited %d ms\n", bd_addr_to_str(d->conn.btaddr),
+             (int)(now - best->enqueued_ms));
+        acquire_resources(d, best->resources);
+        memset(best, 0, sizeof(*best));
+
+        // The time waiting in the queue doesn't count towards the connection timeout.
+        uni_hid_device_resume_connection_timeout(d);
+        step(d);
+        /* 'd' might be destroyed after this call, don't use it */
+    }
+}
+
+static bool is_queue_empty(void) {
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (entries[i].device != NULL)
+            return false;
+    }
+    return true;
+}
+
+void uni_bt_sched_request(uni_hid_device_t* d, uint8_t resources, uni_bt_sched_step_t step) {
+    sched_entry_t* e = NULL;
+    bool resources_free = are_resources_free(d, resources);
+
+    // Shortcut, only when nobody else is waiting. Otherwise a released resource would go to whoever asks first,
+    // and not to the one with the highest priority: dispatch() decides.
+    if (resources_free && !dispatch_pending && is_queue_empty()) {
+        acquire_resources(d, resources);
+        step(d);
+        return;
+    }
+
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (entries[i].device == d || (e == NULL && entries[i].device == NULL))
+            e = &entries[i];
+        if (entries[i].device == d)
+            break;
+    }
+    if (e == NULL) {
+        // Should not happen, since there is one entry per device.
+        loge("Sched: no free entries for %s\n", bd_addr_to_str(d->conn.btaddr));
+        return;
+    }
+
+    logi("Sched: %s waiting for resources %#x\n", bd_addr_to_str(d->conn.btaddr), resources);
+    e->device = d;
+    e->step = step;
+    e->resources = resources;
+    e->enqueued_ms = btstack_run_loop_get_time_ms();
+    uni_hid_device_pause_connection_timeout(d);
+    // Nobody would release them.
+    if (resources_free)
+        schedule_dispatch();
+}
+
+void uni_bt_sched_release(uni_hid_device_t* d, uint8_t resources) {
+    bool released = false;
+
+    for (int i = 0; i < SCHED_RESOURCE_COUNT; i++) {
+        if ((resources & (1 << i)) && holders[i] == d) {
+            holders[i] = NULL;
+            released = true;
+        }
+    }
+    if (released)
+        schedule_dispatch();
+}
+
+void uni_bt_sched_on_device_deleted(uni_hid_device_t* d) {
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (entries[i].device == d)
+            memset(&entries[i], 0, sizeof(entries[i]));
+    }
+    uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_SDP | UNI_BT_SCHED_RESOURCE_PAGE);
+}
+
+void uni_bt_sched_dump(void) {
+    uint32_t now = btstack_run_loop_get_time_ms();
+
+    // bd_addr_to_str() uses a static buffer, so one call per log.
+    logi("Sched: SDP holder: %s\n", holders[0] ? bd_addr_to_str(holders[0]->conn.btaddr) : "<none>");
+    logi("Sched: Page holder: %s\n", holders[1] ? bd_addr_to_str(holders[1]->conn.btaddr) : "<none>");
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (entries[i].device == NULL)
+            continue;
+        logi("  %s: resources=%#x, state=%d, waiting=%d ms\n", bd_addr_to_str(entries[i].device->conn.btaddr),
+             entries[i].resources, uni_bt_conn_get_state(&entries[i].device->conn),
+             (int)(now - entries[i].enqueued_ms));
+    }
+}
@@ -54,6 +54,9 @@
 
 #include "bt/uni_bt.h"
 #include "bt/uni_bt_bredr.h"
+#include "bt/uni_bt_conn_policy.h"
+#include "bt/uni_bt_profiler.h"
+#include "bt/uni_bt_sched.h"
 #include "uni_common.h"
 #include "uni_config.h"
 #include "uni_log.h"
@@ -64,11 +67,8 @@
 #endif
 
 #define MAX_ATTRIBUTE_VALUE_SIZE 512  // Apparently PS4 has a 470-bytes report
-
-// Some old devices like "ThinkGeek 8-bitty Game Controller" takes a lot of time to respond
-// to SDP queries.
-#define SDP_QUERY_TIMEOUT_MS 13000
-_Static_assert(SDP_QUERY_TIMEOUT_MS < HID_DEVICE_CONNECTION_TIMEOUT_MS, "Timeout too big");
+// How often to check whether the SDP client finished a query that can't be cancelled. E.g: one that timed out.
+#define SDP_BUSY_RETRY_MS 250
 
 static uint8_t sdp_attribute_value[MAX_ATTRIBUTE_VALUE_SIZE];
 static const unsigned int sdp_attribute_value_buffer_size = MAX_ATTRIBUTE_VALUE_SIZE;
@@ -76,6 +76,10 @@ static uni_hid_device_t* sdp_device = NULL;
 static btstack_timer_source_t sdp_query_timer;
 
 static void sdp_query_timeout(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(sdp_query_timeout)
+static void sdp_query_failed(uni_hid_device_t* d);
+static void sdp_query_busy(uni_hid_device_t* d);
+static void start_query_timer(uni_hid_device_t* d);
 
 // SDP Server
 static uint8_t device_id_sdp_service_buffer[100];
@@ -91,8 +95,9 @@ static void uni_handle_sdp_hid_query_result(uint8_t packet_type, uint16_t channe
     uint8_t* des_element;
     uint8_t* element;
 
+    // E.g: the events of an aborted query.
     if (sdp_device == NULL) {
-        loge("ERROR: uni_handle_sdp_hid_query_result. SDP device = NULL\n");
+        logd("uni_handle_sdp_hid_query_result: no SDP device, ignoring event\n");
         return;
     }
 
@@ -133,6 +138,11 @@ static void uni_handle_sdp_hid_query_result(uint8_t packet_type, uint16_t channe
             }
             break;
         case SDP_EVENT_QUERY_COMPLETE:
+            if (sdp_event_query_complete_get_status(packet)) {
+                loge("SDP HID-descriptor query failed: 0x%02x\n", sdp_event_query_complete_get_status(packet));
+                sdp_query_failed(sdp_device);
+                break;
+            }
             uni_bt_sdp_query_end(sdp_device);
             break;
         default:
@@ -140,6 +150,8 @@ static void uni_handle_sdp_hid_query_result(uint8_t packet_type, uint16_t channe
     }
 }
 
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(uni_handle_sdp_hid_query_result)
+
 // Device ID results: Vendor ID, Product ID, Version, etc...
 static void uni_handle_sdp_pid_query_result(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {
     ARG_UNUSED(packet_type);
@@ -148,8 +160,9 @@ static void uni_handle_sdp_pid_query_result(uint8_t packet_type, uint16_t channe
 
     uint16_t id16;
 
+    // E.g: the events of an aborted query.
     if (sdp_device == NULL) {
-        loge("ERROR: uni_handle_sdp_pid_query_result. SDP device = NULL\n");
+        logd("uni_handle_sdp_pid_query_result: no SDP device, ignoring event\n");
         return;
     }
 
@@ -184,9 +197,16 @@ static void uni_handle_sdp_pid_query_result(uint8_t packet_type, uint16_t channe
             }
             break;
         case SDP_EVENT_QUERY_COMPLETE:
+            if (sdp_event_query_complete_get_status(packet)) {
+                loge("SDP VID/PID query failed: 0x%02x\n", sdp_event_query_complete_get_status(packet));
+                sdp_query_failed(sdp_device);
+                break;
+            }
             logi("Vendor ID: 0x%04x - Product ID: 0x%04x\n", uni_hid_device_get_vendor_id(sdp_device),
                  uni_hid_device_get_product_id(sdp_device));
             uni_hid_device_guess_controller_type_from_pid_vid(sdp_device);
+            // The controller family is known now. E.g: the slow ones get a longer deadline.
+            start_query_timer(sdp_device);
             uni_bt_conn_set_state(&sdp_device->conn, UNI_BT_CONN_STATE_SDP_VENDOR_FETCHED);
             uni_bt_bredr_process_fsm(sdp_device);
             break;
@@ -197,6 +217,8 @@ static void uni_handle_sdp_pid_query_result(uint8_t packet_type, uint16_t channe
     }
 }
 
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(uni_handle_sdp_pid_query_result)
+
 static void sdp_query_timeout(btstack_timer_source_t* ts) {
     loge("<------- sdp_query_timeout()\n");
     uni_hid_device_t* d = btstack_run_loop_get_timer_context(ts);
@@ -210,17 +232,50 @@ static void sdp_query_timeout(btstack_timer_source_t* ts) {
         return;
     }
 
-    logi("Failed to query SDP for %s, timeout\n", bd_addr_to_str(d->conn.btaddr));
+    uni_bt_conn_policy_on_stage_timeout(UNI_BT_CONN_STAGE_SDP);
     sdp_device = NULL;
+    uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_SDP | UNI_BT_SCHED_RESOURCE_PAGE);
+
+    // BTstack can't cancel the query, but closing the connection finishes it. The retry polls the SDP client until
+    // the aborted query is gone. See sdp_query_busy()
+    if (uni_bt_bredr_restart_stage(d, UNI_BT_CONN_STAGE_SDP))
+        return;
+
+    logi("Failed to query SDP for %s, timeout. Deleting it\n", bd_addr_to_str(d->conn.btaddr));
+    uni_hid_device_disconnect(d);
+    uni_hid_device_delete(d);
+    /* 'd' is destroyed after this call, don't use it */
 }
 
-// Public functions
+// BTstack finished the query with an error. Retries the whole query (VID/PID + HID descriptor), or deletes the device.
+static void sdp_query_failed(uni_hid_device_t* d) {
+    sdp_device = NULL;
+    btstack_run_loop_remove_timer(&sdp_query_timer);
+    uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_SDP | UNI_BT_SCHED_RESOURCE_PAGE);
 
-void uni_bt_sdp_query_start(uni_hid_device_t* d) {
-    logi("-----------> sdp_query_start()\n");
-    // Needed for the SDP query since it only supports one SDP query at the time.
+    if (uni_bt_bredr_retry_stage(d, UNI_BT_CONN_STAGE_SDP))
+        return;
+
+    loge("Failed to query SDP for %s, deleting it\n", bd_addr_to_str(d->conn.btaddr));
+    uni_hid_device_disconnect(d);
+    uni_hid_device_delete(d);
+    /* 'd' is destroyed after this call, don't use it */
+}
+
+// The SDP client is still busy with an aborted query, or with a query of a deleted device. Not a failure of this
+// device: try again later without counting a retry. The connection timeout still applies.
+static void sdp_query_busy(uni_hid_device_t* d) {
+    sdp_device = NULL;
+    btstack_run_loop_remove_timer(&sdp_query_timer);
+    uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_SDP | UNI_BT_SCHED_RESOURCE_PAGE);
+    uni_bt_bredr_delay_stage(d, UNI_BT_CONN_STAGE_SDP, SDP_BUSY_RETRY_MS);
+}
+
+// Called by the scheduler once the SDP client is available.
+static void sdp_query_start(uni_hid_device_t* d) {
     if (sdp_device != NULL) {
-        logi("Another SDP query is in progress (%s), disconnecting...\n", bd_addr_to_str(sdp_device->conn.btaddr));
+        // Should not happen, the scheduler serializes the queries.
+        loge("Another SDP query is in progress (%s), disconnecting...\n", bd_addr_to_str(sdp_device->conn.btaddr));
         uni_hid_device_disconnect(d);
         uni_hid_device_delete(d);
         /* 'd'' is destroyed after this call, don't use it */
@@ -228,19 +283,38 @@ void uni_bt_sdp_query_start(uni_hid_device_t* d) {
     }
 
     sdp_device = d;
+    start_query_timer(d);
+    uni_bt_sdp_query_start_vid_pid(d);
+}
+
+static void start_query_timer(uni_hid_device_t* d) {
+    btstack_run_loop_remove_timer(&sdp_query_timer);
     btstack_run_loop_set_timer_context(&sdp_query_timer, d);
-    btstack_run_loop_set_timer_handler(&sdp_query_timer, &sdp_query_timeout);
-    btstack_run_loop_set_timer(&sdp_query_timer, SDP_QUERY_TIMEOUT_MS);
+    btstack_run_loop_set_timer_handler(&sdp_query_timer, UNI_BT_PROFILER_TIMER(sdp_query_timeout));
+    btstack_run_loop_set_timer(&sdp_query_timer, uni_bt_conn_policy_get_timeout_ms(d, UNI_BT_CONN_STAGE_SDP));
     btstack_run_loop_add_timer(&sdp_query_timer);
+}
 
-    uni_bt_sdp_query_start_vid_pid(d);
+// Public functions
+
+void uni_bt_sdp_query_start(uni_hid_device_t* d) {
+    logi("-----------> sdp_query_start()\n");
+    // SDP client only supports one SDP query at the time. If busy, the query is queued.
+    // A device without an ACL connection needs to be paged as well.
+    uni_bt_sched_request(d,
+                         d->conn.handle != UNI_BT_CONN_HANDLE_INVALID
+                             ? UNI_BT_SCHED_RESOURCE_SDP
+                             : (UNI_BT_SCHED_RESOURCE_SDP | UNI_BT_SCHED_RESOURCE_PAGE),
+                         &sdp_query_start);
 }
 
 void uni_bt_sdp_query_end(uni_hid_device_t* d) {
     logi("<----------- sdp_query_end()\n");
     uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_SDP_HID_DESCRIPTOR_FETCHED);
+    uni_bt_conn_policy_on_stage_completed(d, UNI_BT_CONN_STAGE_SDP);
     sdp_device = NULL;
     btstack_run_loop_remove_timer(&sdp_query_timer);
+    uni_bt_sched_release(d, UNI_BT_SCHED_RESOURCE_SDP | UNI_BT_SCHED_RESOURCE_PAGE);
     uni_bt_bredr_process_fsm(d);
 }
 
@@ -248,13 +322,17 @@ void uni_bt_sdp_query_start_vid_pid(uni_hid_device_t* d) {
     logi("Starting SDP VID/PID query for %s\n", bd_addr_to_str(d->conn.btaddr));
 
     uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_SDP_VENDOR_REQUESTED);
-    uint8_t status = sdp_client_query_uuid16(&uni_handle_sdp_pid_query_result, d->conn.btaddr,
-                                             BLUETOOTH_SERVICE_CLASS_PNP_INFORMATION);
+    uint8_t status = sdp_client_query_uuid16(UNI_BT_PROFILER_PACKET_HANDLER(uni_handle_sdp_pid_query_result),
+                                             d->conn.btaddr, BLUETOOTH_SERVICE_CLASS_PNP_INFORMATION);
+    if (status == SDP_QUERY_BUSY) {
+        logi("SDP client busy, delaying VID/PID query for %s\n", bd_addr_to_str(d->conn.btaddr));
+        sdp_query_busy(d);
+        return;
+    }
     if (status != 0) {
-        loge("Failed to perform SDP VID/PID query\n");
-        uni_hid_device_disconnect(d);
-        uni_hid_device_delete(d);
-        /* 'd' is destroyed after this call, don't use it */
+        loge("Failed to perform SDP VID/PID query: 0x%02x\n", status);
+        sdp_query_failed(d);
+        /* 'd' might be invalid */
         return;
     }
 }
@@ -275,17 +353,22 @@ void uni_bt_sdp_query_start_hid_descriptor(uni_hid_device_t* d) {
     }
 
     uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_SDP_HID_DESCRIPTOR_REQUESTED);
-    uint8_t status = sdp_client_query_uuid16(&uni_handle_sdp_hid_query_result, d->conn.btaddr,
-                                             BLUETOOTH_SERVICE_CLASS_HUMAN_INTERFACE_DEVICE_SERVICE);
+    uint8_t status = sdp_client_query_uuid16(UNI_BT_PROFILER_PACKET_HANDLER(uni_handle_sdp_hid_query_result),
+                                             d->conn.btaddr, BLUETOOTH_SERVICE_CLASS_HUMAN_INTERFACE_DEVICE_SERVICE);
     if (status != 0) {
-        loge("Failed to perform SDP query for %s. Removing it...\n", bd_addr_to_str(d->conn.btaddr));
-        btstack_run_loop_remove_timer(&sdp_query_timer);
-        uni_hid_device_disconnect(d);
-        uni_hid_device_delete(d);
-        /* 'd'' is destroyed after this call, don't use it */
+        loge("Failed to perform SDP query for %s: 0x%02x\n", bd_addr_to_str(d->conn.btaddr), status);
+        sdp_query_failed(d);
+        /* 'd' might be invalid */
     }
 }
 
+void uni_bt_sdp_on_device_deleted(uni_hid_device_t* d) {
+    if (sdp_device != d)
+        return;
+    sdp_device = NULL;
+    btstack_run_loop_remove_timer(&sdp_query_timer);
+}
+
 void uni_bt_sdp_server_init() {
     // Only initialize the SDP record. Just needed for DualShock/DualSense to have
     // a successful reconnecting.
@@ -9,6 +9,7 @@
 #include "bt/uni_bt.h"
 #include "bt/uni_bt_allowlist.h"
 #include "bt/uni_bt_le.h"
+#include "bt/uni_bt_profiler.h"
 #include "bt/uni_bt_service.gatt.h"
 #include "controller/uni_gamepad.h"
 #include "uni_common.h"
@@ -22,10 +23,15 @@
 #define APP_AD_FLAGS 0x06
 
 // Max number of clients that can connect to the service at the same time.
-#define MAX_NR_CLIENT_CONNECTIONS 1
+#ifdef CONFIG_BLUEPAD32_BLE_SERVICE_MAX_CLIENTS
+#define MAX_NR_CLIENT_CONNECTIONS CONFIG_BLUEPAD32_BLE_SERVICE_MAX_CLIENTS
+#else
+#define MAX_NR_CLIENT_CONNECTIONS 2
+#endif
 
-// Don't know how to increate MTU for notification, so use the minimum which is 20 (23 - 3)
-#define NOTIFICATION_MTU 20
+// Minimum ATT MTU is 23. Notifications have 3 bytes of overhead.
+// A bigger MTU is requested when the client enables notifications. See request_mtu().
+#define NOTIFICATION_MIN_PAYLOAD (ATT_DEFAULT_MTU - 3)
 
 // Struct sent to the BLE client
 // A compact version of uni_hid_device_t.
@@ -39,22 +45,108 @@ typedef struct __attribute((packed)) {
     uint16_t controller_type;
     uni_controller_subtype_t controller_subtype;
 } compact_device_t;
-_Static_assert(sizeof(compact_device_t) <= NOTIFICATION_MTU, "compact_device_t too big");
+_Static_assert(sizeof(compact_device_t) <= NOTIFICATION_MIN_PAYLOAD, "compact_device_t too big");
+_Static_assert(CONFIG_BLUEPAD32_MAX_DEVICES <= 32, "dirty_devices is a 32-bit mask");
+
+// Live controller state. Only gamepads are supported.
+// Each notification contains one or more records with the following format:
+// - uint8_t: device index
+// - uint16_t: fields present in the record. See CONTROLLER_STATE_FIELD_
+// - the fields that changed since the previous notification, in the same order as the enum.
+// The first record of a device after subscribing or changing the config contains all the fields.
+// A full record with IMU data is 44 bytes, bigger than what the default ATT MTU (23) allows. In that case
+// gyro and accel are sent in a record of their own, in the next notification.
+enum {
+    CONTROLLER_STATE_FIELD_DPAD = BIT(0),          // uint8_t
+    CONTROLLER_STATE_FIELD_BUTTONS = BIT(1),       // uint16_t
+    CONTROLLER_STATE_FIELD_MISC_BUTTONS = BIT(2),  // uint8_t
+    CONTROLLER_STATE_FIELD_AXIS_X = BIT(3),        // int16_t
+    CONTROLLER_STATE_FIELD_AXIS_Y = BIT(4),        // int16_t
+    CONTROLLER_STATE_FIELD_AXIS_RX = BIT(5),       // int16_t
+    CONTROLLER_STATE_FIELD_AXIS_RY = BIT(6),       // int16_t
+    CONTROLLER_STATE_FIELD_BRAKE = BIT(7),         // int16_t
+    CONTROLLER_STATE_FIELD_THROTTLE = BIT(8),      // int16_t
+    CONTROLLER_STATE_FIELD_BATTERY = BIT(9),       // uint8_t
+    CONTROLLER_STATE_FIELD_GYRO = BIT(10),         // int16_t[3], only when IMU is enabled
+    CONTROLLER_STATE_FIELD_ACCEL = BIT(11),        // int16_t[3], only when IMU is enabled
+
+    CONTROLLER_STATE_FIELD_ALL = GENMASK(11, 0),
+    CONTROLLER_STATE_FIELD_IMU = CONTROLLER_STATE_FIELD_GYRO | CONTROLLER_STATE_FIELD_ACCEL,
+};
+// idx + fields + dpad + buttons + misc_buttons + 6 axis + battery + gyro + accel
+#define CONTROLLER_STATE_RECORD_MAX_LEN (1 + 2 + 1 + 2 + 1 + 6 * 2 + 1 + 3 * 2 + 3 * 2)
+// Same, without gyro and accel. Must fit in the default MTU.
+#define CONTROLLER_STATE_RECORD_NO_IMU_MAX_LEN (CONTROLLER_STATE_RECORD_MAX_LEN - 3 * 2 - 3 * 2)
+_Static_assert(CONTROLLER_STATE_RECORD_NO_IMU_MAX_LEN <= NOTIFICATION_MIN_PAYLOAD, "controller state record too big");
+
+typedef struct {
+    uint8_t dpad;
+    uint16_t buttons;
+    uint8_t misc_buttons;
+    // axis_x, axis_y, axis_rx, axis_ry, brake, throttle
+    int16_t axis[6];
+    uint8_t battery;
+    int16_t gyro[3];
+    int16_t accel[3];
+} controller_state_t;
+
+enum {
+    CONTROLLER_STATE_CONFIG_FLAG_IMU = BIT(0),  // Include gyro and accel
+};
+
+// Written by the client to select which devices to notify, and how often.
+typedef struct __attribute((packed)) {
+    uint32_t device_mask;      // One bit per device. 0 disables the live controller state.
+    uint16_t min_interval_ms;  // Min time between notifications. 0 means: as fast as possible.
+    uint8_t flags;             // See CONTROLLER_STATE_CONFIG_FLAG_
+} controller_state_config_t;
 
 // client connection
 typedef struct {
     bool notification_enabled;
     uint16_t value_handle;
     hci_con_handle_t connection_handle;
+    // Negotiated ATT MTU
+    uint16_t mtu;
+    // MTU exchange requested by us. Done once per connection.
+    bool mtu_requested;
+    // Devices that changed and were not notified yet. One bit per device.
+    uint32_t dirty_devices;
+    // Device where the next notification starts, so that all devices get a turn when they don't fit in the MTU.
+    uint8_t devices_cursor;
+
+    // Live controller state
+    bool state_notification_enabled;
+    controller_state_config_t state_config;
+    // Devices whose state changed and were not notified yet. One bit per device.
+    uint32_t state_dirty;
+    // Devices whose last state was notified, so that only the changed fields are sent.
+    uint32_t state_synced;
+    // Same, for gyro and accel, since they might be sent in a different notification.
+    uint32_t state_imu_synced;
+    // Devices whose next split record contains gyro and accel. See notify_controller_state().
+    uint32_t state_imu_turn;
+    uint32_t state_last_notification_ms;
+    uint8_t state_cursor;
+    bool state_timer_pending;
+    btstack_timer_source_t state_timer;
+    controller_state_t state_sent[CONFIG_BLUEPAD32_MAX_DEVICES];
 } client_connection_t;
 static client_connection_t client_connections[MAX_NR_CLIENT_CONNECTIONS];
 
-// Iterate all over the connected clients, but only one is supported. Hardcoded to 0, don't change.
-static int notification_connection_idx;
-// Iterate all over the connected controllers
-static int notification_device_idx;
+// Clients are served round-robin: only one can-send-now request is pending at a time,
+// and the next one starts from the client after the one that was just served.
+static int next_client_idx;
+static hci_con_handle_t can_send_now_handle;
 
 static compact_device_t compact_devices[CONFIG_BLUEPAD32_MAX_DEVICES];
+static controller_state_t controller_states[CONFIG_BLUEPAD32_MAX_DEVICES];
+// Multiple records are packed in one notification, as many as the MTU allows.
+#define NOTIFICATION_BUFFER_LEN                                  \
+    (sizeof(compact_devices) > CONTROLLER_STATE_RECORD_MAX_LEN * CONFIG_BLUEPAD32_MAX_DEVICES \
+         ? sizeof(compact_devices)                               \
+         : CONTROLLER_STATE_RECORD_MAX_LEN * CONFIG_BLUEPAD32_MAX_DEVICES)
+static uint8_t notification_buffer[NOTIFICATION_BUFFER_LEN];
 static bool service_enabled;
 
 // clang-format off
@@ -72,6 +164,7 @@ _Static_assert(sizeof(adv_data) <= 31, "adv_data too big");
 static const int adv_data_len = sizeof(adv_data);
 
 static void uni_att_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size);
+UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(uni_att_packet_handler)
 static int uni_att_write_callback(hci_con_handle_t con_handle,
                                   uint16_t att_handle,
                                   uint16_t transaction_mode,
@@ -84,61 +177,363 @@ static uint16_t uni_att_read_callback(hci_con_handle_t conn_handle,
                                       uint8_t* buffer,
                                       uint16_t buffer_size);
 static client_connection_t* connection_for_conn_handle(hci_con_handle_t conn_handle);
-static bool next_notify_device(void);
-static void notify_client(void);
-static void maybe_notify_client();
+static void notify_client(client_connection_t* ctx);
+static void request_can_send_now(void);
+static void notify_controller_state(client_connection_t* ctx);
+static bool is_controller_state_ready(const client_connection_t* ctx);
+static void maybe_start_controller_state_timer(client_connection_t* ctx);
 
-static bool is_notify_client_valid(void) {
-    return ((client_connections[notification_connection_idx].connection_handle != HCI_CON_HANDLE_INVALID) &&
-            (client_connections[notification_connection_idx].notification_enabled));
-}
-
-static bool next_notify_device(void) {
-    // TODO: For simplicity, we send all 4 devices.
-    // But we should only send the connected ones.
-    notification_device_idx++;
-    if (notification_device_idx == CONFIG_BLUEPAD32_MAX_DEVICES) {
-        notification_device_idx = 0;
+static bool is_client_pending(const client_connection_t* ctx) {
+    if (ctx->connection_handle == HCI_CON_HANDLE_INVALID)
+        return false;
+    if (ctx->notification_enabled && ctx->dirty_devices)
         return true;
-    }
-    return false;
+    return is_controller_state_ready(ctx);
 }
 
-static void notify_client(void) {
-    logd("Notifying client idx = %d, device idx = %d\n", notification_connection_idx, notification_device_idx);
+// Sends at most one notification to the client.
+static void notify_client(client_connection_t* ctx) {
     uint8_t status;
-    client_connection_t* ctx;
-    bool finish_round;
+    int max_len;
+    int len = 0;
+    uint32_t sent = 0;
+    int idx;
 
-    if (!is_notify_client_valid())
+    // Devices list has priority over the live controller state.
+    if (!ctx->notification_enabled || !ctx->dirty_devices) {
+        notify_controller_state(ctx);
+        return;
+    }
+
+    // Pack as many changed devices as possible in one notification.
+    max_len = btstack_min(ctx->mtu - 3, sizeof(notification_buffer));
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        idx = (ctx->devices_cursor + i) % CONFIG_BLUEPAD32_MAX_DEVICES;
+        if ((ctx->dirty_devices & BIT(idx)) == 0)
+            continue;
+        if (len + (int)sizeof(compact_devices[0]) > max_len)
+            break;
+        memcpy(&notification_buffer[len], &compact_devices[idx], sizeof(compact_devices[0]));
+        len += sizeof(compact_devices[0]);
+        sent |= BIT(idx);
+        ctx->devices_cursor = (idx + 1) % CONFIG_BLUEPAD32_MAX_DEVICES;
+    }
+    if (len == 0)
         return;
 
-    ctx = &client_connections[notification_connection_idx];
+    logd("BLE Service: Notifying client handle = %#x, devices = %#x, len = %d\n", ctx->connection_handle, sent, len);
 
-    // send
-    status = att_server_notify(ctx->connection_handle, ctx->value_handle,
-                               (const uint8_t*)&compact_devices[notification_device_idx], sizeof(compact_devices[0]));
+    status = att_server_notify(ctx->connection_handle, ctx->value_handle, notification_buffer, len);
     if (status != ERROR_CODE_SUCCESS) {
         loge("BLE Service: Failed to notify client, error: %#x\n", status);
+        return;
     }
+    ctx->dirty_devices &= ~sent;
+}
+
+// Requests a can-send-now event for the next client that has something to send.
+static void request_can_send_now(void) {
+    client_connection_t* ctx;
+    int idx;
+
+    // Already requested. The rest of the clients will be served after it.
+    if (can_send_now_handle != HCI_CON_HANDLE_INVALID)
+        return;
 
-    finish_round = next_notify_device();
-    if (!finish_round)
+    for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++) {
+        idx = (next_client_idx + i) % MAX_NR_CLIENT_CONNECTIONS;
+        ctx = &client_connections[idx];
+        if (!is_client_pending(ctx))
+            continue;
+        next_client_idx = (idx + 1) % MAX_NR_CLIENT_CONNECTIONS;
+        can_send_now_handle = ctx->connection_handle;
         att_server_request_can_send_now_event(ctx->connection_handle);
+        return;
+    }
 }
 
-static void maybe_notify_client(void) {
-    client_connection_t* ctx = NULL;
+static void on_can_send_now(hci_con_handle_t con_handle) {
+    client_connection_t* ctx;
 
-    for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++) {
-        if (client_connections[i].connection_handle != HCI_CON_HANDLE_INVALID &&
-            client_connections[i].notification_enabled) {
-            ctx = &client_connections[i];
-            break;
+    // The event says who can send. The pending request might belong to another client, if they interleaved.
+    ctx = connection_for_conn_handle(con_handle);
+    if (can_send_now_handle == con_handle)
+        can_send_now_handle = HCI_CON_HANDLE_INVALID;
+    if (ctx)
+        notify_client(ctx);
+    request_can_send_now();
+}
+
+static int16_t clamp_int16(int32_t v) {
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)v;
+}
+
+static void controller_state_from_controller(controller_state_t* st, const uni_controller_t* ctl) {
+    const uni_gamepad_t* gp = &ctl->gamepad;
+
+    st->dpad = gp->dpad;
+    st->buttons = gp->buttons;
+    st->misc_buttons = gp->misc_buttons;
+    st->axis[0] = clamp_int16(gp->axis_x);
+    st->axis[1] = clamp_int16(gp->axis_y);
+    st->axis[2] = clamp_int16(gp->axis_rx);
+    st->axis[3] = clamp_int16(gp->axis_ry);
+    st->axis[4] = clamp_int16(gp->brake);
+    st->axis[5] = clamp_int16(gp->throttle);
+    st->battery = ctl->battery;
+    for (int i = 0; i < 3; i++) {
+        st->gyro[i] = clamp_int16(gp->gyro[i]);
+        st->accel[i] = clamp_int16(gp->accel[i]);
+    }
+}
+
+// Encodes the "allowed" fields that changed, plus the "full" ones even if they didn't change.
+// Returns the length of the encoded record, or 0 if no field changed.
+static int encode_controller_state(uint8_t* buf,
+                                   int idx,
+                                   const controller_state_t* cur,
+                                   const controller_state_t* prev,
+                                   uint16_t full_fields,
+                                   uint16_t allowed_fields) {
+    uint16_t fields = 0;
+    int len = 3;
+    bool full = (full_fields & ~CONTROLLER_STATE_FIELD_IMU) != 0;
+    bool full_imu = (full_fields & CONTROLLER_STATE_FIELD_IMU) != 0;
+    bool imu = (allowed_fields & CONTROLLER_STATE_FIELD_IMU) != 0;
+
+    if (full || cur->dpad != prev->dpad) {
+        fields |= CONTROLLER_STATE_FIELD_DPAD;
+        buf[len++] = cur->dpad;
+    }
+    if (full || cur->buttons != prev->buttons) {
+        fields |= CONTROLLER_STATE_FIELD_BUTTONS;
+        little_endian_store_16(buf, len, cur->buttons);
+        len += 2;
+    }
+    if (full || cur->misc_buttons != prev->misc_buttons) {
+        fields |= CONTROLLER_STATE_FIELD_MISC_BUTTONS;
+        buf[len++] = cur->misc_buttons;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (full || cur->axis[i] != prev->axis[i]) {
+            fields |= CONTROLLER_STATE_FIELD_AXIS_X << i;
+            little_endian_store_16(buf, len, (uint16_t)cur->axis[i]);
+            len += 2;
         }
     }
-    if (ctx)
-        att_server_request_can_send_now_event(ctx->connection_handle);
+    if (full || cur->battery != prev->battery) {
+        fields |= CONTROLLER_STATE_FIELD_BATTERY;
+        buf[len++] = cur->battery;
+    }
+    if (imu && (full_imu || memcmp(cur->gyro, prev->gyro, sizeof(cur->gyro)) != 0)) {
+        fields |= CONTROLLER_STATE_FIELD_GYRO;
+        for (int i = 0; i < 3; i++) {
+            little_endian_store_16(buf, len, (uint16_t)cur->gyro[i]);
+            len += 2;
+        }
+    }
+    if (imu && (full_imu || memcmp(cur->accel, prev->accel, sizeof(cur->accel)) != 0)) {
+        fields |= CONTROLLER_STATE_FIELD_ACCEL;
+        for (int i = 0; i < 3; i++) {
+            little_endian_store_16(buf, len, (uint16_t)cur->accel[i]);
+            len += 2;
+        }
+    }
+
+    if (fields == 0)
+        return 0;
+
+    buf[0] = idx;
+    little_endian_store_16(buf, 1, fields);
+    return len;
+}
+
+// Saves the notified fields, so that the next record only contains the ones that changed.
+static void save_controller_state(controller_state_t* sent, const controller_state_t* cur, uint16_t fields) {
+    if (fields & ~CONTROLLER_STATE_FIELD_IMU) {
+        sent->dpad = cur->dpad;
+        sent->buttons = cur->buttons;
+        sent->misc_buttons = cur->misc_buttons;
+        memcpy(sent->axis, cur->axis, sizeof(sent->axis));
+        sent->battery = cur->battery;
+    }
+    if (fields & CONTROLLER_STATE_FIELD_IMU) {
+        memcpy(sent->gyro, cur->gyro, sizeof(sent->gyro));
+        memcpy(sent->accel, cur->accel, sizeof(sent->accel));
+    }
+}
+
+static void notify_controller_state(client_connection_t* ctx) {
+    uint8_t status;
+    uint8_t record[CONTROLLER_STATE_RECORD_MAX_LEN];
+    // Fields that each device could include in the record: all of them, or half of them if split.
+    uint16_t record_fields[CONFIG_BLUEPAD32_MAX_DEVICES];
+    uint16_t allowed;
+    uint16_t full;
+    int max_len;
+    int record_len;
+    int len = 0;
+    uint32_t sent = 0;
+    // Devices that were sent with all the fields.
+    uint32_t done = 0;
+    int idx;
+
+    // Honor the rate requested by the client.
+    if (!is_controller_state_ready(ctx)) {
+        maybe_start_controller_state_timer(ctx);
+        return;
+    }
+
+    allowed = CONTROLLER_STATE_FIELD_ALL;
+    if (!(ctx->state_config.flags & CONTROLLER_STATE_CONFIG_FLAG_IMU))
+        allowed &= ~CONTROLLER_STATE_FIELD_IMU;
+    max_len = btstack_min(ctx->mtu - 3, sizeof(notification_buffer));
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        idx = (ctx->state_cursor + i) % CONFIG_BLUEPAD32_MAX_DEVICES;
+        if ((ctx->state_dirty & BIT(idx)) == 0)
+            continue;
+        full = 0;
+        if (!(ctx->state_synced & BIT(idx)))
+            full |= CONTROLLER_STATE_FIELD_ALL & ~CONTROLLER_STATE_FIELD_IMU;
+        if (!(ctx->state_imu_synced & BIT(idx)))
+            full |= CONTROLLER_STATE_FIELD_IMU;
+        record_fields[idx] = allowed;
+        record_len =
+            encode_controller_state(record, idx, &controller_states[idx], &ctx->state_sent[idx], full, allowed);
+        if (record_len > max_len) {
+            // Doesn't fit in the MTU: gyro and accel go in a record of their own.
+            // Both halves take turns, so that none of them starves.
+            record_fields[idx] = (ctx->state_imu_turn & BIT(idx)) ? CONTROLLER_STATE_FIELD_IMU
+                                                                  : (allowed & ~CONTROLLER_STATE_FIELD_IMU);
+            record_len = encode_controller_state(record, idx, &controller_states[idx], &ctx->state_sent[idx],
+                                                 full & record_fields[idx], record_fields[idx]);
+        }
+        if (len + record_len > max_len)
+            break;
+        memcpy(&notification_buffer[len], record, record_len);
+        len += record_len;
+        sent |= BIT(idx);
+        if (record_fields[idx] == allowed)
+            done |= BIT(idx);
+        ctx->state_cursor = (idx + 1) % CONFIG_BLUEPAD32_MAX_DEVICES;
+    }
+    // Split devices stay dirty, until the other half is sent.
+    ctx->state_dirty &= ~done;
+    if (len == 0)
+        return;
+
+    status = att_server_notify(ctx->connection_handle,
+                               ATT_CHARACTERISTIC_4627C4A4_AC0E_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE,
+                               notification_buffer, len);
+    if (status != ERROR_CODE_SUCCESS) {
+        loge("BLE Service: Failed to notify controller state, error: %#x\n", status);
+        // Try again later, with all the fields.
+        ctx->state_dirty |= sent;
+        ctx->state_synced &= ~sent;
+        ctx->state_imu_synced &= ~sent;
+        return;
+    }
+
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (!(sent & BIT(i)))
+            continue;
+        save_controller_state(&ctx->state_sent[i], &controller_states[i], record_fields[i]);
+        if (record_fields[i] & ~CONTROLLER_STATE_FIELD_IMU)
+            ctx->state_synced |= BIT(i);
+        if (record_fields[i] & CONTROLLER_STATE_FIELD_IMU)
+            ctx->state_imu_synced |= BIT(i);
+        // Next split record of the device sends the other half.
+        if (record_fields[i] == CONTROLLER_STATE_FIELD_IMU || (done & BIT(i)))
+            ctx->state_imu_turn &= ~BIT(i);
+        else
+            ctx->state_imu_turn |= BIT(i);
+    }
+    ctx->state_last_notification_ms = btstack_run_loop_get_time_ms();
+
+    maybe_start_controller_state_timer(ctx);
+}
+
+static bool is_controller_state_ready(const client_connection_t* ctx) {
+    if (!ctx->state_notification_enabled || !ctx->state_dirty)
+        return false;
+    return btstack_run_loop_get_time_ms() - ctx->state_last_notification_ms >= ctx->state_config.min_interval_ms;
+}
+
+static void on_controller_state_timer(btstack_timer_source_t* ts) {
+    client_connection_t* ctx = btstack_run_loop_get_timer_context(ts);
+
+    ctx->state_timer_pending = false;
+    request_can_send_now();
+}
+
+UNI_BT_PROFILER_DECLARE_TIMER(on_controller_state_timer)
+
+static void maybe_start_controller_state_timer(client_connection_t* ctx) {
+    uint32_t elapsed;
+
+    if (!ctx->state_notification_enabled || !ctx->state_dirty || ctx->state_timer_pending)
+        return;
+
+    elapsed = btstack_run_loop_get_time_ms() - ctx->state_last_notification_ms;
+    if (elapsed >= ctx->state_config.min_interval_ms)
+        return;
+
+    // Too early. Try again once the interval has elapsed.
+    btstack_run_loop_set_timer_handler(&ctx->state_timer, UNI_BT_PROFILER_TIMER(on_controller_state_timer));
+    btstack_run_loop_set_timer_context(&ctx->state_timer, ctx);
+    btstack_run_loop_set_timer(&ctx->state_timer, ctx->state_config.min_interval_ms - elapsed);
+    btstack_run_loop_add_timer(&ctx->state_timer);
+    ctx->state_timer_pending = true;
+}
+
+// Resets the live controller state of the client, so that the selected devices are sent with all the fields.
+static void reset_controller_state(client_connection_t* ctx) {
+    ctx->state_synced = 0;
+    ctx->state_imu_synced = 0;
+    ctx->state_dirty = 0;
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if ((ctx->state_config.device_mask & BIT(i)) && compact_devices[i].state != 0)
+            ctx->state_dirty |= BIT(i);
+    }
+    maybe_start_controller_state_timer(ctx);
+    request_can_send_now();
+}
+
+static void remove_controller_state_timer(client_connection_t* ctx) {
+    if (ctx->state_timer_pending)
+        btstack_run_loop_remove_timer(&ctx->state_timer);
+    ctx->state_timer_pending = false;
+}
+
+static void mark_device_dirty(int idx) {
+    for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++)
+        client_connections[i].dirty_devices |= BIT(idx);
+}
+
+static void uni_gatt_client_mtu_handler(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {
+    ARG_UNUSED(channel);
+    ARG_UNUSED(size);
+
+    if (packet_type != HCI_EVENT_PACKET)
+        return;
+
+    // The new MTU is also reported to the ATT server, and handled in ATT_EVENT_MTU_EXCHANGE_COMPLETE.
+    if (hci_event_packet_get_type(packet) == GATT_EVENT_MTU)
+        logi("BLE Service: MTU exchange complete, mtu = %d\n", gatt_event_mtu_get_MTU(packet));
+}
+
+// Most clients request a bigger MTU, but not all of them. Request it in case the client doesn't.
+// Only done for clients that enable notifications: the rest of LE links, like HOGP controllers,
+// don't use the service, and each request would take a GATT client slot.
+static void request_mtu(client_connection_t* ctx) {
+    if (ctx->mtu_requested || ctx->mtu > ATT_DEFAULT_MTU)
+        return;
+    ctx->mtu_requested = true;
+    gatt_client_send_mtu_negotiation(uni_gatt_client_mtu_handler, ctx->connection_handle);
 }
 
 static int uni_att_write_callback(hci_con_handle_t con_handle,
@@ -182,8 +577,16 @@ static int uni_att_write_callback(hci_con_handle_t con_handle,
             ctx->notification_enabled =
                 little_endian_read_16(buffer, 0) == GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION;
             ctx->value_handle = ATT_CHARACTERISTIC_4627C4A4_AC06_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE;
-            if (ctx->notification_enabled)
-                att_server_request_can_send_now_event(ctx->connection_handle);
+            if (ctx->notification_enabled) {
+                request_mtu(ctx);
+                // Send the devices that are in use. Empty slots are skipped.
+                ctx->dirty_devices = 0;
+                for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+                    if (compact_devices[i].state != 0)
+                        ctx->dirty_devices |= BIT(i);
+                }
+                request_can_send_now();
+            }
 
             logi("BLE Service: Notification enabled = %d for handle %#x\n", ctx->notification_enabled,
                  ctx->connection_handle);
@@ -251,6 +654,36 @@ static int uni_att_write_callback(hci_con_handle_t con_handle,
             uni_system_reboot();
             break;
         }
+        case ATT_CHARACTERISTIC_4627C4A4_AC0E_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE: {
+            // Live controller state config
+            ctx = connection_for_conn_handle(con_handle);
+            if (!ctx)
+                return ATT_ERROR_REQUEST_NOT_SUPPORTED;
+            if (buffer_size != sizeof(controller_state_config_t) || offset != 0)
+                return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+            memcpy(&ctx->state_config, buffer, sizeof(ctx->state_config));
+            logi("BLE Service: Controller state devices = %#x, min interval = %d ms, flags = %#x\n",
+                 ctx->state_config.device_mask, ctx->state_config.min_interval_ms, ctx->state_config.flags);
+            reset_controller_state(ctx);
+            break;
+        }
+        case ATT_CHARACTERISTIC_4627C4A4_AC0E_46B9_B688_AFC5C1BF7F63_01_CLIENT_CONFIGURATION_HANDLE: {
+            // Notify live controller state
+            ctx = connection_for_conn_handle(con_handle);
+            if (!ctx)
+                return ATT_ERROR_REQUEST_NOT_SUPPORTED;
+            ctx->state_notification_enabled =
+                little_endian_read_16(buffer, 0) == GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION;
+            if (ctx->state_notification_enabled) {
+                request_mtu(ctx);
+                reset_controller_state(ctx);
+            } else {
+                remove_controller_state_timer(ctx);
+            }
+            logi("BLE Service: Controller state notification enabled = %d for handle %#x\n",
+                 ctx->state_notification_enabled, ctx->connection_handle);
+            break;
+        }
         default:
             logi("BLE Service: Unsupported write to 0x%04x, len %u\n", att_handle, buffer_size);
             return ATT_ERROR_ATTRIBUTE_NOT_FOUND;
@@ -258,12 +691,32 @@ static int uni_att_write_callback(hci_con_handle_t con_handle,
     return ATT_ERROR_SUCCESS;
 }
 
+// Addresses of the "address" rules, 6 bytes each. Other rule types are not reported.
+// Follows the att_read_callback_handle_blob() convention: if buffer is NULL, returns the total length.
+static uint16_t read_allowlist_addresses(uint16_t offset, uint8_t* buffer, uint16_t buffer_size) {
+    const uni_bt_allowlist_rule_t* rules;
+    int total;
+    uint16_t len = 0;
+    uint16_t copied = 0;
+
+    uni_bt_allowlist_get_rules(&rules, &total);
+    for (int i = 0; i < total; i++) {
+        if (rules[i].type != UNI_BT_ALLOWLIST_RULE_ADDR)
+            continue;
+        for (int j = 0; j < BD_ADDR_LEN; j++, len++) {
+            if (buffer && len >= offset && copied < buffer_size)
+                buffer[copied++] = rules[i].addr[j];
+        }
+    }
+    return buffer ? copied : len;
+}
+
 static uint16_t uni_att_read_callback(hci_con_handle_t conn_handle,
                                       uint16_t att_handle,
                                       uint16_t offset,
                                       uint8_t* buffer,
                                       uint16_t buffer_size) {
-    ARG_UNUSED(conn_handle);
+    client_connection_t* ctx;
 
     switch (att_handle) {
         case ATT_CHARACTERISTIC_4627C4A4_AC01_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE:
@@ -290,9 +743,8 @@ static uint16_t uni_att_read_callback(hci_con_handle_t conn_handle,
             return att_read_callback_handle_blob((const void*)compact_devices, (uint16_t)sizeof(compact_devices),
                                                  offset, buffer, buffer_size);
         case ATT_CHARACTERISTIC_4627C4A4_AC06_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE:
-            // Notify all connected devices, only when there is a change, one at a time.
-            // Ideally it should be merged with the previous one, but don't know how to increase
-            // the MTU for the notify package.
+            // Notify connected devices, only when there is a change.
+            // Multiple devices are packed in one notification, as many as the MTU allows.
             // Notify only. Read not supported.
             loge("BLE Service: 4627C4A4_AC06_46B9_B688_AFC5C1BF7F63 does not support read\n");
             break;
@@ -309,11 +761,7 @@ static uint16_t uni_att_read_callback(hci_con_handle_t conn_handle,
         }
         case ATT_CHARACTERISTIC_4627C4A4_AC09_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE: {
             // List of addresses in the allowlist.
-            const bd_addr_t* addresses;
-            int total;
-            uni_bt_allowlist_get_all(&addresses, &total);
-            return att_read_callback_handle_blob((const uint8_t*)addresses, (uint16_t)sizeof(bd_addr_t) * total, offset,
-                                                 buffer, buffer_size);
+            return read_allowlist_addresses(offset, buffer, buffer_size);
         }
         case ATT_CHARACTERISTIC_4627C4A4_AC0A_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE: {
             // Whether to enable Virtual Devices
@@ -328,6 +776,14 @@ static uint16_t uni_att_read_callback(hci_con_handle_t conn_handle,
             // Delete stored Bluetooth bond keys
             loge("BLE Service: 4627C4A4_AC0C_46B9_B688_AFC5C1BF7F63 does not support read\n");
             break;
+        case ATT_CHARACTERISTIC_4627C4A4_AC0E_46B9_B688_AFC5C1BF7F63_01_VALUE_HANDLE: {
+            // Live controller state config
+            ctx = connection_for_conn_handle(conn_handle);
+            if (!ctx)
+                break;
+            return att_read_callback_handle_blob((const uint8_t*)&ctx->state_config,
+                                                 (uint16_t)sizeof(ctx->state_config), offset, buffer, buffer_size);
+        }
 
         case ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL_01_VALUE_HANDLE:
             break;
@@ -384,25 +840,35 @@ static void uni_att_packet_handler(uint8_t packet_type, uint16_t channel, uint8_
                 break;
             ctx->connection_handle = att_event_connected_get_handle(packet);
             mtu = att_server_get_mtu(ctx->connection_handle);
+            ctx->mtu = mtu;
             logi("BLE Service: New client connected handle = %#x, mtu = %d\n", ctx->connection_handle, mtu);
             break;
         case ATT_EVENT_MTU_EXCHANGE_COMPLETE:
-            mtu = att_event_mtu_exchange_complete_get_MTU(packet) - 3;
+            mtu = att_event_mtu_exchange_complete_get_MTU(packet);
             ctx = connection_for_conn_handle(att_event_mtu_exchange_complete_get_handle(packet));
             if (!ctx)
                 break;
+            ctx->mtu = mtu;
+            logi("BLE Service: client handle = %#x, mtu = %d\n", ctx->connection_handle, mtu);
+            // Records that didn't fit in the previous MTU might fit now.
+            if (ctx->state_notification_enabled)
+                reset_controller_state(ctx);
             break;
         case ATT_EVENT_CAN_SEND_NOW:
-            printf_hexdump(packet, size);
-            notify_client();
+            on_can_send_now(att_event_can_send_now_get_handle(packet));
             break;
         case ATT_EVENT_DISCONNECTED:
             ctx = connection_for_conn_handle(att_event_disconnected_get_handle(packet));
             if (!ctx)
                 break;
             logi("BLE Service: client disconnected, handle = %#x\n", ctx->connection_handle);
+            remove_controller_state_timer(ctx);
+            // BTstack drops the can-send-now request of a disconnected client. Give the turn to the next one.
+            if (can_send_now_handle == ctx->connection_handle)
+                can_send_now_handle = HCI_CON_HANDLE_INVALID;
             memset(ctx, 0, sizeof(*ctx));
             ctx->connection_handle = HCI_CON_HANDLE_INVALID;
+            request_can_send_now();
             break;
         case HCI_EVENT_DISCONNECTION_COMPLETE:
             // Do something?
@@ -424,6 +890,8 @@ static void uni_att_packet_handler(uint8_t packet_type, uint16_t channel, uint8_
 }
 
 void uni_bt_service_deinit(void) {
+    for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++)
+        remove_controller_state_timer(&client_connections[i]);
     att_server_deinit();
     gap_advertisements_enable(false);
 }
@@ -445,14 +913,17 @@ void uni_bt_service_init(void) {
     bd_addr_t null_addr = {0};
 
     memset(compact_devices, 0, sizeof(compact_devices));
+    memset(controller_states, 0, sizeof(controller_states));
     memset(&client_connections, 0, sizeof(client_connections));
     for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++)
         client_connections[i].connection_handle = HCI_CON_HANDLE_INVALID;
+    next_client_idx = 0;
+    can_send_now_handle = HCI_CON_HANDLE_INVALID;
     for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++)
         compact_devices[i].idx = i;
 
     // register for ATT events
-    att_server_register_packet_handler(uni_att_packet_handler);
+    att_server_register_packet_handler(UNI_BT_PROFILER_PACKET_HANDLER(uni_att_packet_handler));
 
     gap_advertisements_set_params(adv_int_min, adv_int_max, adv_type, 0, null_addr, 0x07, 0x00);
     gap_advertisements_set_data(adv_data_len, (uint8_t*)adv_data);
@@ -490,7 +961,8 @@ void uni_bt_service_on_device_ready(const uni_hid_device_t* d) {
     compact_devices[idx].controller_subtype = d->controller_subtype;
     compact_devices[idx].state = d->conn.connected;
 
-    maybe_notify_client();
+    mark_device_dirty(idx);
+    request_can_send_now();
 }
 
 void uni_bt_service_on_device_connected(const uni_hid_device_t* d) {
@@ -511,7 +983,8 @@ void uni_bt_service_on_device_connected(const uni_hid_device_t* d) {
     compact_devices[idx].state = d->conn.state;
     compact_devices[idx].incoming = d->conn.incoming;
 
-    maybe_notify_client();
+    mark_device_dirty(idx);
+    request_can_send_now();
 }
 
 void uni_bt_service_on_device_disconnected(const uni_hid_device_t* d) {
@@ -526,6 +999,46 @@ void uni_bt_service_on_device_disconnected(const uni_hid_device_t* d) {
         return;
     memset(&compact_devices[idx], 0, sizeof(compact_devices[0]));
     compact_devices[idx].idx = idx;
+    memset(&controller_states[idx], 0, sizeof(controller_states[0]));
+    for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++) {
+        client_connections[i].state_dirty &= ~BIT(idx);
+        client_connections[i].state_synced &= ~BIT(idx);
+        client_connections[i].state_imu_synced &= ~BIT(idx);
+    }
+
+    // Notify it once, so that the client knows that the slot is empty.
+    mark_device_dirty(idx);
+    request_can_send_now();
+}
+
+void uni_bt_service_on_controller_data(const uni_hid_device_t* d, const uni_controller_t* ctl) {
+    // Must be called from BTstack task
+    controller_state_t st;
+    client_connection_t* ctx;
+
+    if (!service_enabled)
+        return;
+    if (ctl->klass != UNI_CONTROLLER_CLASS_GAMEPAD)
+        return;
+
+    int idx = uni_hid_device_get_idx_for_instance(d);
+    if (idx < 0)
+        return;
 
-    maybe_notify_client();
+    memset(&st, 0, sizeof(st));
+    controller_state_from_controller(&st, ctl);
+    if (memcmp(&st, &controller_states[idx], sizeof(st)) == 0)
+        return;
+    controller_states[idx] = st;
+
+    for (int i = 0; i < MAX_NR_CLIENT_CONNECTIONS; i++) {
+        ctx = &client_connections[i];
+        if (ctx->connection_handle == HCI_CON_HANDLE_INVALID || !ctx->state_notification_enabled)
+            continue;
+        if ((ctx->state_config.device_mask & BIT(idx)) == 0)
+            continue;
+        ctx->state_dirty |= BIT(idx);
+        maybe_start_controller_state_timer(ctx);
+    }
+    request_can_send_now();
 }
@@ -9,13 +9,17 @@
 
 void uni_keyboard_dump(const uni_keyboard_t* kb) {
     // Don't add "\n"
+    bool first = true;
+
     logi("modifiers=%#x, pressed keys=[", kb->modifiers);
-    for (int i = 0; i < UNI_KEYBOARD_PRESSED_KEYS_MAX; i++) {
-        if (kb->pressed_keys[i] == HID_USAGE_KB_NONE || kb->pressed_keys[i] == HID_USAGE_KB_ERROR_ROLL_OVER)
-            break;
-        if (i > 0)
+    // Modifiers are not included: they were already printed.
+    for (int i = 0; i < HID_USAGE_KB_LEFT_CONTROL; i++) {
+        if (!uni_keyboard_is_key_down(kb, i))
+            continue;
+        if (!first)
             logi(", ");
-        logi("%#x", kb->pressed_keys[i]);
+        logi("%#x", i);
+        first = false;
     }
     logi("]");
 }
@@ -4,10 +4,60 @@
 
 #include "controller/uni_mouse.h"
 
+#include <string.h>
+
 #include "uni_log.h"
 
+static int32_t add_sat_int32(int32_t a, int32_t b) {
+    int64_t r = (int64_t)a + b;
+    if (r > INT32_MAX)
+        return INT32_MAX;
+    if (r < INT32_MIN)
+        return INT32_MIN;
+    return (int32_t)r;
+}
+
+static int8_t add_sat_int8(int8_t a, int8_t b) {
+    int r = a + b;
+    if (r > INT8_MAX)
+        return INT8_MAX;
+    if (r < INT8_MIN)
+        return INT8_MIN;
+    return (int8_t)r;
+}
+
 void uni_mouse_dump(const uni_mouse_t* ms) {
     // Don't add "\n"
     logi("delta_x=%4d, delta_y=%4d, buttons=%#x, misc_buttons=%#x, scroll_wheel=%#x", ms->delta_x, ms->delta_y,
          ms->buttons, ms->misc_buttons, ms->scroll_wheel);
 }
+
+void uni_mouse_accum_reset(uni_mouse_accum_t* acc) {
+    memset(acc, 0, sizeof(*acc));
+}
+
+void uni_mouse_accum_add(uni_mouse_accum_t* acc, const uni_mouse_t* ms) {
+    acc->delta_x = add_sat_int32(acc->delta_x, ms->delta_x);
+    acc->delta_y = add_sat_int32(acc->delta_y, ms->delta_y);
+    acc->scroll_wheel = add_sat_int8(acc->scroll_wheel, ms->scroll_wheel);
+
+    acc->buttons = ms->buttons;
+    acc->buttons_latched |= ms->buttons;
+    acc->misc_buttons = ms->misc_buttons;
+    acc->misc_buttons_latched |= ms->misc_buttons;
+}
+
+void uni_mouse_accum_read(uni_mouse_accum_t* acc, uni_mouse_t* out) {
+    out->delta_x = acc->delta_x;
+    out->delta_y = acc->delta_y;
+    out->scroll_wheel = acc->scroll_wheel;
+    out->buttons = acc->buttons | acc->buttons_latched;
+    out->misc_buttons = acc->misc_buttons | acc->misc_buttons_latched;
+
+    acc->delta_x = 0;
+    acc->delta_y = 0;
+    acc->scroll_wheel = 0;
+    // Buttons still pressed will be reported again in the next read.
+    acc->buttons_latched = 0;
+    acc->misc_buttons_latched = 0;
+}
@@ -31,6 +31,10 @@ void uni_bt_del_keys_safe(void);
 void uni_bt_del_keys_unsafe(void);
 // Dump all connected devices.
 void uni_bt_dump_devices_safe(void);
+// Dump the setup timeline percentiles of the last connections.
+void uni_bt_dump_conn_trace_safe(void);
+// Dump the run-loop profile: time spent in each handler. Optionally resets it after dumping.
+void uni_bt_dump_profiler_safe(bool reset);
 // Whether to enable new Bluetooth connections.
 // When enabled, the device scans for new connections, and it will try to auto-connect to supported devices.
 // When disabled, only devices that have paired before can connect.
@@ -58,6 +62,9 @@ void uni_bt_enable_service_safe(bool enabled);
 // Disconnects a device
 void uni_bt_disconnect_device_safe(int device_idx);
 
+// Pages the bonded BR/EDR controllers, instead of waiting for them to reconnect.
+void uni_bt_reconnect_safe(void);
+
 // Get local BD address
 void uni_bt_get_local_bd_addr_safe(bd_addr_t addr);
 
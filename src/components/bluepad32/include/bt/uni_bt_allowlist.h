@@ -10,46 +10,94 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <btstack.h>
 
 //
 // IMPORTANT:
-// These functions are not %100 thread safe, but "safe-enough".
+// The functions that modify the allowlist must be called from the BTstack thread.
+// From other threads (e.g: console), use the "_safe" ones: they are applied by the BTstack thread.
+// The query functions are not %100 thread safe, but "safe-enough".
 // If another task calls them, the worst case that can happen is a race condition
 // where a connection is accepted/declined when it shouldn't.
-// But no crashes should happen since no deletions/insertions are performed.
+// But no crashes should happen since the tables have a fixed size.
 //
 
 // IMPORTANT:
 // These functions modify NVS (non-volatile storage).
-// If you add an address to the allow list, it will persist reboots.
+// If you add a rule to the allow list, it will persist reboots.
 // Similar if you enable or disable allow list.
 
+typedef enum {
+    // Exact Bluetooth address.
+    UNI_BT_ALLOWLIST_RULE_ADDR,
+    // Address prefix (Organizationally Unique Identifier): first 3 bytes of the address.
+    UNI_BT_ALLOWLIST_RULE_OUI,
+    // Vendor and Product ID. Only known after connecting: devices are disconnected before being "ready".
+    UNI_BT_ALLOWLIST_RULE_VID_PID,
+} uni_bt_allowlist_rule_type_t;
+
+typedef struct {
+    uint8_t type;  // uni_bt_allowlist_rule_type_t
+    union {
+        bd_addr_t addr;
+        uint8_t oui[3];
+        struct {
+            uint16_t vid;
+            uint16_t pid;
+        } vid_pid;
+    };
+} uni_bt_allowlist_rule_t;
+
 // Whether the address is allowed to connect.
+// If the allowlist has VID/PID rules, returns true for unknown addresses, since the VID/PID is not known yet.
 bool uni_bt_allowlist_is_allowed_addr(bd_addr_t addr);
 
+// Whether the device is allowed to connect, once its VID/PID is known.
+bool uni_bt_allowlist_is_allowed(bd_addr_t addr, uint16_t vid, uint16_t pid);
+
 // Add a new address to the allow list.
 bool uni_bt_allowlist_add_addr(bd_addr_t addr);
 
 // Remove an existing address from the allow list.
 bool uni_bt_allowlist_remove_addr(bd_addr_t addr);
 
+// Add / remove a rule of any type.
+bool uni_bt_allowlist_add_rule(const uni_bt_allowlist_rule_t* rule);
+bool uni_bt_allowlist_remove_rule(const uni_bt_allowlist_rule_t* rule);
+
+// Adds many rules, and stores them in NVS only once. Useful to pre-approve a batch of controllers.
+// Returns the number of rules added. Duplicates are skipped.
+int uni_bt_allowlist_add_rules(const uni_bt_allowlist_rule_t* rules, int total);
+
 // Remove all entries from the allow list.
 bool uni_bt_allowlist_remove_all(void);
 
-// Print the allowed-address to the console.
+// Can be called from any thread. Return false if the rule is invalid, or if the command queue is full.
+bool uni_bt_allowlist_add_rule_safe(const uni_bt_allowlist_rule_t* rule);
+bool uni_bt_allowlist_remove_rule_safe(const uni_bt_allowlist_rule_t* rule);
+
+// Print the allowed rules to the console.
 void uni_bt_allowlist_list(void);
 
-// Return a pointer to the addresses.
+// Return a pointer to the rules.
 // Do not modify the returned data.
-void uni_bt_allowlist_get_all(const bd_addr_t** addresses, int* total);
+void uni_bt_allowlist_get_rules(const uni_bt_allowlist_rule_t** rules, int* total);
+
+// Parses a rule. Accepted formats:
+//  - Address: "00:11:22:33:44:55"
+//  - OUI: "00:11:22"
+//  - VID/PID, in hex: "054c/05c4"
+bool uni_bt_allowlist_parse_rule(const char* str, uni_bt_allowlist_rule_t* rule);
 
 // Whether the allowlist is enabled.
 bool uni_bt_allowlist_is_enabled(void);
 
 // Enables/Disables the allowlist feature.
 void uni_bt_allowlist_set_enabled(bool enabled);
+// Can be called from any thread. Returns false if the command queue is full.
+bool uni_bt_allowlist_set_enabled_safe(bool enabled);
 
 // Initialize the Allowlist feature.
 void uni_bt_allowlist_init(void);
@@ -58,4 +106,4 @@ void uni_bt_allowlist_init(void);
 }
 #endif
 
-#endif  // UNI_BT_ALLOWLIST_H
\ No newline at end of file
+#endif  // UNI_BT_ALLOWLIST_H
@@ -18,7 +18,8 @@ extern "C" {
 #include "bt/uni_bt_conn.h"
 #include "uni_hid_device.h"
 
-void uni_bt_bredr_scan_start(void);
+// Periodic inquiry. Lengths in 1.28s units.
+void uni_bt_bredr_scan_start_with_params(uint16_t max_periodic_len, uint16_t min_periodic_len, uint8_t inquiry_len);
 void uni_bt_bredr_scan_stop(void);
 
 // Called from uni_hid_device_disconnect()
@@ -33,6 +34,14 @@ bool uni_bt_bredr_is_enabled(void);
 
 void uni_bt_bredr_l2cap_create_control_connection(uni_hid_device_t* d);
 void uni_bt_bredr_process_fsm(uni_hid_device_t* d);
+// Retries a failed setup stage after a backoff, if the connection policy allows it.
+// Returns false if it can't be retried. In that case the caller handles the failure.
+bool uni_bt_bredr_retry_stage(uni_hid_device_t* d, uni_bt_conn_stage_t stage);
+// Like uni_bt_bredr_retry_stage(), but closes the ACL connection first, keeping the device.
+// Aborts what can't be cancelled otherwise, like a lost SDP query. Only for outgoing connections.
+bool uni_bt_bredr_restart_stage(uni_hid_device_t* d, uni_bt_conn_stage_t stage);
+// Runs the setup stage again after a delay, without counting it as a retry. E.g: a resource is still busy.
+void uni_bt_bredr_delay_stage(uni_hid_device_t* d, uni_bt_conn_stage_t stage, uint32_t delay_ms);
 
 void uni_bt_bredr_on_l2cap_incoming_connection(uint16_t channel, const uint8_t* packet, uint16_t size);
 void uni_bt_bredr_on_l2cap_channel_opened(uint16_t channel, const uint8_t* packet, uint16_t size);
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_CMD_QUEUE_H
+#define UNI_BT_CMD_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Command queue into the BTstack thread.
+// Bounded, lock-free, multi-producer / single-consumer: commands can be pushed from any thread or core.
+// They are executed in order, in batches, from the BTstack thread.
+// Used by the "_safe" functions. Platforms can use it as well.
+
+struct uni_bt_cmd_s;
+// Called from the BTstack thread.
+typedef void (*uni_bt_cmd_handler_t)(const struct uni_bt_cmd_s* cmd);
+
+typedef struct uni_bt_cmd_s {
+    uni_bt_cmd_handler_t handler;
+    // Handler-defined.
+    uint16_t cmd;
+    union {
+        bool enabled;
+        int32_t value;
+        // Commands for one device. E.g: rumble, player LEDs
+        struct {
+            uint8_t idx;
+            uint8_t data[7];
+        } device;
+    } args;
+} uni_bt_cmd_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t executed;
+    // Commands dropped because the queue was full.
+    uint32_t overflows;
+    // Times the BTstack thread was woken up, and the max commands executed in one wakeup.
+    uint32_t wakeups;
+    uint32_t max_batch;
+} uni_bt_cmd_queue_stats_t;
+
+// Can be called from any thread. Doesn't block.
+// Returns false if the queue is full. The command is dropped.
+bool uni_bt_cmd_queue_push(const uni_bt_cmd_t* cmd);
+
+void uni_bt_cmd_queue_get_stats(uni_bt_cmd_queue_stats_t* stats);
+void uni_bt_cmd_queue_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_CMD_QUEUE_H
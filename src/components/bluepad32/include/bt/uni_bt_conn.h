@@ -39,8 +39,23 @@ typedef enum {
 
     UNI_BT_CONN_STATE_DEVICE_PENDING_READY,
     UNI_BT_CONN_STATE_DEVICE_READY,
+
+    UNI_BT_CONN_STATE_COUNT,  // Must be the last one
 } uni_bt_conn_state_t;
 
+// Setup stages that have their own deadline and retries. See uni_bt_conn_policy.h
+typedef enum {
+    UNI_BT_CONN_STAGE_NAME,
+    UNI_BT_CONN_STAGE_SDP,
+    UNI_BT_CONN_STAGE_L2CAP,
+    UNI_BT_CONN_STAGE_PARSER,
+
+    UNI_BT_CONN_STAGE_COUNT,  // Must be the last one
+} uni_bt_conn_stage_t;
+
+// Value used in the setup timeline for states that were not reached.
+#define UNI_BT_CONN_TRACE_NOT_REACHED 0xffff
+
 typedef struct {
     bd_addr_t btaddr;
     hci_con_handle_t handle;
@@ -51,6 +66,17 @@ typedef struct {
     // BR/EDR only
     uint8_t page_scan_repetition_mode;
     uint16_t clock_offset;
+    // Paged by the reconnect manager, and it didn't respond yet.
+    bool reconnecting;
+
+    // BLE only. Connection parameters in use, 0 if unknown.
+    // Interval in 1.25ms units, supervision timeout in 10ms units.
+    uint16_t le_interval;
+    uint16_t le_latency;
+    uint16_t le_supervision_timeout;
+    // Max interval requested by the connection-parameter policy, 0 if none was requested.
+    uint16_t le_requested_interval_max;
+    uint8_t le_update_failures;
 
     // BLE & BR/EDR
     uint8_t rssi;
@@ -60,6 +86,16 @@ typedef struct {
 
     uni_bt_conn_state_t state;
     uni_bt_conn_protocol_t protocol;
+
+    // Retries done in each setup stage.
+    uint8_t stage_retries[UNI_BT_CONN_STAGE_COUNT];
+    // BR/EDR setup in progress, and when it started. See uni_bt_conn_policy_on_setup_started()
+    bool setup_started;
+    uint32_t setup_start_ms;
+
+    // Setup timeline: when each state was reached, in ms since the setup started.
+    uint32_t trace_start_ms;
+    uint16_t trace_ms[UNI_BT_CONN_STATE_COUNT];
 } uni_bt_conn_t;
 
 void uni_bt_conn_init(uni_bt_conn_t* conn);
@@ -72,4 +108,16 @@ void uni_bt_conn_set_connected(uni_bt_conn_t* conn, bool connected);
 bool uni_bt_conn_is_connected(const uni_bt_conn_t* conn);
 void uni_bt_conn_disconnect(uni_bt_conn_t* conn);
 
+// Setup timeline tracing. Must be called from BTstack thread.
+// Marks the start of the setup. Called when the device gets created.
+void uni_bt_conn_trace_start(uni_bt_conn_t* conn);
+// Returns when "state" was reached in ms since the setup started, or -1 if it was not reached.
+int32_t uni_bt_conn_trace_get_state_ms(const uni_bt_conn_t* conn, uni_bt_conn_state_t state);
+// Returns the percentile (0-100) of the time it took to reach "state" in the last connections
+// that got ready, or -1 if there is no data.
+int32_t uni_bt_conn_trace_get_percentile(uni_bt_conn_state_t state, int percentile);
+const char* uni_bt_conn_state_to_str(uni_bt_conn_state_t state);
+void uni_bt_conn_trace_dump(const uni_bt_conn_t* conn);
+void uni_bt_conn_trace_dump_stats(void);
+
 #endif  // UNI_BT_CONN_H
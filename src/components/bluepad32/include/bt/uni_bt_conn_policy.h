@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_CONN_POLICY_H
+#define UNI_BT_CONN_POLICY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bt/uni_bt_conn.h"
+#include "uni_hid_device.h"
+
+// Connection-setup policy: deadline and retries of each setup stage.
+// A stage that fails for a transient reason (lost SDP response, L2CAP refused for lack of resources, etc.)
+// is retried after a short backoff, instead of waiting for the whole connection timeout.
+// Both the deadline and the backoff are doubled on each retry.
+// Some controller families have their own policy, chosen by controller type or by VID/PID.
+
+typedef struct {
+    // Deadline of the first attempt.
+    uint16_t timeout_ms;
+    uint8_t max_retries;
+    // Delay before the first retry.
+    uint16_t backoff_ms;
+} uni_bt_conn_stage_policy_t;
+
+typedef struct {
+    uint32_t setups_ok;
+    uint32_t setups_failed;
+    // Of the successful setups.
+    uint32_t setup_avg_ms;
+    uint32_t setup_max_ms;
+    uint32_t stage_timeouts[UNI_BT_CONN_STAGE_COUNT];
+    uint32_t stage_retries[UNI_BT_CONN_STAGE_COUNT];
+    // Completed after one or more retries.
+    uint32_t stage_recovered[UNI_BT_CONN_STAGE_COUNT];
+} uni_bt_conn_policy_stats_t;
+
+// All must be called from BTstack thread.
+const uni_bt_conn_stage_policy_t* uni_bt_conn_policy_get(const uni_hid_device_t* d, uni_bt_conn_stage_t stage);
+// Deadline of the current attempt of the stage.
+uint32_t uni_bt_conn_policy_get_timeout_ms(const uni_hid_device_t* d, uni_bt_conn_stage_t stage);
+// Returns true if the stage can be retried, and how long to wait before retrying it. The retry is counted.
+bool uni_bt_conn_policy_next_retry(uni_hid_device_t* d, uni_bt_conn_stage_t stage, uint32_t* backoff_ms);
+
+// Stats
+void uni_bt_conn_policy_on_stage_timeout(uni_bt_conn_stage_t stage);
+void uni_bt_conn_policy_on_stage_completed(const uni_hid_device_t* d, uni_bt_conn_stage_t stage);
+// Only the BR/EDR setups are counted: from uni_bt_bredr_process_fsm() until the device is ready or deleted.
+// Calling it more than once is fine: only the first call counts.
+void uni_bt_conn_policy_on_setup_started(uni_hid_device_t* d);
+// Ignored if the setup was not started, or if it already finished.
+void uni_bt_conn_policy_on_setup_finished(uni_hid_device_t* d, bool success);
+void uni_bt_conn_policy_get_stats(uni_bt_conn_policy_stats_t* stats);
+const char* uni_bt_conn_stage_to_str(uni_bt_conn_stage_t stage);
+void uni_bt_conn_policy_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_CONN_POLICY_H
@@ -24,6 +24,8 @@ void uni_bt_le_on_gap_event_advertising_report(const uint8_t* packet, uint16_t s
 void uni_bt_le_on_hci_disconnection_complete(uint16_t channel, const uint8_t* packet, uint16_t size);
 
 void uni_bt_le_scan_start(void);
+// Interval and window in 0.625ms units.
+void uni_bt_le_scan_start_with_params(uint16_t interval, uint16_t window);
 void uni_bt_le_scan_stop(void);
 
 // Called from uni_hid_device_disconnect()
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_LE_CONN_PARAMS_H
+#define UNI_BT_LE_CONN_PARAMS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "uni_hid_device.h"
+
+// BLE connection-parameter policy.
+// The input latency of a BLE controller is bounded by the connection interval: a report waits
+// for the next connection event. Gamepads and mice get the shortest interval with no peripheral latency.
+// Keyboards and remotes get relaxed parameters, to leave air time to the rest of the links.
+//
+// The interval of the low-latency links grows with the number of active LE links,
+// so that all of them fit in the radio schedule. It is re-negotiated when a link comes or goes.
+// If the peripheral rejects the parameters, a wider range is requested once. After that,
+// the parameters negotiated by the peripheral are kept.
+
+typedef enum {
+    UNI_BT_LE_CONN_PROFILE_LOW_LATENCY,
+    UNI_BT_LE_CONN_PROFILE_RELAXED,
+} uni_bt_le_conn_profile_t;
+
+// All must be called from BTstack thread.
+// Sets the parameters used when creating new connections. Called from uni_bt_le_setup().
+void uni_bt_le_conn_params_setup(void);
+uni_bt_le_conn_profile_t uni_bt_le_conn_params_get_profile(const uni_hid_device_t* d);
+// Called when the HID service is connected: requests the parameters of the device profile.
+void uni_bt_le_conn_params_on_device_connected(uni_hid_device_t* d);
+// Re-negotiates the low-latency links. Called when an LE link gets disconnected.
+void uni_bt_le_conn_params_rebalance(void);
+// HCI LE Meta events. Record the parameters in use.
+void uni_bt_le_conn_params_on_connection_complete(uni_hid_device_t* d, const uint8_t* packet);
+void uni_bt_le_conn_params_on_connection_update_complete(const uint8_t* packet);
+
+void uni_bt_le_conn_params_dump_device(const uni_hid_device_t* d);
+void uni_bt_le_conn_params_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_LE_CONN_PARAMS_H
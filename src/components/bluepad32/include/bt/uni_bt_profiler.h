@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_PROFILER_H
+#define UNI_BT_PROFILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <btstack.h>
+
+#include "sdkconfig.h"
+
+// Run-loop profiler.
+// Everything in Bluepad32 runs from BTstack packet handlers and timers, in one thread.
+// It measures how long each handler takes, per event type, so that it is possible to know
+// which one is responsible when the run loop saturates.
+//
+// Enabled with CONFIG_BLUEPAD32_RUN_LOOP_PROFILER. When disabled, the macros below have no cost.
+//
+// Usage, after the handler has been declared:
+//
+//    static void my_timer_callback(btstack_timer_source_t* ts);
+//    UNI_BT_PROFILER_DECLARE_TIMER(my_timer_callback)
+//    ...
+//    btstack_run_loop_set_timer_handler(&timer, UNI_BT_PROFILER_TIMER(my_timer_callback));
+
+typedef enum {
+    UNI_BT_PROFILER_KIND_PACKET,
+    UNI_BT_PROFILER_KIND_TIMER,
+    // Callbacks executed with btstack_run_loop_execute_on_main_thread()
+    UNI_BT_PROFILER_KIND_CALLBACK,
+} uni_bt_profiler_kind_t;
+
+// All must be called from BTstack thread.
+uint32_t uni_bt_profiler_begin(void);
+void uni_bt_profiler_end(const char* name, uni_bt_profiler_kind_t kind, uint32_t event, uint32_t start_us);
+// Returns the event key for a packet: packet type, event and sub-event for "meta" events.
+uint32_t uni_bt_profiler_get_packet_event(uint8_t packet_type, const uint8_t* packet, uint16_t size);
+void uni_bt_profiler_dump(void);
+void uni_bt_profiler_reset(void);
+
+#ifdef CONFIG_BLUEPAD32_RUN_LOOP_PROFILER
+
+#define UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(fn)                                                        \
+    static void fn##_profiled(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {    \
+        uint32_t start_us = uni_bt_profiler_begin();                                                      \
+        fn(packet_type, channel, packet, size);                                                           \
+        uni_bt_profiler_end(#fn, UNI_BT_PROFILER_KIND_PACKET,                                             \
+                            uni_bt_profiler_get_packet_event(packet_type, packet, size), start_us);       \
+    }
+#define UNI_BT_PROFILER_PACKET_HANDLER(fn) (&fn##_profiled)
+
+#define UNI_BT_PROFILER_DECLARE_TIMER(fn)                                           \
+    static void fn##_profiled(btstack_timer_source_t* ts) {                         \
+        uint32_t start_us = uni_bt_profiler_begin();                                \
+        fn(ts);                                                                     \
+        uni_bt_profiler_end(#fn, UNI_BT_PROFILER_KIND_TIMER, 0, start_us);          \
+    }
+#define UNI_BT_PROFILER_TIMER(fn) (&fn##_profiled)
+
+#define UNI_BT_PROFILER_DECLARE_CALLBACK(fn)                                        \
+    static void fn##_profiled(void* context) {                                      \
+        uint32_t start_us = uni_bt_profiler_begin();                                \
+        fn(context);                                                                \
+        uni_bt_profiler_end(#fn, UNI_BT_PROFILER_KIND_CALLBACK, 0, start_us);       \
+    }
+#define UNI_BT_PROFILER_CALLBACK(fn) (&fn##_profiled)
+
+#else  // !CONFIG_BLUEPAD32_RUN_LOOP_PROFILER
+
+#define UNI_BT_PROFILER_DECLARE_PACKET_HANDLER(fn)
+#define UNI_BT_PROFILER_PACKET_HANDLER(fn) (&fn)
+#define UNI_BT_PROFILER_DECLARE_TIMER(fn)
+#define UNI_BT_PROFILER_TIMER(fn) (&fn)
+#define UNI_BT_PROFILER_DECLARE_CALLBACK(fn)
+#define UNI_BT_PROFILER_CALLBACK(fn) (&fn)
+
+#endif  // !CONFIG_BLUEPAD32_RUN_LOOP_PROFILER
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_PROFILER_H
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_RECONNECT_H
+#define UNI_BT_RECONNECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include "uni_hid_device.h"
+
+// BR/EDR reconnect manager.
+// Pages the bonded controllers, instead of waiting for them to initiate the connection
+// or to be discovered again by the inquiry. Some controllers don't reconnect reliably by themselves.
+//
+// Controllers are paged one at a time, most recently used first, using the page scan mode
+// and clock offset seen in their last connection.
+// The scan is held only while a page is in progress, and runs between pages,
+// so that new controllers can still be discovered.
+
+// All must be called from BTstack thread.
+void uni_bt_reconnect_init(void);
+// Starts a reconnect session. Called when the stack is ready, or on demand.
+void uni_bt_reconnect_start(void);
+// Stops paging. E.g: when scanning and autoconnect get disabled, or when the bonded keys are deleted.
+void uni_bt_reconnect_stop(void);
+void uni_bt_reconnect_dump(void);
+
+// Called from uni_bt_bredr.c when the name request used as a page finishes.
+// Returns true if the device was being paged by the reconnect manager. If so, the device is deleted.
+bool uni_bt_reconnect_on_page_failed(uni_hid_device_t* d);
+void uni_bt_reconnect_on_page_succeeded(uni_hid_device_t* d);
+// Updates the hints (page scan mode, clock offset, recently used order) of the device.
+void uni_bt_reconnect_on_device_ready(uni_hid_device_t* d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_RECONNECT_H
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_REJECT_CACHE_H
+#define UNI_BT_REJECT_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include <btstack.h>
+
+// Cache of recently rejected addresses: phones, beacons, etc.
+// In crowded environments the same devices advertise hundreds of times per second.
+// Rejected addresses are ignored, without parsing their advertisement, until the entry expires.
+// Fixed size, set-associative with LRU replacement.
+
+// Must be called from BTstack thread.
+bool uni_bt_reject_cache_contains(const bd_addr_t addr);
+void uni_bt_reject_cache_add(const bd_addr_t addr);
+void uni_bt_reject_cache_dump(void);
+
+// Can be called from any thread. E.g: when the allowlist changes.
+// The cache is flushed on the next access.
+void uni_bt_reject_cache_invalidate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_REJECT_CACHE_H
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_SCAN_POLICY_H
+#define UNI_BT_SCAN_POLICY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+// Scanning (BR/EDR inquiry and BLE scan) shares the radio with the connected controllers,
+// and adds jitter to their reports.
+// The scan policy reduces the scan duty cycle when nothing new appears,
+// and stops scanning when all the seats are taken.
+// Bonded BR/EDR controllers can still reconnect, since page scan is not affected.
+// BLE controllers reconnect once the scan finds them: with the low duty cycle they take longer to reconnect.
+
+typedef enum {
+    UNI_BT_SCAN_POLICY_ALWAYS_ON,  // Scan with the high duty cycle while scanning is enabled
+    UNI_BT_SCAN_POLICY_ADAPTIVE,   // Back off when idle, stop when full
+
+    UNI_BT_SCAN_POLICY_COUNT,
+} uni_bt_scan_policy_t;
+
+typedef enum {
+    UNI_BT_SCAN_LEVEL_OFF,
+    UNI_BT_SCAN_LEVEL_LOW,   // Low duty cycle: nothing new appeared recently
+    UNI_BT_SCAN_LEVEL_HIGH,  // Default duty cycle
+} uni_bt_scan_level_t;
+
+// Must be called from BTstack thread.
+void uni_bt_scan_policy_start(void);
+void uni_bt_scan_policy_stop(void);
+// A new device appeared, or the user requested a scan. Ramps up the scan.
+void uni_bt_scan_policy_on_activity(void);
+uni_bt_scan_level_t uni_bt_scan_policy_get_level(void);
+// Stops the scan temporarily, without changing whether scanning is enabled. E.g: while paging.
+void uni_bt_scan_policy_set_hold(bool hold);
+
+// Can be called from any thread. The BTstack thread applies them.
+void uni_bt_scan_policy_set_policy(uni_bt_scan_policy_t policy);
+uni_bt_scan_policy_t uni_bt_scan_policy_get_policy(void);
+// Seconds without new devices before backing off.
+void uni_bt_scan_policy_set_idle_timeout(int seconds);
+int uni_bt_scan_policy_get_idle_timeout(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_SCAN_POLICY_H
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_BT_SCHED_H
+#define UNI_BT_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "uni_hid_device.h"
+
+// Connection-setup scheduler.
+// Setup steps that use a shared resource (like the SDP client) are queued here,
+// and executed once the resources they need are free.
+// Steps that don't conflict run concurrently.
+// When several steps are waiting, the one from the device closest to "ready" runs first.
+
+// Resources, used as a bitmask.
+typedef enum {
+    // BTstack SDP client: supports only one query at a time.
+    UNI_BT_SCHED_RESOURCE_SDP = 1 << 0,
+    // Outgoing page: remote-name request or ACL connection to a device that is not connected yet.
+    UNI_BT_SCHED_RESOURCE_PAGE = 1 << 1,
+} uni_bt_sched_resource_t;
+
+typedef void (*uni_bt_sched_step_t)(uni_hid_device_t* d);
+
+// Runs "step" once all the "resources" are available. It could be called immediately, if nobody else is waiting.
+// A device can have only one pending step. The resources are held until released.
+void uni_bt_sched_request(uni_hid_device_t* d, uint8_t resources, uni_bt_sched_step_t step);
+// Releases the resources held by the device. Resources held by other devices are ignored.
+void uni_bt_sched_release(uni_hid_device_t* d, uint8_t resources);
+// Cancels the pending step, and releases the resources held by the device.
+void uni_bt_sched_on_device_deleted(uni_hid_device_t* d);
+void uni_bt_sched_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // UNI_BT_SCHED_H
@@ -15,6 +15,8 @@ void uni_bt_sdp_query_start(uni_hid_device_t* d);
 void uni_bt_sdp_query_end(uni_hid_device_t* d);
 void uni_bt_sdp_query_start_vid_pid(uni_hid_device_t* d);
 void uni_bt_sdp_query_start_hid_descriptor(uni_hid_device_t* d);
+// Forgets the query of the device. BTstack still finishes it, and its events are ignored.
+void uni_bt_sdp_on_device_deleted(uni_hid_device_t* d);
 
 void uni_bt_sdp_server_init(void);
 
@@ -22,6 +22,7 @@ void uni_bt_service_set_enabled(bool enabled);
 void uni_bt_service_on_device_ready(const uni_hid_device_t* d);
 void uni_bt_service_on_device_connected(const uni_hid_device_t* d);
 void uni_bt_service_on_device_disconnected(const uni_hid_device_t* d);
+void uni_bt_service_on_controller_data(const uni_hid_device_t* d, const uni_controller_t* ctl);
 
 #ifdef __cplusplus
 }
@@ -9,6 +9,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "uni_common.h"
@@ -16,8 +17,12 @@ extern "C" {
 // Array of pressed keys. Hardcode it at 10.
 // We expect that keyboards won't support more than 10 press keys at the same time,
 // since we have a max of 10 fingers.
+// Kept for compatibility. Use the "keys" bitmap instead: it supports any number of pressed keys.
 #define UNI_KEYBOARD_PRESSED_KEYS_MAX 10
 
+// One bit per HID usage of the Keyboard/Keypad page: 256 bits.
+#define UNI_KEYBOARD_BITMAP_WORDS (256 / 32)
+
 // Instead of using the HID_USAGE values, we use a special field for them.
 // Easier to parse.
 enum {
@@ -37,8 +42,29 @@ typedef struct {
     uint8_t pressed_keys[UNI_KEYBOARD_PRESSED_KEYS_MAX];
     // Reserved for future use, like "Consumer page": eject, play, pause keyboard buttons.
     uint8_t reserved[16];
+
+    // Bitmap of the pressed keys. Bit N is the key with HID usage N. Modifiers included (0xe0-0xe7).
+    uint32_t keys[UNI_KEYBOARD_BITMAP_WORDS];
+    // Keys that were pressed / released since the previous report.
+    uint32_t keys_pressed[UNI_KEYBOARD_BITMAP_WORDS];
+    uint32_t keys_released[UNI_KEYBOARD_BITMAP_WORDS];
 } uni_keyboard_t;
 
+// Whether the key is being held down.
+static inline bool uni_keyboard_is_key_down(const uni_keyboard_t* kb, uint8_t usage) {
+    return (kb->keys[usage / 32] >> (usage % 32)) & 1;
+}
+
+// Whether the key was pressed in this report. Only true once per press.
+static inline bool uni_keyboard_was_key_pressed(const uni_keyboard_t* kb, uint8_t usage) {
+    return (kb->keys_pressed[usage / 32] >> (usage % 32)) & 1;
+}
+
+// Whether the key was released in this report.
+static inline bool uni_keyboard_was_key_released(const uni_keyboard_t* kb, uint8_t usage) {
+    return (kb->keys_released[usage / 32] >> (usage % 32)) & 1;
+}
+
 void uni_keyboard_dump(const uni_keyboard_t* kb);
 
 #ifdef __cplusplus
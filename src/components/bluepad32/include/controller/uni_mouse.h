@@ -34,8 +34,30 @@ typedef struct {
     uint8_t misc_buttons;
 } uni_mouse_t;
 
+// Accumulates mouse reports between reads.
+// Useful for consumers that poll the mouse state slower than the mouse reports it (e.g: NINA host
+// polling at 60Hz a 1000Hz mouse). Each consumer should have one per device.
+// - Deltas are added, and saturated.
+// - Buttons pressed since the last read are latched. A button that was pressed and released
+//   between two reads is reported as pressed in the first read, and released in the next one.
+// Not thread-safe. Callers must protect it if "add" and "read" are called from different tasks.
+typedef struct {
+    int32_t delta_x;
+    int32_t delta_y;
+    int8_t scroll_wheel;
+    uint16_t buttons;          // Current buttons
+    uint16_t buttons_latched;  // Buttons pressed since last read
+    uint8_t misc_buttons;
+    uint8_t misc_buttons_latched;
+} uni_mouse_accum_t;
+
 void uni_mouse_dump(const uni_mouse_t* ms);
 
+void uni_mouse_accum_reset(uni_mouse_accum_t* acc);
+void uni_mouse_accum_add(uni_mouse_accum_t* acc, const uni_mouse_t* ms);
+// Fills "out" with the accumulated values, and resets the accumulator.
+void uni_mouse_accum_read(uni_mouse_accum_t* acc, uni_mouse_t* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,6 +58,10 @@ struct uni_platform {
     // To accept it return UNI_ERROR_SUCCESS.
     uni_error_t (*on_device_ready)(uni_hid_device_t* d);
 
+    // Number of seats (e.g: joystick ports) that can still take a controller. Optional.
+    // Scanning stops when there are no free seats. If NULL, each free device slot is a seat.
+    int (*get_free_seats)(void);
+
     // Indicates that a gamepad button and/or stick was pressed and/or released.
     // Deprecated. Use on_controller_data instead
     void (*on_gamepad_data)(uni_hid_device_t* d, uni_gamepad_t* gp);
@@ -11,6 +11,7 @@
 
 #include "controller/uni_controller.h"
 #include "platform/uni_platform.h"
+#include "uni_gpio_port.h"
 #include "uni_hid_device.h"
 
 // How many Balance Board entries to store
@@ -31,6 +32,9 @@ typedef enum {
     UNI_PLATFORM_UNIJOYSTICLE_CMD_SET_C64_POT_MODE_RUMBLE,    // C64 can enable rumble via Pots
     UNI_PLATFORM_UNIJOYSTICLE_CMD_SET_C64_POT_MODE_PADDLE,    // Use for paddle
 
+    UNI_PLATFORM_UNIJOYSTICLE_CMD_LOAD_JOYSTICK_PROFILES,  // Applies the stored joystick profiles
+    UNI_PLATFORM_UNIJOYSTICLE_CMD_GET_JOYSTICK_PROFILES,
+
     UNI_PLATFORM_UNIJOYSTICLE_CMD_COUNT,
 } uni_platform_unijoysticle_cmd_t;
 
@@ -171,5 +175,8 @@ void uni_platform_unijoysticle_run_cmd(uni_platform_unijoysticle_cmd_t cmd);
 void uni_platform_unijoysticle_on_push_button_mode_pressed(int button_idx);
 void uni_platform_unijoysticle_on_push_button_swap_pressed(int button_idx);
 uni_platform_unijoysticle_instance_t* uni_platform_unijoysticle_get_instance(const uni_hid_device_t* d);
+// Joystick port lines of the seat. Line N is UNI_PLATFORM_UNIJOYSTICLE_JOY_N.
+// Lines must be written through it, so that they are not overwritten by stale values.
+uni_gpio_port_t* uni_platform_unijoysticle_get_port(uni_gamepad_seat_t seat);
 
 #endif  // UNI_PLATFORM_UNIJOYSTICLE_H
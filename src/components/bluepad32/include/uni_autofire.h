@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_AUTOFIRE_H
+#define UNI_AUTOFIRE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "uni_gpio_port.h"
+
+// Timer-driven autofire.
+// Each channel toggles one line of a GPIO port with its own rate and duty cycle.
+// The edges are scheduled from the time the channel was started, so they don't drift, and the first
+// "press" happens as soon as the channel is started.
+// No timer is armed while a channel is stopped.
+//
+// Paced by uni_rt_timer (microsecond resolution) in all the archs.
+
+#define UNI_AUTOFIRE_MAX_CHANNELS 6
+
+// Clicks per second. One click is one press + one release.
+#define UNI_AUTOFIRE_CPS_MIN 1
+#define UNI_AUTOFIRE_CPS_MAX 100
+// Percentage of the period that the line is "pressed".
+#define UNI_AUTOFIRE_DUTY_MIN 10
+#define UNI_AUTOFIRE_DUTY_MAX 90
+
+void uni_autofire_init(void);
+// Returns the channel, or -1 if there are no free channels. "line" is the index of the line in the port.
+int uni_autofire_add_channel(uni_gpio_port_t* port, int line);
+// Takes effect on the next period.
+void uni_autofire_set_rate(int ch, uint8_t cps, uint8_t duty);
+void uni_autofire_get_rate(int ch, uint8_t* cps, uint8_t* duty);
+// Presses the line, and keeps toggling it until stopped. No-op if it is already running.
+void uni_autofire_start(int ch);
+// Releases the line. No-op if it is not running.
+void uni_autofire_stop(int ch);
+bool uni_autofire_is_running(int ch);
+void uni_autofire_dump(void);
+
+#endif  // UNI_AUTOFIRE_H
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_CD32_H
+#define UNI_CD32_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Amiga CD32 pad protocol: the Amiga pulls the mode line (pin 5) low, and reads the buttons on pin 9,
+// one bit per clock (pin 6) rising edge. 7 buttons plus 2 ID bits: released, then pressed.
+//
+// The whole output sequence is computed when the mode line falls, so that each clock edge
+// only has to shift it and write one level.
+
+// 7 buttons + 2 ID bits.
+#define UNI_CD32_BITS 9
+
+// Output levels, LSB first, for the given buttons (bit N clear means button N pressed).
+// Level 1 means "pressed": there is an inverter between the pad and the Amiga.
+static inline uint32_t uni_cd32_get_sequence(uint8_t buttons) {
+    // Bit 7: ID "released". Bit 8: ID "pressed".
+    return (~buttons & 0x7fu) | (1u << 8);
+}
+
+// Returns the level of the current bit, and moves to the next one.
+// Once the sequence is over, it keeps returning "pressed", like the original pad.
+static inline bool uni_cd32_shift(uint32_t* sequence) {
+    bool level = *sequence & 1;
+
+    *sequence = (*sequence >> 1) | (1u << 8);
+    return level;
+}
+
+// Host-side model of the Amiga reading the pad, to check the timing margins.
+typedef struct {
+    // From the mode / clock edge until the new level is on the line. Worst case.
+    uint32_t latency_ns;
+    // Between clock rising edges.
+    uint32_t clock_period_ns;
+    // The Amiga samples the line this long after the mode / clock edge.
+    uint32_t sample_ns;
+} uni_cd32_sim_timing_t;
+
+// Simulates a read of the 9 bits: "read" gets the levels as the Amiga sees them.
+// Returns the worst margin in nanoseconds: setup (level written before being sampled) or hold (not replaced before
+// being sampled). Negative means that at least one bit was read wrong.
+int32_t uni_cd32_sim_read(uint8_t buttons, const uni_cd32_sim_timing_t* timing, uint16_t* read);
+
+#endif  // UNI_CD32_H
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_GPIO_HAL_H
+#define UNI_GPIO_HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_TARGET_POSIX
+#include <stdio.h>
+#endif  // CONFIG_TARGET_POSIX
+
+// Interface
+// Each arch needs to implement these functions
+//
+// ESP32 drives the real GPIOs. Posix and Pico W keep the levels in a simulated register.
+// Posix also records every change, with its timestamp, so that the waveforms can be checked off-target.
+// And in Linux, it can drive the lines of a GPIO chip as well, using the GPIO character device (v2 API).
+// The waveforms are timed with uni_rt_timer.h, which each arch implements as well.
+
+// Max GPIOs. Bit N of the masks is GPIO N.
+#define UNI_GPIO_HAL_MAX_GPIOS 64
+
+// Returns 0 on success. GPIO -1 is ignored.
+int uni_gpio_hal_set_level(int gpio, bool level);
+bool uni_gpio_hal_get_level(int gpio);
+// GPIOs in "set" go high and the ones in "clear" go low, at once when the arch supports it.
+void uni_gpio_hal_write_mask(uint64_t set, uint64_t clear);
+
+#ifdef CONFIG_TARGET_POSIX
+// Max recorded changes. Recording stops when full.
+#define UNI_GPIO_HAL_TRACE_MAX_EVENTS 8192
+
+// Discards the recorded changes, and starts recording again.
+void uni_gpio_hal_trace_reset(void);
+int uni_gpio_hal_trace_get_count(void);
+// Writes the recorded changes in VCD format (Value Change Dump), for GTKWave, sigrok, etc.
+void uni_gpio_hal_trace_write_vcd(FILE* f);
+
+// Drives the lines of a GPIO chip, like "/dev/gpiochip0". GPIO N is line offset N of the chip.
+// Bit N of "lines" requests line N as an output. All of them are part of the same line request, so
+// the lines changed by uni_gpio_hal_write_mask() are updated with a single ioctl.
+// The lines start with the levels of the simulated register, which keeps being updated.
+// Returns 0 on success. Only supported in Linux.
+int uni_gpio_hal_chardev_open(const char* path, uint64_t lines);
+// Releases the lines.
+void uni_gpio_hal_chardev_close(void);
+#endif  // CONFIG_TARGET_POSIX
+
+#endif  // UNI_GPIO_HAL_H
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_GPIO_PORT_H
+#define UNI_GPIO_PORT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// A port is a group of output lines (GPIOs) that are updated together, like the pins of a joystick port.
+// The new levels are compared with the last written ones, and only the lines that changed are written.
+// All of them at once, using uni_gpio_hal_write_mask(), so that the lines change at the same time.
+//
+// Lines can be written from different tasks, as long as each line has only one writer at a time.
+// A line written outside this API must be invalidated, otherwise the next update might be skipped.
+
+#define UNI_GPIO_PORT_MAX_LINES 8
+
+typedef struct {
+    // GPIO of each line. -1 if not connected.
+    int8_t gpios[UNI_GPIO_PORT_MAX_LINES];
+    uint8_t count;
+
+    // Last written levels: bit N is line N.
+    atomic_uint levels;
+    // Lines that must be written in the next update, even if they didn't change.
+    atomic_uint dirty;
+
+    // Stats
+    atomic_uint updates;
+    atomic_uint suppressed;
+} uni_gpio_port_t;
+
+// The lines are marked as dirty: the first update writes all of them.
+void uni_gpio_port_init(uni_gpio_port_t* port);
+// Returns the index of the line, or -1 if the port is full.
+int uni_gpio_port_add_line(uni_gpio_port_t* port, int gpio);
+// Sets the lines in "mask" to "levels", one bit per line.
+void uni_gpio_port_write(uni_gpio_port_t* port, uint32_t levels, uint32_t mask);
+// Lines in "mask" were written outside this API.
+void uni_gpio_port_invalidate(uni_gpio_port_t* port, uint32_t mask);
+uint32_t uni_gpio_port_get_levels(uni_gpio_port_t* port);
+void uni_gpio_port_dump(uni_gpio_port_t* port, const char* name);
+
+#endif  // UNI_GPIO_PORT_H
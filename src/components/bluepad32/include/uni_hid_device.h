@@ -40,8 +40,16 @@ struct uni_hid_device_s {
 
     // Will abort connection if the connection was not established after timeout.
     btstack_timer_source_t connection_timer;
+    // When the connection timeout expires. Used to pause/resume it.
+    uint32_t connection_deadline_ms;
+    // Remaining time while paused, or 0 if not paused.
+    uint32_t connection_remaining_ms;
     // Max amount of time to wait to get the device name.
     btstack_timer_source_t inquiry_remote_name_timer;
+    // Deadline of the current setup stage, or delay before retrying it.
+    btstack_timer_source_t setup_timer;
+    // Stage to retry when "setup_timer" fires. uni_bt_conn_stage_t
+    uint8_t setup_retry_stage;
 
     // SDP
     uint8_t hid_descriptor[HID_MAX_DESCRIPTOR_LEN];
@@ -136,6 +144,12 @@ void uni_hid_device_on_connected(uni_hid_device_t* d, bool connected);
 void uni_hid_device_connect(uni_hid_device_t* d);
 void uni_hid_device_disconnect(uni_hid_device_t* d);
 void uni_hid_device_delete(uni_hid_device_t* d);
+// Time that the device waits for others, like in the setup scheduler, doesn't count towards the connection timeout.
+void uni_hid_device_pause_connection_timeout(uni_hid_device_t* d);
+void uni_hid_device_resume_connection_timeout(uni_hid_device_t* d);
+// Timer used for the deadline of the current setup stage, or to retry it. See uni_bt_conn_policy.h
+void uni_hid_device_start_setup_timer(uni_hid_device_t* d, uint32_t ms, void (*handler)(btstack_timer_source_t* ts));
+void uni_hid_device_stop_setup_timer(uni_hid_device_t* d);
 
 void uni_hid_device_set_cod(uni_hid_device_t* d, uint32_t cod);
 bool uni_hid_device_is_cod_supported(uint32_t cod);
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_JOYSTICK_PROFILE_H
+#define UNI_JOYSTICK_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "controller/uni_gamepad.h"
+#include "uni_joystick.h"
+
+// Gamepad to joystick conversion profiles.
+// A profile is a list of rules like "button A sets fire", or "axis X below -128 sets left".
+// The rules are compiled into one mask per joystick line, plus one threshold per axis, so converting a report
+// costs the same regardless of how many rules the profile has.
+//
+// The "normal", "normal with two buttons" and "twin stick" modes are built-in profiles.
+// Custom profiles can be added at runtime from a text description, like:
+//   "a:fire,b:up,x:button2,dpad_up:up,x-:left,x+:right,ry-@200:j2.up"
+// Each rule is "<source>:<line>". Sources:
+//   - buttons: a, b, x, y, shoulder_l, shoulder_r, trigger_l, trigger_r, thumb_l, thumb_r
+//   - misc buttons: system, select, start, capture
+//   - dpad: dpad_up, dpad_down, dpad_right, dpad_left
+//   - axes: x, y, rx, ry, brake, throttle. Followed by "-" or "+", and optionally "@<threshold>"
+// Lines: up, down, left, right, fire, button2, button3, auto_fire. With the "j2." prefix for the 2nd joystick.
+
+#define UNI_JOYSTICK_PROFILE_MAX_RULES 32
+#define UNI_JOYSTICK_PROFILE_MAX_CUSTOM 4
+#define UNI_JOYSTICK_PROFILE_NAME_LEN 16
+// A profile controls up to two joysticks: twin stick.
+#define UNI_JOYSTICK_PROFILE_MAX_JOYS 2
+
+typedef enum {
+    UNI_JOYSTICK_PROFILE_SINGLE,              // One gamepad controls one joystick. Button B is "up".
+    UNI_JOYSTICK_PROFILE_SINGLE_TWO_BUTTONS,  // Same, but button B is the 2nd button, like MSX.
+    UNI_JOYSTICK_PROFILE_TWINSTICK,           // One gamepad controls two joysticks.
+
+    UNI_JOYSTICK_PROFILE_BUILTIN_COUNT,
+} uni_joystick_profile_builtin_t;
+
+typedef enum {
+    UNI_JOYSTICK_PROFILE_SOURCE_BUTTON,       // Bit of "buttons"
+    UNI_JOYSTICK_PROFILE_SOURCE_MISC_BUTTON,  // Bit of "misc_buttons"
+    UNI_JOYSTICK_PROFILE_SOURCE_DPAD,         // Bit of "dpad"
+    UNI_JOYSTICK_PROFILE_SOURCE_AXIS_NEG,     // Axis below -threshold
+    UNI_JOYSTICK_PROFILE_SOURCE_AXIS_POS,     // Axis above threshold
+} uni_joystick_profile_source_t;
+
+// Brake and throttle are handled like any other axis.
+typedef enum {
+    UNI_JOYSTICK_PROFILE_AXIS_X,
+    UNI_JOYSTICK_PROFILE_AXIS_Y,
+    UNI_JOYSTICK_PROFILE_AXIS_RX,
+    UNI_JOYSTICK_PROFILE_AXIS_RY,
+    UNI_JOYSTICK_PROFILE_AXIS_BRAKE,
+    UNI_JOYSTICK_PROFILE_AXIS_THROTTLE,
+
+    UNI_JOYSTICK_PROFILE_AXIS_COUNT,
+} uni_joystick_profile_axis_t;
+
+// Lines of uni_joystick_t.
+typedef enum {
+    UNI_JOYSTICK_PROFILE_LINE_UP,
+    UNI_JOYSTICK_PROFILE_LINE_DOWN,
+    UNI_JOYSTICK_PROFILE_LINE_LEFT,
+    UNI_JOYSTICK_PROFILE_LINE_RIGHT,
+    UNI_JOYSTICK_PROFILE_LINE_FIRE,
+    UNI_JOYSTICK_PROFILE_LINE_BUTTON2,
+    UNI_JOYSTICK_PROFILE_LINE_BUTTON3,
+    UNI_JOYSTICK_PROFILE_LINE_AUTO_FIRE,
+
+    UNI_JOYSTICK_PROFILE_LINE_COUNT,
+} uni_joystick_profile_line_t;
+
+typedef struct {
+    uint8_t source;  // uni_joystick_profile_source_t
+    // Button, misc button or dpad mapping (e.g: UNI_GAMEPAD_MAPPINGS_BUTTON_A), or uni_joystick_profile_axis_t.
+    uint8_t index;
+    // 0: 1st joystick, 1: 2nd joystick.
+    uint8_t joy;
+    uint8_t line;  // uni_joystick_profile_line_t
+    // Only used by axes. 0 means AXIS_THRESHOLD.
+    int16_t threshold;
+} uni_joystick_profile_rule_t;
+
+// Compiled profile.
+typedef struct {
+    char name[UNI_JOYSTICK_PROFILE_NAME_LEN];
+    // Number of joysticks that the profile controls.
+    uint8_t joys;
+
+    // Sources that set each line.
+    uint16_t buttons[UNI_JOYSTICK_PROFILE_MAX_JOYS][UNI_JOYSTICK_PROFILE_LINE_COUNT];
+    uint8_t misc_buttons[UNI_JOYSTICK_PROFILE_MAX_JOYS][UNI_JOYSTICK_PROFILE_LINE_COUNT];
+    uint8_t dpad[UNI_JOYSTICK_PROFILE_MAX_JOYS][UNI_JOYSTICK_PROFILE_LINE_COUNT];
+
+    // Per axis, negative and positive directions. Lines: bit (joy * UNI_JOYSTICK_PROFILE_LINE_COUNT + line).
+    // Directions without lines are not evaluated.
+    int16_t axis_thresholds[UNI_JOYSTICK_PROFILE_AXIS_COUNT][2];
+    uint16_t axis_lines[UNI_JOYSTICK_PROFILE_AXIS_COUNT][2];
+} uni_joystick_profile_t;
+
+// Compiles the built-in profiles.
+void uni_joystick_profile_init(void);
+
+// Returns 0 on success.
+int uni_joystick_profile_compile(uni_joystick_profile_t* profile,
+                                 const char* name,
+                                 const uni_joystick_profile_rule_t* rules,
+                                 int count);
+// Parses a text description. Returns the number of rules, or -1 on error.
+int uni_joystick_profile_parse(const char* text, uni_joystick_profile_rule_t* rules, int max);
+
+// Sets the lines of the joysticks. Lines are OR-ed: out_joy1 / out_joy2 should be cleared by the caller.
+// out_joy2 can be NULL: lines of the 2nd joystick are ignored.
+void uni_joystick_profile_apply(const uni_joystick_profile_t* profile,
+                                const uni_gamepad_t* gp,
+                                uni_joystick_t* out_joy1,
+                                uni_joystick_t* out_joy2);
+
+const uni_joystick_profile_t* uni_joystick_profile_get_builtin(uni_joystick_profile_builtin_t idx);
+// Built-in profiles are never modified: safe to call from any task.
+bool uni_joystick_profile_is_builtin(const char* name);
+// Built-in or custom. Returns NULL if not found.
+const uni_joystick_profile_t* uni_joystick_profile_find(const char* name);
+// Adds a custom profile from a text description, or replaces the one with the same name.
+// Returns 0 on success.
+// Custom profiles are not thread-safe: should be called from the task that applies the profiles.
+int uni_joystick_profile_add_custom(const char* name, const char* text);
+// Same, but from parsed rules.
+int uni_joystick_profile_add_custom_rules(const char* name, const uni_joystick_profile_rule_t* rules, int count);
+
+void uni_joystick_profile_dump(const uni_joystick_profile_t* profile);
+void uni_joystick_profile_dump_all(void);
+
+#endif  // UNI_JOYSTICK_PROFILE_H
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_POT_TIMING_H
+#define UNI_POT_TIMING_H
+
+#include <stdint.h>
+
+// Timing of the emulated C64 paddles (SID POT lines).
+//
+// The SID measures a pot every 512 cycles: during the first 256 it discharges the capacitor, and during the
+// next 256 it counts the cycles until the line reaches the threshold. The emulator pulls the lines "high" when the
+// measurement starts (sync edge), and releases each one when its value must be read.
+//
+// Times are in timer ticks from the sync edge, so that they can be loaded in a hardware timer as is.
+// Pure functions, so that the produced pulses can be checked on the host as well.
+
+// SID cycle, in nanoseconds. PAL: 985248 Hz. NTSC (1022727 Hz) reads ~3% lower.
+#define UNI_POT_TIMING_CYCLE_NS 1015
+#define UNI_POT_TIMING_DISCHARGE_CYCLES 256
+
+enum {
+    UNI_POT_TIMING_LINE_X,
+    UNI_POT_TIMING_LINE_Y,
+    UNI_POT_TIMING_LINE_MAX,
+};
+
+typedef struct {
+    // Lines in release order.
+    uint8_t lines[UNI_POT_TIMING_LINE_MAX];
+    // Ticks from the sync edge.
+    uint32_t ticks[UNI_POT_TIMING_LINE_MAX];
+} uni_pot_timing_schedule_t;
+
+// Computes when each line must be released so that the SID reads "x" and "y".
+void uni_pot_timing_compute(uint8_t x, uint8_t y, uint32_t ticks_per_us, uni_pot_timing_schedule_t* out);
+// Model of the SID: value read for a line released "ticks" after the sync edge.
+uint8_t uni_pot_timing_read(uint32_t ticks, uint32_t ticks_per_us);
+
+#endif  // UNI_POT_TIMING_H
@@ -14,18 +14,22 @@
 // Keep them sorted
 #define UNI_PROPERTY_NAME_ALLOWLIST_ENABLED "bp.bt.allow_en"
 #define UNI_PROPERTY_NAME_ALLOWLIST_LIST "bp.bt.allowlist"
+#define UNI_PROPERTY_NAME_ALLOWLIST_RULES "bp.bt.allow_rl"
 #define UNI_PROPERTY_NAME_BLE_ENABLED "bp.ble.enabled"
+#define UNI_PROPERTY_NAME_BT_RECONNECT_HINTS "bp.bt.reconn"
 #define UNI_PROPERTY_NAME_GAP_INQ_LEN "bp.gap.inq_len"
 #define UNI_PROPERTY_NAME_GAP_LEVEL "bp.gap.level"
 #define UNI_PROPERTY_NAME_GAP_MAX_PERIODIC_LEN "bp.gap.max_len"
 #define UNI_PROPERTY_NAME_GAP_MIN_PERIODIC_LEN "bp.gap.min_len"
 #define UNI_PROPERTY_NAME_MOUSE_SCALE "bp.mouse.scale"
+#define UNI_PROPERTY_NAME_SCAN_IDLE_TIMEOUT "bp.scan.idle_s"
+#define UNI_PROPERTY_NAME_SCAN_POLICY "bp.scan.policy"
 #define UNI_PROPERTY_NAME_VERSION "bp.version"
 #define UNI_PROPERTY_NAME_VIRTUAL_DEVICE_ENABLED "bp.virt_dev_en"
 
 typedef enum {
     UNI_PROPERTY_IDX_ALLOWLIST_ENABLED,
-    UNI_PROPERTY_IDX_ALLOWLIST_LIST,
+    UNI_PROPERTY_IDX_ALLOWLIST_LIST,  // Legacy, replaced by ALLOWLIST_RULES. Only read to migrate it.
     UNI_PROPERTY_IDX_BLE_ENABLED,
     UNI_PROPERTY_IDX_GAP_INQ_LEN,
     UNI_PROPERTY_IDX_GAP_LEVEL,
@@ -34,15 +38,23 @@ typedef enum {
     UNI_PROPERTY_IDX_MOUSE_SCALE,
     UNI_PROPERTY_IDX_VERSION,
     UNI_PROPERTY_IDX_VIRTUAL_DEVICE_ENABLED,
+    // New properties go here, not sorted: in Pico W and Posix the index is the storage key.
+    UNI_PROPERTY_IDX_SCAN_IDLE_TIMEOUT,
+    UNI_PROPERTY_IDX_SCAN_POLICY,
+    UNI_PROPERTY_IDX_ALLOWLIST_RULES,
+    UNI_PROPERTY_IDX_BT_RECONNECT_HINTS,
     UNI_PROPERTY_IDX_LAST,
 
     // Unijoysticle only properties
     // TODO: Should be moved to the platform file
     // Or could be conditionally compiled.
-    UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS = UNI_PROPERTY_IDX_LAST,
+    UNI_PROPERTY_IDX_UNI_AF_B_CPS = UNI_PROPERTY_IDX_LAST,
+    UNI_PROPERTY_IDX_UNI_AF_DUTY,
+    UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS,
     UNI_PROPERTY_IDX_UNI_BB_FIRE_THRESHOLD,
     UNI_PROPERTY_IDX_UNI_BB_MOVE_THRESHOLD,
     UNI_PROPERTY_IDX_UNI_C64_POT_MODE,
+    UNI_PROPERTY_IDX_UNI_JOYSTICK_PROFILES,
     UNI_PROPERTY_IDX_UNI_MODEL,
     UNI_PROPERTY_IDX_UNI_MOUSE_EMULATION,
     UNI_PROPERTY_IDX_UNI_SERIAL_NUMBER,
@@ -59,6 +71,7 @@ typedef enum {
     UNI_PROPERTY_TYPE_U32,
     UNI_PROPERTY_TYPE_FLOAT,
     UNI_PROPERTY_TYPE_STRING,
+    UNI_PROPERTY_TYPE_BLOB,  // Binary data. Read it with uni_property_get_blob()
 } uni_property_type_t;
 
 typedef union {
@@ -67,6 +80,10 @@ typedef union {
     uint32_t u32;
     float f32;
     const char* str;
+    struct {
+        const void* data;
+        uint16_t size;
+    } blob;
 } uni_property_value_t;
 
 typedef enum {
@@ -83,6 +100,8 @@ typedef struct {
 
 void uni_property_set(uni_property_idx_t idx, uni_property_value_t value);
 uni_property_value_t uni_property_get(uni_property_idx_t idx);
+// Copies the blob into "buf". Returns the number of bytes read, or 0 if not found or if it doesn't fit.
+int uni_property_get_blob(uni_property_idx_t idx, void* buf, int size);
 void uni_property_dump_all(void);
 __attribute__((deprecated("Use `uni_property_dump_all` instead"))) inline void uni_property_list_all(void) {
     uni_property_dump_all();
@@ -96,5 +115,6 @@ const uni_property_t* uni_property_get_property_by_name(const char* name);
 void uni_property_init(void);
 void uni_property_set_with_property(const uni_property_t* p, uni_property_value_t value);
 uni_property_value_t uni_property_get_with_property(const uni_property_t* p);
+int uni_property_get_blob_with_property(const uni_property_t* p, void* buf, int size);
 
 #endif  // UNI_PROPERTY_H
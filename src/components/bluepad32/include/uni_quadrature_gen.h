@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_QUADRATURE_GEN_H
+#define UNI_QUADRATURE_GEN_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+// Quadrature waveform generator: one encoder, two lines (A and B).
+// Each step moves to the next / previous phase of the Gray code (00, 10, 11, 01), so only one line changes
+// per step. The register writes of every transition are precomputed when the GPIOs are assigned, so a step
+// is a table lookup plus a single register write, cheap enough to be done from the timer ISR.
+//
+// ESP32 writes the GPIO set / clear registers directly. Other targets use uni_gpio_hal_set_level().
+// Other targets (Posix, Pico W) also record the emitted waveform, to validate it.
+//
+// Pacing: the steps of each report are spread evenly over the measured report interval, so that they are
+// done by the time the next report arrives. Fractions of a step are carried over to the next report.
+// All of it in fixed point.
+
+// Faster than this, steps are not spread anymore: the backlog grows.
+#define UNI_QUADRATURE_GEN_MIN_STEP_PERIOD_US 25
+// Backlog is capped to what can be emitted in this number of report intervals. Bounds the latency.
+#define UNI_QUADRATURE_GEN_MAX_BACKLOG_INTERVALS 2
+// Report interval used until it is measured. ~100 reports per second.
+#define UNI_QUADRATURE_GEN_DEFAULT_INTERVAL_US 10000
+// Scale factors are in 8.8 fixed point.
+#define UNI_QUADRATURE_GEN_SCALE_ONE 256
+
+#ifndef CONFIG_IDF_TARGET
+// Samples recorded per encoder. Older samples are discarded.
+#define UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES 256
+#endif  // !CONFIG_IDF_TARGET
+
+enum {
+    UNI_QUADRATURE_GEN_DIR_NEG,
+    UNI_QUADRATURE_GEN_DIR_POS,
+    UNI_QUADRATURE_GEN_DIR_MAX,
+};
+
+typedef struct {
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    volatile uint32_t* reg;
+    uint32_t mask;
+#else
+    int8_t gpio;
+    uint8_t level;
+#endif
+} uni_quadrature_gen_write_t;
+
+// Report interval of a mouse.
+typedef struct {
+    int64_t last_report_us;
+    // Smoothed.
+    uint32_t interval_us;
+} uni_quadrature_rate_t;
+
+typedef struct {
+    // Register write needed to enter each phase, for each direction.
+    uni_quadrature_gen_write_t writes[UNI_QUADRATURE_GEN_DIR_MAX][4];
+
+    // Steps not emitted yet. Negative means the other direction.
+    // Added by the producer (add_motion), consumed by the timer ISR (step).
+    atomic_int pending;
+    // Fraction of step, in 1/256 units. Only used by the producer.
+    int32_t remainder;
+
+    // Only used by the ISR.
+    uint8_t phase;
+
+    // Stats
+    uint32_t steps;
+    // Steps discarded because of the backlog cap, or a change of direction.
+    uint32_t dropped;
+
+#ifndef CONFIG_IDF_TARGET
+    // Bit 0: A, bit 1: B.
+    uint8_t sim_samples[UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES];
+    uint32_t sim_count;
+#endif  // !CONFIG_IDF_TARGET
+} uni_quadrature_gen_t;
+
+// Precomputes the register writes for the given GPIOs. Lines start at phase 0 (A=0, B=0).
+void uni_quadrature_gen_init(uni_quadrature_gen_t* gen, int gpio_a, int gpio_b);
+// Adds the motion of a report, scaled by "scale" (8.8 fixed point).
+// Returns the period between steps, in microseconds, so that the backlog is emitted within "interval_us".
+// Returns 0 if there is nothing to emit.
+uint32_t uni_quadrature_gen_add_motion(uni_quadrature_gen_t* gen, int32_t delta, uint32_t scale, uint32_t interval_us);
+// Emits one step, if any is pending. Safe to call from an ISR.
+// Returns false if there was nothing to do.
+bool uni_quadrature_gen_step(uni_quadrature_gen_t* gen);
+
+void uni_quadrature_rate_init(uni_quadrature_rate_t* rate);
+// Should be called on every report. Returns the smoothed report interval, in microseconds.
+uint32_t uni_quadrature_rate_update(uni_quadrature_rate_t* rate, int64_t now_us);
+
+#ifndef CONFIG_IDF_TARGET
+// Copies the last recorded samples, oldest first. Returns the number of samples.
+int uni_quadrature_gen_sim_get_samples(const uni_quadrature_gen_t* gen, uint8_t* out, int max);
+// Checks that only one line changes between consecutive samples.
+// Returns the net position (positive direction minus negative), or INT32_MIN if the waveform is invalid.
+int32_t uni_quadrature_gen_sim_validate(const uint8_t* samples, int count);
+#endif  // !CONFIG_IDF_TARGET
+
+#endif  // UNI_QUADRATURE_GEN_H
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef UNI_RT_TIMER_H
+#define UNI_RT_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#if defined(CONFIG_IDF_TARGET)
+#include <esp_timer.h>
+#elif defined(CONFIG_TARGET_PICO_W)
+#include <pico/time.h>
+#endif
+
+// Interface
+// Each arch needs to implement these functions
+//
+// One-shot timers with microsecond resolution, for the waveforms that BTstack timers are too coarse for:
+// quadrature steps and autofire edges. Together with uni_gpio_hal.h, it is what they need from the arch.
+// Callbacks should be short, and must not block. Where they are called from depends on the arch:
+// - Posix: a single thread, with realtime priority (SCHED_FIFO) when the process is allowed to. Otherwise it
+//   falls back to a normal thread, and the jitter is whatever the scheduler gives.
+// - ESP32: the esp_timer task.
+// - Pico W: the timer IRQ of the default alarm pool.
+
+// Max registered timers.
+#define UNI_RT_TIMER_MAX 16
+// Posix: SCHED_FIFO priority of the timer thread.
+#define UNI_RT_TIMER_PRIORITY 50
+
+typedef void (*uni_rt_timer_callback_t)(void* arg);
+
+typedef struct {
+    uni_rt_timer_callback_t callback;
+    void* arg;
+    // Absolute time, in microseconds. 0 if not armed.
+    int64_t deadline_us;
+#if defined(CONFIG_IDF_TARGET)
+    esp_timer_handle_t handle;
+#elif defined(CONFIG_TARGET_PICO_W)
+    // 0 if not armed.
+    alarm_id_t alarm_id;
+#endif
+} uni_rt_timer_t;
+
+// Registers the timer. In Posix, it starts the timer thread the first time. Returns -1 if there are no free slots.
+int uni_rt_timer_init(uni_rt_timer_t* t, uni_rt_timer_callback_t callback, void* arg);
+// Fires once, "delay_us" from now. Re-arming a timer that is armed replaces its deadline.
+void uni_rt_timer_arm(uni_rt_timer_t* t, int64_t delay_us);
+// Doesn't wait for the callback if it is already running: callers that need it must synchronize with it.
+void uni_rt_timer_disarm(uni_rt_timer_t* t);
+bool uni_rt_timer_is_armed(uni_rt_timer_t* t);
+// Monotonic time, in microseconds. Same clock used by the timers.
+int64_t uni_rt_timer_get_time_us(void);
+// Serializes the callbacks with the code that arms and disarms them from other contexts. Not recursive.
+// Posix and ESP32 use a mutex. Pico W disables the IRQs, since the callbacks run in one.
+void uni_rt_timer_lock(void);
+void uni_rt_timer_unlock(void);
+void uni_rt_timer_dump(void);
+
+#endif  // UNI_RT_TIMER_H
@@ -27,6 +27,7 @@ limitations under the License.
 
 #include <string.h>
 
+#include "bt/uni_bt_profiler.h"
 #include "controller/uni_controller.h"
 #include "hid_usage.h"
 #include "uni_config.h"
@@ -138,7 +139,9 @@ static ds3_instance_t* get_ds3_instance(uni_hid_device_t* d);
 static void ds3_update_led(uni_hid_device_t* d, uint8_t player_leds);
 static void ds3_send_output_report(uni_hid_device_t* d, ds3_output_report_t* out);
 static void on_ds3_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_ds3_set_rumble_on)
 static void on_ds3_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_ds3_set_rumble_off)
 static void ds3_stop_rumble_now(uni_hid_device_t* d);
 static void ds3_play_dual_rumble_now(uni_hid_device_t* d,
                                      uint16_t duration_ms,
@@ -293,7 +296,7 @@ void uni_hid_parser_ds3_play_dual_rumble(struct uni_hid_device_s* d,
         ds3_play_dual_rumble_now(d, duration_ms, weak_magnitude, strong_magnitude);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_ds3_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_ds3_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = DS3_STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -407,7 +410,7 @@ static void ds3_play_dual_rumble_now(uni_hid_device_t* d,
     ds3_send_output_report(d, &out);
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_ds3_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_ds3_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = DS3_STATE_RUMBLE_IN_PROGRESS;
     btstack_run_loop_set_timer(&ins->rumble_timer_duration, duration_ms);
@@ -13,6 +13,7 @@
 #include <assert.h>
 
 #include "bt/uni_bt_defines.h"
+#include "bt/uni_bt_profiler.h"
 #include "uni_config.h"
 #include "uni_hid_device.h"
 #include "uni_log.h"
@@ -234,7 +235,9 @@ static void ds5_request_pairing_info_report(uni_hid_device_t* d);
 static void ds5_request_firmware_version_report(uni_hid_device_t* d);
 static void ds5_request_calibration_report(uni_hid_device_t* d);
 static void on_ds5_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_ds5_set_rumble_on)
 static void on_ds5_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_ds5_set_rumble_off)
 static void ds5_stop_rumble_now(uni_hid_device_t* d);
 static void ds5_play_dual_rumble_now(uni_hid_device_t* d,
                                      uint16_t duration_ms,
@@ -709,7 +712,7 @@ void uni_hid_parser_ds5_play_dual_rumble(struct uni_hid_device_s* d,
         ds5_play_dual_rumble_now(d, duration_ms, weak_magnitude, strong_magnitude);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_ds5_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_ds5_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = DS5_STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -799,7 +802,7 @@ static void ds5_play_dual_rumble_now(uni_hid_device_t* d,
     ds5_send_output_report(d, &out);
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_ds5_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_ds5_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = DS5_STATE_RUMBLE_IN_PROGRESS;
     btstack_run_loop_set_timer(&ins->rumble_timer_duration, duration_ms);
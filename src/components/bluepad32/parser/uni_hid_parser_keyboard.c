@@ -28,6 +28,8 @@ typedef struct {
 
 typedef struct {
     int pressed_key_index;
+    // Keys of the previous report. Used to find the keys that were pressed / released.
+    uint32_t prev_keys[UNI_KEYBOARD_BITMAP_WORDS];
 
     // TODO: JX_05 parser should be moved to its own parser... when the Keyboard parser becomes unmaintainable.
     bool using_jx_05;
@@ -36,13 +38,44 @@ typedef struct {
 
 static keyboard_instance_t* get_keyboard_instance(uni_hid_device_t* d);
 
+static void press_key(uni_hid_device_t* d, uint8_t usage) {
+    keyboard_instance_t* ins = get_keyboard_instance(d);
+    uni_keyboard_t* kb = &d->controller.keyboard;
+    int word = usage / 32;
+    uint32_t bit = BIT(usage % 32);
+
+    // Errors (like "roll over") are not keys. Only added to the array, like before.
+    if (usage > HID_USAGE_KB_ERROR_UNDEFINED) {
+        // Already reported in this report.
+        if (kb->keys[word] & bit)
+            return;
+        kb->keys[word] |= bit;
+        if (!(ins->prev_keys[word] & bit))
+            kb->keys_pressed[word] |= bit;
+        kb->keys_released[word] &= ~bit;
+    }
+
+    if (usage >= HID_USAGE_KB_LEFT_CONTROL && usage <= HID_USAGE_KB_RIGHT_GUI) {
+        // Value is between 0xe0 and 0xe7: the modifiers
+        // Modifier is between 0 - 7
+        kb->modifiers |= BIT(usage - HID_USAGE_KB_LEFT_CONTROL);
+        return;
+    }
+
+    if (ins->pressed_key_index >= UNI_KEYBOARD_PRESSED_KEYS_MAX) {
+        // Not lost: it is in the bitmap.
+        logd("Keyboard: pressed_keys is full, key %#x only in bitmap\n", usage);
+        return;
+    }
+    kb->pressed_keys[ins->pressed_key_index++] = usage;
+}
+
 static void jx_05_parse_usage(uni_hid_device_t* d,
                               const hid_globals_t* globals,
                               uint16_t usage_page,
                               uint16_t usage,
                               int32_t value) {
     keyboard_instance_t* ins = get_keyboard_instance(d);
-    int idx = ins->pressed_key_index;
 
     switch (usage_page) {
         case HID_USAGE_PAGE_GENERIC_DESKTOP:
@@ -88,9 +121,9 @@ static void jx_05_parse_usage(uni_hid_device_t* d,
 
                         // Button repeats the first and last (second) report coordinates
                         if (x == -260 && y == 145)
-                            d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_SPACEBAR;
+                            press_key(d, HID_USAGE_KB_SPACEBAR);
                         else
-                            d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_DOWN_ARROW;
+                            press_key(d, HID_USAGE_KB_DOWN_ARROW);
                     }
                     if (ins->jx_05.ready_to_process) {
                         // This is the last usage in the JX05 report.
@@ -102,17 +135,16 @@ static void jx_05_parse_usage(uni_hid_device_t* d,
                         //  x=-48,  y=251  / ... / x=-467, y=251, and tip_switch=false, "scroll right"
                         //  x=-260, y=145  / x=-260, y=145, and tip_switch=false, "button"
                         if (x == -260 && y == -222)
-                            d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_UP_ARROW;
+                            press_key(d, HID_USAGE_KB_UP_ARROW);
                         else if (x == -260 && y == 145)
                             // Could either be "down" or "press". The next packet decides
                             ins->jx_05.is_down_or_button = true;
                         else if (x == -387 && y == 251)
-                            d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_LEFT_ARROW;
+                            press_key(d, HID_USAGE_KB_LEFT_ARROW);
                         else if (x == -48 && y == 251)
-                            d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_RIGHT_ARROW;
+                            press_key(d, HID_USAGE_KB_RIGHT_ARROW);
                         else
                             break;
-                        ins->pressed_key_index = idx;
                         ins->jx_05.ready_to_process = false;
                     }
                     break;
@@ -151,8 +183,14 @@ void uni_hid_parser_keyboard_init_report(uni_hid_device_t* d) {
 
     // Reset old state. Each report contains a full-state.
     uni_controller_t* ctl = &d->controller;
+    if (ctl->klass == UNI_CONTROLLER_CLASS_KEYBOARD)
+        memcpy(ins->prev_keys, ctl->keyboard.keys, sizeof(ins->prev_keys));
+    else
+        memset(ins->prev_keys, 0, sizeof(ins->prev_keys));
     memset(ctl, 0, sizeof(*ctl));
     ctl->klass = UNI_CONTROLLER_CLASS_KEYBOARD;
+    // Until they are found in this report.
+    memcpy(ctl->keyboard.keys_released, ins->prev_keys, sizeof(ins->prev_keys));
 }
 
 void uni_hid_parser_keyboard_parse_usage(uni_hid_device_t* d,
@@ -168,25 +206,13 @@ void uni_hid_parser_keyboard_parse_usage(uni_hid_device_t* d,
 
     logd("usage page=%#x, usage=%#x, value=%d\n", usage_page, usage, value);
 
-    int idx = ins->pressed_key_index;
     switch (usage_page) {
         case HID_USAGE_PAGE_KEYBOARD_KEYPAD:
             if (value) {
-                if (usage < HID_USAGE_KB_LEFT_CONTROL) {
-                    if (idx >= UNI_KEYBOARD_PRESSED_KEYS_MAX) {
-                        loge("Keyboard: Reached max keyboard keys, skipping page: %d, usage: %d, value: %d\n",
-                             usage_page, usage, value);
-                        return;
-                    }
-                    // "usage" represents the pressed key.
+                if (usage <= HID_USAGE_KB_RIGHT_GUI) {
+                    // "usage" represents the pressed key, or modifier.
                     // See: USB HID Usage Tables, Section 10 (page 53).
-                    d->controller.keyboard.pressed_keys[idx++] = usage;
-                    ins->pressed_key_index = idx;
-                } else if (usage <= HID_USAGE_KB_RIGHT_GUI) {
-                    // Value is between 0xe0 and 0xe7: the modifiers
-                    // Modifier is between 0 - 7
-                    uint8_t modifier = usage - HID_USAGE_KB_LEFT_CONTROL;
-                    d->controller.keyboard.modifiers |= BIT(modifier);
+                    press_key(d, usage);
                 } else {
                     // Usage >= 0xe8, unsupported value.
                     logi("Keyboard: unsupported page:%d, usage:%d, value:%d\n", usage_page, usage, value);
@@ -206,41 +232,32 @@ void uni_hid_parser_keyboard_parse_usage(uni_hid_device_t* d,
                     break;
                 // Used by "TikTog Ring Controller"
                 case HID_USAGE_POWER:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_POWER;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_POWER);
                     break;
                 case HID_USAGE_VOLUME_UP:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_VOLUME_UP;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_VOLUME_UP);
                     break;
                 case HID_USAGE_VOLUME_DOWN:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_VOLUME_DOWN;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_VOLUME_DOWN);
                     break;
                 case HID_USAGE_AC_HOME:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_HOME;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_HOME);
                     break;
                 case HID_USAGE_AC_SCROLL_UP:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_PAGE_UP;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_PAGE_UP);
                     break;
                 case HID_USAGE_AC_SCROLL_DOWN:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_PAGE_DOWN;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_PAGE_DOWN);
                     break;
                 // Used by "5-button keyboard"
                 case HID_USAGE_SCAN_NEXT_TRACK:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_RIGHT_ARROW;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_RIGHT_ARROW);
                     break;
                 case HID_USAGE_SCAN_PREVIOUS_TRACK:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_LEFT_ARROW;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_LEFT_ARROW);
                     break;
                 case HID_USAGE_PLAY_PAUSE:
-                    d->controller.keyboard.pressed_keys[idx++] = HID_USAGE_KB_PAUSE;
-                    ins->pressed_key_index = idx;
+                    press_key(d, HID_USAGE_KB_PAUSE);
                     break;
                 default:
                     logi("Keyboard: Unsupported page: 0x%04x, usage: 0x%04x, value=0x%x\n", usage_page, usage, value);
@@ -11,6 +11,7 @@
 
 #include <string.h>
 
+#include "bt/uni_bt_profiler.h"
 #include "controller/uni_controller.h"
 #include "hid_usage.h"
 #include "uni_config.h"
@@ -125,7 +126,9 @@ typedef struct __attribute((packed)) {
 static psmove_instance_t* get_psmove_instance(uni_hid_device_t* d);
 static void psmove_send_output_report(uni_hid_device_t* d, psmove_output_report_t* out);
 static void on_psmove_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_psmove_set_rumble_on)
 static void on_psmove_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_psmove_set_rumble_off)
 static void psmove_play_dual_rumble_now(uni_hid_device_t* d, uint16_t duration_ms, uint8_t magnitude);
 
 void uni_hid_parser_psmove_init_report(uni_hid_device_t* d) {
@@ -228,7 +231,7 @@ void uni_hid_parser_psmove_play_dual_rumble(struct uni_hid_device_s* d,
         psmove_play_dual_rumble_now(d, duration_ms, magnitude);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_psmove_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_psmove_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = PSMOVE_STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -328,7 +331,7 @@ static void psmove_play_dual_rumble_now(uni_hid_device_t* d, uint16_t duration_m
     psmove_send_output_report(d, &out);
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_psmove_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_psmove_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = PSMOVE_STATE_RUMBLE_IN_PROGRESS;
     btstack_run_loop_set_timer(&ins->rumble_timer_duration, duration_ms);
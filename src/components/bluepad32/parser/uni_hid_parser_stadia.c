@@ -7,6 +7,7 @@
 
 #include "parser/uni_hid_parser_stadia.h"
 
+#include "bt/uni_bt_profiler.h"
 #include "controller/uni_controller.h"
 #include "uni_hid_device.h"
 #include "uni_log.h"
@@ -41,7 +42,9 @@ _Static_assert(sizeof(stadia_instance_t) < HID_DEVICE_MAX_PARSER_DATA, "Stadia i
 
 static stadia_instance_t* get_stadia_instance(uni_hid_device_t* d);
 static void on_stadia_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_stadia_set_rumble_on)
 static void on_stadia_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_stadia_set_rumble_off)
 static void stadia_stop_rumble_now(uni_hid_device_t* d);
 static void stadia_play_dual_rumble_now(uni_hid_device_t* d,
                                         uint16_t duration_ms,
@@ -87,7 +90,7 @@ void uni_hid_parser_stadia_play_dual_rumble(struct uni_hid_device_s* d,
         stadia_play_dual_rumble_now(d, duration_ms, weak_magnitude, strong_magnitude);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_stadia_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_stadia_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -119,7 +122,7 @@ static void stadia_stop_rumble_now(uni_hid_device_t* d) {
                                            (const uint8_t*)&ff, sizeof(ff));
     if (status == ERROR_CODE_COMMAND_DISALLOWED) {
         logd("Stadia: Failed to turn off rumble, error=%#x, retrying...\n", status);
-        ins->rumble_timer_duration.process = &on_stadia_set_rumble_off;
+        ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_stadia_set_rumble_off);
         ins->rumble_timer_duration.context = d;
         ins->rumble_state = STATE_RUMBLE_IN_PROGRESS;
 
@@ -155,7 +158,7 @@ static void stadia_play_dual_rumble_now(uni_hid_device_t* d,
                                            (const uint8_t*)&ff, sizeof(ff));
     if (status == ERROR_CODE_COMMAND_DISALLOWED) {
         logd("Stadia: Failed to send rumble report, error=%#x, retrying...\n", status);
-        ins->rumble_timer_delayed_start.process = &on_stadia_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_stadia_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = STATE_RUMBLE_DELAYED;
 
@@ -169,7 +172,7 @@ static void stadia_play_dual_rumble_now(uni_hid_device_t* d,
     }
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_stadia_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_stadia_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = STATE_RUMBLE_IN_PROGRESS;
     btstack_run_loop_set_timer(&ins->rumble_timer_duration, duration_ms);
@@ -21,6 +21,7 @@
 #endif  // ENABLE_SPI_FLASH_DUMP
 
 #include "bt/uni_bt_conn.h"
+#include "bt/uni_bt_profiler.h"
 #include "controller/uni_controller.h"
 #include "hid_usage.h"
 #include "uni_common.h"
@@ -336,13 +337,16 @@ static void process_reply_enable_imu(struct uni_hid_device_s* d, const struct sw
 static int32_t calibrate_axis(int32_t v, switch_cal_stick_t cal);
 static void set_led(uni_hid_device_t* d, uint8_t leds);
 static void on_switch_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_switch_set_rumble_on)
 static void on_switch_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_switch_set_rumble_off)
 static void switch_stop_rumble_now(uni_hid_device_t* d);
 static void switch_play_dual_rumble_now(uni_hid_device_t* d,
                                         uint16_t duration_ms,
                                         uint8_t weak_magnitude,
                                         uint8_t strong_magnitude);
 static void switch_setup_timeout_callback(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(switch_setup_timeout_callback)
 static void parse_stick_calibration(switch_cal_stick_t* x, switch_cal_stick_t* y, const uint8_t* data, bool is_left);
 
 void uni_hid_parser_switch_setup(struct uni_hid_device_s* d) {
@@ -423,7 +427,7 @@ static void process_fsm(struct uni_hid_device_s* d) {
         case STATE_SETUP:
             logd("STATE_SETUP\n");
             btstack_run_loop_set_timer_context(&ins->setup_timer, d);
-            btstack_run_loop_set_timer_handler(&ins->setup_timer, &switch_setup_timeout_callback);
+            btstack_run_loop_set_timer_handler(&ins->setup_timer, UNI_BT_PROFILER_TIMER(switch_setup_timeout_callback));
             btstack_run_loop_set_timer(&ins->setup_timer, SWITCH_SETUP_TIMEOUT_MS);
             btstack_run_loop_add_timer(&ins->setup_timer);
 
@@ -1269,7 +1273,7 @@ void uni_hid_parser_switch_play_dual_rumble(struct uni_hid_device_s* d,
         switch_play_dual_rumble_now(d, duration_ms, weak_magnitude, strong_magnitude);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_switch_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_switch_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = SWITCH_STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -1401,7 +1405,7 @@ static void switch_play_dual_rumble_now(uni_hid_device_t* d,
     send_subcmd(d, &req, sizeof(req) - 1);
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_switch_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_switch_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = SWITCH_STATE_RUMBLE_IN_PROGRESS;
     btstack_run_loop_set_timer(&ins->rumble_timer_duration, duration_ms);
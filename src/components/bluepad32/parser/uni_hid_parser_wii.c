@@ -20,6 +20,7 @@
 
 #include "parser/uni_hid_parser_wii.h"
 
+#include "bt/uni_bt_profiler.h"
 #include "controller/uni_controller.h"
 #include "hid_usage.h"
 #include "uni_common.h"
@@ -194,7 +195,9 @@ static void wii_read_mem(uni_hid_device_t* d, wii_read_type_t t, uint32_t offset
 static wii_instance_t* get_wii_instance(uni_hid_device_t* d);
 static void wii_set_led(uni_hid_device_t* d, uni_gamepad_seat_t seat);
 static void on_wii_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_wii_set_rumble_on)
 static void on_wii_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_wii_set_rumble_off)
 static void wii_play_dual_rumble_now(struct uni_hid_device_s* d, uint16_t duration_ms);
 
 // Constants
@@ -1359,7 +1362,7 @@ void uni_hid_parser_wii_play_dual_rumble(struct uni_hid_device_s* d,
         wii_play_dual_rumble_now(d, duration_ms);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_wii_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_wii_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = WII_STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -1459,7 +1462,7 @@ static void wii_play_dual_rumble_now(uni_hid_device_t* d, uint16_t duration_ms)
     uni_hid_device_send_intr_report(d, report, sizeof(report));
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_wii_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_wii_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = WII_STATE_RUMBLE_IN_PROGRESS;
     btstack_run_loop_set_timer(&ins->rumble_timer_duration, duration_ms);
@@ -10,6 +10,7 @@
 
 #include "parser/uni_hid_parser_xboxone.h"
 
+#include "bt/uni_bt_profiler.h"
 #include "controller/uni_controller.h"
 #include "hid_usage.h"
 #include "uni_hid_device.h"
@@ -115,7 +116,9 @@ _Static_assert(sizeof(xboxone_instance_t) < HID_DEVICE_MAX_PARSER_DATA, "Xbox on
 
 static xboxone_instance_t* get_xboxone_instance(uni_hid_device_t* d);
 static void on_xboxone_set_rumble_on(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_xboxone_set_rumble_on)
 static void on_xboxone_set_rumble_off(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(on_xboxone_set_rumble_off)
 static void xboxone_stop_rumble_now(uni_hid_device_t* d);
 static void xboxone_play_quad_rumble_now(uni_hid_device_t* d,
                                          uint16_t duration_ms,
@@ -538,7 +541,7 @@ void xboxone_play_quad_rumble(struct uni_hid_device_s* d,
         xboxone_play_quad_rumble_now(d, duration_ms, trigger_left, trigger_right, weak_magnitude, strong_magnitude);
     } else {
         // Set timer to have a delayed start
-        ins->rumble_timer_delayed_start.process = &on_xboxone_set_rumble_on;
+        ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_xboxone_set_rumble_on);
         ins->rumble_timer_delayed_start.context = d;
         ins->rumble_state = XBOXONE_STATE_RUMBLE_DELAYED;
         ins->rumble_duration_ms = duration_ms;
@@ -576,13 +579,13 @@ static void xboxone_retry_cmd(uni_hid_device_t* d, xboxone_retry_cmd_t cmd) {
 
     switch (cmd) {
         case XBOXONE_RETRY_CMD_RUMBLE_ON:
-            ins->rumble_timer_delayed_start.process = &on_xboxone_set_rumble_on;
+            ins->rumble_timer_delayed_start.process = UNI_BT_PROFILER_TIMER(on_xboxone_set_rumble_on);
             ins->rumble_state = XBOXONE_STATE_RUMBLE_DELAYED;
             btstack_run_loop_set_timer(&ins->rumble_timer_delayed_start, BLE_RETRY_MS);
             btstack_run_loop_add_timer(&ins->rumble_timer_delayed_start);
             break;
         case XBOXONE_RETRY_CMD_RUMBLE_OFF:
-            ins->rumble_timer_duration.process = &on_xboxone_set_rumble_off;
+            ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_xboxone_set_rumble_off);
             ins->rumble_state = XBOXONE_STATE_RUMBLE_IN_PROGRESS;
             btstack_run_loop_set_timer(&ins->rumble_timer_duration, BLE_RETRY_MS);
             btstack_run_loop_add_timer(&ins->rumble_timer_duration);
@@ -692,7 +695,7 @@ static void xboxone_play_quad_rumble_now(uni_hid_device_t* d,
     }
 
     // Set timer to turn off rumble
-    ins->rumble_timer_duration.process = &on_xboxone_set_rumble_off;
+    ins->rumble_timer_duration.process = UNI_BT_PROFILER_TIMER(on_xboxone_set_rumble_off);
     ins->rumble_timer_duration.context = d;
     ins->rumble_state = XBOXONE_STATE_RUMBLE_IN_PROGRESS;
 
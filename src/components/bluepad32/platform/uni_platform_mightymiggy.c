@@ -10,14 +10,17 @@
 #include <freertos/queue.h>
 #include <nvs.h>
 #include <nvs_flash.h>
+#include <soc/gpio_struct.h>
 
 #include "sdkconfig.h"
 
 #include "bt/uni_bt.h"
 #include "controller/uni_controller.h"
 #include "controller/uni_controller_type.h"
+#include "uni_cd32.h"
 #include "uni_common.h"
 #include "uni_config.h"
+#include "uni_gpio_hal.h"
 #include "uni_hid_device.h"
 #include "uni_joystick.h"
 #include "uni_log.h"
@@ -505,13 +508,24 @@ typedef struct RuntimeControllerInfo_s {
      */
     volatile uint8_t buttonsLive;
 
-    /** \brief Button register for CD32 mode currently being shifted out
+    /** \brief Output levels for CD32 mode currently being shifted out
      *
-     * This is where #buttonsLive gets copied when it is sampled.
+     * This is computed from #buttonsLive when it is sampled, see
+     * uni_cd32_get_sequence().
+     */
+    uint32_t isrSequence;
+
+    /** \brief True while the CD32 is reading the buttons
      *
-     * 0 means pressed, etc.
+     * The clock ISR is always installed while CD32 support is enabled, and
+     * does nothing unless this is set.
      */
-    volatile uint8_t isrButtons;
+    volatile bool cd32Shifting;
+
+    //! \brief GPIO set/clear registers and mask of #PIN_NO_B2, for the clock ISR
+    volatile uint32_t* b2SetReg;
+    volatile uint32_t* b2ClearReg;
+    uint32_t b2Mask;
 
     /** \brief Commodore 64 mode
      *
@@ -876,7 +890,7 @@ static void buttonPress(const gpio_num_t pin) {
      * pin, so we must use inverse logic... which, since joystick signals are
      * active-low, means "normal" logic, i.e.: 1 = pressed ;)
      */
-    ESP_ERROR_CHECK(gpio_set_level(pin, 1));
+    ESP_ERROR_CHECK(uni_gpio_hal_set_level(pin, 1));
 }
 
 /** \brief Report a button as released on the DB-9 port
@@ -886,7 +900,7 @@ static void buttonPress(const gpio_num_t pin) {
  * \param[in] pin Pin corresponding to the button to be pressed
  */
 static void buttonRelease(const gpio_num_t pin) {
-    ESP_ERROR_CHECK(gpio_set_level(pin, 0));
+    ESP_ERROR_CHECK(uni_gpio_hal_set_level(pin, 0));
 }
 
 /** \brief Map horizontal movements of the left analog stick to a
@@ -1161,9 +1175,9 @@ static void setSeat(uni_hid_device_t* d, uni_gamepad_seat_t seat) {
  */
 static void flashLed(gpio_num_t pin, int n) {
     for (int i = 0; i < n; ++i) {
-        gpio_set_level(pin, 1);
+        uni_gpio_hal_set_level(pin, 1);
         vTaskDelay(pdMS_TO_TICKS(40));
-        gpio_set_level(pin, 0);
+        uni_gpio_hal_set_level(pin, 0);
         vTaskDelay(pdMS_TO_TICKS(80));
     }
 }
@@ -1482,22 +1496,26 @@ static void handleMouse(const RuntimeControllerInfo* cinfo) {
             if (x > 0) {
                 // Right
                 if (millis() - tx >= period) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_RIGHT], !gpio_get_level(cinfo->mousePins[PIN_NO_RIGHT]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_RIGHT],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_RIGHT]));
                     tx = millis();
                 }
 
                 if (millis() - tx >= period / 2) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_DOWN], !gpio_get_level(cinfo->mousePins[PIN_NO_RIGHT]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_DOWN],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_RIGHT]));
                 }
             } else {
                 // Left
                 if (millis() - tx >= period) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_DOWN], !gpio_get_level(cinfo->mousePins[PIN_NO_DOWN]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_DOWN],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_DOWN]));
                     tx = millis();
                 }
 
                 if (millis() - tx >= period / 2) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_RIGHT], !gpio_get_level(cinfo->mousePins[PIN_NO_DOWN]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_RIGHT],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_DOWN]));
                 }
             }
         }
@@ -1512,22 +1530,26 @@ static void handleMouse(const RuntimeControllerInfo* cinfo) {
             if (y > 0) {
                 // Up
                 if (millis() - ty >= period) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_LEFT], !gpio_get_level(cinfo->mousePins[PIN_NO_LEFT]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_LEFT],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_LEFT]));
                     ty = millis();
                 }
 
                 if (millis() - ty >= period / 2) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_UP], !gpio_get_level(cinfo->mousePins[PIN_NO_LEFT]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_UP],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_LEFT]));
                 }
             } else {
                 // Down
                 if (millis() - ty >= period) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_UP], !gpio_get_level(cinfo->mousePins[PIN_NO_UP]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_UP],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_UP]));
                     ty = millis();
                 }
 
                 if (millis() - ty >= period / 2) {
-                    gpio_set_level(cinfo->mousePins[PIN_NO_LEFT], !gpio_get_level(cinfo->mousePins[PIN_NO_UP]));
+                    uni_gpio_hal_set_level(cinfo->mousePins[PIN_NO_LEFT],
+                                           !uni_gpio_hal_get_level(cinfo->mousePins[PIN_NO_UP]));
                 }
             }
         }
@@ -1832,7 +1854,7 @@ static void gpio_isr_handler_button(void* arg) {
     mmlogd("Button ISR running on core %d\n", xPortGetCoreID());
 
     // Button released?
-    if (gpio_get_level(GPIO_PUSH_BUTTON)) {
+    if (uni_gpio_hal_get_level(GPIO_PUSH_BUTTON)) {
         //~ g_last_time_pressed_us = esp_timer_get_time ();
         mmlogi("SWAP Button released\n");
         return;
@@ -1854,29 +1876,51 @@ static void gpio_isr_handler_button(void* arg) {
 //! \name Interrupt handlers for CD32 mode
 //! @{
 
-/** \brief ISR servicing rising edges on #pins_port[PIN_NO_B1]
+/** \brief Write a level on #PIN_NO_B2 with a single register write
+ *
+ * Registers must have been prepared with prepareB2Registers().
+ */
+static IRAM_ATTR void writeB2(const RuntimeControllerInfo* cinfo, bool level) {
+    *(level ? cinfo->b2SetReg : cinfo->b2ClearReg) = cinfo->b2Mask;
+}
+
+static void prepareB2Registers(RuntimeControllerInfo* cinfo) {
+    gpio_num_t pin = cinfo->joyPins[PIN_NO_B2];
+
+    if (pin < 32) {
+        cinfo->b2SetReg = &GPIO.out_w1ts;
+        cinfo->b2ClearReg = &GPIO.out_w1tc;
+        cinfo->b2Mask = 1U << pin;
+    } else {
+        cinfo->b2SetReg = &GPIO.out1_w1ts.val;
+        cinfo->b2ClearReg = &GPIO.out1_w1tc.val;
+        cinfo->b2Mask = 1U << (pin - 32);
+    }
+}
+
+/** \brief ISR servicing rising edges on #pins_port[PIN_NO_CLOCK]
  *
  * Called on clock pin rising, this function shall shift out next bit.
+ * Installed as long as CD32 support is enabled, so it does nothing unless
+ * the CD32 is reading the buttons.
  */
-static void onClockEdge(void* arg) {
+static IRAM_ATTR void onClockEdge(void* arg) {
     RuntimeControllerInfo* cinfo = (RuntimeControllerInfo*)arg;
 
+    if (!cinfo->cd32Shifting)
+        return;
+
 #ifdef ENABLE_INSTRUMENTATION
-    gpio_set_level(PIN_INTERRUPT_TIMING, 1);
+    uni_gpio_hal_set_level(PIN_INTERRUPT_TIMING, 1);
 #endif
 
-    if (!(cinfo->isrButtons & 0x01)) {
-        gpio_set_level(cinfo->joyPins[PIN_NO_B2], 1);
-    } else {
-        gpio_set_level(cinfo->joyPins[PIN_NO_B2], 0);
-    }
-
-    cinfo->isrButtons >>= 1U; /* Again, non-existing button 10 will be
-                               * reported as pressed for the ID sequence
-                               */
+    /* Non-existing button 10 and beyond will be reported as pressed for the
+     * ID sequence
+     */
+    writeB2(cinfo, uni_cd32_shift(&cinfo->isrSequence));
 
 #ifdef ENABLE_INSTRUMENTATION
-    gpio_set_level(PIN_INTERRUPT_TIMING, 0);
+    uni_gpio_hal_set_level(PIN_INTERRUPT_TIMING, 0);
 #endif
 }
 
@@ -1889,36 +1933,29 @@ static void onClockEdge(void* arg) {
 static void onPadModeChange(void* arg) {
     RuntimeControllerInfo* cinfo = (RuntimeControllerInfo*)arg;
 
-    if (gpio_get_level(cinfo->joyPins[PIN_NO_MODE]) == 0) {
+    if (uni_gpio_hal_get_level(cinfo->joyPins[PIN_NO_MODE]) == 0) {
         // Switch to CD32 mode
 #ifdef ENABLE_INSTRUMENTATION
-        gpio_set_level(PIN_CD32MODE, 0);
+        uni_gpio_hal_set_level(PIN_CD32MODE, 0);
 #endif
+        /* Sample input values, they will be shifted out on subsequent clock
+         * inputs. The ID sequence (button 8 released, 9 pressed) is part of it.
+         */
+        cinfo->isrSequence = uni_cd32_get_sequence(cinfo->buttonsLive);
+
         // Output status of first button as soon as possible
-        if (!(cinfo->buttonsLive & 0x01)) {
-            gpio_set_level(cinfo->joyPins[PIN_NO_B2], 1);
-        } else {
-            gpio_set_level(cinfo->joyPins[PIN_NO_B2], 0);
-        }
+        prepareB2Registers(cinfo);
+        writeB2(cinfo, uni_cd32_shift(&cinfo->isrSequence));
 
         /* Disable output on clock pin. No need to rush here, as when the CD32
          * drives it high, it's doing so open-collector-style as well.
          *
          * Remember there's an inverter between us and the Amiga!
          */
-        gpio_set_level(cinfo->joyPins[PIN_NO_B1], 0);
-
-        /* Sample input values, they will be shifted out on subsequent clock
-         * inputs.
-         *
-         * At this point MSB must be 1 for ID sequence. Then it will be zeroed
-         * by the shift. This will report non-existing buttons 8 as released and
-         * 9 as pressed as required by the ID sequence.
-         */
-        cinfo->isrButtons = cinfo->buttonsLive >> 1U;
+        uni_gpio_hal_set_level(cinfo->joyPins[PIN_NO_B1], 0);
 
-        // Enable interrupt on clock edges
-        ESP_ERROR_CHECK(gpio_isr_handler_add(cinfo->joyPins[PIN_NO_CLOCK], onClockEdge, (void*)cinfo));
+        // Start shifting on clock edges. The ISR is already installed.
+        cinfo->cd32Shifting = true;
 
         // Set state to ST_CD32
         if (cinfo->state != ST_CD32 && cinfo->state != ST_JOYSTICK_TEMP) {
@@ -1927,13 +1964,13 @@ static void onPadModeChange(void* arg) {
         cinfo->stateEnteredTime = 0;
         cinfo->state = ST_CD32;
 #ifdef ENABLE_INSTRUMENTATION
-        gpio_set_level(PIN_CD32MODE, 1);
-        gpio_set_level(PIN_CD32MODE, 0);
+        uni_gpio_hal_set_level(PIN_CD32MODE, 1);
+        uni_gpio_hal_set_level(PIN_CD32MODE, 0);
 #endif
     } else {
 #ifdef ENABLE_INSTRUMENTATION
-        gpio_set_level(PIN_CD32MODE, 1);
-        gpio_set_level(PIN_CD32MODE, 0);
+        uni_gpio_hal_set_level(PIN_CD32MODE, 1);
+        uni_gpio_hal_set_level(PIN_CD32MODE, 0);
 #endif
 
         /* Set pin directions and set levels according to buttons, as waiting
@@ -1952,14 +1989,14 @@ static void onPadModeChange(void* arg) {
             buttonRelease(cinfo->joyPins[PIN_NO_B2]);
         }
 
-        // Disable interrupt on clock edges
-        gpio_isr_handler_remove(cinfo->joyPins[PIN_NO_CLOCK]);
+        // Stop shifting on clock edges
+        cinfo->cd32Shifting = false;
 
         // Set state to ST_JOYSTICK_TEMP
         cinfo->state = ST_JOYSTICK_TEMP;
 
 #ifdef ENABLE_INSTRUMENTATION
-        gpio_set_level(PIN_CD32MODE, 1);
+        uni_gpio_hal_set_level(PIN_CD32MODE, 1);
 #endif
     }
 }
@@ -2013,7 +2050,7 @@ static void updateLeds() {
                 case ST_CD32:
                 case ST_JOYSTICK_TEMP:
                     // Led lit up steadily
-                    gpio_set_level(cinfo->ledPin, 1);
+                    uni_gpio_hal_set_level(cinfo->ledPin, 1);
                     break;
                 case ST_WAIT_SELECT_RELEASE:
                 case ST_WAIT_BUTTON_PRESS:
@@ -2021,15 +2058,15 @@ static void updateLeds() {
                 case ST_WAIT_COMBO_PRESS:
                 case ST_WAIT_COMBO_RELEASE:
                     // Programming mode, blink fast
-                    gpio_set_level(cinfo->ledPin, (millis() / 250) % 2 == 0);
+                    uni_gpio_hal_set_level(cinfo->ledPin, (millis() / 250) % 2 == 0);
                     break;
                 default:
                     // WTF?! Blink fast... er!
-                    gpio_set_level(cinfo->ledPin, (millis() / 100) % 2 == 0);
+                    uni_gpio_hal_set_level(cinfo->ledPin, (millis() / 100) % 2 == 0);
                     break;
             }
         } else {
-            gpio_set_level(pin, 0);
+            uni_gpio_hal_set_level(pin, 0);
         }
     }
 }
@@ -2109,21 +2146,21 @@ static void loopCore1(void* arg) {
 
     // Check for factory reset
     unsigned long startPress = millis();
-    if (gpio_get_level(GPIO_PUSH_BUTTON) == 0) {
+    if (uni_gpio_hal_get_level(GPIO_PUSH_BUTTON) == 0) {
         mmlogi("SWAP button pressed at power-up, starting factory reset\n");
-        while (gpio_get_level(GPIO_PUSH_BUTTON) == 0) {
+        while (uni_gpio_hal_get_level(GPIO_PUSH_BUTTON) == 0) {
             if (millis() - startPress < 3000UL) {
-                gpio_set_level(PIN_LED_P1, (millis() / 333) % 2 == 0);
+                uni_gpio_hal_set_level(PIN_LED_P1, (millis() / 333) % 2 == 0);
             } else if (millis() - startPress < 5000UL) {
-                gpio_set_level(PIN_LED_P1, (millis() / 80) % 2 == 0);
+                uni_gpio_hal_set_level(PIN_LED_P1, (millis() / 80) % 2 == 0);
             } else {
                 // OK, user has convinced us to actually perform the reset
                 mmlogi("Performing factory reset\n");
-                gpio_set_level(PIN_LED_P1, 1);
+                uni_gpio_hal_set_level(PIN_LED_P1, 1);
                 clearConfigurations();
                 saveConfigurations();
                 uni_bt_del_keys_safe();  // Also delete BT keys
-                while (gpio_get_level(GPIO_PUSH_BUTTON) == 0) {
+                while (uni_gpio_hal_get_level(GPIO_PUSH_BUTTON) == 0) {
                     vTaskDelay(10);
                 }
             }
@@ -2157,6 +2194,11 @@ static void loopCore1(void* arg) {
             mmlogi("Enabling CD32 trigger for Seat A on core %d\n", xPortGetCoreID());
             uni_hid_device_t* dev = getControllerForSeat(GAMEPAD_SEAT_A);
             if (dev && (cinfo = getControllerInstance(dev))) {
+                /* The clock ISR stays installed until CD32 support is disabled.
+                 * Adding / removing it from the mode ISR is not allowed.
+                 */
+                cinfo->cd32Shifting = false;
+                ESP_ERROR_CHECK(gpio_isr_handler_add(cinfo->joyPins[PIN_NO_CLOCK], onClockEdge, (void*)cinfo));
                 ESP_ERROR_CHECK(gpio_isr_handler_add(cinfo->joyPins[PIN_NO_MODE], onPadModeChange, (void*)cinfo));
             }
 #endif
@@ -2171,6 +2213,7 @@ static void loopCore1(void* arg) {
                 //~ taskDISABLE_INTERRUPTS ();
                 gpio_isr_handler_remove(cinfo->joyPins[PIN_NO_CLOCK]);
                 gpio_isr_handler_remove(cinfo->joyPins[PIN_NO_MODE]);
+                cinfo->cd32Shifting = false;
                 //~ taskENABLE_INTERRUPTS ();
             }
 #endif
@@ -2181,6 +2224,11 @@ static void loopCore1(void* arg) {
             mmlogi("Enabling CD32 trigger for Seat B on core %d\n", xPortGetCoreID());
             uni_hid_device_t* dev = getControllerForSeat(GAMEPAD_SEAT_B);
             if (dev && (cinfo = getControllerInstance(dev))) {
+                /* The clock ISR stays installed until CD32 support is disabled.
+                 * Adding / removing it from the mode ISR is not allowed.
+                 */
+                cinfo->cd32Shifting = false;
+                ESP_ERROR_CHECK(gpio_isr_handler_add(cinfo->joyPins[PIN_NO_CLOCK], onClockEdge, (void*)cinfo));
                 ESP_ERROR_CHECK(gpio_isr_handler_add(cinfo->joyPins[PIN_NO_MODE], onPadModeChange, (void*)cinfo));
             }
 #endif
@@ -2195,6 +2243,7 @@ static void loopCore1(void* arg) {
                 //~ taskDISABLE_INTERRUPTS ();
                 gpio_isr_handler_remove(cinfo->joyPins[PIN_NO_CLOCK]);
                 gpio_isr_handler_remove(cinfo->joyPins[PIN_NO_MODE]);
+                cinfo->cd32Shifting = false;
                 //~ taskENABLE_INTERRUPTS ();
             }
 #endif
@@ -2280,14 +2329,14 @@ static void mightymiggy_init(int argc, const char** argv) {
 
     // Blink to signal we're ready to roll!
     for (int i = 0; i < 3; i++) {
-        gpio_set_level(PIN_LED_P2, 1);
-        gpio_set_level(PIN_LED_P1, 0);
+        uni_gpio_hal_set_level(PIN_LED_P2, 1);
+        uni_gpio_hal_set_level(PIN_LED_P1, 0);
         vTaskDelay(100 / portTICK_PERIOD_MS);
-        gpio_set_level(PIN_LED_P2, 0);
-        gpio_set_level(PIN_LED_P1, 1);
+        uni_gpio_hal_set_level(PIN_LED_P2, 0);
+        uni_gpio_hal_set_level(PIN_LED_P1, 1);
         vTaskDelay(100 / portTICK_PERIOD_MS);
     }
-    gpio_set_level(PIN_LED_P1, 0);
+    uni_gpio_hal_set_level(PIN_LED_P1, 0);
     vTaskDelay(200 / portTICK_PERIOD_MS);
 }
 
@@ -2296,7 +2345,7 @@ static void mightymiggy_on_init_complete(void) {
     uni_bt_start_scanning_and_autoconnect_safe();
 
     // Hi-released, Low-pressed
-    bool pushed = !gpio_get_level(GPIO_PUSH_BUTTON);
+    bool pushed = !uni_gpio_hal_get_level(GPIO_PUSH_BUTTON);
     if (pushed)
         uni_bt_del_keys_safe();
     else
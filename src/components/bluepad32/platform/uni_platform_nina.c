@@ -23,7 +23,6 @@
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
-#include <freertos/queue.h>
 #include <freertos/semphr.h>
 #include <hal/gpio_ll.h>
 #include <math.h>
@@ -31,6 +30,7 @@
 #include "sdkconfig.h"
 
 #include "bt/uni_bt.h"
+#include "bt/uni_bt_cmd_queue.h"
 #include "controller/uni_controller.h"
 #include "platform/uni_platform.h"
 #include "uni_common.h"
@@ -66,6 +66,16 @@
 #define GPIO_READY GPIO_NUM_33
 #define DMA_CHANNEL 1
 
+// Must be modulo 4 and word aligned.
+// A higher value up to SPI_MAX_DMA_LEN can be defined if needed.
+#ifdef CONFIG_BLUEPAD32_NINA_SPI_BUFFER_LEN
+#define SPI_BUFFER_LEN CONFIG_BLUEPAD32_NINA_SPI_BUFFER_LEN
+#else
+#define SPI_BUFFER_LEN 256
+#endif
+_Static_assert((SPI_BUFFER_LEN % 4) == 0, "SPI_BUFFER_LEN must be multiple of 4");
+_Static_assert(CONFIG_BLUEPAD32_MAX_DEVICES <= 32, "NINA seats are stored in a 32-bit mask");
+
 enum {
     NINA_CONTROLLER_INVALID = -1,
 };
@@ -176,15 +186,19 @@ typedef struct nina_instance_s {
 _Static_assert(sizeof(nina_instance_t) < HID_DEVICE_MAX_PLATFORM_DATA, "NINA intance too big");
 
 static SemaphoreHandle_t _ready_semaphore = NULL;
-static QueueHandle_t _pending_queue = NULL;
 static SemaphoreHandle_t controller_mutex = NULL;
 static nina_controller_t _controllers[CONFIG_BLUEPAD32_MAX_DEVICES];
 static nina_controller_properties_t _controllers_properties[CONFIG_BLUEPAD32_MAX_DEVICES];
-static volatile uni_gamepad_seat_t _gamepad_seats;
+// Mice might report faster than the host polls. Accumulate the reports until the host reads them.
+static uni_mouse_accum_t _mouse_accums[CONFIG_BLUEPAD32_MAX_DEVICES];
+// One bit per controller index. Not using uni_gamepad_seat_t since it only has 4 seats.
+static volatile uint32_t _controller_seats;
 
 static nina_instance_t* get_nina_instance(uni_hid_device_t* d);
+static void flush_mouse_accum(int idx);
 
 static uint8_t predicate_nina_index(uni_hid_device_t* d, void* data);
+static void pending_request_handler(const uni_bt_cmd_t* cmd);
 
 //
 //
@@ -192,8 +206,8 @@ static uint8_t predicate_nina_index(uni_hid_device_t* d, void* data);
 //
 // BTStack / Bluepad32 are not thread safe.
 // This code is the bridge between CPU1 and CPU0.
-// CPU1 (SPI-slave) queues possible commands here,
-// CPU0 will read from them and execute the commands.
+// CPU1 (SPI-slave) queues possible commands in the uni_bt_cmd_queue,
+// CPU0 executes them from pending_request_handler().
 //
 //
 enum {
@@ -204,13 +218,10 @@ enum {
     PENDING_REQUEST_CMD_DISCONNECT = 4,
 };
 
-typedef struct {
-    uint8_t controller_idx;
-    uint8_t cmd;
-    uint8_t args[8];
-} pending_request_t;
-
-#define MAX_PENDING_REQUESTS 16
+static void queue_pending_request(const uni_bt_cmd_t* request) {
+    if (!uni_bt_cmd_queue_push(request))
+        loge("NINA: command %d dropped, queue full\n", request->cmd);
+}
 
 //
 //
@@ -254,10 +265,16 @@ enum {
     RESPONSE_OK = 1,
 };
 
+// Max length that a request handler can fill. Last byte is reserved for CMD_END.
+#define RESPONSE_MAX_LEN (SPI_BUFFER_LEN - 1)
+
+// Used in paged responses to indicate that there are no more pages.
+#define PAGE_END 0xff
+
 // Command 0x00
 static int request_protocol_version(const uint8_t command[], uint8_t response[]) {
 #define PROTOCOL_VERSION_HI 0x01
-#define PROTOCOL_VERSION_LO 0x04
+#define PROTOCOL_VERSION_LO 0x05
 
     response[2] = 1;  // Number of parameters
     response[3] = 2;  // Param len
@@ -280,7 +297,11 @@ static int request_gamepads_data(const uint8_t command[], uint8_t response[]) {
     int total_controllers = 0;
     int offset = 3;
     for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
-        if (_gamepad_seats & BIT(i)) {
+        if (_controller_seats & BIT(i)) {
+            // Legacy request: report only the gamepads that fit in one response.
+            // Use request_controllers_data_paged() to get all of them.
+            if (offset + sizeof(_controllers[0].gamepad) + 1 + 1 > RESPONSE_MAX_LEN)
+                break;
             total_controllers++;
             // Update param len
             // +1 is for the "idx" field
@@ -318,12 +339,13 @@ static int request_set_gamepad_player_leds(const uint8_t command[], uint8_t resp
         return 5;
     }
 
-    pending_request_t request = (pending_request_t){
-        .controller_idx = idx,
+    uni_bt_cmd_t request = {
+        .handler = &pending_request_handler,
         .cmd = PENDING_REQUEST_CMD_PLAYER_LEDS,
-        .args[0] = command[6],
+        .args.device.idx = idx,
+        .args.device.data[0] = command[6],
     };
-    xQueueSendToBack(_pending_queue, &request, (TickType_t)0);
+    queue_pending_request(&request);
 
     // TODO: We really don't know whether this request will succeed
     response[2] = 1;  // Number of parameters
@@ -349,14 +371,15 @@ static int request_set_gamepad_color_led(const uint8_t command[], uint8_t respon
         return 5;
     }
 
-    pending_request_t request = (pending_request_t){
-        .controller_idx = idx,
+    uni_bt_cmd_t request = {
+        .handler = &pending_request_handler,
         .cmd = PENDING_REQUEST_CMD_LIGHTBAR_COLOR,
-        .args[0] = command[6],
-        .args[1] = command[7],
-        .args[2] = command[8],
+        .args.device.idx = idx,
+        .args.device.data[0] = command[6],
+        .args.device.data[1] = command[7],
+        .args.device.data[2] = command[8],
     };
-    xQueueSendToBack(_pending_queue, &request, (TickType_t)0);
+    queue_pending_request(&request);
 
     // TODO: We really don't know whether this request will succeed
     response[2] = 1;  // Number of parameters
@@ -382,13 +405,14 @@ static int request_set_gamepad_rumble(const uint8_t command[], uint8_t response[
         return 5;
     }
 
-    pending_request_t request = (pending_request_t){
-        .controller_idx = idx,
+    uni_bt_cmd_t request = {
+        .handler = &pending_request_handler,
         .cmd = PENDING_REQUEST_CMD_RUMBLE,
-        .args[0] = command[6],
-        .args[1] = command[7],
+        .args.device.idx = idx,
+        .args.device.data[0] = command[6],
+        .args.device.data[1] = command[7],
     };
-    xQueueSendToBack(_pending_queue, &request, (TickType_t)0);
+    queue_pending_request(&request);
 
     // TODO: We really don't know whether this request will succeed
     response[2] = 1;  // Number of parameters
@@ -468,11 +492,12 @@ static int request_disconnect_gamepad(const uint8_t command[], uint8_t response[
         goto exit;
     }
 
-    pending_request_t request = (pending_request_t){
-        .controller_idx = idx,
+    uni_bt_cmd_t request = {
+        .handler = &pending_request_handler,
         .cmd = PENDING_REQUEST_CMD_DISCONNECT,
+        .args.device.idx = idx,
     };
-    xQueueSendToBack(_pending_queue, &request, (TickType_t)0);
+    queue_pending_request(&request);
 
 exit:
     response[2] = 1;  // total params
@@ -494,8 +519,13 @@ static int request_controllers_data(const uint8_t command[], uint8_t response[])
     int total_controllers = 0;
     int offset = 3;
     for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
-        if (_gamepad_seats & BIT(i)) {
+        if (_controller_seats & BIT(i)) {
+            // Report only the controllers that fit in one response.
+            // Use request_controllers_data_paged() to get all of them.
+            if (offset + sizeof(_controllers[0]) + 1 > RESPONSE_MAX_LEN)
+                break;
             total_controllers++;
+            flush_mouse_accum(i);
             // Update param len
             response[offset] = sizeof(_controllers[0]);
             // Update param (data)
@@ -512,6 +542,66 @@ static int request_controllers_data(const uint8_t command[], uint8_t response[])
     return offset;
 }
 
+// Command 0x0a
+static int request_controllers_data_paged(const uint8_t command[], uint8_t response[]) {
+    // Like request_controllers_data(), but supports more controllers than the ones that fit
+    // in one SPI response, and lets the host select which controllers to get.
+    // The host should keep requesting pages until "next index" is PAGE_END.
+    //
+    // command[2]: total params. If 0, all controllers are requested starting from index 0.
+    // command[3]: param len, should be 4
+    // command[4-7]: controller index mask, little endian. 0 means all controllers.
+    // command[8]: param len, should be 1
+    // command[9]: first controller index to report (the "next index" returned in the previous page)
+    //
+    // Returned struct:
+    // byte 2: number of parameters (1 + number of controllers in this page)
+    //      3: param len (2)
+    //      4: next index to request, or PAGE_END if there are no more controllers
+    //      5: total number of connected controllers that match the mask
+    //      6: param len (sizeof(_controllers[0])
+    //      7: controller N data
+    uint32_t mask = 0;
+    int start_idx = 0;
+
+    if (command[2] >= 1 && command[3] == 4)
+        mask = command[4] | (command[5] << 8) | (command[6] << 16) | ((uint32_t)command[7] << 24);
+    if (command[2] >= 2 && command[8] == 1)
+        start_idx = command[9];
+    if (mask == 0)
+        mask = GENMASK(CONFIG_BLUEPAD32_MAX_DEVICES - 1, 0);
+
+    xSemaphoreTake(controller_mutex, portMAX_DELAY);
+
+    uint32_t seats = _controller_seats & mask;
+    int next_idx = PAGE_END;
+    int total_controllers = 0;
+    int offset = 6;
+    for (int i = start_idx; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if ((seats & BIT(i)) == 0)
+            continue;
+        if (offset + sizeof(_controllers[0]) + 1 > RESPONSE_MAX_LEN) {
+            next_idx = i;
+            break;
+        }
+        total_controllers++;
+        flush_mouse_accum(i);
+        response[offset] = sizeof(_controllers[0]);
+        memcpy(&response[offset + 1], &_controllers[i], sizeof(_controllers[0]));
+        offset += sizeof(_controllers[0]) + 1;
+    }
+
+    xSemaphoreGive(controller_mutex);
+
+    response[2] = total_controllers + 1;  // total params
+    response[3] = 2;                      // param len
+    response[4] = next_idx;
+    response[5] = __builtin_popcount(seats);
+
+    // "offset" has the total length
+    return offset;
+}
+
 // Command 0x1a
 static int request_set_debug(const uint8_t command[], uint8_t response[]) {
     // Since v4.0, this feature is not supported anymore. Cannot enable/disable output in runtime
@@ -699,7 +789,7 @@ const command_handler_t command_handlers[] = {
     request_start_scanning,           // Enable/Disable bluetooth connection
     request_disconnect_gamepad,       // Disconnect gamepad
     request_controllers_data,         // Gamepad, Mouse, Balance. Deprecates request_gamepads_data
-    NULL,
+    request_controllers_data_paged,   // Like request_controllers_data, but paged and filtered by index mask
     NULL,
     NULL,
     NULL,
@@ -920,11 +1010,9 @@ static void spi_main_loop(void* arg) {
     esp_err_t ret = spi_slave_initialize(VSPI_HOST, &buscfg, &slvcfg, DMA_CHANNEL);
     assert(ret == ESP_OK);
 
-    // Must be modulo 4 and word aligned.
-    // A higher value up to SPI_MAX_DMA_LEN can be defined if needed.
-#define SPI_BUFFER_LEN 256
-    WORD_ALIGNED_ATTR uint8_t response_buf[SPI_BUFFER_LEN];
-    WORD_ALIGNED_ATTR uint8_t command_buf[SPI_BUFFER_LEN];
+    // Static, and not in the stack, since SPI_BUFFER_LEN is configurable and could be bigger than the task stack.
+    static WORD_ALIGNED_ATTR uint8_t response_buf[SPI_BUFFER_LEN];
+    static WORD_ALIGNED_ATTR uint8_t command_buf[SPI_BUFFER_LEN];
 
     while (1) {
         memset(command_buf, 0, SPI_BUFFER_LEN);
@@ -948,45 +1036,41 @@ static void spi_main_loop(void* arg) {
 // Be extra careful when calling code that runs on the other CPU
 //
 
-static void process_pending_requests(void) {
-    pending_request_t request;
-
-    while (xQueueReceive(_pending_queue, &request, (TickType_t)0) == pdTRUE) {
-        int idx = request.controller_idx;
-        uni_hid_device_t* d = uni_hid_device_get_instance_with_predicate(predicate_nina_index, (void*)idx);
-        if (d == NULL) {
-            loge("NINA: device cannot be found while processing pending request\n");
-            return;
-        }
-        switch (request.cmd) {
-            case PENDING_REQUEST_CMD_LIGHTBAR_COLOR:
-                if (d->report_parser.set_lightbar_color != NULL)
-                    d->report_parser.set_lightbar_color(d, request.args[0], request.args[1], request.args[2]);
-                break;
-            case PENDING_REQUEST_CMD_PLAYER_LEDS:
-                if (d->report_parser.set_player_leds != NULL)
-                    d->report_parser.set_player_leds(d, request.args[0]);
-                break;
+static void pending_request_handler(const uni_bt_cmd_t* request) {
+    int idx = request->args.device.idx;
+    const uint8_t* args = request->args.device.data;
+    uni_hid_device_t* d = uni_hid_device_get_instance_with_predicate(predicate_nina_index, (void*)idx);
+    if (d == NULL) {
+        loge("NINA: device cannot be found while processing pending request\n");
+        return;
+    }
+    switch (request->cmd) {
+        case PENDING_REQUEST_CMD_LIGHTBAR_COLOR:
+            if (d->report_parser.set_lightbar_color != NULL)
+                d->report_parser.set_lightbar_color(d, args[0], args[1], args[2]);
+            break;
+        case PENDING_REQUEST_CMD_PLAYER_LEDS:
+            if (d->report_parser.set_player_leds != NULL)
+                d->report_parser.set_player_leds(d, args[0]);
+            break;
 
-            case PENDING_REQUEST_CMD_RUMBLE:
-                if (d->report_parser.play_dual_rumble != NULL)
-                    d->report_parser.play_dual_rumble(d, 0 /* delayed start ms */, request.args[1] * 4 /* duration */,
-                                                      request.args[0] /* weak magnitude */,
-                                                      request.args[0] /* strong magnitude */);
-                break;
+        case PENDING_REQUEST_CMD_RUMBLE:
+            if (d->report_parser.play_dual_rumble != NULL)
+                d->report_parser.play_dual_rumble(d, 0 /* delayed start ms */, args[1] * 4 /* duration */,
+                                                  args[0] /* weak magnitude */, args[0] /* strong magnitude */);
+            break;
 
-            case PENDING_REQUEST_CMD_DISCONNECT:
-                // Don't call "uni_hid_device_disconnect" since it will
-                // disconnect the "d" immediately and functions in the
-                // stack trace might depend on it.
-                // Instead, call it from a callback.
-                idx = uni_hid_device_get_idx_for_instance(d);
-                uni_bt_disconnect_device_safe(idx);
-                break;
+        case PENDING_REQUEST_CMD_DISCONNECT:
+            // Don't call "uni_hid_device_disconnect" since it will
+            // disconnect the "d" immediately and functions in the
+            // stack trace might depend on it.
+            // Instead, call it from a callback.
+            idx = uni_hid_device_get_idx_for_instance(d);
+            uni_bt_disconnect_device_safe(idx);
+            break;
 
-            default:
-                loge("NINA: Invalid pending command: %d\n", request.cmd);
-        }
+        default:
+            loge("NINA: Invalid pending command: %d\n", request->cmd);
     }
 }
 
@@ -1020,9 +1104,6 @@ static void nina_on_init_complete(void) {
     controller_mutex = xSemaphoreCreateMutex();
     assert(controller_mutex != NULL);
 
-    _pending_queue = xQueueCreate(MAX_PENDING_REQUESTS, sizeof(pending_request_t));
-    assert(_pending_queue != NULL);
-
     // Create SPI main loop thread.
     // To not interfere with Bluetooth that runs in CPU0, SPI code should run in CPU1
     xTaskCreatePinnedToCore(spi_main_loop, "spi_main_loop", 8192, NULL, 1, NULL, 1);
@@ -1045,10 +1126,11 @@ static void nina_on_device_disconnected(uni_hid_device_t* d) {
                  CONFIG_BLUEPAD32_MAX_DEVICES);
             return;
         }
-        _gamepad_seats &= ~BIT(ins->controller_idx);
+        _controller_seats &= ~BIT(ins->controller_idx);
 
         memset(&_controllers[ins->controller_idx], 0, sizeof(_controllers[0]));
         _controllers[ins->controller_idx].idx = NINA_CONTROLLER_INVALID;
+        uni_mouse_accum_reset(&_mouse_accums[ins->controller_idx]);
 
         memset(&_controllers_properties[ins->controller_idx], 0, sizeof(_controllers_properties[0]));
         _controllers_properties[ins->controller_idx].idx = NINA_CONTROLLER_INVALID;
@@ -1057,8 +1139,12 @@ static void nina_on_device_disconnected(uni_hid_device_t* d) {
     }
 }
 
+static int nina_get_free_seats(void) {
+    return CONFIG_BLUEPAD32_MAX_DEVICES - __builtin_popcount(_controller_seats);
+}
+
 static uni_error_t nina_on_device_ready(uni_hid_device_t* d) {
-    if (_gamepad_seats == (GAMEPAD_SEAT_A | GAMEPAD_SEAT_B | GAMEPAD_SEAT_C | GAMEPAD_SEAT_D)) {
+    if (_controller_seats == GENMASK(CONFIG_BLUEPAD32_MAX_DEVICES - 1, 0)) {
         // No more available seats, reject connection
         logi("NINA: More available seats\n");
         return UNI_ERROR_NO_SLOTS;
@@ -1072,9 +1158,9 @@ static uni_error_t nina_on_device_ready(uni_hid_device_t* d) {
 
     // Find first available gamepad
     for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
-        if ((_gamepad_seats & BIT(i)) == 0) {
+        if ((_controller_seats & BIT(i)) == 0) {
             ins->controller_idx = i;
-            _gamepad_seats |= BIT(i);
+            _controller_seats |= BIT(i);
             break;
         }
     }
@@ -1129,14 +1215,6 @@ static uint8_t predicate_nina_index(uni_hid_device_t* d, void* data) {
 }
 
 static void nina_on_controller_data(uni_hid_device_t* d, uni_controller_t* ctl) {
-    // FIXME:
-    // When SPI-slave (CPU1) receives a request that cannot be fulfilled
-    // immediately (e.g: the ones that needs to run on CPU0), it is processed from
-    // this callback. This works because a "gamepad_data" event is generated
-    // almost immediately after the SPI-slave request was made. Although unlikely,
-    // it could happen that "gamepad_data" gets called after a delay.
-    process_pending_requests();
-
     nina_instance_t* ins = get_nina_instance(d);
     if (ins->controller_idx < 0 || ins->controller_idx >= CONFIG_BLUEPAD32_MAX_DEVICES) {
         loge("NINA: unexpected controller idx, got: %d, want: [0-%d]\n", ins->controller_idx,
@@ -1161,11 +1239,8 @@ static void nina_on_controller_data(uni_hid_device_t* d, uni_controller_t* ctl)
             memcpy(_controllers[ins->controller_idx].gamepad.accel, ctl->gamepad.accel, sizeof(ctl->gamepad.accel));
             break;
         case UNI_CONTROLLER_CLASS_MOUSE:
-            _controllers[ins->controller_idx].mouse.delta_x = ctl->mouse.delta_x;
-            _controllers[ins->controller_idx].mouse.delta_y = ctl->mouse.delta_y;
-            _controllers[ins->controller_idx].mouse.buttons = ctl->mouse.buttons;
-            _controllers[ins->controller_idx].mouse.misc_buttons = ctl->mouse.misc_buttons;
-            _controllers[ins->controller_idx].mouse.scroll_wheel = ctl->mouse.scroll_wheel;
+            // Copied to _controllers when the host requests it. See flush_mouse_accum().
+            uni_mouse_accum_add(&_mouse_accums[ins->controller_idx], &ctl->mouse);
             break;
         case UNI_CONTROLLER_CLASS_BALANCE_BOARD:
             break;
@@ -1197,6 +1272,21 @@ static nina_instance_t* get_nina_instance(uni_hid_device_t* d) {
     return (nina_instance_t*)&d->platform_data[0];
 }
 
+// Must be called with controller_mutex taken.
+static void flush_mouse_accum(int idx) {
+    uni_mouse_t ms;
+
+    if (_controllers[idx].klass != UNI_CONTROLLER_CLASS_MOUSE)
+        return;
+
+    uni_mouse_accum_read(&_mouse_accums[idx], &ms);
+    _controllers[idx].mouse.delta_x = ms.delta_x;
+    _controllers[idx].mouse.delta_y = ms.delta_y;
+    _controllers[idx].mouse.buttons = ms.buttons;
+    _controllers[idx].mouse.misc_buttons = ms.misc_buttons;
+    _controllers[idx].mouse.scroll_wheel = ms.scroll_wheel;
+}
+
 //
 // Entry Point
 //
@@ -1208,6 +1298,7 @@ struct uni_platform* uni_platform_nina_create(void) {
         .on_device_connected = nina_on_device_connected,
         .on_device_disconnected = nina_on_device_disconnected,
         .on_device_ready = nina_on_device_ready,
+        .get_free_seats = nina_get_free_seats,
         .on_oob_event = nina_on_oob_event,
         .on_controller_data = nina_on_controller_data,
         .get_property = nina_get_property,
@@ -1225,6 +1316,7 @@ struct uni_platform* uni_platform_airlift_create(void) {
         .on_device_connected = nina_on_device_connected,
         .on_device_disconnected = nina_on_device_disconnected,
         .on_device_ready = nina_on_device_ready,
+        .get_free_seats = nina_get_free_seats,
         .on_oob_event = nina_on_oob_event,
         .on_controller_data = nina_on_controller_data,
         .get_property = nina_get_property,
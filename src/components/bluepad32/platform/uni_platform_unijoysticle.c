@@ -26,6 +26,7 @@
 #include "sdkconfig.h"
 
 #include "bt/uni_bt.h"
+#include "bt/uni_bt_cmd_queue.h"
 #include "cmd_system.h"
 #include "controller/uni_balance_board.h"
 #include "controller/uni_controller.h"
@@ -41,11 +42,15 @@
 #include "platform/uni_platform_unijoysticle_c64.h"
 #include "platform/uni_platform_unijoysticle_msx.h"
 #include "platform/uni_platform_unijoysticle_singleport.h"
+#include "uni_autofire.h"
 #include "uni_common.h"
 #include "uni_config.h"
 #include "uni_gpio.h"
+#include "uni_gpio_hal.h"
+#include "uni_gpio_port.h"
 #include "uni_hid_device.h"
 #include "uni_joystick.h"
+#include "uni_joystick_profile.h"
 #include "uni_log.h"
 #include "uni_mouse_quadrature.h"
 #include "uni_property.h"
@@ -67,6 +72,12 @@
 // In some board models, not all GPIOs are set. Macro to simplify code for that.
 #define SAFE_SET_BIT64(__value) (__value == -1) ? 0 : (1ULL << __value)
 
+// Joystick port lines. Bit N is UNI_PLATFORM_UNIJOYSTICLE_JOY_N
+#define JOY_LINE(__line) BIT(UNI_PLATFORM_UNIJOYSTICLE_JOY_##__line)
+#define JOY_LINES_DIRECTIONS (JOY_LINE(UP) | JOY_LINE(DOWN) | JOY_LINE(LEFT) | JOY_LINE(RIGHT))
+#define JOY_LINES_POTS (JOY_LINE(BUTTON2) | JOY_LINE(BUTTON3))
+#define JOY_LINES_ALL (BIT(UNI_PLATFORM_UNIJOYSTICLE_JOY_MAX) - 1)
+
 // 20 milliseconds ~= 1 frame in PAL
 // 16.6 milliseconds ~= 1 frame in NTSC
 // From: https://eab.abime.net/showthread.php?t=99970
@@ -81,16 +92,20 @@
 #define AUTOFIRE_CPS_QUICKSHOT (29)        // ~17ms, ~1 frame
 #define AUTOFIRE_CPS_COMPETITION_PRO (62)  // ~8ms, ~1/2 frame
 #define AUTOFIRE_CPS_DEFAULT AUTOFIRE_CPS_QUICKGUN
+// Percentage of the period that fire is pressed.
+#define AUTOFIRE_DUTY_DEFAULT (50)
 
-#define TASK_AUTOFIRE_PRIO (9)
 #define TASK_PUSH_BUTTON_PRIO (8)
 #define TASK_BLINK_LED_PRIO (7)
 
 // Unijoysticle properties: Keep them sorted
+#define UNI_PROPERTY_NAME_UNI_AF_B_CPS "bp.uni.af_b_cps"
+#define UNI_PROPERTY_NAME_UNI_AF_DUTY "bp.uni.af_duty"
 #define UNI_PROPERTY_NAME_UNI_AUTOFIRE_CPS "bp.uni.autofire"
 #define UNI_PROPERTY_NAME_UNI_BB_FIRE_THRESHOLD "bp.uni.bb_fire"
 #define UNI_PROPERTY_NAME_UNI_BB_MOVE_THRESHOLD "bp.uni.bb_move"
 #define UNI_PROPERTY_NAME_UNI_C64_POT_MODE "bp.uni.c64pot"
+#define UNI_PROPERTY_NAME_UNI_JOYSTICK_PROFILES "bp.uni.joyprof"
 #define UNI_PROPERTY_NAME_UNI_MODEL "bp.uni.model"
 #define UNI_PROPERTY_NAME_UNI_MOUSE_EMULATION "bp.uni.mouseemu"
 #define UNI_PROPERTY_NAME_UNI_SERIAL_NUMBER "bp.uni.serial"
@@ -104,10 +119,6 @@ enum {
     // Push buttons
     EVENT_BUTTON_0 = UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_0,
     EVENT_BUTTON_1 = UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_1,
-
-    // Autofire group
-    EVENT_AUTOFIRE_TRIGGER = 0,
-    EVENT_AUTOFIRE_CONFIG = 1,
 };
 
 typedef enum {
@@ -171,20 +182,24 @@ static void process_mouse(uni_hid_device_t* d,
 static void process_gamepad(uni_hid_device_t* d, uni_gamepad_t* gp);
 static void process_balance_board(uni_hid_device_t* d, uni_balance_board_t* bb);
 static void process_keyboard(uni_hid_device_t* d, uni_keyboard_t* kb);
-static void joy_update_port(const uni_joystick_t* joy, const gpio_num_t* gpios);
+static void joy_update_port(const uni_joystick_t* joy, uni_gpio_port_t* port, const gpio_num_t* gpios);
 static void init_quadrature_mouse(void);
 static int get_mouse_emulation_from_nvs(void);
+static void load_joystick_profiles(void);
+static void print_joystick_profiles(void);
+static int get_autofire_property_from_nvs(uni_property_idx_t idx);
+static void update_autofire_rates(void);
 // Interrupt handlers
 static void handle_event_button(int button_idx);
 // GPIO Interrupt handlers
 static void gpio_isr_handler_button(void* arg);
 _Noreturn static void pushbutton_event_task(void* arg);
-_Noreturn static void auto_fire_task(void* arg);
 static void maybe_enable_mouse_timers(void);
 // Commands or Event related
 static int cmd_swap_ports(int argc, char** argv);
 static int cmd_gamepad_mode(int argc, char** argv);
 static int cmd_autofire_cps(int argc, char** argv);
+static int cmd_joystick_profile(int argc, char** argv);
 static int cmd_mouse_emulation(int argc, char** argv);
 static int cmd_version(int argc, char** argv);
 static void swap_ports(void);
@@ -207,6 +222,9 @@ static const char* mouse_modes[] = {
 
 // Unijoysticle only properties
 static const uni_property_t properties[] = {
+    {UNI_PROPERTY_IDX_UNI_AF_B_CPS, UNI_PROPERTY_NAME_UNI_AF_B_CPS, UNI_PROPERTY_TYPE_U8, .default_value.u8 = 0},
+    {UNI_PROPERTY_IDX_UNI_AF_DUTY, UNI_PROPERTY_NAME_UNI_AF_DUTY, UNI_PROPERTY_TYPE_U8,
+     .default_value.u8 = AUTOFIRE_DUTY_DEFAULT},
     {UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS, UNI_PROPERTY_NAME_UNI_AUTOFIRE_CPS, UNI_PROPERTY_TYPE_U8,
      .default_value.u8 = AUTOFIRE_CPS_DEFAULT},
     {UNI_PROPERTY_IDX_UNI_BB_FIRE_THRESHOLD, UNI_PROPERTY_NAME_UNI_BB_FIRE_THRESHOLD, UNI_PROPERTY_TYPE_U32,
@@ -215,6 +233,9 @@ static const uni_property_t properties[] = {
      .default_value.u32 = UNI_BALANCE_BOARD_FIRE_THRESHOLD_DEFAULT},
     {UNI_PROPERTY_IDX_UNI_C64_POT_MODE, UNI_PROPERTY_NAME_UNI_C64_POT_MODE, UNI_PROPERTY_TYPE_U8,
      .default_value.u8 = UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_3BUTTONS},
+    // Binary format. See joystick_profiles_blob_t
+    {UNI_PROPERTY_IDX_UNI_JOYSTICK_PROFILES, UNI_PROPERTY_NAME_UNI_JOYSTICK_PROFILES, UNI_PROPERTY_TYPE_BLOB,
+     .default_value.blob = {NULL, 0}},
     {UNI_PROPERTY_IDX_UNI_MODEL, UNI_PROPERTY_NAME_UNI_MODEL, UNI_PROPERTY_TYPE_STRING, .default_value.str = "Unknown",
      .flags = UNI_PROPERTY_FLAG_READ_ONLY},
     {UNI_PROPERTY_IDX_UNI_MOUSE_EMULATION, UNI_PROPERTY_NAME_UNI_MOUSE_EMULATION, UNI_PROPERTY_TYPE_U8,
@@ -232,15 +253,32 @@ static const struct uni_platform_unijoysticle_variant* g_variant;
 // Used as cache of g_variant->gpio_config
 static const struct uni_platform_unijoysticle_gpio_config* g_gpio_config;
 
+// Port A & B. Written from the Bluetooth task and the autofire timers.
+static uni_gpio_port_t g_joy_ports[2];
+// Autofire channel of the fire line of each port.
+static int g_autofire_channels[2];
+// Custom conversion profile of each port. NULL: the built-in one of the gamepad mode.
+// Only accessed from the Bluetooth task.
+static const uni_joystick_profile_t* g_port_profiles[2];
+
+// Stored as is in the UNI_PROPERTY_IDX_UNI_JOYSTICK_PROFILES property.
+// Custom profiles only live in RAM: their rules are stored too, and added again when loaded.
+#define JOYSTICK_PROFILES_BLOB_VERSION 1
+typedef struct {
+    uint8_t version;
+    struct {
+        // Empty: the built-in one of the gamepad mode.
+        char name[UNI_JOYSTICK_PROFILE_NAME_LEN];
+        // Rules of the custom profile. 0 for built-in profiles.
+        uint8_t count;
+        uni_joystick_profile_rule_t rules[UNI_JOYSTICK_PROFILE_MAX_RULES];
+    } ports[2];
+} joystick_profiles_blob_t;
+
 static EventGroupHandle_t g_pushbutton_group;
-static EventGroupHandle_t g_autofire_group;
 
 struct push_button_state g_push_buttons_state[UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_MAX] = {0};
 
-// Autofire
-static bool g_autofire_a_enabled;
-static bool g_autofire_b_enabled;
-
 // Button "mode". Used in A500/C64/800XL
 static int s_bluetooth_led_on;  // Used as a cache
 static bool s_auto_enable_bluetooth = true;
@@ -259,16 +297,23 @@ static struct {
 
 static struct {
     struct arg_int* value;
+    struct arg_str* port;
+    struct arg_int* duty;
     struct arg_end* end;
 } autofire_cps_args;
 
+static struct {
+    struct arg_str* name;
+    struct arg_str* port;
+    struct arg_str* rules;
+    struct arg_end* end;
+} joystick_profile_args;
+
 static struct {
     struct arg_str* value;
     struct arg_end* end;
 } mouse_emulation_args;
 
-static btstack_context_callback_registration_t cmd_callback_registration;
-
 //
 // Platform Overrides
 //
@@ -325,12 +370,23 @@ static void unijoysticle_init(int argc, const char** argv) {
 
     ESP_ERROR_CHECK(gpio_config(&io_conf));
 
-    // Set low all joystick GPIOs... just in case.
+    // Line N of the port is UNI_PLATFORM_UNIJOYSTICLE_JOY_N
+    uni_gpio_port_init(&g_joy_ports[0]);
+    uni_gpio_port_init(&g_joy_ports[1]);
     for (int i = 0; i < UNI_PLATFORM_UNIJOYSTICLE_JOY_MAX; i++) {
-        ESP_ERROR_CHECK(uni_gpio_set_level(g_gpio_config->port_a[i], 0));
-        ESP_ERROR_CHECK(uni_gpio_set_level(g_gpio_config->port_b[i], 0));
+        uni_gpio_port_add_line(&g_joy_ports[0], g_gpio_config->port_a[i]);
+        uni_gpio_port_add_line(&g_joy_ports[1], g_gpio_config->port_b[i]);
     }
 
+    // Set low all joystick GPIOs... just in case.
+    uni_gpio_port_write(&g_joy_ports[0], 0, JOY_LINES_ALL);
+    uni_gpio_port_write(&g_joy_ports[1], 0, JOY_LINES_ALL);
+
+    uni_autofire_init();
+    g_autofire_channels[0] = uni_autofire_add_channel(&g_joy_ports[0], UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE);
+    g_autofire_channels[1] = uni_autofire_add_channel(&g_joy_ports[1], UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE);
+    update_autofire_rates();
+
     // Turn On Player LEDs
     uni_gpio_set_level(g_gpio_config->leds[UNI_PLATFORM_UNIJOYSTICLE_LED_J1], 1);
     uni_gpio_set_level(g_gpio_config->leds[UNI_PLATFORM_UNIJOYSTICLE_LED_J2], 1);
@@ -340,13 +396,9 @@ static void unijoysticle_init(int argc, const char** argv) {
     // Tasks should be created before the ISR, just in case an interrupt
     // gets called before the Task-that-handles-the-ISR gets triggered.
 
-    // Split "events" from "auto_fire", since auto-fire is an ongoing event.
     g_pushbutton_group = xEventGroupCreate();
     xTaskCreate(pushbutton_event_task, "bp.uni.button", 4096, NULL, TASK_PUSH_BUTTON_PRIO, NULL);
 
-    g_autofire_group = xEventGroupCreate();
-    xTaskCreate(auto_fire_task, "bp.uni.autofire", 4096, NULL, TASK_AUTOFIRE_PRIO, NULL);
-
     // Push Buttons
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
     for (int i = 0; i < UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_MAX; i++) {
@@ -383,6 +435,8 @@ static void unijoysticle_on_init_complete(void) {
     if (g_variant->flags & UNI_PLATFORM_UNIJOYSTICLE_VARIANT_FLAG_QUADRATURE_MOUSE)
         init_quadrature_mouse();
 
+    load_joystick_profiles();
+
     if (g_variant->on_init_complete)
         g_variant->on_init_complete();
 
@@ -394,7 +448,7 @@ static void unijoysticle_on_init_complete(void) {
     // Button not supported on this board
     bool delete_keys = false;
     if ((g_gpio_config->push_buttons[UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_0].gpio != -1) &&
-        !gpio_get_level(g_gpio_config->push_buttons[UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_0].gpio))
+        !uni_gpio_hal_get_level(g_gpio_config->push_buttons[UNI_PLATFORM_UNIJOYSTICLE_PUSH_BUTTON_0].gpio))
         delete_keys = true;
 
     if (delete_keys)
@@ -533,6 +587,19 @@ static uni_error_t unijoysticle_on_device_ready(uni_hid_device_t* d) {
     return UNI_ERROR_SUCCESS;
 }
 
+static int unijoysticle_get_free_seats(void) {
+    uint32_t used_joystick_ports = 0;
+
+    // A virtual device gets disconnected to make room for a new one. Its seat is free.
+    // In Twin Stick mode, a gamepad takes both seats.
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        uni_hid_device_t* tmp_d = uni_hid_device_get_instance_for_idx(i);
+        if (!uni_hid_device_is_virtual_device(tmp_d))
+            used_joystick_ports |= uni_platform_unijoysticle_get_instance(tmp_d)->seat;
+    }
+    return __builtin_popcount(~used_joystick_ports & GAMEPAD_SEAT_AB_MASK);
+}
+
 static bool test_gamepad_misc_button_pressed(uni_hid_device_t* d, uni_gamepad_t* gp, uint32_t button_mask) {
     uni_platform_unijoysticle_instance_t* ins = uni_platform_unijoysticle_get_instance(d);
     bool already_pressed = ins->debouncer & button_mask;
@@ -550,33 +617,6 @@ static bool test_gamepad_misc_button_pressed(uni_hid_device_t* d, uni_gamepad_t*
     return false;
 }
 
-static bool test_keyboard_key_pressed(uni_hid_device_t* d, uni_keyboard_t* kb, uint8_t usage_key, uint32_t key_mask) {
-    uni_platform_unijoysticle_instance_t* ins = uni_platform_unijoysticle_get_instance(d);
-    bool already_pressed = ins->debouncer & key_mask;
-    bool found = false;
-
-    // Only return true the first time it is pressed.
-    // Next time will occur when the button is released and pressed again.
-    for (int i = 0; i < UNI_KEYBOARD_PRESSED_KEYS_MAX; i++) {
-        // Assume not found if value is between 0 and 3, which are all errors.
-        if (kb->pressed_keys[i] < HID_USAGE_KB_ERROR_UNDEFINED)
-            break;
-        if (kb->pressed_keys[i] == usage_key) {
-            found = true;
-            break;
-        }
-    }
-    if (found) {
-        if (already_pressed)
-            return false;
-        ins->debouncer |= key_mask;
-        return true;
-    } else {
-        ins->debouncer &= ~key_mask;
-    }
-    return false;
-}
-
 static void test_gamepad_select_button(uni_hid_device_t* d, uni_gamepad_t* gp) {
     if (test_gamepad_misc_button_pressed(d, gp, MISC_BUTTON_SELECT))
         try_swap_ports(d);
@@ -588,16 +628,14 @@ static void test_gamepad_start_button(uni_hid_device_t* d, uni_gamepad_t* gp) {
 }
 
 static void test_keyboard_esc_key(uni_hid_device_t* d, uni_keyboard_t* kb) {
-    // FIXME: BUTTON_A should not be mapped to ESC.
-    // Define BIT constants for 32 keys (size of the bitmask)
-    if (test_keyboard_key_pressed(d, kb, HID_USAGE_KB_ESCAPE, BUTTON_A))
+    // Only the first time it is pressed.
+    if (uni_keyboard_was_key_pressed(kb, HID_USAGE_KB_ESCAPE))
         try_swap_ports(d);
 }
 
 static void test_keyboard_tab_key(uni_hid_device_t* d, uni_keyboard_t* kb) {
-    // FIXME: BUTTON_B should not be mapped to Tab.
-    // Define BIT constants for 32 keys (size of the bitmask)
-    if (test_keyboard_key_pressed(d, kb, HID_USAGE_KB_TAB, BUTTON_B))
+    // Only the first time it is pressed.
+    if (uni_keyboard_was_key_pressed(kb, HID_USAGE_KB_TAB))
         set_next_gamepad_mode(d);
 }
 
@@ -765,6 +803,60 @@ static int get_mouse_emulation_from_nvs(void) {
     return value.u8;
 }
 
+static void get_joystick_profiles_from_nvs(joystick_profiles_blob_t* blob) {
+    int len;
+
+    len = uni_property_get_blob(UNI_PROPERTY_IDX_UNI_JOYSTICK_PROFILES, blob, sizeof(*blob));
+    if (len != sizeof(*blob) || blob->version != JOYSTICK_PROFILES_BLOB_VERSION) {
+        if (len != 0)
+            loge("unijoysticle: invalid stored joystick profiles, len=%d\n", len);
+        memset(blob, 0, sizeof(*blob));
+        blob->version = JOYSTICK_PROFILES_BLOB_VERSION;
+        return;
+    }
+
+    // Validate it.
+    for (int i = 0; i < ARRAY_SIZE(blob->ports); i++) {
+        blob->ports[i].name[UNI_JOYSTICK_PROFILE_NAME_LEN - 1] = 0;
+        if (blob->ports[i].count > UNI_JOYSTICK_PROFILE_MAX_RULES)
+            memset(&blob->ports[i], 0, sizeof(blob->ports[i]));
+    }
+}
+
+static void set_joystick_profiles_to_nvs(const joystick_profiles_blob_t* blob) {
+    uni_property_value_t value;
+
+    value.blob.data = blob;
+    value.blob.size = sizeof(*blob);
+    uni_property_set(UNI_PROPERTY_IDX_UNI_JOYSTICK_PROFILES, value);
+}
+
+// Should be called from the Bluetooth task.
+static void load_joystick_profiles(void) {
+    // Too big for the stack.
+    static joystick_profiles_blob_t blob;
+    const uni_joystick_profile_t* profile;
+
+    get_joystick_profiles_from_nvs(&blob);
+    for (int i = 0; i < ARRAY_SIZE(blob.ports); i++) {
+        profile = NULL;
+        if (blob.ports[i].name[0] != 0) {
+            if (blob.ports[i].count > 0)
+                uni_joystick_profile_add_custom_rules(blob.ports[i].name, blob.ports[i].rules, blob.ports[i].count);
+            profile = uni_joystick_profile_find(blob.ports[i].name);
+            if (profile == NULL)
+                loge("unijoysticle: invalid joystick profile for port %c: %s\n", 'A' + i, blob.ports[i].name);
+        }
+        g_port_profiles[i] = profile;
+    }
+}
+
+// Should be called from the Bluetooth task.
+static void print_joystick_profiles(void) {
+    for (int i = 0; i < ARRAY_SIZE(g_port_profiles); i++)
+        logi("Port %c: %s\n", 'A' + i, g_port_profiles[i] ? g_port_profiles[i]->name : "none");
+}
+
 static void print_mouse_emulation(void) {
     int mode = get_mouse_emulation_from_nvs();
 
@@ -820,8 +912,15 @@ static void unijoysticle_register_cmds(void) {
     gamepad_mode_args.value = arg_str1(NULL, NULL, "<mode>", "valid options: 'normal', 'twinstick' or 'mouse'");
     gamepad_mode_args.end = arg_end(2);
 
-    autofire_cps_args.value = arg_int1(NULL, NULL, "<cps>", "clicks per second (cps)");
-    autofire_cps_args.end = arg_end(2);
+    autofire_cps_args.value = arg_int0(NULL, NULL, "<cps>", "clicks per second (cps)");
+    autofire_cps_args.port = arg_str0("p", "port", "<a|b>", "only for the given port. Default: both ports");
+    autofire_cps_args.duty = arg_int0("d", "duty", "<duty>", "percentage of the period that fire is pressed");
+    autofire_cps_args.end = arg_end(4);
+
+    joystick_profile_args.name = arg_str0(NULL, NULL, "<name>", "profile to use, or 'none' for the built-in ones");
+    joystick_profile_args.port = arg_str0("p", "port", "<a|b>", "only for the given port. Default: both ports");
+    joystick_profile_args.rules = arg_str0("r", "rules", "<rules>", "adds / replaces the custom profile <name>");
+    joystick_profile_args.end = arg_end(4);
 
     const esp_console_cmd_t swap_ports = {
         .command = "swap_ports",
@@ -844,13 +943,25 @@ static void unijoysticle_register_cmds(void) {
     const esp_console_cmd_t autofire_cps = {
         .command = "autofire_cps",
         .help =
-            "Get/Set the autofire 'clicks per second' (cps)\n"
-            "Default: 7",
+            "Get/Set the autofire 'clicks per second' (cps) and duty cycle\n"
+            "Default: 7 cps, 50% duty",
         .hint = NULL,
         .func = &cmd_autofire_cps,
         .argtable = &autofire_cps_args,
     };
 
+    const esp_console_cmd_t joystick_profile = {
+        .command = "joystick_profile",
+        .help =
+            "Get/Set the gamepad to joystick conversion profile of each port\n"
+            "  Rules: '<source>:<line>,...'. E.g: 'a:fire,b:up,x-:left,x+:right,dpad_up:up'\n"
+            "  Profiles with 'j2.' lines are used in twinstick mode, only in port A. The rest in normal mode.\n"
+            "  Stored in NVS, with the rules of the custom profiles. Default: none",
+        .hint = NULL,
+        .func = &cmd_joystick_profile,
+        .argtable = &joystick_profile_args,
+    };
+
     const esp_console_cmd_t version = {
         .command = "version",
         .help = "Gets the Unijoysticle version info",
@@ -861,6 +972,7 @@ static void unijoysticle_register_cmds(void) {
     ESP_ERROR_CHECK(esp_console_cmd_register(&swap_ports));
     ESP_ERROR_CHECK(esp_console_cmd_register(&gamepad_mode));
     ESP_ERROR_CHECK(esp_console_cmd_register(&autofire_cps));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&joystick_profile));
 
     uni_balance_board_register_cmds();
 
@@ -899,21 +1011,34 @@ static int get_uni_serial_number_from_nvs(void) {
     return value.u32;
 }
 
-static void set_autofire_cps_to_nvs(int cps) {
+static void set_autofire_property_to_nvs(uni_property_idx_t idx, int v) {
     uni_property_value_t value;
-    value.u8 = cps;
+    value.u8 = v;
 
-    uni_property_set(UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS, value);
+    uni_property_set(idx, value);
     logi("Done\n");
 }
 
-static int get_autofire_cps_from_nvs(void) {
+static int get_autofire_property_from_nvs(uni_property_idx_t idx) {
     uni_property_value_t value;
 
-    value = uni_property_get(UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS);
+    value = uni_property_get(idx);
     return value.u8;
 }
 
+static void update_autofire_rates(void) {
+    int cps_a = get_autofire_property_from_nvs(UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS);
+    int cps_b = get_autofire_property_from_nvs(UNI_PROPERTY_IDX_UNI_AF_B_CPS);
+    int duty = get_autofire_property_from_nvs(UNI_PROPERTY_IDX_UNI_AF_DUTY);
+
+    // 0 means that Port B uses the same rate as Port A
+    if (cps_b == 0)
+        cps_b = cps_a;
+
+    uni_autofire_set_rate(g_autofire_channels[0], cps_a, duty);
+    uni_autofire_set_rate(g_autofire_channels[1], cps_b, duty);
+}
+
 static board_model_t get_uni_model_from_pins(void) {
 #if PLAT_UNIJOYSTICLE_SINGLE_PORT
     // Legacy: Only needed for Arananet's Unijoy2Amiga.
@@ -948,11 +1073,11 @@ static board_model_t get_uni_model_from_pins(void) {
     gpio_set_direction(GPIO_NUM_36, GPIO_MODE_INPUT);
     gpio_set_direction(GPIO_NUM_39, GPIO_MODE_INPUT);
 
-    int gpio_4 = gpio_get_level(GPIO_NUM_4);
-    int gpio_5 = gpio_get_level(GPIO_NUM_5);
-    int gpio_15 = gpio_get_level(GPIO_NUM_15);
-    int gpio_36 = gpio_get_level(GPIO_NUM_36);
-    int gpio_39 = gpio_get_level(GPIO_NUM_39);
+    int gpio_4 = uni_gpio_hal_get_level(GPIO_NUM_4);
+    int gpio_5 = uni_gpio_hal_get_level(GPIO_NUM_5);
+    int gpio_15 = uni_gpio_hal_get_level(GPIO_NUM_15);
+    int gpio_36 = uni_gpio_hal_get_level(GPIO_NUM_36);
+    int gpio_39 = uni_gpio_hal_get_level(GPIO_NUM_39);
 
     logi("Unijoysticle: Board ID values: %d,%d,%d,%d,%d\n", gpio_4, gpio_5, gpio_15, gpio_36, gpio_39);
     if (gpio_4 == 1 && gpio_5 == 0 && gpio_15 == 1 && gpio_36 == 0 && gpio_39 == 1)
@@ -994,8 +1119,6 @@ static void process_mouse(uni_hid_device_t* d,
     if (!(g_variant->flags & UNI_PLATFORM_UNIJOYSTICLE_VARIANT_FLAG_QUADRATURE_MOUSE))
         return;
 
-    static uint16_t prev_buttons = 0;
-
     if (mouse_emulation_cached == UNI_PLATFORM_UNIJOYSTICLE_MOUSE_EMULATION_ATARIST) {
         if (delta_x < -ATARIST_MOUSE_DELTA_MAX)
             delta_x = -ATARIST_MOUSE_DELTA_MAX;
@@ -1010,49 +1133,66 @@ static void process_mouse(uni_hid_device_t* d,
     logd("unijoysticle: seat: %d, mouse: x=%d, y=%d, buttons=0x%04x\n", seat, delta_x, delta_y, buttons);
 
     int port_idx = (seat == GAMEPAD_SEAT_A) ? UNI_MOUSE_QUADRATURE_PORT_0 : UNI_MOUSE_QUADRATURE_PORT_1;
+    uni_gpio_port_t* port = uni_platform_unijoysticle_get_port(seat);
+    uint32_t levels = 0;
 
     uni_mouse_quadrature_update(port_idx, delta_x, delta_y);
-
-    if (buttons != prev_buttons) {
-        prev_buttons = buttons;
-        int fire, button2, button3;
-        if (seat == GAMEPAD_SEAT_A) {
-            fire = g_gpio_config->port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE];
-            button2 = g_gpio_config->port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON2];
-            button3 = g_gpio_config->port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON3];
-        } else {
-            fire = g_gpio_config->port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE];
-            button2 = g_gpio_config->port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON2];
-            button3 = g_gpio_config->port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON3];
-        }
-        if (fire != -1)
-            gpio_set_level(fire, (buttons & BUTTON_A) != 0);
-        if (button2 != -1)
-            gpio_set_level(button2, (buttons & BUTTON_B) != 0);
-        if (button3 != -1)
-            gpio_set_level(button3, (buttons & BUTTON_X) != 0);
-    }
+    // Direction lines are driven by the quadrature encoder, not by the port.
+    uni_gpio_port_invalidate(port, JOY_LINES_DIRECTIONS);
+
+    if (buttons & BUTTON_A)
+        levels |= JOY_LINE(FIRE);
+    if (buttons & BUTTON_B)
+        levels |= JOY_LINE(BUTTON2);
+    if (buttons & BUTTON_X)
+        levels |= JOY_LINE(BUTTON3);
+    uni_gpio_port_write(port, levels, JOY_LINE(FIRE) | JOY_LINES_POTS);
 }
 
 static void process_joystick(uni_hid_device_t* d, uni_gamepad_seat_t seat, const uni_joystick_t* joy) {
+    int idx;
+
     ARG_UNUSED(d);
     if (seat == GAMEPAD_SEAT_A) {
-        joy_update_port(joy, g_gpio_config->port_a);
-        g_autofire_a_enabled = joy->auto_fire;
+        idx = 0;
     } else if (seat == GAMEPAD_SEAT_B) {
-        joy_update_port(joy, g_gpio_config->port_b);
-        g_autofire_b_enabled = joy->auto_fire;
+        idx = 1;
     } else {
         loge("unijoysticle: process_joystick: invalid gamepad seat: %d\n", seat);
+        return;
     }
 
-    if (g_autofire_a_enabled || g_autofire_b_enabled) {
-        xEventGroupSetBits(g_autofire_group, BIT(EVENT_AUTOFIRE_TRIGGER));
-    }
+    // Autofire owns the fire line while it is running.
+    // Stopped before the port update, so that fire gets its real value.
+    if (!joy->auto_fire)
+        uni_autofire_stop(g_autofire_channels[idx]);
+
+    joy_update_port(joy, &g_joy_ports[idx], (idx == 0) ? g_gpio_config->port_a : g_gpio_config->port_b);
+
+    if (joy->auto_fire)
+        uni_autofire_start(g_autofire_channels[idx]);
+}
+
+// Custom profile of the seat's port, if it controls "joys" joysticks.
+// In twinstick mode the seat is A and B: the profile of port A is used.
+static const uni_joystick_profile_t* get_custom_profile(uni_gamepad_seat_t seat, int joys) {
+    const uni_joystick_profile_t* profile;
+
+    if (seat & GAMEPAD_SEAT_A)
+        profile = g_port_profiles[0];
+    else if (seat & GAMEPAD_SEAT_B)
+        profile = g_port_profiles[1];
+    else
+        return NULL;
+
+    if (profile == NULL || profile->joys != joys)
+        return NULL;
+    return profile;
 }
 
 static void process_gamepad(uni_hid_device_t* d, uni_gamepad_t* gp) {
     uni_platform_unijoysticle_instance_t* ins = uni_platform_unijoysticle_get_instance(d);
+    const uni_joystick_profile_t* profile;
 
     uni_joystick_t joy, joy_ext;
     memset(&joy, 0, sizeof(joy));
@@ -1062,16 +1202,23 @@ static void process_gamepad(uni_hid_device_t* d, uni_gamepad_t* gp) {
         case UNI_PLATFORM_UNIJOYSTICLE_GAMEPAD_MODE_NORMAL:
             // Special case when the accelerometer mode is enabled in Wii.
             // Use it as regular joystick
+            profile = get_custom_profile(ins->seat, 1);
             if (d->controller_type == CONTROLLER_TYPE_WiiController &&
                 d->controller_subtype == CONTROLLER_SUBTYPE_WIIMOTE_ACCEL)
                 uni_joy_to_single_from_wii_accel(gp, &joy);
+            else if (profile)
+                uni_joystick_profile_apply(profile, gp, &joy, NULL);
             else
                 uni_joy_to_single_joy_from_gamepad(
                     gp, &joy, g_variant->flags & UNI_PLATFORM_UNIJOYSTICLE_VARIANT_FLAG_TWO_BUTTONS);
             process_joystick(d, ins->seat, &joy);
             break;
         case UNI_PLATFORM_UNIJOYSTICLE_GAMEPAD_MODE_TWINSTICK:
-            uni_joy_to_twinstick_from_gamepad(gp, &joy, &joy_ext);
+            profile = get_custom_profile(ins->seat, 2);
+            if (profile)
+                uni_joystick_profile_apply(profile, gp, &joy, &joy_ext);
+            else
+                uni_joy_to_twinstick_from_gamepad(gp, &joy, &joy_ext);
             if (ins->swap_ports_in_twinstick) {
                 process_joystick(d, GAMEPAD_SEAT_B, &joy);
                 process_joystick(d, GAMEPAD_SEAT_A, &joy_ext);
@@ -1195,27 +1342,36 @@ static void set_gamepad_seat(uni_hid_device_t* d, uni_gamepad_seat_t seat) {
     }
 }
 
-static void joy_update_port(const uni_joystick_t* joy, const gpio_num_t* gpios) {
+static void joy_update_port(const uni_joystick_t* joy, uni_gpio_port_t* port, const gpio_num_t* gpios) {
+    uint32_t levels = 0;
+    uint32_t mask = JOY_LINES_DIRECTIONS;
+
     logd("up=%d, down=%d, left=%d, right=%d, fire=%d, bt2=%d, bt3=%d\n", joy->up, joy->down, joy->left, joy->right,
          joy->fire, joy->button2, joy->button3);
 
-    uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_UP], joy->up);
-    uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_DOWN], joy->down);
-    uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_LEFT], joy->left);
-    uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_RIGHT], joy->right);
+    levels |= joy->up ? JOY_LINE(UP) : 0;
+    levels |= joy->down ? JOY_LINE(DOWN) : 0;
+    levels |= joy->left ? JOY_LINE(LEFT) : 0;
+    levels |= joy->right ? JOY_LINE(RIGHT) : 0;
+    levels |= joy->fire ? JOY_LINE(FIRE) : 0;
+    levels |= joy->button2 ? JOY_LINE(BUTTON2) : 0;
+    levels |= joy->button3 ? JOY_LINE(BUTTON3) : 0;
 
     // Only update fire if auto-fire is off. Otherwise, it will conflict.
-    if (!joy->auto_fire) {
-        uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE], joy->fire);
-    }
+    if (!joy->auto_fire)
+        mask |= JOY_LINE(FIRE);
 
     if (g_variant->set_gpio_level_for_pot) {
+        // The variant drives the pots by itself.
         g_variant->set_gpio_level_for_pot(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON2], joy->button2);
         g_variant->set_gpio_level_for_pot(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON3], joy->button3);
+        uni_gpio_port_invalidate(port, JOY_LINES_POTS);
     } else {
-        uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON2], joy->button2);
-        uni_gpio_set_level(gpios[UNI_PLATFORM_UNIJOYSTICLE_JOY_BUTTON3], joy->button3);
+        mask |= JOY_LINES_POTS;
     }
+
+    // All lines at once. Skipped if nothing changed.
+    uni_gpio_port_write(port, levels, mask);
 }
 
 _Noreturn static void pushbutton_event_task(void* arg) {
@@ -1237,44 +1393,6 @@ _Noreturn static void pushbutton_event_task(void* arg) {
     }
 }
 
-_Noreturn static void auto_fire_task(void* arg) {
-    // timeout of 100s
-    const TickType_t timeout = pdMS_TO_TICKS(100000);
-    int ms = 1000 / get_autofire_cps_from_nvs() / 2;
-    TickType_t delay_ticks = pdMS_TO_TICKS(ms);
-    while (1) {
-        EventBits_t bits = xEventGroupWaitBits(
-            g_autofire_group, BIT(EVENT_AUTOFIRE_TRIGGER) | BIT(EVENT_AUTOFIRE_CONFIG), pdTRUE, pdFALSE, timeout);
-
-        // timeout ?
-        if (bits == 0)
-            continue;
-
-        if (bits & BIT(EVENT_AUTOFIRE_CONFIG)) {
-            ms = 1000 / get_autofire_cps_from_nvs() / 2;
-            delay_ticks = pdMS_TO_TICKS(ms);
-        }
-
-        if (bits & BIT(EVENT_AUTOFIRE_TRIGGER)) {
-            while (g_autofire_a_enabled || g_autofire_b_enabled) {
-                if (g_autofire_a_enabled)
-                    uni_gpio_set_level(g_gpio_config->port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE], 1);
-                if (g_autofire_b_enabled)
-                    uni_gpio_set_level(g_gpio_config->port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE], 1);
-
-                vTaskDelay(delay_ticks);
-
-                if (g_autofire_a_enabled)
-                    uni_gpio_set_level(g_gpio_config->port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE], 0);
-                if (g_autofire_b_enabled)
-                    uni_gpio_set_level(g_gpio_config->port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_FIRE], 0);
-
-                vTaskDelay(delay_ticks);
-            }
-        }
-    }
-}
-
 static void gpio_isr_handler_button(void* arg) {
     int button_idx = (int)arg;
 
@@ -1284,7 +1402,7 @@ static void gpio_isr_handler_button(void* arg) {
     struct push_button_state* st = &g_push_buttons_state[button_idx];
 
     // Button released?
-    if (gpio_get_level(pb->gpio)) {
+    if (uni_gpio_hal_get_level(pb->gpio)) {
         st->last_time_pressed_us = esp_timer_get_time();
         return;
     }
@@ -1314,7 +1432,7 @@ static void handle_event_button(int button_idx) {
     st->last_time_pressed_us = now;
 
     // "up" button is released. Ignore event.
-    if (gpio_get_level(pb->gpio)) {
+    if (uni_gpio_hal_get_level(pb->gpio)) {
         return;
     }
 
@@ -1325,9 +1443,8 @@ static void handle_event_button(int button_idx) {
     pb->callback(button_idx);
 }
 
-static void cmd_callback(void* context) {
-    uni_platform_unijoysticle_cmd_t cmd = (uni_platform_unijoysticle_cmd_t)context;
-    switch (cmd) {
+static void cmd_handler(const uni_bt_cmd_t* cmd) {
+    switch (cmd->cmd) {
         case UNI_PLATFORM_UNIJOYSTICLE_CMD_SWAP_PORTS:
             swap_ports();
             break;
@@ -1358,6 +1475,14 @@ static void cmd_callback(void* context) {
         case UNI_PLATFORM_UNIJOYSTICLE_CMD_SET_C64_POT_MODE_PADDLE:
             uni_platform_unijoysticle_c64_set_pot_mode(UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_PADDLE);
             break;
+        case UNI_PLATFORM_UNIJOYSTICLE_CMD_LOAD_JOYSTICK_PROFILES:
+            load_joystick_profiles();
+            print_joystick_profiles();
+            break;
+        case UNI_PLATFORM_UNIJOYSTICLE_CMD_GET_JOYSTICK_PROFILES:
+            uni_joystick_profile_dump_all();
+            print_joystick_profiles();
+            break;
         default:
             loge("Unijoysticle: invalid command: %d\n", cmd);
             break;
@@ -1387,6 +1512,10 @@ static void version(void) {
     if (g_variant->print_version)
         g_variant->print_version();
 
+    uni_gpio_port_dump(&g_joy_ports[0], "Port A");
+    uni_gpio_port_dump(&g_joy_ports[1], "Port B");
+    uni_autofire_dump();
+
     if (esp_flash_get_size(NULL, &flash_size) != ESP_OK) {
         loge("Flash size failed\n");
         flash_size = 0;
@@ -1711,23 +1840,182 @@ static int cmd_swap_ports(int argc, char** argv) {
 }
 
 static int cmd_autofire_cps(int argc, char** argv) {
-    int cps;
+    int cps, duty;
+    uint8_t rate_cps, rate_duty;
+    const char* port = NULL;
 
     int nerrors = arg_parse(argc, argv, (void**)&autofire_cps_args);
     if (nerrors != 0) {
         arg_print_errors(stderr, autofire_cps_args.end, argv[0]);
+        return 1;
+    }
 
-        // Don't treat as error, just print current value.
-        cps = get_autofire_cps_from_nvs();
-        logi("%d\n", cps);
+    if (autofire_cps_args.port->count > 0) {
+        port = autofire_cps_args.port->sval[0];
+        if (strcmp(port, "a") != 0 && strcmp(port, "b") != 0) {
+            loge("Invalid port: %s. Valid options: 'a' or 'b'\n", port);
+            return 1;
+        }
+    }
+
+    if (autofire_cps_args.duty->count > 0) {
+        duty = autofire_cps_args.duty->ival[0];
+        if (duty < UNI_AUTOFIRE_DUTY_MIN || duty > UNI_AUTOFIRE_DUTY_MAX) {
+            loge("Invalid duty: %d. Valid range: %d - %d\n", duty, UNI_AUTOFIRE_DUTY_MIN, UNI_AUTOFIRE_DUTY_MAX);
+            return 1;
+        }
+        set_autofire_property_to_nvs(UNI_PROPERTY_IDX_UNI_AF_DUTY, duty);
+    }
+
+    if (autofire_cps_args.value->count > 0) {
+        cps = autofire_cps_args.value->ival[0];
+        if (cps < UNI_AUTOFIRE_CPS_MIN || cps > UNI_AUTOFIRE_CPS_MAX) {
+            loge("Invalid cps: %d. Valid range: %d - %d\n", cps, UNI_AUTOFIRE_CPS_MIN, UNI_AUTOFIRE_CPS_MAX);
+            return 1;
+        }
+        if (port == NULL) {
+            set_autofire_property_to_nvs(UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS, cps);
+            set_autofire_property_to_nvs(UNI_PROPERTY_IDX_UNI_AF_B_CPS, 0);
+        } else if (port[0] == 'a') {
+            // Port B should not follow the new Port A rate.
+            if (get_autofire_property_from_nvs(UNI_PROPERTY_IDX_UNI_AF_B_CPS) == 0)
+                set_autofire_property_to_nvs(UNI_PROPERTY_IDX_UNI_AF_B_CPS,
+                                             get_autofire_property_from_nvs(UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS));
+            set_autofire_property_to_nvs(UNI_PROPERTY_IDX_UNI_AUTOFIRE_CPS, cps);
+        } else {
+            set_autofire_property_to_nvs(UNI_PROPERTY_IDX_UNI_AF_B_CPS, cps);
+        }
+    }
+
+    update_autofire_rates();
+
+    for (int i = 0; i < 2; i++) {
+        uni_autofire_get_rate(g_autofire_channels[i], &rate_cps, &rate_duty);
+        logi("Port %c: %d cps, %d%% duty\n", 'A' + i, rate_cps, rate_duty);
+    }
+    return 0;
+}
+
+// Joysticks controlled by the profile, or -1 if the rules are invalid.
+// Uses its own copy: the loaded profiles belong to the Bluetooth task.
+static int get_joystick_profile_joys(const char* name, const uni_joystick_profile_rule_t* rules, int count) {
+    static uni_joystick_profile_t profile;
+
+    if (uni_joystick_profile_is_builtin(name))
+        return uni_joystick_profile_find(name)->joys;
+    if (uni_joystick_profile_compile(&profile, name, rules, count) != 0)
+        return -1;
+    return profile.joys;
+}
+
+static int cmd_joystick_profile(int argc, char** argv) {
+    // Too big for the stack. Only called from the console task.
+    static joystick_profiles_blob_t blob;
+    static uni_joystick_profile_rule_t rules[UNI_JOYSTICK_PROFILE_MAX_RULES];
+    int count = 0;
+    int joys;
+    const char* name;
+    const char* port = NULL;
+    bool found;
+
+    int nerrors = arg_parse(argc, argv, (void**)&joystick_profile_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, joystick_profile_args.end, argv[0]);
+        return 1;
+    }
+
+    if (joystick_profile_args.port->count > 0) {
+        port = joystick_profile_args.port->sval[0];
+        if (strcmp(port, "a") != 0 && strcmp(port, "b") != 0) {
+            loge("Invalid port: %s. Valid options: 'a' or 'b'\n", port);
+            return 1;
+        }
+    }
+
+    // Profiles are only accessed from the Bluetooth task.
+    if (joystick_profile_args.name->count == 0) {
+        uni_platform_unijoysticle_run_cmd(UNI_PLATFORM_UNIJOYSTICLE_CMD_GET_JOYSTICK_PROFILES);
         return 0;
     }
-    cps = autofire_cps_args.value->ival[0];
-    set_autofire_cps_to_nvs(cps);
 
-    logi("New autofire cps: %d\n", cps);
+    name = joystick_profile_args.name->sval[0];
+    if (strlen(name) == 0 || strlen(name) >= UNI_JOYSTICK_PROFILE_NAME_LEN) {
+        loge("Invalid profile: %s\n", name);
+        return 1;
+    }
+
+    get_joystick_profiles_from_nvs(&blob);
+    memset(rules, 0, sizeof(rules));
 
-    xEventGroupSetBits(g_autofire_group, BIT(EVENT_AUTOFIRE_CONFIG));
+    if (strcmp(name, "none") == 0) {
+        if (joystick_profile_args.rules->count > 0) {
+            loge("Invalid profile: 'none' cannot have rules\n");
+            return 1;
+        }
+        name = "";
+    } else if (joystick_profile_args.rules->count > 0) {
+        if (uni_joystick_profile_is_builtin(name)) {
+            loge("Cannot replace built-in profile: %s\n", name);
+            return 1;
+        }
+        count = uni_joystick_profile_parse(joystick_profile_args.rules->sval[0], rules, ARRAY_SIZE(rules));
+        if (count < 0)
+            return 1;
+        // Replaced: the ports that use it get the new rules as well.
+        for (int i = 0; i < ARRAY_SIZE(blob.ports); i++) {
+            if (strcmp(blob.ports[i].name, name) == 0) {
+                blob.ports[i].count = count;
+                memcpy(blob.ports[i].rules, rules, sizeof(rules));
+            }
+        }
+    } else if (!uni_joystick_profile_is_builtin(name)) {
+        // Custom profile: its rules are the ones stored in another port.
+        found = false;
+        for (int i = 0; i < ARRAY_SIZE(blob.ports); i++) {
+            if (strcmp(blob.ports[i].name, name) == 0) {
+                count = blob.ports[i].count;
+                memcpy(rules, blob.ports[i].rules, sizeof(rules));
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            loge("Invalid profile: %s. New profiles need --rules\n", name);
+            return 1;
+        }
+    }
+
+    // Normal mode uses the profiles with one joystick, of each port. Twinstick, the ones with two, of port A.
+    // In port B they would never be used.
+    joys = (name[0] != 0) ? get_joystick_profile_joys(name, rules, count) : 1;
+    if (joys < 0)
+        return 1;
+    if (joys > 1) {
+        if (port != NULL && port[0] == 'b') {
+            loge("Invalid port: profiles with 'j2.' lines are for twinstick mode, which only uses port A\n");
+            return 1;
+        }
+        // New rules for a name that port B uses: port B would get them as well.
+        if (joystick_profile_args.rules->count > 0 && strcmp(blob.ports[1].name, name) == 0) {
+            loge("Invalid rules: '%s' is used by port B, and 'j2.' lines only work in port A\n", name);
+            return 1;
+        }
+        if (port == NULL) {
+            logi("Profile with 'j2.' lines, for twinstick mode: only set in port A\n");
+            port = "a";
+        }
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(blob.ports); i++) {
+        if (port != NULL && port[0] != 'a' + i)
+            continue;
+        snprintf(blob.ports[i].name, sizeof(blob.ports[i].name), "%s", name);
+        blob.ports[i].count = count;
+        memcpy(blob.ports[i].rules, rules, sizeof(rules));
+    }
+
+    set_joystick_profiles_to_nvs(&blob);
+    uni_platform_unijoysticle_run_cmd(UNI_PLATFORM_UNIJOYSTICLE_CMD_LOAD_JOYSTICK_PROFILES);
     return 0;
 }
 
@@ -1804,9 +2092,12 @@ static void maybe_enable_bluetooth(bool enabled) {
 // "Protected": Called from variants
 //
 void uni_platform_unijoysticle_run_cmd(uni_platform_unijoysticle_cmd_t cmd) {
-    cmd_callback_registration.callback = &cmd_callback;
-    cmd_callback_registration.context = (void*)cmd;
-    btstack_run_loop_execute_on_main_thread(&cmd_callback_registration);
+    uni_bt_cmd_t bt_cmd = {
+        .handler = &cmd_handler,
+        .cmd = cmd,
+    };
+    if (!uni_bt_cmd_queue_push(&bt_cmd))
+        loge("unijoysticle: command %d dropped, queue full\n", cmd);
 }
 
 void uni_platform_unijoysticle_on_push_button_mode_pressed(int button_idx) {
@@ -1831,6 +2122,7 @@ struct uni_platform* uni_platform_unijoysticle_create(void) {
         .on_device_connected = unijoysticle_on_device_connected,
         .on_device_disconnected = unijoysticle_on_device_disconnected,
         .on_device_ready = unijoysticle_on_device_ready,
+        .get_free_seats = unijoysticle_get_free_seats,
         .on_oob_event = unijoysticle_on_oob_event,
         .on_controller_data = unijoysticle_on_controller_data,
         .get_property = unijoysticle_get_property,
@@ -1844,3 +2136,7 @@ struct uni_platform* uni_platform_unijoysticle_create(void) {
 uni_platform_unijoysticle_instance_t* uni_platform_unijoysticle_get_instance(const uni_hid_device_t* d) {
     return (uni_platform_unijoysticle_instance_t*)&d->platform_data[0];
 }
+
+uni_gpio_port_t* uni_platform_unijoysticle_get_port(uni_gamepad_seat_t seat) {
+    return (seat == GAMEPAD_SEAT_B) ? &g_joy_ports[1] : &g_joy_ports[0];
+}
@@ -8,10 +8,12 @@
 
 #include "platform/uni_platform_unijoysticle_c64.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <sys/cdefs.h>
 
 #include <argtable3/argtable3.h>
+#include <driver/timer.h>
 #include <esp_console.h>
 #include <esp_err.h>
 #include <freertos/FreeRTOS.h>
@@ -19,15 +21,25 @@
 
 #include "sdkconfig.h"
 
+#include "bt/uni_bt_cmd_queue.h"
 #include "platform/uni_platform_unijoysticle.h"
 #include "uni_common.h"
 #include "uni_gpio.h"
+#include "uni_gpio_hal.h"
 #include "uni_log.h"
+#include "uni_pot_timing.h"
 #include "uni_property.h"
 
 #define TASK_SYNC_IRQ_PRIO (9)
-#define uS_MIN 3
-#define uS_MAX 243  // Larger values cause the interrupt to take too long
+
+// Paddle timer. Free, since C64 doesn't support the quadrature mouse.
+#define POT_TIMER_GROUP TIMER_GROUP_0
+#define POT_TIMER_IDX TIMER_0
+// 80Mhz / 16 = 5Mhz: 0.2us resolution
+#define POT_TIMER_DIVIDER 16
+#define POT_TIMER_TICKS_PER_US 5
+// Alarms closer than this might be missed: the line is released by spinning instead.
+#define POT_TIMER_MIN_ALARM_TICKS (2 * POT_TIMER_TICKS_PER_US)
 
 // CPU where the Pot task runs
 #define POT_TASK_CPU 1
@@ -43,9 +55,8 @@ static int get_c64_pot_mode_from_nvs(void);
 // GPIO Interrupt handlers
 _Noreturn static void sync_irq_event_task(void* arg);
 
-static volatile bool pot_x_leads = true;  // if false, y leads
-static volatile uint16_t pot_x_delay_us = uS_MAX;
-static volatile uint16_t pot_y_delay_us = uS_MAX;
+// Paddle values: X in the low byte, Y in the high byte. Both read at once by the sync ISR.
+static atomic_uint pot_values = 0x8080;
 
 // --- Consts (ROM)
 
@@ -79,6 +90,7 @@ static const char* c64_pot_modes[] = {
     "3buttons",  // UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_3BUTTONS
     "5buttons",  // UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_5BUTTONS
     "rumble",    // UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_RUMBLE
+    "paddle",    // UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_PADDLE
 };
 
 // Globals to the file (RAM)
@@ -86,13 +98,20 @@ static EventGroupHandle_t _sync_irq_group;
 static TaskHandle_t _sync_task;
 uni_platform_unijoysticle_c64_pot_mode_t _pot_mode = UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_INVALID;
 
+// Paddle: current measurement. Only used by the ISRs.
+static const gpio_num_t pot_gpios[UNI_POT_TIMING_LINE_MAX] = {GPIO_NUM_16, GPIO_NUM_33};
+static uni_pot_timing_schedule_t pot_schedule;
+static uint64_t pot_sync_ticks;
+static int pot_next_line;
+// Paddle stats
+static uint32_t pot_measurements;
+static uint32_t pot_max_late_ticks;
+
 static struct {
     struct arg_str* value;
     struct arg_end* end;
 } c64_pot_mode_args;
 
-static btstack_context_callback_registration_t syncirq_callback_registration;
-
 //
 // Helpers
 //
@@ -112,8 +131,8 @@ static int get_c64_pot_mode_from_nvs(void) {
     return value.u8;
 }
 
-static void enable_rumble_callback(void* context) {
-    int seat = (int)context;
+static void enable_rumble_handler(const uni_bt_cmd_t* cmd) {
+    int seat = cmd->args.value;
     uni_hid_device_t* d;
 
     for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
@@ -130,6 +149,16 @@ static void enable_rumble_callback(void* context) {
     }
 }
 
+static void push_enable_rumble(int seat) {
+    uni_bt_cmd_t cmd = {
+        .handler = &enable_rumble_handler,
+        .args.value = seat,
+    };
+    // Each port gets its own command. Sharing a registration lost one of them when both IRQs fired.
+    if (!uni_bt_cmd_queue_push(&cmd))
+        loge("Unijoysticle C64: rumble for seat %d dropped: queue full\n", seat);
+}
+
 _Noreturn static void sync_irq_event_task(void* arg) {
     // timeout of 100s
     const TickType_t xTicksToWait = pdMS_TO_TICKS(100000);
@@ -145,16 +174,12 @@ _Noreturn static void sync_irq_event_task(void* arg) {
         // They should be considered "hi" events.
         if (bits & BIT(EVENT_SYNC_IRQ_0)) {
             // gpio_set_level(g_gpio_config->leds[LED_J1], 1);
-            syncirq_callback_registration.callback = &enable_rumble_callback;
-            syncirq_callback_registration.context = (void*)(GAMEPAD_SEAT_A);
-            btstack_run_loop_execute_on_main_thread(&syncirq_callback_registration);
+            push_enable_rumble(GAMEPAD_SEAT_A);
         }
 
         if (bits & BIT(EVENT_SYNC_IRQ_1)) {
             // gpio_set_level(g_gpio_config->leds[LED_J2], 1);
-            syncirq_callback_registration.callback = &enable_rumble_callback;
-            syncirq_callback_registration.context = (void*)(GAMEPAD_SEAT_B);
-            btstack_run_loop_execute_on_main_thread(&syncirq_callback_registration);
+            push_enable_rumble(GAMEPAD_SEAT_B);
         }
     }
 }
@@ -168,37 +193,81 @@ static IRAM_ATTR void gpio_isr_handler_sync(void* arg) {
         portYIELD_FROM_ISR();
 }
 
-inline void delay_us(uint32_t delay) {
-#if ESP_IDF_VERSION_MAJOR == 4
-    ets_delay_us(delay);
-#else
-    esp_rom_delay_us(delay);
-#endif
+static IRAM_ATTR void pot_release_line(int idx, uint64_t now) {
+    uint64_t due = pot_sync_ticks + pot_schedule.ticks[idx];
+
+    if (now > due && now - due > pot_max_late_ticks)
+        pot_max_late_ticks = now - due;
+    uni_gpio_hal_set_level(pot_gpios[pot_schedule.lines[idx]], 0);
+}
+
+static IRAM_ATTR bool pot_timer_handler(void* arg) {
+    uint64_t now;
+    uint64_t due;
+
+    while (pot_next_line < UNI_POT_TIMING_LINE_MAX) {
+        now = timer_group_get_counter_value_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX);
+        due = pot_sync_ticks + pot_schedule.ticks[pot_next_line];
+        if (due > now && due - now >= POT_TIMER_MIN_ALARM_TICKS) {
+            // The alarm gets disabled every time it fires.
+            timer_group_set_alarm_value_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX, due);
+            timer_group_enable_alarm_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX);
+            break;
+        }
+        // Due, or too close to arm the alarm.
+        while (now < due)
+            now = timer_group_get_counter_value_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX);
+        pot_release_line(pot_next_line, now);
+        pot_next_line++;
+    }
+
+    // No task was woken up.
+    return false;
 }
 
 static IRAM_ATTR void gpio_isr_handler_paddle(void* arg) {
-    // From:
+    // Based on:
     // https://github.com/LeifBloomquist/JoystickEmulator/blob/master/Arduino/PaddleEmulator/PaddleEmulator.ino
-    gpio_set_level(GPIO_NUM_16, 1);
-    gpio_set_level(GPIO_NUM_33, 1);
-
-    // Wait while the SID discharges the capacitor.
-    // According to the spec, this should be 320 microseconds.
-    // With function overhead and so on, this seems about right.
-    delay_us(220);
-
-    // Now, delay the amount required to represent the desired values.
-    if (pot_x_leads) {
-        delay_us(pot_x_delay_us);
-        gpio_set_level(GPIO_NUM_16, 0);
-        delay_us(pot_y_delay_us);  // This is a delta!
-        gpio_set_level(GPIO_NUM_33, 0);
-    } else {
-        delay_us(pot_y_delay_us);
-        gpio_set_level(GPIO_NUM_33, 0);
-        delay_us(pot_x_delay_us);  // This is a delta!
-        gpio_set_level(GPIO_NUM_16, 0);
+    // But instead of busy-waiting, the lines are released by the timer.
+    unsigned int values = atomic_load(&pot_values);
+
+    uni_gpio_hal_set_level(pot_gpios[UNI_POT_TIMING_LINE_X], 1);
+    uni_gpio_hal_set_level(pot_gpios[UNI_POT_TIMING_LINE_Y], 1);
+
+    // Relative to the sync edge. The SID discharges the capacitor first.
+    pot_sync_ticks = timer_group_get_counter_value_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX);
+    uni_pot_timing_compute(values & 0xff, values >> 8, POT_TIMER_TICKS_PER_US, &pot_schedule);
+    pot_next_line = 0;
+    pot_measurements++;
+
+    timer_group_set_alarm_value_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX, pot_sync_ticks + pot_schedule.ticks[0]);
+    timer_group_enable_alarm_in_isr(POT_TIMER_GROUP, POT_TIMER_IDX);
+}
+
+static void enable_paddle(void) {
+    const timer_config_t config = {
+        .divider = POT_TIMER_DIVIDER,
+        .counter_dir = TIMER_COUNT_UP,
+        .counter_en = TIMER_PAUSE,
+        .alarm_en = TIMER_ALARM_DIS,
+        .auto_reload = TIMER_AUTORELOAD_DIS,
+    };
+
+    // Free running. Alarms are set from the sync edge.
+    ESP_ERROR_CHECK(timer_init(POT_TIMER_GROUP, POT_TIMER_IDX, &config));
+    timer_set_counter_value(POT_TIMER_GROUP, POT_TIMER_IDX, 0);
+    timer_isr_callback_add(POT_TIMER_GROUP, POT_TIMER_IDX, pot_timer_handler, NULL, 0);
+    timer_start(POT_TIMER_GROUP, POT_TIMER_IDX);
+}
+
+static void disable_paddle(void) {
+    gpio_num_t gpio = gpio_config_univ2c64.sync_irq[0];
+
+    if (gpio != -1) {
+        gpio_set_intr_type(gpio, GPIO_INTR_DISABLE);
+        gpio_isr_handler_remove(gpio);
     }
+    timer_deinit(POT_TIMER_GROUP, POT_TIMER_IDX);
 }
 
 static void print_c64_pot_mode(void) {
@@ -257,6 +326,9 @@ static void set_pot_mode_from_cpu(void* m) {
         goto exit;
     }
 
+    if (_pot_mode == UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_PADDLE)
+        disable_paddle();
+
     _pot_mode = mode;
     set_c64_pot_mode_to_nvs(mode);
 
@@ -316,6 +388,9 @@ static void set_pot_mode_from_cpu(void* m) {
             ESP_ERROR_CHECK(gpio_isr_handler_add(gpio, gpio_isr_handler_sync, (void*)i));
         }
     } else if (mode == UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_PADDLE) {
+        // Timer ISR should be registered from the same CPU as the sync one.
+        enable_paddle();
+
         // Sync IRQs
         for (int i = 0; i < 1; i++) {
             gpio_num_t gpio = gpio_config_univ2c64.sync_irq[i];
@@ -349,63 +424,54 @@ void uni_platform_unijoysticle_c64_set_pot_mode(uni_platform_unijoysticle_c64_po
 
 void uni_platform_unijoysticle_c64_version(void) {
     logi("\tPot mode: %s\n", c64_pot_modes[get_c64_pot_mode_from_nvs()]);
+    if (_pot_mode == UNI_PLATFORM_UNIJOYSTICLE_C64_POT_MODE_PADDLE)
+        logi("\tPaddle: measurements=%u, max late=%u ns\n", (unsigned int)pot_measurements,
+             (unsigned int)(pot_max_late_ticks * 1000 / POT_TIMER_TICKS_PER_US));
 }
 
 static void process_5button(uni_hid_device_t* d, uni_gamepad_seat_t seat, uint8_t misc_buttons) {
-    if (misc_buttons & MISC_BUTTON_SELECT) {
-        if (seat & GAMEPAD_SEAT_A) {
-            uni_gpio_set_level(gpio_config_univ2c64.port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_UP], 1);
-            uni_gpio_set_level(gpio_config_univ2c64.port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_DOWN], 1);
-        }
-        if (seat & GAMEPAD_SEAT_B) {
-            uni_gpio_set_level(gpio_config_univ2c64.port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_UP], 1);
-            uni_gpio_set_level(gpio_config_univ2c64.port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_DOWN], 1);
-        }
-    }
+    uint32_t lines = 0;
+
+    // "Select" button
+    if (misc_buttons & MISC_BUTTON_SELECT)
+        lines |= BIT(UNI_PLATFORM_UNIJOYSTICLE_JOY_UP) | BIT(UNI_PLATFORM_UNIJOYSTICLE_JOY_DOWN);
 
     // "Start" buttons
-    if (misc_buttons & MISC_BUTTON_START) {
-        if (seat & GAMEPAD_SEAT_A) {
-            uni_gpio_set_level(gpio_config_univ2c64.port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_LEFT], 1);
-            uni_gpio_set_level(gpio_config_univ2c64.port_a[UNI_PLATFORM_UNIJOYSTICLE_JOY_RIGHT], 1);
-        }
-        if (seat & GAMEPAD_SEAT_B) {
-            uni_gpio_set_level(gpio_config_univ2c64.port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_LEFT], 1);
-            uni_gpio_set_level(gpio_config_univ2c64.port_b[UNI_PLATFORM_UNIJOYSTICLE_JOY_RIGHT], 1);
-        }
-    }
-}
+    if (misc_buttons & MISC_BUTTON_START)
+        lines |= BIT(UNI_PLATFORM_UNIJOYSTICLE_JOY_LEFT) | BIT(UNI_PLATFORM_UNIJOYSTICLE_JOY_RIGHT);
 
-static void process_paddle(uni_hid_device_t* d, uni_gamepad_seat_t seat, uint8_t misc_buttons) {
-#if 0
-    // Disabled
+    if (!lines)
+        return;
+    if (seat & GAMEPAD_SEAT_A)
+        uni_gpio_port_write(uni_platform_unijoysticle_get_port(GAMEPAD_SEAT_A), lines, lines);
+    if (seat & GAMEPAD_SEAT_B)
+        uni_gpio_port_write(uni_platform_unijoysticle_get_port(GAMEPAD_SEAT_B), lines, lines);
+}
 
-    // A 1:1 mapping actually works pretty well.  If tweaking/scaling is required, do it here.
-    int delay_x = (1024 - gp->brake) / 4;
-    int delay_y = (1024 - gp->throttle) / 4;
+// A 1:1 mapping actually works pretty well.  If tweaking/scaling is required, do it here.
+// Trigger: 0-1023. Pot: 0-255, a released trigger reads 255.
+static unsigned int trigger_to_pot(int32_t value) {
+    if (value < 0)
+        value = 0;
+    else if (value > 1023)
+        value = 1023;
+    return (1023 - value) / 4;
+}
 
-    // Now the trick to keep everything in one interrupt.  Use the other delay as a delta!
-    if (delay_x < delay_y) {
-        pot_x_leads = true;
-        delay_y -= delay_x;
-    } else {
-        pot_x_leads = false;
-        delay_x -= delay_y;
-    }
+static void process_paddle(uni_hid_device_t* d, uni_gamepad_seat_t seat, uint8_t misc_buttons) {
+    ARG_UNUSED(misc_buttons);
+    const uni_gamepad_t* gp = &d->controller.gamepad;
+    unsigned int x;
+    unsigned int y;
 
-    if (delay_x > uS_MAX)
-        delay_x = uS_MAX;
-    else if (delay_x < uS_MIN)
-        delay_x = uS_MIN;
+    // The paddles are wired to the Pot lines of port A. See pot_gpios.
+    if (d->controller.klass != UNI_CONTROLLER_CLASS_GAMEPAD || !(seat & GAMEPAD_SEAT_A))
+        return;
 
-    if (delay_y > uS_MAX)
-        delay_y = uS_MAX;
-    else if (delay_y < uS_MIN)
-        delay_y = uS_MIN;
+    x = trigger_to_pot(gp->brake);
+    y = trigger_to_pot(gp->throttle);
 
-    pot_x_delay_us = delay_x;
-    pot_y_delay_us = delay_y;
-#endif
+    atomic_store(&pot_values, x | (y << 8));
 }
 
 //
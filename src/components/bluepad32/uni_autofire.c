@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_autofire.h"
+
+#include <stdatomic.h>
+
+#include <btstack.h>
+
+#include "uni_common.h"
+#include "uni_log.h"
+#include "uni_rt_timer.h"
+
+#define DEFAULT_CPS 7
+#define DEFAULT_DUTY 50
+
+typedef struct {
+    uni_gpio_port_t* port;
+    uint32_t line_mask;
+
+    // Set by the caller, read by the timer callback.
+    atomic_bool running;
+    uint8_t cps;
+    uint8_t duty;
+
+    // Protected by uni_rt_timer_lock(): start / stop run in the BTstack thread, and the edges in the timer callback.
+    bool pressed;
+    // Absolute time of the next edge.
+    int64_t next_edge_us;
+
+    uni_rt_timer_t timer;
+
+    // Stats
+    uint32_t shots;
+    // How late the timer fired, in the worst case.
+    uint32_t max_late_us;
+} channel_t;
+
+static channel_t channels[UNI_AUTOFIRE_MAX_CHANNELS];
+static int channels_count;
+
+static void on_edge(channel_t* c);
+
+static void timer_callback(void* arg) {
+    on_edge((channel_t*)arg);
+}
+
+static void write_line(channel_t* c, bool pressed) {
+    c->pressed = pressed;
+    uni_gpio_port_write(c->port, pressed ? c->line_mask : 0, c->line_mask);
+}
+
+// Time until the next edge, from the current one.
+static int64_t get_edge_delay_us(const channel_t* c) {
+    int64_t period_us = 1000000 / c->cps;
+    int64_t pressed_us = period_us * c->duty / 100;
+
+    return c->pressed ? pressed_us : period_us - pressed_us;
+}
+
+static void on_edge(channel_t* c) {
+    int64_t now;
+    int64_t late_us;
+
+    // uni_rt_timer_disarm() doesn't wait for a callback that is already running: the lock makes stop() wait for
+    // it instead, so that it can't leave the line pressed and the timer armed.
+    uni_rt_timer_lock();
+    now = uni_rt_timer_get_time_us();
+
+    // Stopped while the callback was pending. The line was already released.
+    if (!atomic_load(&c->running)) {
+        uni_rt_timer_unlock();
+        return;
+    }
+
+    // Stopped and started again while the callback was pending: it belongs to the previous run.
+    // Timers never fire before their deadline.
+    if (now < c->next_edge_us) {
+        uni_rt_timer_unlock();
+        return;
+    }
+
+    late_us = now - c->next_edge_us;
+    if (late_us > (int64_t)c->max_late_us)
+        c->max_late_us = (uint32_t)late_us;
+
+    write_line(c, !c->pressed);
+    if (c->pressed)
+        c->shots++;
+
+    // Scheduled from the previous edge, not from "now", so that the rate doesn't drift.
+    c->next_edge_us += get_edge_delay_us(c);
+    // Way behind: don't try to catch up with a burst of edges.
+    if (c->next_edge_us < now)
+        c->next_edge_us = now;
+    uni_rt_timer_arm(&c->timer, c->next_edge_us - now);
+    uni_rt_timer_unlock();
+}
+
+void uni_autofire_init(void) {
+    channels_count = 0;
+}
+
+int uni_autofire_add_channel(uni_gpio_port_t* port, int line) {
+    channel_t* c;
+
+    if (channels_count >= UNI_AUTOFIRE_MAX_CHANNELS) {
+        loge("autofire: no free channels\n");
+        return -1;
+    }
+
+    c = &channels[channels_count];
+    c->port = port;
+    c->line_mask = BIT(line);
+    atomic_init(&c->running, false);
+    c->cps = DEFAULT_CPS;
+    c->duty = DEFAULT_DUTY;
+    uni_rt_timer_init(&c->timer, timer_callback, c);
+
+    return channels_count++;
+}
+
+void uni_autofire_set_rate(int ch, uint8_t cps, uint8_t duty) {
+    if (ch < 0 || ch >= channels_count)
+        return;
+
+    channels[ch].cps = btstack_max(UNI_AUTOFIRE_CPS_MIN, btstack_min(cps, UNI_AUTOFIRE_CPS_MAX));
+    channels[ch].duty = btstack_max(UNI_AUTOFIRE_DUTY_MIN, btstack_min(duty, UNI_AUTOFIRE_DUTY_MAX));
+}
+
+void uni_autofire_get_rate(int ch, uint8_t* cps, uint8_t* duty) {
+    if (ch < 0 || ch >= channels_count)
+        return;
+
+    *cps = channels[ch].cps;
+    *duty = channels[ch].duty;
+}
+
+void uni_autofire_start(int ch) {
+    channel_t* c;
+
+    if (ch < 0 || ch >= channels_count)
+        return;
+    c = &channels[ch];
+    uni_rt_timer_lock();
+    if (atomic_exchange(&c->running, true)) {
+        uni_rt_timer_unlock();
+        return;
+    }
+
+    // The first shot is not delayed: it starts with the press.
+    write_line(c, true);
+    c->shots++;
+    c->next_edge_us = uni_rt_timer_get_time_us() + get_edge_delay_us(c);
+    uni_rt_timer_arm(&c->timer, get_edge_delay_us(c));
+    uni_rt_timer_unlock();
+}
+
+void uni_autofire_stop(int ch) {
+    channel_t* c;
+
+    if (ch < 0 || ch >= channels_count)
+        return;
+    c = &channels[ch];
+    uni_rt_timer_lock();
+    if (!atomic_exchange(&c->running, false)) {
+        uni_rt_timer_unlock();
+        return;
+    }
+
+    uni_rt_timer_disarm(&c->timer);
+    write_line(c, false);
+    uni_rt_timer_unlock();
+}
+
+bool uni_autofire_is_running(int ch) {
+    if (ch < 0 || ch >= channels_count)
+        return false;
+    return atomic_load(&channels[ch].running);
+}
+
+void uni_autofire_dump(void) {
+    for (int i = 0; i < channels_count; i++) {
+        const channel_t* c = &channels[i];
+        logi("\tAutofire #%d: cps=%d, duty=%d%%, running=%d, shots=%u, max late=%u us\n", i, c->cps, c->duty,
+             atomic_load(&c->running), (unsigned int)c->shots, (unsigned int)c->max_late_us);
+    }
+}
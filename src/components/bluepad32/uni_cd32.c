@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_cd32.h"
+
+int32_t uni_cd32_sim_read(uint8_t buttons, const uni_cd32_sim_timing_t* timing, uint16_t* read) {
+    uint32_t sequence = uni_cd32_get_sequence(buttons);
+    bool levels[UNI_CD32_BITS + 1];
+    // Not valid yet when sampled: the previous level is read.
+    int32_t setup = (int32_t)timing->sample_ns - (int32_t)timing->latency_ns;
+    // Already replaced by the next one when sampled: the next level is read.
+    int32_t hold = (int32_t)timing->clock_period_ns + (int32_t)timing->latency_ns - (int32_t)timing->sample_ns;
+    // Level on the line before the mode edge: fire released.
+    bool previous = false;
+
+    // One more, for the "hold" of the last bit.
+    for (int i = 0; i <= UNI_CD32_BITS; i++)
+        levels[i] = uni_cd32_shift(&sequence);
+
+    // Every bit has the same margins: edges are relative to the mode / clock edge of that bit.
+    *read = 0;
+    for (int i = 0; i < UNI_CD32_BITS; i++) {
+        bool level = levels[i];
+
+        if (setup < 0)
+            level = previous;
+        else if (hold < 0)
+            level = levels[i + 1];
+        previous = levels[i];
+
+        if (level)
+            *read |= 1u << i;
+    }
+
+    return (setup < hold) ? setup : hold;
+}
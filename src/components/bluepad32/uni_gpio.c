@@ -12,6 +12,7 @@
 
 #include "sdkconfig.h"
 #include "uni_common.h"
+#include "uni_gpio_hal.h"
 #include "uni_log.h"
 
 static char buf_gpio_get[16];
@@ -46,7 +47,7 @@ static int cmd_gpio_get(int argc, char** argv) {
 
     if (argc == 1) {
         for (int i = 0; i < GPIO_NUM_MAX; i++) {
-            int value = gpio_get_level(i);
+            int value = uni_gpio_hal_get_level(i);
             logi("GPIO %d = %d\n", i, value);
         }
         return 0;
@@ -62,7 +63,7 @@ static int cmd_gpio_get(int argc, char** argv) {
     if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
         return 1;
 
-    value = gpio_get_level(gpio_num);
+    value = uni_gpio_hal_get_level(gpio_num);
     logi("GPIO %d = %d\n", gpio_num, value);
     return 0;
 }
@@ -82,7 +83,7 @@ static int cmd_gpio_set(int argc, char** argv) {
     if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
         return 1;
 
-    if (gpio_set_level(gpio_num, value) != ESP_OK)
+    if (uni_gpio_hal_set_level(gpio_num, value) != ESP_OK)
         return 1;
     return 0;
 }
@@ -119,7 +120,5 @@ void uni_gpio_register_cmds(void) {
 }
 
 esp_err_t uni_gpio_set_level(gpio_num_t gpio, int value) {
-    if (gpio == -1)
-        return ESP_OK;
-    return gpio_set_level(gpio, !!value);
+    return uni_gpio_hal_set_level(gpio, value);
 }
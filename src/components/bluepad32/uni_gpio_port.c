@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_gpio_port.h"
+
+#include <stdbool.h>
+
+#include "uni_gpio_hal.h"
+#include "uni_log.h"
+
+static uint32_t get_lines_mask(const uni_gpio_port_t* port) {
+    return (1u << port->count) - 1;
+}
+
+// Writes the "changed" lines with the values in "levels".
+static void apply(const uni_gpio_port_t* port, uint32_t levels, uint32_t changed) {
+    uint64_t set = 0;
+    uint64_t clear = 0;
+    int gpio;
+
+    for (int i = 0; i < port->count; i++) {
+        gpio = port->gpios[i];
+        if (!(changed & (1u << i)) || gpio < 0)
+            continue;
+        if (levels & (1u << i))
+            set |= 1ULL << gpio;
+        else
+            clear |= 1ULL << gpio;
+    }
+
+    // All at once, when the arch supports it.
+    uni_gpio_hal_write_mask(set, clear);
+}
+
+void uni_gpio_port_init(uni_gpio_port_t* port) {
+    for (int i = 0; i < UNI_GPIO_PORT_MAX_LINES; i++)
+        port->gpios[i] = -1;
+    port->count = 0;
+    atomic_init(&port->levels, 0);
+    atomic_init(&port->dirty, ~0u);
+    atomic_init(&port->updates, 0);
+    atomic_init(&port->suppressed, 0);
+}
+
+int uni_gpio_port_add_line(uni_gpio_port_t* port, int gpio) {
+    if (port->count >= UNI_GPIO_PORT_MAX_LINES) {
+        loge("gpio_port: cannot add GPIO %d, port is full\n", gpio);
+        return -1;
+    }
+    port->gpios[port->count] = gpio;
+    return port->count++;
+}
+
+void uni_gpio_port_write(uni_gpio_port_t* port, uint32_t levels, uint32_t mask) {
+    unsigned int old_levels;
+    unsigned int new_levels;
+    unsigned int dirty;
+    unsigned int changed;
+
+    mask &= get_lines_mask(port);
+    levels &= mask;
+
+    dirty = atomic_fetch_and(&port->dirty, ~mask) & mask;
+
+    // Other lines might be written at the same time from a different task.
+    old_levels = atomic_load_explicit(&port->levels, memory_order_relaxed);
+    do {
+        new_levels = (old_levels & ~mask) | levels;
+    } while (!atomic_compare_exchange_weak(&port->levels, &old_levels, new_levels));
+
+    changed = ((old_levels ^ new_levels) | dirty) & mask;
+    if (!changed) {
+        atomic_fetch_add_explicit(&port->suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    apply(port, new_levels, changed);
+    atomic_fetch_add_explicit(&port->updates, 1, memory_order_relaxed);
+}
+
+void uni_gpio_port_invalidate(uni_gpio_port_t* port, uint32_t mask) {
+    atomic_fetch_or(&port->dirty, mask);
+}
+
+uint32_t uni_gpio_port_get_levels(uni_gpio_port_t* port) {
+    return atomic_load(&port->levels);
+}
+
+void uni_gpio_port_dump(uni_gpio_port_t* port, const char* name) {
+    logi("\t%s: levels=0x%02x, updates=%u, suppressed=%u\n", name, uni_gpio_port_get_levels(port),
+         atomic_load_explicit(&port->updates, memory_order_relaxed),
+         atomic_load_explicit(&port->suppressed, memory_order_relaxed));
+}
@@ -11,8 +11,14 @@
 
 #include "bt/uni_bt_allowlist.h"
 #include "bt/uni_bt_bredr.h"
+#include "bt/uni_bt_conn_policy.h"
 #include "bt/uni_bt_defines.h"
 #include "bt/uni_bt_le.h"
+#include "bt/uni_bt_le_conn_params.h"
+#include "bt/uni_bt_profiler.h"
+#include "bt/uni_bt_reconnect.h"
+#include "bt/uni_bt_sched.h"
+#include "bt/uni_bt_sdp.h"
 #include "bt/uni_bt_service.h"
 #include "controller/uni_controller_type.h"
 #include "parser/uni_hid_parser_8bitdo.h"
@@ -58,8 +64,12 @@ static const bd_addr_t zero_addr = {0, 0, 0, 0, 0, 0};
 static void process_misc_button_system(uni_hid_device_t* d);
 static void process_misc_button_home(uni_hid_device_t* d);
 static void misc_button_enable_callback(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(misc_button_enable_callback)
 static void device_connection_timeout(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(device_connection_timeout)
 static void start_connection_timeout(uni_hid_device_t* d);
+static void parser_setup_timeout(btstack_timer_source_t* ts);
+UNI_BT_PROFILER_DECLARE_TIMER(parser_setup_timeout)
 
 void uni_hid_device_setup(void) {
     for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++)
@@ -71,8 +81,10 @@ uni_hid_device_t* uni_hid_device_create(bd_addr_t address) {
         if (bd_addr_cmp(g_devices[i].conn.btaddr, zero_addr) == 0) {
             logi("Creating device: %s (idx=%d)\n", bd_addr_to_str(address), i);
 
-            memset(&g_devices[i], 0, sizeof(g_devices[i]));
+            // Same as a deleted device. E.g: connection handle must be invalid, and not 0.
+            uni_hid_device_init(&g_devices[i]);
             bd_addr_copy(g_devices[i].conn.btaddr, address);
+            uni_bt_conn_trace_start(&g_devices[i].conn);
 
             // Delete device if it doesn't have a connection
             start_connection_timeout(&g_devices[i]);
@@ -219,9 +231,11 @@ void uni_hid_device_set_ready(uni_hid_device_t* d) {
 
     // Each "parser" is responsible to call uni_hid_device_set_ready() once the
     // "parser" is ready.
-    if (d->report_parser.setup)
+    if (d->report_parser.setup) {
+        uni_hid_device_start_setup_timer(d, uni_bt_conn_policy_get_timeout_ms(d, UNI_BT_CONN_STAGE_PARSER),
+                                         UNI_BT_PROFILER_TIMER(parser_setup_timeout));
         d->report_parser.setup(d);
-    else {
+    } else {
         // If parser.setup() is not present, it is safe to assume that the setup is complete
         uni_hid_device_set_ready_complete(d);
     }
@@ -241,8 +255,22 @@ bool uni_hid_device_set_ready_complete(uni_hid_device_t* d) {
 
     logi("Device setup (%s) is complete\n", bd_addr_to_str(d->conn.btaddr));
 
-    // Remove the timer once the connection was established.
+    // Remove the timers once the connection was established.
     btstack_run_loop_remove_timer(&d->connection_timer);
+    uni_hid_device_stop_setup_timer(d);
+
+    // The connection setup finished. Devices rejected below are not setup failures.
+    uni_bt_conn_policy_on_setup_finished(d, true);
+
+    // VID/PID rules can only be evaluated now.
+    if (!uni_bt_allowlist_is_allowed(d->conn.btaddr, d->vendor_id, d->product_id)) {
+        loge("Device not in allow-list: %s, VID/PID: %04x/%04x. Deleting it\n", bd_addr_to_str(d->conn.btaddr),
+             d->vendor_id, d->product_id);
+        uni_hid_device_disconnect(d);
+        uni_hid_device_delete(d);
+        /* 'd' is destroyed after this call, don't use it */
+        return false;
+    }
 
     // Platform can reject the connection.
     if (uni_get_platform()->on_device_ready(d) != UNI_ERROR_SUCCESS) {
@@ -254,8 +282,11 @@ bool uni_hid_device_set_ready_complete(uni_hid_device_t* d) {
     }
 
     uni_bt_service_on_device_ready(d);
+    if (IS_ENABLED(UNI_ENABLE_BREDR))
+        uni_bt_reconnect_on_device_ready(d);
 
     uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_DEVICE_READY);
+    uni_bt_conn_policy_on_stage_completed(d, UNI_BT_CONN_STAGE_PARSER);
     return true;
 }
 
@@ -500,8 +531,18 @@ void uni_hid_device_delete(uni_hid_device_t* d) {
     else
         logi("Deleting device: %s\n", bd_addr_to_str(d->conn.btaddr));
 
-    // Remove the timer. If it was still running, it will crash if the handler gets called.
+    // Setup didn't finish. Devices paged by the reconnect manager that are not around don't count.
+    if (!d->conn.reconnecting && uni_bt_conn_get_state(&d->conn) != UNI_BT_CONN_STATE_DEVICE_READY)
+        uni_bt_conn_policy_on_setup_finished(d, false);
+
+    // Remove the timers. If they were still running, it will crash if the handler gets called.
     btstack_run_loop_remove_timer(&d->connection_timer);
+    uni_hid_device_stop_setup_timer(d);
+
+    if (IS_ENABLED(UNI_ENABLE_BREDR)) {
+        uni_bt_sched_on_device_deleted(d);
+        uni_bt_sdp_on_device_deleted(d);
+    }
 
     uni_hid_device_init(d);
 }
@@ -548,6 +589,9 @@ void uni_hid_device_dump_device(uni_hid_device_t* d) {
         uni_get_platform()->device_dump(d);
     if (d->report_parser.device_dump)
         d->report_parser.device_dump(d);
+    if (IS_ENABLED(UNI_ENABLE_BLE) && d->conn.protocol == UNI_BT_CONN_PROTOCOL_BLE)
+        uni_bt_le_conn_params_dump_device(d);
+    uni_bt_conn_trace_dump(&d->conn);
 }
 
 void uni_hid_device_dump_all(void) {
@@ -787,6 +831,8 @@ void uni_hid_device_process_controller(uni_hid_device_t* d) {
         // Deprecated: should implement only on_controller_data
         uni_get_platform()->on_gamepad_data(d, &d->controller.gamepad);
 
+    uni_bt_service_on_controller_data(d, &d->controller);
+
     // FIXME: each backend should decide what to do with misc buttons
     process_misc_button_system(d);
     process_misc_button_home(d);
@@ -943,7 +989,8 @@ static void process_misc_button_system(uni_hid_device_t* d) {
     if (requires_delay) {
         d->misc_button_wait_delay |= MISC_BUTTON_SYSTEM;
         btstack_run_loop_set_timer_context(&d->misc_button_delay_timer, d);
-        btstack_run_loop_set_timer_handler(&d->misc_button_delay_timer, &misc_button_enable_callback);
+        btstack_run_loop_set_timer_handler(&d->misc_button_delay_timer,
+                                           UNI_BT_PROFILER_TIMER(misc_button_enable_callback));
         btstack_run_loop_set_timer(&d->misc_button_delay_timer, MISC_BUTTON_DELAY_MS);
         btstack_run_loop_add_timer(&d->misc_button_delay_timer);
     }
@@ -983,8 +1030,66 @@ static void device_connection_timeout(btstack_timer_source_t* ts) {
 }
 
 static void start_connection_timeout(uni_hid_device_t* d) {
+    d->connection_deadline_ms = btstack_run_loop_get_time_ms() + HID_DEVICE_CONNECTION_TIMEOUT_MS;
     btstack_run_loop_set_timer_context(&d->connection_timer, d);
-    btstack_run_loop_set_timer_handler(&d->connection_timer, &device_connection_timeout);
+    btstack_run_loop_set_timer_handler(&d->connection_timer, UNI_BT_PROFILER_TIMER(device_connection_timeout));
     btstack_run_loop_set_timer(&d->connection_timer, HID_DEVICE_CONNECTION_TIMEOUT_MS);
     btstack_run_loop_add_timer(&d->connection_timer);
 }
+
+void uni_hid_device_pause_connection_timeout(uni_hid_device_t* d) {
+    int32_t remaining;
+
+    if (d->connection_remaining_ms || d->conn.state == UNI_BT_CONN_STATE_DEVICE_READY)
+        return;
+
+    remaining = (int32_t)(d->connection_deadline_ms - btstack_run_loop_get_time_ms());
+    // Keep it non-zero, since zero means "not paused".
+    d->connection_remaining_ms = remaining > 1 ? remaining : 1;
+    btstack_run_loop_remove_timer(&d->connection_timer);
+}
+
+void uni_hid_device_start_setup_timer(uni_hid_device_t* d, uint32_t ms, void (*handler)(btstack_timer_source_t* ts)) {
+    btstack_run_loop_remove_timer(&d->setup_timer);
+    btstack_run_loop_set_timer_context(&d->setup_timer, d);
+    btstack_run_loop_set_timer_handler(&d->setup_timer, handler);
+    btstack_run_loop_set_timer(&d->setup_timer, ms);
+    btstack_run_loop_add_timer(&d->setup_timer);
+}
+
+void uni_hid_device_stop_setup_timer(uni_hid_device_t* d) {
+    btstack_run_loop_remove_timer(&d->setup_timer);
+}
+
+static void parser_setup_timeout(btstack_timer_source_t* ts) {
+    uni_hid_device_t* d = btstack_run_loop_get_timer_context(ts);
+    uint32_t backoff_ms;
+
+    if (uni_bt_conn_get_state(&d->conn) == UNI_BT_CONN_STATE_DEVICE_READY)
+        return;
+
+    uni_bt_conn_policy_on_stage_timeout(UNI_BT_CONN_STAGE_PARSER);
+    // Only the families whose setup can be re-run have retries. E.g: the parser request or its response got lost.
+    // The deadline already waited long enough: no backoff.
+    if (uni_bt_conn_policy_next_retry(d, UNI_BT_CONN_STAGE_PARSER, &backoff_ms)) {
+        uni_hid_device_start_setup_timer(d, uni_bt_conn_policy_get_timeout_ms(d, UNI_BT_CONN_STAGE_PARSER),
+                                         UNI_BT_PROFILER_TIMER(parser_setup_timeout));
+        d->report_parser.setup(d);
+        return;
+    }
+
+    logi("Parser setup timeout for %s, deleting it\n", bd_addr_to_str(d->conn.btaddr));
+    uni_hid_device_disconnect(d);
+    uni_hid_device_delete(d);
+    /* 'd' is destroyed after this call, don't use it */
+}
+
+void uni_hid_device_resume_connection_timeout(uni_hid_device_t* d) {
+    if (!d->connection_remaining_ms)
+        return;
+
+    d->connection_deadline_ms = btstack_run_loop_get_time_ms() + d->connection_remaining_ms;
+    btstack_run_loop_set_timer(&d->connection_timer, d->connection_remaining_ms);
+    btstack_run_loop_add_timer(&d->connection_timer);
+    d->connection_remaining_ms = 0;
+}
@@ -13,6 +13,7 @@
 #include "uni_config.h"
 #include "uni_console.h"
 #include "uni_hid_device.h"
+#include "uni_joystick_profile.h"
 #include "uni_log.h"
 #include "uni_property.h"
 #include "uni_version.h"
@@ -33,6 +34,8 @@ int uni_init(int argc, const char** argv) {
     loge("Version: v" BTSTACK_VERSION_STRING "\n");
 
     uni_property_init();
+    // Before the platform: platforms might use the built-in profiles.
+    uni_joystick_profile_init();
     uni_platform_init(argc, argv);
     uni_hid_device_setup();
 
@@ -4,85 +4,89 @@
 
 #include "uni_joystick.h"
 
+#include <stddef.h>
 #include <string.h>
 
 #include "hid_usage.h"
+#include "uni_common.h"
+#include "uni_joystick_profile.h"
 #include "uni_log.h"
 
 // When accelerometer mode is enabled, it will use it as if it were
 // in the Nintendo Wii Wheel.
 #define ENABLE_ACCEL_WHEEL_MODE 1
 
-static void to_single_joy(const uni_gamepad_t* gp, uni_joystick_t* out_joy) {
-    // Button A is "fire"
-    out_joy->fire |= ((gp->buttons & BUTTON_A) != 0);
-    // Thumb left is "fire"
-    out_joy->fire |= ((gp->buttons & BUTTON_THUMB_L) != 0);
-
-    // Shoulder right is "auto fire"
-    out_joy->auto_fire |= ((gp->buttons & BUTTON_SHOULDER_R) != 0);
-
-    // Dpad
-    if (gp->dpad & DPAD_UP)
-        out_joy->up |= 1;
-    if (gp->dpad & DPAD_DOWN)
-        out_joy->down |= 1;
-    if (gp->dpad & DPAD_RIGHT)
-        out_joy->right |= 1;
-    if (gp->dpad & DPAD_LEFT)
-        out_joy->left |= 1;
-
-    // Axis: X and Y
-    out_joy->left |= (gp->axis_x < -AXIS_THRESHOLD);
-    out_joy->right |= (gp->axis_x > AXIS_THRESHOLD);
-    out_joy->up |= (gp->axis_y < -AXIS_THRESHOLD);
-    out_joy->down |= (gp->axis_y > AXIS_THRESHOLD);
-
-    // 2nd & 3rd buttons
-    out_joy->button2 = (gp->brake >> 2);     // convert from 1024 to 256
-    out_joy->button3 = (gp->throttle >> 2);  // convert from 1024 to 256
-}
+// Keyboard to joystick mapping.
+enum {
+    KB_MODE_SINGLE = BIT(0),
+    KB_MODE_TWIN = BIT(1),
+    KB_MODE_ALL = KB_MODE_SINGLE | KB_MODE_TWIN,
+};
+
+// Joystick 1 is the one controlled by the arrow keys.
+enum {
+    KB_JOY_1,
+    KB_JOY_2,
+    KB_JOY_COUNT,
+};
+
+typedef struct {
+    uint8_t usage;
+    // Modes in which the key is valid.
+    uint8_t modes;
+    uint8_t joy;
+    // Field of uni_joystick_t set by the key. All of them are uint8_t.
+    uint8_t offset;
+} kb_to_joy_t;
+
+#define KB_TO_JOY(_usage, _modes, _joy, _field) \
+    {.usage = (_usage), .modes = (_modes), .joy = (_joy), .offset = offsetof(uni_joystick_t, _field)}
+
+static const kb_to_joy_t kb_to_joy[] = {
+    // Valid for both "single" and "twin stick" modes
+    // 1st joystick: Arrow keys
+    KB_TO_JOY(HID_USAGE_KB_LEFT_ARROW, KB_MODE_ALL, KB_JOY_1, left),
+    KB_TO_JOY(HID_USAGE_KB_RIGHT_ARROW, KB_MODE_ALL, KB_JOY_1, right),
+    KB_TO_JOY(HID_USAGE_KB_UP_ARROW, KB_MODE_ALL, KB_JOY_1, up),
+    KB_TO_JOY(HID_USAGE_KB_DOWN_ARROW, KB_MODE_ALL, KB_JOY_1, down),
+
+    // Only valid in "single" mode
+    // 1st joystick: Buttons, and left modifiers
+    KB_TO_JOY(HID_USAGE_KB_SPACEBAR, KB_MODE_SINGLE, KB_JOY_1, fire),
+    KB_TO_JOY(HID_USAGE_KB_Z, KB_MODE_SINGLE, KB_JOY_1, fire),
+    KB_TO_JOY(HID_USAGE_KB_X, KB_MODE_SINGLE, KB_JOY_1, button2),
+    KB_TO_JOY(HID_USAGE_KB_C, KB_MODE_SINGLE, KB_JOY_1, button3),
+    KB_TO_JOY(HID_USAGE_KB_LEFT_CONTROL, KB_MODE_SINGLE, KB_JOY_1, fire),
+    KB_TO_JOY(HID_USAGE_KB_LEFT_ALT, KB_MODE_SINGLE, KB_JOY_1, button2),
+    KB_TO_JOY(HID_USAGE_KB_LEFT_SHIFT, KB_MODE_SINGLE, KB_JOY_1, button3),
+
+    // Only valid in "twin stick" mode
+    // 1st joystick: right modifiers
+    KB_TO_JOY(HID_USAGE_KB_RIGHT_ALT, KB_MODE_TWIN, KB_JOY_1, fire),
+    KB_TO_JOY(HID_USAGE_KB_RIGHT_CONTROL, KB_MODE_TWIN, KB_JOY_1, button2),
+    KB_TO_JOY(HID_USAGE_KB_RIGHT_SHIFT, KB_MODE_TWIN, KB_JOY_1, button3),
+    // 2nd joystick: WASD and buttons (Q, E, R)
+    KB_TO_JOY(HID_USAGE_KB_W, KB_MODE_TWIN, KB_JOY_2, up),
+    KB_TO_JOY(HID_USAGE_KB_A, KB_MODE_TWIN, KB_JOY_2, left),
+    KB_TO_JOY(HID_USAGE_KB_S, KB_MODE_TWIN, KB_JOY_2, down),
+    KB_TO_JOY(HID_USAGE_KB_D, KB_MODE_TWIN, KB_JOY_2, right),
+    KB_TO_JOY(HID_USAGE_KB_Q, KB_MODE_TWIN, KB_JOY_2, button2),
+    KB_TO_JOY(HID_USAGE_KB_E, KB_MODE_TWIN, KB_JOY_2, fire),
+    KB_TO_JOY(HID_USAGE_KB_R, KB_MODE_TWIN, KB_JOY_2, button3),
+};
 
 // Basic Mode: One gamepad controls one joystick
 void uni_joy_to_single_joy_from_gamepad(const uni_gamepad_t* gp, uni_joystick_t* out_joy, int use_two_buttons) {
-    to_single_joy(gp, out_joy);
-
-    if (!use_two_buttons) {
-        // Buttom B is "jump". Good for C64 games
-        out_joy->up |= ((gp->buttons & BUTTON_B) != 0);
-    } else {
-        // Buttom B is second joystick button, as in MSX
-        out_joy->button2 = ((gp->buttons & BUTTON_B) != 0);
-    }
-
-    // 2nd & 3rd buttons
-    out_joy->button2 |= ((gp->buttons & BUTTON_X) != 0);
-    out_joy->button3 |= ((gp->buttons & BUTTON_Y) != 0);
+    uni_joystick_profile_apply(uni_joystick_profile_get_builtin(use_two_buttons
+                                                                    ? UNI_JOYSTICK_PROFILE_SINGLE_TWO_BUTTONS
+                                                                    : UNI_JOYSTICK_PROFILE_SINGLE),
+                               gp, out_joy, NULL);
 }
 
 // Twin Stick mode: One gamepad controls two joysticks
 void uni_joy_to_twinstick_from_gamepad(const uni_gamepad_t* gp, uni_joystick_t* out_joy1, uni_joystick_t* out_joy2) {
-    to_single_joy(gp, out_joy2);
-
-    out_joy2->button2 |= ((gp->buttons & BUTTON_X) != 0);
-
-    // Button B is "fire"
-    out_joy1->fire |= ((gp->buttons & BUTTON_B) != 0);
-    // Thumb right is "fire"
-    out_joy1->fire |= ((gp->buttons & BUTTON_THUMB_R) != 0);
-
-    out_joy1->button2 |= ((gp->buttons & BUTTON_Y) != 0);
-
-    // Swap "auto fire" in Twin Stick
-    // "left" belongs to joy1 while "right" to joy2.
-    out_joy2->auto_fire = ((gp->buttons & BUTTON_SHOULDER_L) != 0);
-    out_joy1->auto_fire = ((gp->buttons & BUTTON_SHOULDER_R) != 0);
-
-    // Axis: RX and RY
-    out_joy1->left |= (gp->axis_rx < -AXIS_THRESHOLD);
-    out_joy1->right |= (gp->axis_rx > AXIS_THRESHOLD);
-    out_joy1->up |= (gp->axis_ry < -AXIS_THRESHOLD);
-    out_joy1->down |= (gp->axis_ry > AXIS_THRESHOLD);
+    uni_joystick_profile_apply(uni_joystick_profile_get_builtin(UNI_JOYSTICK_PROFILE_TWINSTICK), gp, out_joy1,
+                               out_joy2);
 }
 
 void uni_joy_to_single_from_wii_accel(const uni_gamepad_t* gp, uni_joystick_t* out_joy) {
@@ -144,105 +148,24 @@ void uni_joy_to_single_from_wii_accel(const uni_gamepad_t* gp, uni_joystick_t* o
 }
 
 static void to_joy_from_keyboard(const uni_keyboard_t* kb, uni_joystick_t* out_joy1, uni_joystick_t* out_joy2) {
+    const kb_to_joy_t* m;
+    uni_joystick_t* joys[KB_JOY_COUNT] = {out_joy1, out_joy2};
+    uint8_t mode = out_joy2 ? KB_MODE_TWIN : KB_MODE_SINGLE;
+
     // Sanity check. Joy1 must be valid, joy2 can be null
     if (!out_joy1) {
         loge("Joystick: Invalid joy1 for keyboard\n");
         return;
     }
 
-    // Keys
-    for (int i = 0; i < UNI_KEYBOARD_PRESSED_KEYS_MAX; i++) {
-        // Stop on values from 0-3, they invalid codes.
-        const uint8_t key = kb->pressed_keys[i];
-        if (key <= HID_USAGE_KB_ERROR_UNDEFINED)
-            break;
-        switch (key) {
-            // Valid for both "single" and "twin stick" modes
-            // 1st joystick: Arrow keys
-            case HID_USAGE_KB_LEFT_ARROW:
-                out_joy1->left = 1;
-                break;
-            case HID_USAGE_KB_RIGHT_ARROW:
-                out_joy1->right = 1;
-                break;
-            case HID_USAGE_KB_UP_ARROW:
-                out_joy1->up = 1;
-                break;
-            case HID_USAGE_KB_DOWN_ARROW:
-                out_joy1->down = 1;
-                break;
-
-            // Only valid in "single" mode
-            // 1st joystick: Buttons
-            case HID_USAGE_KB_SPACEBAR:
-            case HID_USAGE_KB_Z:
-                if (out_joy2 == NULL)
-                    out_joy1->fire = 1;
-                break;
-            case HID_USAGE_KB_X:
-                if (out_joy2 == NULL)
-                    out_joy1->button2 = 1;
-                break;
-            case HID_USAGE_KB_C:
-                if (out_joy2 == NULL)
-                    out_joy1->button3 = 1;
-                break;
-
-            // Only valid in "twin stick" mode
-            // 2nd joystick: WASD and buttons (Q, E, R)
-            case HID_USAGE_KB_W:
-                if (out_joy2)
-                    out_joy2->up = 1;
-                break;
-
-            case HID_USAGE_KB_A:
-                if (out_joy2)
-                    out_joy2->left = 1;
-                break;
-
-            case HID_USAGE_KB_S:
-                if (out_joy2)
-                    out_joy2->down = 1;
-                break;
-
-            case HID_USAGE_KB_D:
-                if (out_joy2)
-                    out_joy2->right = 1;
-                break;
-
-            case HID_USAGE_KB_Q:
-                if (out_joy2)
-                    out_joy2->button2 = 1;
-                break;
-
-            case HID_USAGE_KB_E:
-                if (out_joy2)
-                    out_joy2->fire = 1;
-                break;
-
-            case HID_USAGE_KB_R:
-                if (out_joy2)
-                    out_joy2->button3 = 1;
-                break;
-
-            default:
-                break;
-        }
-    }
-
-    // Joystick 1 buttons from Modifiers
-    if (out_joy2 == NULL) {
-        // Left modifiers only valid when in "single" mode
-        out_joy1->fire |= (kb->modifiers & UNI_KEYBOARD_MODIFIER_LEFT_CONTROL) ? 1 : 0;
-        out_joy1->button2 |= (kb->modifiers & UNI_KEYBOARD_MODIFIER_LEFT_ALT) ? 1 : 0;
-        out_joy1->button3 |= (kb->modifiers & UNI_KEYBOARD_MODIFIER_LEFT_SHIFT) ? 1 : 0;
-    } else {
-        // Right modifiers only valid when in "twin stick" mode
-        out_joy1->fire |= (kb->modifiers & UNI_KEYBOARD_MODIFIER_RIGHT_ALT) ? 1 : 0;
-        out_joy1->button2 |= (kb->modifiers & UNI_KEYBOARD_MODIFIER_RIGHT_CONTROL) ? 1 : 0;
-        out_joy1->button3 |= (kb->modifiers & UNI_KEYBOARD_MODIFIER_RIGHT_SHIFT) ? 1 : 0;
+    // Cost doesn't depend on how many keys are pressed.
+    for (size_t i = 0; i < ARRAY_SIZE(kb_to_joy); i++) {
+        m = &kb_to_joy[i];
+        if ((m->modes & mode) && uni_keyboard_is_key_down(kb, m->usage))
+            ((uint8_t*)joys[m->joy])[m->offset] = 1;
     }
 }
+
 void uni_joy_to_single_joy_from_keyboard(const uni_keyboard_t* kb, uni_joystick_t* out_joy) {
     to_joy_from_keyboard(kb, out_joy, NULL);
 }
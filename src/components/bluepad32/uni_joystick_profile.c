@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_joystick_profile.h"
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uni_common.h"
+#include "uni_log.h"
+
+// Brake and throttle go from 0 to 1023. Before the profiles they were converted to 0-255, and any value
+// other than 0 was "pressed".
+#define PEDAL_THRESHOLD 3
+
+// Max length of a rule in the text description.
+#define RULE_TEXT_LEN 32
+
+enum {
+    DIR_NEG,
+    DIR_POS,
+};
+
+#define RULE(_source, _index, _joy, _line, _threshold)                                                 \
+    {.source = UNI_JOYSTICK_PROFILE_SOURCE_##_source, .index = (_index), .joy = (_joy),                \
+     .line = UNI_JOYSTICK_PROFILE_LINE_##_line, .threshold = (_threshold)}
+#define BUTTON(_button, _joy, _line) RULE(BUTTON, UNI_GAMEPAD_MAPPINGS_BUTTON_##_button, _joy, _line, 0)
+#define DPAD(_dpad, _joy, _line) RULE(DPAD, UNI_GAMEPAD_MAPPINGS_DPAD_##_dpad, _joy, _line, 0)
+#define AXIS_NEG(_axis, _joy, _line) RULE(AXIS_NEG, UNI_JOYSTICK_PROFILE_AXIS_##_axis, _joy, _line, 0)
+#define AXIS_POS(_axis, _joy, _line) RULE(AXIS_POS, UNI_JOYSTICK_PROFILE_AXIS_##_axis, _joy, _line, 0)
+#define PEDAL(_axis, _joy, _line) \
+    RULE(AXIS_POS, UNI_JOYSTICK_PROFILE_AXIS_##_axis, _joy, _line, PEDAL_THRESHOLD)
+
+// Dpad and left stick. Common to all the built-in profiles.
+#define RULES_DIRECTIONS(_joy)                                                                             \
+    DPAD(UP, _joy, UP), DPAD(DOWN, _joy, DOWN), DPAD(LEFT, _joy, LEFT), DPAD(RIGHT, _joy, RIGHT),          \
+        AXIS_NEG(X, _joy, LEFT), AXIS_POS(X, _joy, RIGHT), AXIS_NEG(Y, _joy, UP), AXIS_POS(Y, _joy, DOWN)
+
+// Basic Mode: One gamepad controls one joystick
+static const uni_joystick_profile_rule_t rules_single[] = {
+    RULES_DIRECTIONS(0),
+    // Button A and thumb left are "fire"
+    BUTTON(A, 0, FIRE),
+    BUTTON(THUMB_L, 0, FIRE),
+    // Shoulder right is "auto fire"
+    BUTTON(SHOULDER_R, 0, AUTO_FIRE),
+    // Buttom B is "jump". Good for C64 games
+    BUTTON(B, 0, UP),
+    // 2nd & 3rd buttons
+    BUTTON(X, 0, BUTTON2),
+    PEDAL(BRAKE, 0, BUTTON2),
+    BUTTON(Y, 0, BUTTON3),
+    PEDAL(THROTTLE, 0, BUTTON3),
+};
+
+// Same, but Buttom B is second joystick button, as in MSX
+static const uni_joystick_profile_rule_t rules_single_two_buttons[] = {
+    RULES_DIRECTIONS(0),
+    BUTTON(A, 0, FIRE),
+    BUTTON(THUMB_L, 0, FIRE),
+    BUTTON(SHOULDER_R, 0, AUTO_FIRE),
+    BUTTON(B, 0, BUTTON2),
+    BUTTON(X, 0, BUTTON2),
+    BUTTON(Y, 0, BUTTON3),
+    PEDAL(THROTTLE, 0, BUTTON3),
+};
+
+// Twin Stick mode: One gamepad controls two joysticks
+// Left side controls the 2nd joystick, and right side the 1st one.
+static const uni_joystick_profile_rule_t rules_twinstick[] = {
+    RULES_DIRECTIONS(1),
+    BUTTON(A, 1, FIRE),
+    BUTTON(THUMB_L, 1, FIRE),
+    BUTTON(X, 1, BUTTON2),
+    PEDAL(BRAKE, 1, BUTTON2),
+    PEDAL(THROTTLE, 1, BUTTON3),
+    // "left" belongs to joy2 while "right" to joy1.
+    BUTTON(SHOULDER_L, 1, AUTO_FIRE),
+
+    // Button B and thumb right are "fire"
+    BUTTON(B, 0, FIRE),
+    BUTTON(THUMB_R, 0, FIRE),
+    BUTTON(Y, 0, BUTTON2),
+    BUTTON(SHOULDER_R, 0, AUTO_FIRE),
+    // Axis: RX and RY
+    AXIS_NEG(RX, 0, LEFT),
+    AXIS_POS(RX, 0, RIGHT),
+    AXIS_NEG(RY, 0, UP),
+    AXIS_POS(RY, 0, DOWN),
+};
+
+static const struct {
+    const char* name;
+    const uni_joystick_profile_rule_t* rules;
+    int count;
+} builtin_rules[] = {
+    [UNI_JOYSTICK_PROFILE_SINGLE] = {"normal", rules_single, ARRAY_SIZE(rules_single)},
+    [UNI_JOYSTICK_PROFILE_SINGLE_TWO_BUTTONS] = {"two_buttons", rules_single_two_buttons,
+                                                 ARRAY_SIZE(rules_single_two_buttons)},
+    [UNI_JOYSTICK_PROFILE_TWINSTICK] = {"twinstick", rules_twinstick, ARRAY_SIZE(rules_twinstick)},
+};
+_Static_assert(ARRAY_SIZE(builtin_rules) == UNI_JOYSTICK_PROFILE_BUILTIN_COUNT, "Invalid builtin profiles");
+
+// Names used by the text description. Keep them in the order of the enums.
+static const char* button_names[] = {
+    "a", "b", "x", "y", "shoulder_l", "shoulder_r", "trigger_l", "trigger_r", "thumb_l", "thumb_r",
+};
+static const char* misc_button_names[] = {
+    "system",
+    "select",
+    "start",
+    "capture",
+};
+static const char* dpad_names[] = {
+    "dpad_up",
+    "dpad_down",
+    "dpad_right",
+    "dpad_left",
+};
+static const char* axis_names[] = {
+    "x", "y", "rx", "ry", "brake", "throttle",
+};
+static const char* line_names[] = {
+    "up", "down", "left", "right", "fire", "button2", "button3", "auto_fire",
+};
+_Static_assert(ARRAY_SIZE(axis_names) == UNI_JOYSTICK_PROFILE_AXIS_COUNT, "Invalid axis names");
+_Static_assert(ARRAY_SIZE(line_names) == UNI_JOYSTICK_PROFILE_LINE_COUNT, "Invalid line names");
+
+// Fields of uni_joystick_t. All of them are uint8_t.
+static const uint8_t line_offsets[] = {
+    offsetof(uni_joystick_t, up),      offsetof(uni_joystick_t, down),    offsetof(uni_joystick_t, left),
+    offsetof(uni_joystick_t, right),   offsetof(uni_joystick_t, fire),    offsetof(uni_joystick_t, button2),
+    offsetof(uni_joystick_t, button3), offsetof(uni_joystick_t, auto_fire),
+};
+_Static_assert(ARRAY_SIZE(line_offsets) == UNI_JOYSTICK_PROFILE_LINE_COUNT, "Invalid line offsets");
+
+static uni_joystick_profile_t builtin_profiles[UNI_JOYSTICK_PROFILE_BUILTIN_COUNT];
+static uni_joystick_profile_t custom_profiles[UNI_JOYSTICK_PROFILE_MAX_CUSTOM];
+static int custom_profiles_count;
+
+static int32_t get_axis_value(const uni_gamepad_t* gp, int axis) {
+    switch (axis) {
+        case UNI_JOYSTICK_PROFILE_AXIS_X:
+            return gp->axis_x;
+        case UNI_JOYSTICK_PROFILE_AXIS_Y:
+            return gp->axis_y;
+        case UNI_JOYSTICK_PROFILE_AXIS_RX:
+            return gp->axis_rx;
+        case UNI_JOYSTICK_PROFILE_AXIS_RY:
+            return gp->axis_ry;
+        case UNI_JOYSTICK_PROFILE_AXIS_BRAKE:
+            return gp->brake;
+        case UNI_JOYSTICK_PROFILE_AXIS_THROTTLE:
+            return gp->throttle;
+        default:
+            return 0;
+    }
+}
+
+// Returns the index of "name" in "names", or -1.
+static int find_name(const char* name, size_t len, const char** names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strlen(names[i]) == len && strncmp(name, names[i], len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int parse_rule(const char* text, uni_joystick_profile_rule_t* rule) {
+    const char* colon = strchr(text, ':');
+    const char* line;
+    const char* end;
+    char* threshold_end;
+    long threshold;
+    size_t len;
+    int idx;
+
+    if (colon == NULL)
+        return -1;
+    memset(rule, 0, sizeof(*rule));
+
+    // Source
+    len = colon - text;
+    if ((idx = find_name(text, len, button_names, ARRAY_SIZE(button_names))) >= 0) {
+        rule->source = UNI_JOYSTICK_PROFILE_SOURCE_BUTTON;
+    } else if ((idx = find_name(text, len, misc_button_names, ARRAY_SIZE(misc_button_names))) >= 0) {
+        rule->source = UNI_JOYSTICK_PROFILE_SOURCE_MISC_BUTTON;
+    } else if ((idx = find_name(text, len, dpad_names, ARRAY_SIZE(dpad_names))) >= 0) {
+        rule->source = UNI_JOYSTICK_PROFILE_SOURCE_DPAD;
+    } else {
+        // Axis: "<axis><-|+>[@threshold]"
+        end = strpbrk(text, "-+");
+        if (end == NULL || end > colon)
+            return -1;
+        idx = find_name(text, end - text, axis_names, ARRAY_SIZE(axis_names));
+        if (idx < 0)
+            return -1;
+        rule->source = (*end == '-') ? UNI_JOYSTICK_PROFILE_SOURCE_AXIS_NEG : UNI_JOYSTICK_PROFILE_SOURCE_AXIS_POS;
+        if (end[1] == '@') {
+            // 1-32767, and nothing else before the colon. 0 would mean the default threshold.
+            if (!isdigit((unsigned char)end[2]))
+                return -1;
+            threshold = strtol(end + 2, &threshold_end, 10);
+            if (threshold_end != colon || threshold < 1 || threshold > INT16_MAX)
+                return -1;
+            rule->threshold = (int16_t)threshold;
+        } else if (end + 1 != colon) {
+            return -1;
+        }
+    }
+    rule->index = idx;
+
+    // Line
+    line = colon + 1;
+    if (strncmp(line, "j2.", 3) == 0) {
+        rule->joy = 1;
+        line += 3;
+    }
+    idx = find_name(line, strlen(line), line_names, ARRAY_SIZE(line_names));
+    if (idx < 0)
+        return -1;
+    rule->line = idx;
+    return 0;
+}
+
+void uni_joystick_profile_init(void) {
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_BUILTIN_COUNT; i++)
+        uni_joystick_profile_compile(&builtin_profiles[i], builtin_rules[i].name, builtin_rules[i].rules,
+                                     builtin_rules[i].count);
+    custom_profiles_count = 0;
+}
+
+int uni_joystick_profile_compile(uni_joystick_profile_t* profile,
+                                 const char* name,
+                                 const uni_joystick_profile_rule_t* rules,
+                                 int count) {
+    const uni_joystick_profile_rule_t* r;
+    int dir;
+    int16_t threshold;
+
+    memset(profile, 0, sizeof(*profile));
+    strncpy(profile->name, name, sizeof(profile->name) - 1);
+    profile->joys = 1;
+
+    for (int i = 0; i < count; i++) {
+        r = &rules[i];
+        if (r->joy >= UNI_JOYSTICK_PROFILE_MAX_JOYS || r->line >= UNI_JOYSTICK_PROFILE_LINE_COUNT) {
+            loge("joystick_profile: %s: invalid rule #%d\n", name, i);
+            return -1;
+        }
+        if (r->joy >= profile->joys)
+            profile->joys = r->joy + 1;
+
+        switch (r->source) {
+            case UNI_JOYSTICK_PROFILE_SOURCE_BUTTON:
+                profile->buttons[r->joy][r->line] |= BIT(r->index);
+                break;
+            case UNI_JOYSTICK_PROFILE_SOURCE_MISC_BUTTON:
+                profile->misc_buttons[r->joy][r->line] |= BIT(r->index);
+                break;
+            case UNI_JOYSTICK_PROFILE_SOURCE_DPAD:
+                profile->dpad[r->joy][r->line] |= BIT(r->index);
+                break;
+            case UNI_JOYSTICK_PROFILE_SOURCE_AXIS_NEG:
+            case UNI_JOYSTICK_PROFILE_SOURCE_AXIS_POS:
+                if (r->index >= UNI_JOYSTICK_PROFILE_AXIS_COUNT) {
+                    loge("joystick_profile: %s: invalid axis in rule #%d\n", name, i);
+                    return -1;
+                }
+                dir = (r->source == UNI_JOYSTICK_PROFILE_SOURCE_AXIS_NEG) ? DIR_NEG : DIR_POS;
+                threshold = r->threshold ? r->threshold : AXIS_THRESHOLD;
+                // One threshold per axis and direction.
+                if (profile->axis_lines[r->index][dir] && profile->axis_thresholds[r->index][dir] != threshold)
+                    logi("joystick_profile: %s: rule #%d overrides the threshold of axis %s\n", name, i,
+                         axis_names[r->index]);
+                profile->axis_thresholds[r->index][dir] = threshold;
+                profile->axis_lines[r->index][dir] |= BIT(r->joy * UNI_JOYSTICK_PROFILE_LINE_COUNT + r->line);
+                break;
+            default:
+                loge("joystick_profile: %s: invalid source in rule #%d\n", name, i);
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int uni_joystick_profile_parse(const char* text, uni_joystick_profile_rule_t* rules, int max) {
+    char rule_text[RULE_TEXT_LEN];
+    const char* end;
+    size_t len;
+    int count = 0;
+
+    while (*text) {
+        end = strchr(text, ',');
+        if (end == NULL)
+            end = text + strlen(text);
+        len = end - text;
+
+        if (len > 0) {
+            if (count >= max || len >= sizeof(rule_text)) {
+                loge("joystick_profile: too many rules, or rule too long\n");
+                return -1;
+            }
+            memcpy(rule_text, text, len);
+            rule_text[len] = 0;
+            if (parse_rule(rule_text, &rules[count]) != 0) {
+                loge("joystick_profile: invalid rule: '%s'\n", rule_text);
+                return -1;
+            }
+            count++;
+        }
+
+        text = (*end) ? end + 1 : end;
+    }
+    return count;
+}
+
+void uni_joystick_profile_apply(const uni_joystick_profile_t* profile,
+                                const uni_gamepad_t* gp,
+                                uni_joystick_t* out_joy1,
+                                uni_joystick_t* out_joy2) {
+    uni_joystick_t* joys[UNI_JOYSTICK_PROFILE_MAX_JOYS] = {out_joy1, out_joy2};
+    uint16_t axis_lines = 0;
+    int32_t value;
+
+    // Axes first, as a bitmap of lines.
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_AXIS_COUNT; i++) {
+        if (!(profile->axis_lines[i][DIR_NEG] | profile->axis_lines[i][DIR_POS]))
+            continue;
+        value = get_axis_value(gp, i);
+        if (value < -profile->axis_thresholds[i][DIR_NEG])
+            axis_lines |= profile->axis_lines[i][DIR_NEG];
+        if (value > profile->axis_thresholds[i][DIR_POS])
+            axis_lines |= profile->axis_lines[i][DIR_POS];
+    }
+
+    for (int j = 0; j < profile->joys; j++) {
+        if (joys[j] == NULL)
+            continue;
+        for (int l = 0; l < UNI_JOYSTICK_PROFILE_LINE_COUNT; l++) {
+            if ((gp->buttons & profile->buttons[j][l]) || (gp->misc_buttons & profile->misc_buttons[j][l]) ||
+                (gp->dpad & profile->dpad[j][l]) || (axis_lines & BIT(j * UNI_JOYSTICK_PROFILE_LINE_COUNT + l)))
+                ((uint8_t*)joys[j])[line_offsets[l]] = 1;
+        }
+    }
+}
+
+const uni_joystick_profile_t* uni_joystick_profile_get_builtin(uni_joystick_profile_builtin_t idx) {
+    if (idx >= UNI_JOYSTICK_PROFILE_BUILTIN_COUNT)
+        return NULL;
+    return &builtin_profiles[idx];
+}
+
+bool uni_joystick_profile_is_builtin(const char* name) {
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_BUILTIN_COUNT; i++) {
+        if (strcmp(builtin_profiles[i].name, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+const uni_joystick_profile_t* uni_joystick_profile_find(const char* name) {
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_BUILTIN_COUNT; i++) {
+        if (strcmp(builtin_profiles[i].name, name) == 0)
+            return &builtin_profiles[i];
+    }
+    for (int i = 0; i < custom_profiles_count; i++) {
+        if (strcmp(custom_profiles[i].name, name) == 0)
+            return &custom_profiles[i];
+    }
+    return NULL;
+}
+
+int uni_joystick_profile_add_custom(const char* name, const char* text) {
+    uni_joystick_profile_rule_t rules[UNI_JOYSTICK_PROFILE_MAX_RULES];
+    int count;
+
+    count = uni_joystick_profile_parse(text, rules, ARRAY_SIZE(rules));
+    if (count < 0)
+        return -1;
+    return uni_joystick_profile_add_custom_rules(name, rules, count);
+}
+
+int uni_joystick_profile_add_custom_rules(const char* name, const uni_joystick_profile_rule_t* rules, int count) {
+    uni_joystick_profile_t compiled;
+    uni_joystick_profile_t* profile = NULL;
+
+    if (strlen(name) == 0 || strlen(name) >= UNI_JOYSTICK_PROFILE_NAME_LEN) {
+        loge("joystick_profile: invalid name: '%s'\n", name);
+        return -1;
+    }
+
+    if (uni_joystick_profile_is_builtin(name)) {
+        loge("joystick_profile: cannot replace built-in profile '%s'\n", name);
+        return -1;
+    }
+
+    // Compiled apart: invalid rules neither take a slot nor replace the profile in use.
+    if (uni_joystick_profile_compile(&compiled, name, rules, count) != 0)
+        return -1;
+
+    for (int i = 0; i < custom_profiles_count; i++) {
+        if (strcmp(custom_profiles[i].name, name) == 0) {
+            profile = &custom_profiles[i];
+            break;
+        }
+    }
+    if (profile == NULL) {
+        if (custom_profiles_count >= UNI_JOYSTICK_PROFILE_MAX_CUSTOM) {
+            loge("joystick_profile: no free custom profiles\n");
+            return -1;
+        }
+        profile = &custom_profiles[custom_profiles_count++];
+    }
+
+    *profile = compiled;
+    return 0;
+}
+
+void uni_joystick_profile_dump(const uni_joystick_profile_t* profile) {
+    logi("\t%s: joysticks=%d\n", profile->name, profile->joys);
+    for (int j = 0; j < profile->joys; j++) {
+        for (int l = 0; l < UNI_JOYSTICK_PROFILE_LINE_COUNT; l++) {
+            if (!profile->buttons[j][l] && !profile->misc_buttons[j][l] && !profile->dpad[j][l])
+                continue;
+            logi("\t\tj%d.%s: buttons=%#x, misc=%#x, dpad=%#x\n", j + 1, line_names[l], profile->buttons[j][l],
+                 profile->misc_buttons[j][l], profile->dpad[j][l]);
+        }
+    }
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_AXIS_COUNT; i++) {
+        if (profile->axis_lines[i][DIR_NEG])
+            logi("\t\t%s < -%d: lines=%#x\n", axis_names[i], profile->axis_thresholds[i][DIR_NEG],
+                 profile->axis_lines[i][DIR_NEG]);
+        if (profile->axis_lines[i][DIR_POS])
+            logi("\t\t%s > %d: lines=%#x\n", axis_names[i], profile->axis_thresholds[i][DIR_POS],
+                 profile->axis_lines[i][DIR_POS]);
+    }
+}
+
+void uni_joystick_profile_dump_all(void) {
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_BUILTIN_COUNT; i++)
+        uni_joystick_profile_dump(&builtin_profiles[i]);
+    for (int i = 0; i < custom_profiles_count; i++)
+        uni_joystick_profile_dump(&custom_profiles[i]);
+}
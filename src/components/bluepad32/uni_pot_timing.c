@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_pot_timing.h"
+
+static uint32_t cycles_to_ticks(uint32_t cycles, uint32_t ticks_per_us) {
+    // Rounded up, so that the SID never reads one less.
+    return ((uint64_t)cycles * UNI_POT_TIMING_CYCLE_NS * ticks_per_us + 999) / 1000;
+}
+
+void uni_pot_timing_compute(uint8_t x, uint8_t y, uint32_t ticks_per_us, uni_pot_timing_schedule_t* out) {
+    uint32_t ticks_x = cycles_to_ticks(UNI_POT_TIMING_DISCHARGE_CYCLES + x, ticks_per_us);
+    uint32_t ticks_y = cycles_to_ticks(UNI_POT_TIMING_DISCHARGE_CYCLES + y, ticks_per_us);
+
+    if (ticks_x <= ticks_y) {
+        out->lines[0] = UNI_POT_TIMING_LINE_X;
+        out->lines[1] = UNI_POT_TIMING_LINE_Y;
+        out->ticks[0] = ticks_x;
+        out->ticks[1] = ticks_y;
+    } else {
+        out->lines[0] = UNI_POT_TIMING_LINE_Y;
+        out->lines[1] = UNI_POT_TIMING_LINE_X;
+        out->ticks[0] = ticks_y;
+        out->ticks[1] = ticks_x;
+    }
+}
+
+uint8_t uni_pot_timing_read(uint32_t ticks, uint32_t ticks_per_us) {
+    uint64_t cycles = (uint64_t)ticks * 1000 / ((uint64_t)UNI_POT_TIMING_CYCLE_NS * ticks_per_us);
+
+    // Released during the discharge: reads 0. Never released: the counter stops at 255.
+    if (cycles < UNI_POT_TIMING_DISCHARGE_CYCLES)
+        return 0;
+    cycles -= UNI_POT_TIMING_DISCHARGE_CYCLES;
+    return (cycles > 255) ? 255 : cycles;
+}
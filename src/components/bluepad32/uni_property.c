@@ -49,6 +49,18 @@ static const uni_property_t properties[] = {
      .default_value.boolean = false
 #endif  // CONFIG_BLUEPAD32_ENABLE_VIRTUAL_DEVICE_BY_DEFAULT
     },
+    // Appended, same order as uni_property_idx_t.
+    // Seconds without new devices before reducing the scan duty cycle.
+    {UNI_PROPERTY_IDX_SCAN_IDLE_TIMEOUT, UNI_PROPERTY_NAME_SCAN_IDLE_TIMEOUT, UNI_PROPERTY_TYPE_U8,
+     .default_value.u8 = 30},
+    // 0: always on, 1: adaptive. See uni_bt_scan_policy_t
+    {UNI_PROPERTY_IDX_SCAN_POLICY, UNI_PROPERTY_NAME_SCAN_POLICY, UNI_PROPERTY_TYPE_U8, .default_value.u8 = 1},
+    // Binary format. See uni_bt_allowlist.c
+    {UNI_PROPERTY_IDX_ALLOWLIST_RULES, UNI_PROPERTY_NAME_ALLOWLIST_RULES, UNI_PROPERTY_TYPE_BLOB,
+     .default_value.blob = {NULL, 0}},
+    // Binary format. See uni_bt_reconnect.c
+    {UNI_PROPERTY_IDX_BT_RECONNECT_HINTS, UNI_PROPERTY_NAME_BT_RECONNECT_HINTS, UNI_PROPERTY_TYPE_BLOB,
+     .default_value.blob = {NULL, 0}},
 
     // TODO: Platform specific. Should be defined in its own file.
 };
@@ -118,6 +130,9 @@ void uni_property_dump_property(const uni_property_t* p) {
             else
                 logi("%s = <empty>\n", p->name);
             break;
+        case UNI_PROPERTY_TYPE_BLOB:
+            logi("%s = <binary>\n", p->name);
+            break;
         default:
             loge("%s = Unsupported property type %d\n", p->name, p->type);
             break;
@@ -154,3 +169,12 @@ uni_property_value_t uni_property_get(uni_property_idx_t idx) {
     }
     return uni_property_get_with_property(p);
 }
+
+int uni_property_get_blob(uni_property_idx_t idx, void* buf, int size) {
+    const uni_property_t* p = get_property(idx);
+    if (!p || p->type != UNI_PROPERTY_TYPE_BLOB) {
+        loge("Could not find blob property %d\n", idx);
+        return 0;
+    }
+    return uni_property_get_blob_with_property(p, buf, size);
+}
@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "uni_quadrature_gen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <btstack_util.h>
+
+#include "sdkconfig.h"
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+#include <esp_attr.h>
+#include <soc/gpio_struct.h>
+#elif defined(CONFIG_IDF_TARGET)
+#include <esp_attr.h>
+#else
+#define IRAM_ATTR
+#endif
+
+#include "uni_gpio_hal.h"
+
+// Intervals out of this range are clamped: 2000 to 50 reports per second.
+// Not 1ms: the intervals of 1ms reports jitter below it. Clamping them would overestimate the interval, and the
+// backlog would grow.
+#define MIN_INTERVAL_US 500
+#define MAX_INTERVAL_US 20000
+// Longer than this, the mouse was idle: not a report interval.
+#define IDLE_INTERVAL_US 100000
+// Smoothing of the report interval: 1/8 of each new sample.
+#define INTERVAL_SMOOTHING_SHIFT 3
+
+// Levels of each phase. Bit 0: A, bit 1: B.
+static const uint8_t gray_code[4] = {0b00, 0b01, 0b11, 0b10};
+
+static void init_write(uni_quadrature_gen_write_t* w, int gpio, bool level) {
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    if (gpio < 32) {
+        w->reg = level ? &GPIO.out_w1ts : &GPIO.out_w1tc;
+        w->mask = 1u << gpio;
+    } else {
+        w->reg = level ? &GPIO.out1_w1ts.val : &GPIO.out1_w1tc.val;
+        w->mask = 1u << (gpio - 32);
+    }
+#else
+    w->gpio = gpio;
+    w->level = level;
+#endif
+}
+
+static IRAM_ATTR void apply_write(const uni_quadrature_gen_write_t* w) {
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    *w->reg = w->mask;
+#else
+    uni_gpio_hal_set_level(w->gpio, w->level);
+#endif
+}
+
+#ifndef CONFIG_IDF_TARGET
+static void sim_record(uni_quadrature_gen_t* gen) {
+    gen->sim_samples[gen->sim_count % UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES] = gray_code[gen->phase];
+    gen->sim_count++;
+}
+#endif  // !CONFIG_IDF_TARGET
+
+void uni_quadrature_gen_init(uni_quadrature_gen_t* gen, int gpio_a, int gpio_b) {
+    memset(gen, 0, sizeof(*gen));
+    atomic_init(&gen->pending, 0);
+
+    for (int phase = 0; phase < 4; phase++) {
+        for (int dir = 0; dir < UNI_QUADRATURE_GEN_DIR_MAX; dir++) {
+            // Phase that precedes "phase" in this direction.
+            int prev = (dir == UNI_QUADRATURE_GEN_DIR_POS) ? (phase + 3) & 3 : (phase + 1) & 3;
+            // Only one line changes between consecutive phases.
+            uint8_t changed = gray_code[phase] ^ gray_code[prev];
+            bool level = gray_code[phase] & changed;
+
+            init_write(&gen->writes[dir][phase], (changed & 0b01) ? gpio_a : gpio_b, level);
+        }
+    }
+
+#ifndef CONFIG_IDF_TARGET
+    // Initial state, so that the first step can be validated.
+    sim_record(gen);
+#endif  // !CONFIG_IDF_TARGET
+}
+
+uint32_t uni_quadrature_gen_add_motion(uni_quadrature_gen_t* gen, int32_t delta, uint32_t scale, uint32_t interval_us) {
+    int64_t total;
+    int32_t steps;
+    int32_t max_pending;
+    int pending;
+    int new_pending;
+    bool reversed;
+    uint32_t period_us;
+
+    // Whole steps go to the backlog. The fraction, to the next report.
+    total = (int64_t)delta * scale + gen->remainder;
+    steps = (int32_t)(total / UNI_QUADRATURE_GEN_SCALE_ONE);
+    gen->remainder = (int32_t)(total - (int64_t)steps * UNI_QUADRATURE_GEN_SCALE_ONE);
+
+    max_pending = UNI_QUADRATURE_GEN_MAX_BACKLOG_INTERVALS * interval_us / UNI_QUADRATURE_GEN_MIN_STEP_PERIOD_US;
+
+    // The ISR might be consuming steps at the same time.
+    pending = atomic_load(&gen->pending);
+    do {
+        // A change of direction discards the old backlog: it is stale.
+        reversed = (pending > 0 && steps < 0) || (pending < 0 && steps > 0);
+        new_pending = reversed ? steps : pending + steps;
+        // Not btstack_min() / btstack_max(): they are unsigned.
+        if (new_pending > max_pending)
+            new_pending = max_pending;
+        else if (new_pending < -max_pending)
+            new_pending = -max_pending;
+    } while (!atomic_compare_exchange_weak(&gen->pending, &pending, new_pending));
+
+    gen->dropped += reversed ? abs(pending) + abs(steps - new_pending) : abs(pending + steps - new_pending);
+
+    if (new_pending == 0)
+        return 0;
+    period_us = interval_us / abs(new_pending);
+    return btstack_max(period_us, UNI_QUADRATURE_GEN_MIN_STEP_PERIOD_US);
+}
+
+IRAM_ATTR bool uni_quadrature_gen_step(uni_quadrature_gen_t* gen) {
+    int pending = atomic_load_explicit(&gen->pending, memory_order_relaxed);
+    int dir;
+
+    // Might be updated by add_motion() at the same time.
+    do {
+        if (pending == 0)
+            return false;
+        dir = (pending > 0) ? UNI_QUADRATURE_GEN_DIR_POS : UNI_QUADRATURE_GEN_DIR_NEG;
+    } while (!atomic_compare_exchange_weak(&gen->pending, &pending,
+                                           (dir == UNI_QUADRATURE_GEN_DIR_POS) ? pending - 1 : pending + 1));
+
+    gen->phase = (gen->phase + ((dir == UNI_QUADRATURE_GEN_DIR_POS) ? 1 : 3)) & 3;
+    apply_write(&gen->writes[dir][gen->phase]);
+    gen->steps++;
+
+#ifndef CONFIG_IDF_TARGET
+    sim_record(gen);
+#endif  // !CONFIG_IDF_TARGET
+    return true;
+}
+
+void uni_quadrature_rate_init(uni_quadrature_rate_t* rate) {
+    rate->last_report_us = 0;
+    rate->interval_us = UNI_QUADRATURE_GEN_DEFAULT_INTERVAL_US;
+}
+
+uint32_t uni_quadrature_rate_update(uni_quadrature_rate_t* rate, int64_t now_us) {
+    int64_t sample = now_us - rate->last_report_us;
+    bool first = (rate->last_report_us == 0);
+
+    rate->last_report_us = now_us;
+    if (first || sample > IDLE_INTERVAL_US)
+        return rate->interval_us;
+
+    sample = btstack_max(MIN_INTERVAL_US, btstack_min(sample, MAX_INTERVAL_US));
+    // Exponential moving average.
+    rate->interval_us += ((int32_t)sample - (int32_t)rate->interval_us) >> INTERVAL_SMOOTHING_SHIFT;
+    return rate->interval_us;
+}
+
+#ifndef CONFIG_IDF_TARGET
+int uni_quadrature_gen_sim_get_samples(const uni_quadrature_gen_t* gen, uint8_t* out, int max) {
+    uint32_t count = gen->sim_count;
+    uint32_t first;
+
+    if (count > UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES)
+        count = UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES;
+    if (count > (uint32_t)max)
+        count = max;
+
+    first = gen->sim_count - count;
+    for (uint32_t i = 0; i < count; i++)
+        out[i] = gen->sim_samples[(first + i) % UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES];
+    return count;
+}
+
+int32_t uni_quadrature_gen_sim_validate(const uint8_t* samples, int count) {
+    // Inverse of gray_code.
+    static const uint8_t phases[4] = {0, 1, 3, 2};
+    int32_t position = 0;
+
+    for (int i = 1; i < count; i++) {
+        switch ((phases[samples[i] & 0b11] - phases[samples[i - 1] & 0b11]) & 3) {
+            case 1:
+                position++;
+                break;
+            case 3:
+                position--;
+                break;
+            default:
+                // No change, or both lines changed at the same time.
+                return INT32_MIN;
+        }
+    }
+    return position;
+}
+#endif  // !CONFIG_IDF_TARGET
@@ -0,0 +1,338 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Subset of the BTstack API used by the modules under test.
+// The run loop is implemented in fake_btstack.c, with virtual time. See fake_btstack.h.
+
+#ifndef BTSTACK_H
+#define BTSTACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BD_ADDR_LEN 6
+typedef uint8_t bd_addr_t[BD_ADDR_LEN];
+typedef uint16_t hci_con_handle_t;
+typedef uint8_t link_key_t[16];
+
+#define HCI_CON_HANDLE_INVALID 0xffff
+#define ERROR_CODE_SUCCESS 0x00
+#define SDP_QUERY_BUSY 0x66
+
+typedef void (*btstack_packet_handler_t)(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size);
+
+typedef struct btstack_linked_item {
+    struct btstack_linked_item* next;
+} btstack_linked_item_t;
+
+typedef struct btstack_timer_source {
+    btstack_linked_item_t item;
+    uint32_t timeout;
+    void (*process)(struct btstack_timer_source* ts);
+    void* context;
+} btstack_timer_source_t;
+
+typedef struct {
+    btstack_linked_item_t item;
+    void (*callback)(void* context);
+    void* context;
+} btstack_context_callback_registration_t;
+
+// Run loop
+uint32_t btstack_run_loop_get_time_ms(void);
+void btstack_run_loop_set_timer(btstack_timer_source_t* ts, uint32_t timeout_in_ms);
+void btstack_run_loop_set_timer_handler(btstack_timer_source_t* ts, void (*process)(btstack_timer_source_t* ts));
+void btstack_run_loop_set_timer_context(btstack_timer_source_t* ts, void* context);
+void* btstack_run_loop_get_timer_context(btstack_timer_source_t* ts);
+void btstack_run_loop_add_timer(btstack_timer_source_t* ts);
+int btstack_run_loop_remove_timer(btstack_timer_source_t* ts);
+void btstack_run_loop_execute_on_main_thread(btstack_context_callback_registration_t* callback_registration);
+
+// Utils
+static inline uint32_t btstack_min(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+static inline uint32_t btstack_max(uint32_t a, uint32_t b) {
+    return a > b ? a : b;
+}
+const char* bd_addr_to_str(const bd_addr_t addr);
+int bd_addr_cmp(const bd_addr_t a, const bd_addr_t b);
+void bd_addr_copy(bd_addr_t dest, const bd_addr_t src);
+void reverse_bd_addr(const bd_addr_t src, bd_addr_t dest);
+uint16_t little_endian_read_16(const uint8_t* buffer, int position);
+uint32_t little_endian_read_24(const uint8_t* buffer, int position);
+void little_endian_store_16(uint8_t* buffer, uint16_t position, uint16_t value);
+void little_endian_store_24(uint8_t* buffer, uint16_t position, uint32_t value);
+void printf_hexdump(const void* data, int size);
+
+// Events. Same layout as BTstack.
+#define HCI_EVENT_PACKET 0x04
+#define SDP_EVENT_QUERY_COMPLETE 0x92
+#define SDP_EVENT_QUERY_ATTRIBUTE_VALUE 0x95
+
+static inline uint8_t hci_event_packet_get_type(const uint8_t* event) {
+    return event[0];
+}
+static inline uint8_t sdp_event_query_complete_get_status(const uint8_t* event) {
+    return event[2];
+}
+static inline uint16_t sdp_event_query_attribute_byte_get_attribute_id(const uint8_t* event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint16_t sdp_event_query_attribute_byte_get_attribute_length(const uint8_t* event) {
+    return little_endian_read_16(event, 6);
+}
+static inline uint16_t sdp_event_query_attribute_byte_get_data_offset(const uint8_t* event) {
+    return little_endian_read_16(event, 8);
+}
+static inline uint8_t sdp_event_query_attribute_byte_get_data(const uint8_t* event) {
+    return event[10];
+}
+
+// HCI, GAP and L2CAP. Provided by fake_bredr.c, that emulates the BR/EDR controllers. See fake_bredr.h
+// The addresses in the events are not reversed, unlike BTstack.
+#define ERROR_CODE_PAGE_TIMEOUT 0x04
+#define ERROR_CODE_CONNECTION_TIMEOUT 0x08
+#define ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION 0x13
+
+#define HCI_EVENT_CONNECTION_COMPLETE 0x03
+#define HCI_EVENT_CONNECTION_REQUEST 0x04
+#define HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE 0x07
+#define HCI_EVENT_PIN_CODE_REQUEST 0x16
+#define GAP_EVENT_INQUIRY_RESULT 0xd9
+#define L2CAP_EVENT_CHANNEL_OPENED 0x70
+#define L2CAP_EVENT_CHANNEL_CLOSED 0x71
+#define L2CAP_EVENT_INCOMING_CONNECTION 0x72
+
+#define BLUETOOTH_PSM_HID_CONTROL 0x11
+#define BLUETOOTH_PSM_HID_INTERRUPT 0x13
+#define PSM_HID_CONTROL BLUETOOTH_PSM_HID_CONTROL
+#define PSM_HID_INTERRUPT BLUETOOTH_PSM_HID_INTERRUPT
+
+#define L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_SECURITY 0x03
+#define L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_RESOURCES 0x04
+#define L2CAP_CONNECTION_RESPONSE_RESULT_RTX_TIMEOUT 0x65
+#define L2CAP_CONNECTION_BASEBAND_DISCONNECT 0x6a
+
+#define HID_MESSAGE_TYPE_DATA 0x0a
+#define HID_REPORT_TYPE_INPUT 0x01
+
+#define PAGE_SCAN_MODE_INTERLACED 1
+#define INQUIRY_MODE_RSSI_AND_EIR 2
+#define LM_LINK_POLICY_ENABLE_ROLE_SWITCH 0x01
+#define LM_LINK_POLICY_ENABLE_SNIFF_MODE 0x04
+#define HCI_ROLE_MASTER 0
+
+typedef enum {
+    LEVEL_0 = 0,
+    LEVEL_1,
+    LEVEL_2,
+    LEVEL_3,
+    LEVEL_4,
+} gap_security_level_t;
+
+typedef enum {
+    GAP_CONNECTION_INVALID,
+    GAP_CONNECTION_ACL,
+    GAP_CONNECTION_SCO,
+    GAP_CONNECTION_LE,
+} gap_connection_type_t;
+
+typedef enum {
+    COMBINATION_KEY = 0,
+} link_key_type_t;
+
+typedef struct {
+    void* context;
+} btstack_link_key_iterator_t;
+
+static inline hci_con_handle_t hci_event_connection_complete_get_connection_handle(const uint8_t* event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hci_event_connection_complete_get_status(const uint8_t* event) {
+    return event[2];
+}
+static inline void hci_event_connection_complete_get_bd_addr(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[5], BD_ADDR_LEN);
+}
+static inline void hci_event_connection_request_get_bd_addr(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[2], BD_ADDR_LEN);
+}
+static inline uint32_t hci_event_connection_request_get_class_of_device(const uint8_t* event) {
+    return little_endian_read_24(event, 8);
+}
+static inline uint8_t hci_event_remote_name_request_complete_get_status(const uint8_t* event) {
+    return event[2];
+}
+static inline void hci_event_remote_name_request_complete_get_bd_addr(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[3], BD_ADDR_LEN);
+}
+static inline const char* hci_event_remote_name_request_complete_get_remote_name(const uint8_t* event) {
+    return (const char*)&event[9];
+}
+static inline void hci_event_pin_code_request_get_bd_addr(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[2], BD_ADDR_LEN);
+}
+static inline void gap_event_inquiry_result_get_bd_addr(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[2], BD_ADDR_LEN);
+}
+static inline uint8_t gap_event_inquiry_result_get_page_scan_repetition_mode(const uint8_t* event) {
+    return event[8];
+}
+static inline uint32_t gap_event_inquiry_result_get_class_of_device(const uint8_t* event) {
+    return little_endian_read_24(event, 9);
+}
+static inline uint16_t gap_event_inquiry_result_get_clock_offset(const uint8_t* event) {
+    return little_endian_read_16(event, 12);
+}
+static inline uint8_t gap_event_inquiry_result_get_rssi_available(const uint8_t* event) {
+    return event[14];
+}
+static inline uint8_t gap_event_inquiry_result_get_rssi(const uint8_t* event) {
+    return event[15];
+}
+static inline uint8_t gap_event_inquiry_result_get_name_available(const uint8_t* event) {
+    return event[16];
+}
+static inline uint8_t gap_event_inquiry_result_get_name_len(const uint8_t* event) {
+    return event[17];
+}
+static inline const uint8_t* gap_event_inquiry_result_get_name(const uint8_t* event) {
+    return &event[18];
+}
+static inline uint8_t l2cap_event_channel_opened_get_status(const uint8_t* event) {
+    return event[2];
+}
+static inline void l2cap_event_channel_opened_get_address(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[3], BD_ADDR_LEN);
+}
+static inline hci_con_handle_t l2cap_event_channel_opened_get_handle(const uint8_t* event) {
+    return little_endian_read_16(event, 9);
+}
+static inline uint16_t l2cap_event_channel_opened_get_psm(const uint8_t* event) {
+    return little_endian_read_16(event, 11);
+}
+static inline uint16_t l2cap_event_channel_opened_get_local_cid(const uint8_t* event) {
+    return little_endian_read_16(event, 13);
+}
+static inline uint16_t l2cap_event_channel_opened_get_remote_cid(const uint8_t* event) {
+    return little_endian_read_16(event, 15);
+}
+static inline uint16_t l2cap_event_channel_opened_get_local_mtu(const uint8_t* event) {
+    return little_endian_read_16(event, 17);
+}
+static inline uint16_t l2cap_event_channel_opened_get_remote_mtu(const uint8_t* event) {
+    return little_endian_read_16(event, 19);
+}
+static inline uint8_t l2cap_event_channel_opened_get_incoming(const uint8_t* event) {
+    return event[23];
+}
+static inline uint16_t l2cap_event_channel_closed_get_local_cid(const uint8_t* event) {
+    return little_endian_read_16(event, 2);
+}
+static inline void l2cap_event_incoming_connection_get_address(const uint8_t* event, bd_addr_t addr) {
+    memcpy(addr, &event[2], BD_ADDR_LEN);
+}
+static inline hci_con_handle_t l2cap_event_incoming_connection_get_handle(const uint8_t* event) {
+    return little_endian_read_16(event, 8);
+}
+static inline uint16_t l2cap_event_incoming_connection_get_psm(const uint8_t* event) {
+    return little_endian_read_16(event, 10);
+}
+static inline uint16_t l2cap_event_incoming_connection_get_local_cid(const uint8_t* event) {
+    return little_endian_read_16(event, 12);
+}
+static inline uint16_t l2cap_event_incoming_connection_get_remote_cid(const uint8_t* event) {
+    return little_endian_read_16(event, 14);
+}
+
+// GAP
+uint8_t gap_remote_name_request(const bd_addr_t addr, uint8_t page_scan_mode, uint16_t clock_offset);
+gap_connection_type_t gap_get_connection_type(hci_con_handle_t connection_handle);
+uint8_t gap_disconnect(hci_con_handle_t handle);
+int gap_inquiry_periodic_start(uint8_t duration, uint16_t max_period_length, uint16_t min_period_length);
+int gap_inquiry_stop(void);
+void gap_set_security_level(gap_security_level_t security_level);
+void gap_request_security_level(hci_con_handle_t con_handle, gap_security_level_t level);
+void gap_connectable_control(uint8_t enable);
+void gap_discoverable_control(uint8_t enable);
+void gap_set_page_scan_type(uint8_t page_scan_type);
+void gap_set_default_link_policy_settings(uint16_t default_link_policy_settings);
+void gap_local_bd_addr(bd_addr_t address_buffer);
+int gap_pin_code_response_binary(const bd_addr_t addr, const uint8_t* pin_data, uint8_t pin_len);
+void gap_drop_link_key_for_bd_addr(bd_addr_t addr);
+int gap_link_key_iterator_init(btstack_link_key_iterator_t* it);
+int gap_link_key_iterator_get_next(btstack_link_key_iterator_t* it,
+                                   bd_addr_t bd_addr,
+                                   link_key_t link_key,
+                                   link_key_type_t* type);
+void gap_link_key_iterator_done(btstack_link_key_iterator_t* it);
+
+// HCI
+void hci_set_inquiry_mode(uint8_t mode);
+void hci_set_master_slave_policy(uint8_t policy);
+
+// L2CAP
+uint8_t l2cap_create_channel(btstack_packet_handler_t packet_handler,
+                             bd_addr_t address,
+                             uint16_t psm,
+                             uint16_t mtu,
+                             uint16_t* out_local_cid);
+uint8_t l2cap_disconnect(uint16_t local_cid);
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler,
+                               uint16_t psm,
+                               uint16_t mtu,
+                               gap_security_level_t security_level);
+void l2cap_accept_connection(uint16_t local_cid);
+void l2cap_decline_connection(uint16_t local_cid);
+
+// SDP. sdp_client_query_uuid16() is provided by fake_bredr.c
+#define BLUETOOTH_SERVICE_CLASS_HUMAN_INTERFACE_DEVICE_SERVICE 0x1124
+#define BLUETOOTH_SERVICE_CLASS_PNP_INFORMATION 0x1200
+#define BLUETOOTH_ATTRIBUTE_VENDOR_ID 0x0201
+#define BLUETOOTH_ATTRIBUTE_PRODUCT_ID 0x0202
+#define BLUETOOTH_ATTRIBUTE_HID_DESCRIPTOR_LIST 0x0206
+#define BLUETOOTH_COMPANY_ID_BLUEKITCHEN_GMBH 0x048f
+#define DEVICE_ID_VENDOR_ID_SOURCE_BLUETOOTH 0x0001
+
+typedef enum {
+    DE_NIL = 0,
+    DE_UINT,
+    DE_INT,
+    DE_UUID,
+    DE_STRING,
+    DE_BOOL,
+    DE_DES,
+    DE_DEA,
+    DE_URL,
+} de_type_t;
+
+typedef struct {
+    uint8_t* element;
+    uint16_t pos;
+    uint16_t length;
+} des_iterator_t;
+
+uint8_t sdp_client_query_uuid16(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid16);
+void sdp_init(void);
+uint8_t sdp_register_service(const uint8_t* record);
+void device_id_create_sdp_record(uint8_t* service,
+                                 uint32_t service_record_handle,
+                                 uint16_t vendor_id_source,
+                                 uint16_t vendor_id,
+                                 uint16_t product_id,
+                                 uint16_t version);
+bool des_iterator_init(des_iterator_t* it, uint8_t* element);
+bool des_iterator_has_more(des_iterator_t* it);
+de_type_t des_iterator_get_type(des_iterator_t* it);
+uint8_t* des_iterator_get_element(des_iterator_t* it);
+void des_iterator_next(des_iterator_t* it);
+const uint8_t* de_get_string(const uint8_t* element);
+uint32_t de_get_data_size(const uint8_t* header);
+uint32_t de_get_len(const uint8_t* header);
+bool de_element_get_uint16(const uint8_t* element, uint16_t* value);
+
+#endif  // BTSTACK_H
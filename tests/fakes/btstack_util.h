@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// In BTstack, btstack.h includes it. Here it is the other way around. See btstack.h
+
+#ifndef BTSTACK_UTIL_H
+#define BTSTACK_UTIL_H
+
+#include <btstack.h>
+
+#endif  // BTSTACK_UTIL_H
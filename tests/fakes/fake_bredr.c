@@ -0,0 +1,800 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "fake_bredr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bt/uni_bt.h"
+#include "bt/uni_bt_allowlist.h"
+#include "bt/uni_bt_bredr.h"
+#include "bt/uni_bt_conn_policy.h"
+#include "bt/uni_bt_defines.h"
+#include "bt/uni_bt_reconnect.h"
+#include "bt/uni_bt_reject_cache.h"
+#include "bt/uni_bt_scan_policy.h"
+#include "bt/uni_bt_sched.h"
+#include "bt/uni_bt_sdp.h"
+#include "fake_btstack.h"
+#include "parser/uni_hid_parser.h"
+#include "uni_common.h"
+#include "uni_log.h"
+
+#define MAX_EVENTS 64
+// Time to deliver the events of a closed connection.
+#define DISCONNECT_MS 30
+
+// SDP query statuses.
+#define SDP_STATUS_FAILED 0x1f
+#define SDP_STATUS_INCOMPLETE 0x6f
+
+// Same as uni_hid_device.c
+#define FLAGS_HAS_NAME BIT(9)
+
+// Steps waiting for the ACL connection.
+enum {
+    WAIT_L2CAP_CONTROL = BIT(0),
+    WAIT_L2CAP_INTERRUPT = BIT(1),
+    WAIT_SDP = BIT(2),
+};
+
+// L2CAP channels of a controller.
+enum {
+    CHANNEL_CONTROL,
+    CHANNEL_INTERRUPT,
+    CHANNEL_COUNT,
+};
+
+typedef struct {
+    fake_bredr_controller_t cfg;
+    bd_addr_t addr;
+    bool paging;
+    bool acl;
+    uint8_t acl_waiters;
+    // Local CID of the channels, pending or open. 0 if none.
+    uint16_t cids[CHANNEL_COUNT];
+    bool open[CHANNEL_COUNT];
+    int sdp_queries;
+    bool deleted;
+    // Remaining misbehaviors.
+    uint8_t sdp_failures;
+    uint8_t sdp_lost;
+    uint8_t l2cap_refused;
+} controller_t;
+
+typedef struct event_s {
+    btstack_timer_source_t timer;
+    bool used;
+    controller_t* c;
+    uint16_t arg;
+    void (*fn)(controller_t* c, uint16_t arg);
+} event_t;
+
+static controller_t controllers[FAKE_BREDR_MAX_CONTROLLERS];
+static int controllers_count;
+static event_t events[MAX_EVENTS];
+static controller_t* page_owner;
+static fake_bredr_stats_t stats;
+
+// Emulated SDP client. Only one query at the time, and it can't be cancelled.
+static struct {
+    bool busy;
+    controller_t* c;
+    btstack_packet_handler_t handler;
+    uint16_t uuid;
+    // Pending answer, or NULL if the query was lost.
+    event_t* answer;
+} sdp_client;
+
+static uni_hid_device_t g_devices[CONFIG_BLUEPAD32_MAX_DEVICES];
+static const bd_addr_t zero_addr;
+
+static void run_event(btstack_timer_source_t* ts) {
+    event_t* e = btstack_run_loop_get_timer_context(ts);
+
+    e->used = false;
+    e->fn(e->c, e->arg);
+}
+
+static event_t* after(controller_t* c, uint32_t ms, void (*fn)(controller_t* c, uint16_t arg), uint16_t arg) {
+    for (int i = 0; i < MAX_EVENTS; i++) {
+        event_t* e = &events[i];
+        if (e->used)
+            continue;
+        e->used = true;
+        e->c = c;
+        e->arg = arg;
+        e->fn = fn;
+        btstack_run_loop_set_timer(&e->timer, ms);
+        btstack_run_loop_set_timer_handler(&e->timer, run_event);
+        btstack_run_loop_set_timer_context(&e->timer, e);
+        btstack_run_loop_add_timer(&e->timer);
+        return e;
+    }
+    printf("fake_bredr: no free events, increase MAX_EVENTS\n");
+    abort();
+}
+
+static void cancel(event_t* e) {
+    btstack_run_loop_remove_timer(&e->timer);
+    e->used = false;
+}
+
+static uint32_t latency(const fake_bredr_latency_t* l) {
+    return fake_random_range(l->min_ms, l->max_ms);
+}
+
+static int controller_idx(const controller_t* c) {
+    return (int)(c - controllers);
+}
+
+static hci_con_handle_t controller_handle(const controller_t* c) {
+    return (hci_con_handle_t)(controller_idx(c) + 1);
+}
+
+static controller_t* controller_for_address(const bd_addr_t addr) {
+    for (int i = 0; i < controllers_count; i++) {
+        if (bd_addr_cmp(controllers[i].addr, addr) == 0)
+            return &controllers[i];
+    }
+    return NULL;
+}
+
+static controller_t* controller_for_handle(hci_con_handle_t handle) {
+    if (handle == 0 || handle > controllers_count)
+        return NULL;
+    return &controllers[handle - 1];
+}
+
+static controller_t* controller_for_cid(uint16_t cid, int* channel) {
+    for (int i = 0; i < controllers_count; i++) {
+        for (int j = 0; j < CHANNEL_COUNT; j++) {
+            if (controllers[i].cids[j] == cid) {
+                *channel = j;
+                return &controllers[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+static void page_start(controller_t* c) {
+    stats.pages++;
+    if (page_owner != NULL)
+        stats.page_overlaps++;
+    page_owner = c;
+}
+
+static void page_end(controller_t* c) {
+    if (page_owner == c)
+        page_owner = NULL;
+}
+
+// SDP client
+
+static void sdp_deliver_attribute(uint16_t attribute_id, uint16_t value) {
+    // Data element: unsigned integer, 2 bytes, big endian.
+    const uint8_t element[] = {0x09, value >> 8, value & 0xff};
+    uint8_t packet[11] = {SDP_EVENT_QUERY_ATTRIBUTE_VALUE, sizeof(packet) - 2};
+
+    for (unsigned int i = 0; i < sizeof(element); i++) {
+        little_endian_store_16(packet, 4, attribute_id);
+        little_endian_store_16(packet, 6, sizeof(element));
+        little_endian_store_16(packet, 8, i);
+        packet[10] = element[i];
+        sdp_client.handler(HCI_EVENT_PACKET, 0, packet, sizeof(packet));
+    }
+}
+
+static void sdp_complete(controller_t* c, uint16_t status) {
+    uint8_t packet[3] = {SDP_EVENT_QUERY_COMPLETE, 1, (uint8_t)status};
+
+    sdp_client.answer = NULL;
+    if (status == ERROR_CODE_SUCCESS && sdp_client.uuid == BLUETOOTH_SERVICE_CLASS_PNP_INFORMATION) {
+        sdp_deliver_attribute(BLUETOOTH_ATTRIBUTE_VENDOR_ID, c->cfg.vendor_id);
+        sdp_deliver_attribute(BLUETOOTH_ATTRIBUTE_PRODUCT_ID, c->cfg.product_id);
+    }
+    // Same as BTstack: the client is idle again when the event is delivered.
+    sdp_client.busy = false;
+    sdp_client.handler(HCI_EVENT_PACKET, 0, packet, sizeof(packet));
+}
+
+static void sdp_answer(controller_t* c) {
+    uint8_t status = ERROR_CODE_SUCCESS;
+
+    if (c->sdp_lost) {
+        // Answered once the connection is closed. See gap_disconnect()
+        c->sdp_lost--;
+        return;
+    }
+    if (c->sdp_failures) {
+        c->sdp_failures--;
+        status = SDP_STATUS_FAILED;
+    }
+    sdp_client.answer = after(c, latency(&c->cfg.sdp), sdp_complete, status);
+}
+
+// L2CAP
+
+static void l2cap_channel_opened(controller_t* c, uint16_t channel) {
+    uint8_t packet[24] = {L2CAP_EVENT_CHANNEL_OPENED, sizeof(packet) - 2};
+    uint8_t status = ERROR_CODE_SUCCESS;
+    uint16_t cid = c->cids[channel];
+
+    // Closed meanwhile.
+    if (cid == 0)
+        return;
+
+    if (!c->acl) {
+        status = L2CAP_CONNECTION_BASEBAND_DISCONNECT;
+    } else if (c->l2cap_refused) {
+        c->l2cap_refused--;
+        status = L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_RESOURCES;
+    }
+    if (status)
+        c->cids[channel] = 0;
+    else
+        c->open[channel] = true;
+
+    packet[2] = status;
+    memcpy(&packet[3], c->addr, BD_ADDR_LEN);
+    little_endian_store_16(packet, 9, controller_handle(c));
+    little_endian_store_16(packet, 11, channel == CHANNEL_CONTROL ? PSM_HID_CONTROL : PSM_HID_INTERRUPT);
+    little_endian_store_16(packet, 13, cid);
+    little_endian_store_16(packet, 15, cid);
+    little_endian_store_16(packet, 17, UNI_BT_L2CAP_CHANNEL_MTU);
+    little_endian_store_16(packet, 19, 672);
+    uni_bt_bredr_on_l2cap_channel_opened(cid, packet, sizeof(packet));
+}
+
+static void l2cap_channel_closed(controller_t* c, uint16_t cid) {
+    uint8_t packet[4] = {L2CAP_EVENT_CHANNEL_CLOSED, sizeof(packet) - 2};
+
+    little_endian_store_16(packet, 2, cid);
+    uni_bt_bredr_on_l2cap_channel_closed(cid, packet, sizeof(packet));
+}
+
+static void close_channel(controller_t* c, int channel) {
+    if (c->open[channel])
+        after(c, DISCONNECT_MS, l2cap_channel_closed, c->cids[channel]);
+    c->cids[channel] = 0;
+    c->open[channel] = false;
+}
+
+// ACL connection
+
+static void start_waiter(controller_t* c, uint8_t waiter) {
+    switch (waiter) {
+        case WAIT_L2CAP_CONTROL:
+            after(c, latency(&c->cfg.l2cap), l2cap_channel_opened, CHANNEL_CONTROL);
+            break;
+        case WAIT_L2CAP_INTERRUPT:
+            after(c, latency(&c->cfg.l2cap), l2cap_channel_opened, CHANNEL_INTERRUPT);
+            break;
+        case WAIT_SDP:
+            sdp_answer(c);
+            break;
+        default:
+            break;
+    }
+}
+
+static void acl_connected(controller_t* c, uint16_t arg) {
+    uint8_t packet[13] = {HCI_EVENT_CONNECTION_COMPLETE, sizeof(packet) - 2};
+    uint8_t waiters = c->acl_waiters;
+
+    page_end(c);
+    c->paging = false;
+    c->acl = true;
+    c->acl_waiters = 0;
+
+    little_endian_store_16(packet, 3, controller_handle(c));
+    memcpy(&packet[5], c->addr, BD_ADDR_LEN);
+    packet[11] = 1;  // ACL
+    uni_bt_bredr_on_hci_connection_complete(0, packet, sizeof(packet));
+
+    for (uint8_t waiter = BIT(0); waiter <= WAIT_SDP; waiter <<= 1) {
+        if (waiters & waiter)
+            start_waiter(c, waiter);
+    }
+}
+
+// Runs the step once the ACL connection exists. Pages the device if needed.
+static void acl_request(controller_t* c, uint8_t waiter) {
+    if (c->acl) {
+        start_waiter(c, waiter);
+        return;
+    }
+    c->acl_waiters |= waiter;
+    if (c->paging)
+        return;
+    c->paging = true;
+    page_start(c);
+    after(c, latency(&c->cfg.page), acl_connected, 0);
+}
+
+// GAP
+
+static void remote_name_request_complete(controller_t* c, uint16_t paged) {
+    uint8_t packet[9 + HID_MAX_NAME_LEN] = {HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE, sizeof(packet) - 2};
+
+    if (paged)
+        page_end(c);
+    memcpy(&packet[3], c->addr, BD_ADDR_LEN);
+    strncpy((char*)&packet[9], c->cfg.name, HID_MAX_NAME_LEN - 1);
+    uni_bt_bredr_on_hci_remote_name_request_complete(0, packet, sizeof(packet));
+}
+
+uint8_t gap_remote_name_request(const bd_addr_t addr, uint8_t page_scan_mode, uint16_t clock_offset) {
+    controller_t* c = controller_for_address(addr);
+    uint32_t ms;
+
+    if (c == NULL)
+        return ERROR_CODE_PAGE_TIMEOUT;
+
+    ms = latency(&c->cfg.name_request);
+    if (!c->acl) {
+        page_start(c);
+        ms += latency(&c->cfg.page);
+    }
+    after(c, ms, remote_name_request_complete, !c->acl);
+    return ERROR_CODE_SUCCESS;
+}
+
+gap_connection_type_t gap_get_connection_type(hci_con_handle_t connection_handle) {
+    controller_t* c = controller_for_handle(connection_handle);
+
+    return (c && c->acl) ? GAP_CONNECTION_ACL : GAP_CONNECTION_INVALID;
+}
+
+uint8_t gap_disconnect(hci_con_handle_t handle) {
+    controller_t* c = controller_for_handle(handle);
+
+    if (c == NULL || !c->acl)
+        return ERROR_CODE_SUCCESS;
+
+    stats.disconnects++;
+    c->acl = false;
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        close_channel(c, i);
+
+    // Closing the connection finishes its SDP query, lost or not.
+    if (sdp_client.busy && sdp_client.c == c) {
+        if (sdp_client.answer)
+            cancel(sdp_client.answer);
+        sdp_client.answer = after(c, latency(&c->cfg.sdp_closed), sdp_complete, SDP_STATUS_INCOMPLETE);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+int gap_inquiry_periodic_start(uint8_t duration, uint16_t max_period_length, uint16_t min_period_length) {
+    return ERROR_CODE_SUCCESS;
+}
+
+int gap_inquiry_stop(void) {
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_set_security_level(gap_security_level_t security_level) {}
+void gap_request_security_level(hci_con_handle_t con_handle, gap_security_level_t level) {}
+void gap_connectable_control(uint8_t enable) {}
+void gap_discoverable_control(uint8_t enable) {}
+void gap_set_page_scan_type(uint8_t page_scan_type) {}
+void gap_set_default_link_policy_settings(uint16_t default_link_policy_settings) {}
+
+void gap_local_bd_addr(bd_addr_t address_buffer) {
+    memset(address_buffer, 0, BD_ADDR_LEN);
+}
+
+int gap_pin_code_response_binary(const bd_addr_t addr, const uint8_t* pin_data, uint8_t pin_len) {
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_drop_link_key_for_bd_addr(bd_addr_t addr) {}
+
+int gap_link_key_iterator_init(btstack_link_key_iterator_t* it) {
+    return 0;
+}
+
+int gap_link_key_iterator_get_next(btstack_link_key_iterator_t* it,
+                                   bd_addr_t bd_addr,
+                                   link_key_t link_key,
+                                   link_key_type_t* type) {
+    return 0;
+}
+
+void gap_link_key_iterator_done(btstack_link_key_iterator_t* it) {}
+
+// HCI
+
+void hci_set_inquiry_mode(uint8_t mode) {}
+void hci_set_master_slave_policy(uint8_t policy) {}
+
+// L2CAP
+
+uint8_t l2cap_create_channel(btstack_packet_handler_t packet_handler,
+                             bd_addr_t address,
+                             uint16_t psm,
+                             uint16_t mtu,
+                             uint16_t* out_local_cid) {
+    controller_t* c = controller_for_address(address);
+    int channel = (psm == PSM_HID_INTERRUPT) ? CHANNEL_INTERRUPT : CHANNEL_CONTROL;
+
+    if (c == NULL)
+        return ERROR_CODE_PAGE_TIMEOUT;
+
+    c->cids[channel] = (uint16_t)(0x40 + controller_idx(c) * CHANNEL_COUNT + channel);
+    c->open[channel] = false;
+    *out_local_cid = c->cids[channel];
+    acl_request(c, channel == CHANNEL_INTERRUPT ? WAIT_L2CAP_INTERRUPT : WAIT_L2CAP_CONTROL);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_disconnect(uint16_t local_cid) {
+    int channel;
+    controller_t* c = controller_for_cid(local_cid, &channel);
+
+    if (c != NULL)
+        close_channel(c, channel);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler,
+                               uint16_t psm,
+                               uint16_t mtu,
+                               gap_security_level_t security_level) {
+    return ERROR_CODE_SUCCESS;
+}
+
+void l2cap_accept_connection(uint16_t local_cid) {}
+void l2cap_decline_connection(uint16_t local_cid) {}
+
+// SDP client
+
+uint8_t sdp_client_query_uuid16(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid16) {
+    controller_t* c = controller_for_address(remote);
+
+    if (c == NULL)
+        return ERROR_CODE_PAGE_TIMEOUT;
+    if (sdp_client.busy) {
+        stats.sdp_busy_replies++;
+        return SDP_QUERY_BUSY;
+    }
+
+    sdp_client.busy = true;
+    sdp_client.c = c;
+    sdp_client.handler = callback;
+    sdp_client.uuid = uuid16;
+    sdp_client.answer = NULL;
+    c->sdp_queries++;
+    acl_request(c, WAIT_SDP);
+    return ERROR_CODE_SUCCESS;
+}
+
+// Emulated uni_hid_device.c. Same as the real one, without the parsers and the platform.
+
+static void device_connection_timeout(btstack_timer_source_t* ts) {
+    uni_hid_device_t* d = btstack_run_loop_get_timer_context(ts);
+
+    if (d->conn.state == UNI_BT_CONN_STATE_DEVICE_READY)
+        return;
+    stats.connection_timeouts++;
+    uni_hid_device_disconnect(d);
+    uni_hid_device_delete(d);
+}
+
+static void start_connection_timeout(uni_hid_device_t* d) {
+    d->connection_deadline_ms = btstack_run_loop_get_time_ms() + HID_DEVICE_CONNECTION_TIMEOUT_MS;
+    btstack_run_loop_set_timer_context(&d->connection_timer, d);
+    btstack_run_loop_set_timer_handler(&d->connection_timer, device_connection_timeout);
+    btstack_run_loop_set_timer(&d->connection_timer, HID_DEVICE_CONNECTION_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&d->connection_timer);
+}
+
+void uni_hid_device_init(uni_hid_device_t* d) {
+    memset(d, 0, sizeof(*d));
+    d->hids_cid = 0xffff;
+    uni_bt_conn_init(&d->conn);
+}
+
+uni_hid_device_t* uni_hid_device_create(bd_addr_t address) {
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (bd_addr_cmp(g_devices[i].conn.btaddr, zero_addr) == 0) {
+            uni_hid_device_init(&g_devices[i]);
+            bd_addr_copy(g_devices[i].conn.btaddr, address);
+            uni_bt_conn_trace_start(&g_devices[i].conn);
+            start_connection_timeout(&g_devices[i]);
+            return &g_devices[i];
+        }
+    }
+    return NULL;
+}
+
+uni_hid_device_t* uni_hid_device_get_instance_for_address(bd_addr_t addr) {
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (bd_addr_cmp(addr, g_devices[i].conn.btaddr) == 0)
+            return &g_devices[i];
+    }
+    return NULL;
+}
+
+uni_hid_device_t* uni_hid_device_get_instance_for_cid(uint16_t cid) {
+    if (cid == 0)
+        return NULL;
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++) {
+        if (g_devices[i].conn.interrupt_cid == cid || g_devices[i].conn.control_cid == cid)
+            return &g_devices[i];
+    }
+    return NULL;
+}
+
+void uni_hid_device_set_ready(uni_hid_device_t* d) {
+    uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_DEVICE_PENDING_READY);
+    uni_hid_device_set_ready_complete(d);
+}
+
+bool uni_hid_device_set_ready_complete(uni_hid_device_t* d) {
+    btstack_run_loop_remove_timer(&d->connection_timer);
+    uni_hid_device_stop_setup_timer(d);
+    uni_bt_conn_policy_on_setup_finished(d, true);
+    uni_bt_conn_set_state(&d->conn, UNI_BT_CONN_STATE_DEVICE_READY);
+    return true;
+}
+
+void uni_hid_device_connect(uni_hid_device_t* d) {
+    uni_bt_conn_set_connected(&d->conn, true);
+}
+
+void uni_hid_device_on_connected(uni_hid_device_t* d, bool connected) {}
+
+void uni_hid_device_disconnect(uni_hid_device_t* d) {
+    if (gap_get_connection_type(d->conn.handle) == GAP_CONNECTION_ACL)
+        uni_bt_bredr_disconnect(d);
+    uni_bt_conn_disconnect(&d->conn);
+    btstack_run_loop_remove_timer(&d->connection_timer);
+    btstack_run_loop_remove_timer(&d->inquiry_remote_name_timer);
+}
+
+void uni_hid_device_delete(uni_hid_device_t* d) {
+    controller_t* c = controller_for_address(d->conn.btaddr);
+
+    if (c != NULL)
+        c->deleted = true;
+    if (!d->conn.reconnecting && uni_bt_conn_get_state(&d->conn) != UNI_BT_CONN_STATE_DEVICE_READY)
+        uni_bt_conn_policy_on_setup_finished(d, false);
+    btstack_run_loop_remove_timer(&d->connection_timer);
+    uni_hid_device_stop_setup_timer(d);
+    uni_bt_sched_on_device_deleted(d);
+    uni_bt_sdp_on_device_deleted(d);
+    uni_hid_device_init(d);
+}
+
+void uni_hid_device_pause_connection_timeout(uni_hid_device_t* d) {
+    int32_t remaining;
+
+    if (d->connection_remaining_ms || d->conn.state == UNI_BT_CONN_STATE_DEVICE_READY)
+        return;
+    remaining = (int32_t)(d->connection_deadline_ms - btstack_run_loop_get_time_ms());
+    d->connection_remaining_ms = remaining > 1 ? remaining : 1;
+    btstack_run_loop_remove_timer(&d->connection_timer);
+}
+
+void uni_hid_device_resume_connection_timeout(uni_hid_device_t* d) {
+    if (!d->connection_remaining_ms)
+        return;
+    d->connection_deadline_ms = btstack_run_loop_get_time_ms() + d->connection_remaining_ms;
+    btstack_run_loop_set_timer(&d->connection_timer, d->connection_remaining_ms);
+    btstack_run_loop_add_timer(&d->connection_timer);
+    d->connection_remaining_ms = 0;
+}
+
+void uni_hid_device_start_setup_timer(uni_hid_device_t* d, uint32_t ms, void (*handler)(btstack_timer_source_t* ts)) {
+    btstack_run_loop_remove_timer(&d->setup_timer);
+    btstack_run_loop_set_timer_context(&d->setup_timer, d);
+    btstack_run_loop_set_timer_handler(&d->setup_timer, handler);
+    btstack_run_loop_set_timer(&d->setup_timer, ms);
+    btstack_run_loop_add_timer(&d->setup_timer);
+}
+
+void uni_hid_device_stop_setup_timer(uni_hid_device_t* d) {
+    btstack_run_loop_remove_timer(&d->setup_timer);
+}
+
+void uni_hid_device_set_cod(uni_hid_device_t* d, uint32_t cod) {
+    d->cod = cod;
+}
+
+uni_error_t uni_hid_device_on_device_discovered(bd_addr_t addr, const char* name, uint16_t cod, uint8_t rssi) {
+    return UNI_ERROR_SUCCESS;
+}
+
+void uni_hid_device_set_incoming(uni_hid_device_t* d, bool incoming) {
+    d->conn.incoming = incoming;
+}
+
+bool uni_hid_device_is_incoming(const uni_hid_device_t* d) {
+    return d->conn.incoming;
+}
+
+void uni_hid_device_set_name(uni_hid_device_t* d, const char* name) {
+    strncpy(d->name, name, sizeof(d->name) - 1);
+    d->name[sizeof(d->name) - 1] = 0;
+    d->flags |= FLAGS_HAS_NAME;
+}
+
+bool uni_hid_device_has_name(const uni_hid_device_t* d) {
+    return (d->flags & FLAGS_HAS_NAME) != 0;
+}
+
+void uni_hid_device_set_hid_descriptor(uni_hid_device_t* d, const uint8_t* descriptor, int len) {}
+
+bool uni_hid_device_does_require_hid_descriptor(const uni_hid_device_t* d) {
+    return true;
+}
+
+void uni_hid_device_set_vendor_id(uni_hid_device_t* d, uint16_t vendor_id) {
+    d->vendor_id = vendor_id;
+}
+
+uint16_t uni_hid_device_get_vendor_id(const uni_hid_device_t* d) {
+    return d->vendor_id;
+}
+
+void uni_hid_device_set_product_id(uni_hid_device_t* d, uint16_t product_id) {
+    d->product_id = product_id;
+}
+
+uint16_t uni_hid_device_get_product_id(const uni_hid_device_t* d) {
+    return d->product_id;
+}
+
+bool uni_hid_device_guess_controller_type_from_name(uni_hid_device_t* d, const char* name) {
+    return false;
+}
+
+void uni_hid_device_guess_controller_type_from_pid_vid(uni_hid_device_t* d) {}
+
+void uni_hid_device_set_connection_handle(uni_hid_device_t* d, hci_con_handle_t handle) {
+    d->conn.handle = handle;
+}
+
+void uni_hid_device_process_controller(uni_hid_device_t* d) {}
+
+void uni_hid_parse_input_report(uni_hid_device_t* d, const uint8_t* report, uint16_t report_len) {}
+
+// Other Bluepad32 modules used by uni_bt_bredr.c, not under test.
+
+bool uni_bt_incoming_connections_is_allowed(void) {
+    return true;
+}
+
+int uni_bt_get_gap_security_level(void) {
+    return 2;
+}
+
+int uni_bt_get_gap_inquiry_length(void) {
+    return 3;
+}
+
+int uni_bt_get_gap_max_periodic_length(void) {
+    return 5;
+}
+
+int uni_bt_get_gap_min_periodic_length(void) {
+    return 4;
+}
+
+void uni_bt_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t* packet, uint16_t size) {}
+
+bool uni_bt_allowlist_is_allowed_addr(bd_addr_t addr) {
+    return true;
+}
+
+void uni_bt_reconnect_init(void) {}
+
+bool uni_bt_reconnect_on_page_failed(uni_hid_device_t* d) {
+    return false;
+}
+
+void uni_bt_reconnect_on_page_succeeded(uni_hid_device_t* d) {}
+
+bool uni_bt_reject_cache_contains(const bd_addr_t addr) {
+    return false;
+}
+
+void uni_bt_reject_cache_add(const bd_addr_t addr) {}
+
+void uni_bt_scan_policy_on_activity(void) {}
+
+// Public functions
+
+void fake_bredr_reset(void) {
+    memset(controllers, 0, sizeof(controllers));
+    controllers_count = 0;
+    memset(events, 0, sizeof(events));
+    memset(&sdp_client, 0, sizeof(sdp_client));
+    memset(&stats, 0, sizeof(stats));
+    page_owner = NULL;
+    for (int i = 0; i < CONFIG_BLUEPAD32_MAX_DEVICES; i++)
+        uni_hid_device_init(&g_devices[i]);
+}
+
+void fake_bredr_controller_init(fake_bredr_controller_t* c) {
+    memset(c, 0, sizeof(*c));
+    c->name = "Emulated Controller";
+    c->cod = 0x002508;  // Peripheral, gamepad
+    c->vendor_id = 0x1234;
+    c->product_id = 0x5678;
+    c->page = (fake_bredr_latency_t){60, 400};
+    c->name_request = (fake_bredr_latency_t){20, 80};
+    c->l2cap = (fake_bredr_latency_t){30, 150};
+    c->sdp = (fake_bredr_latency_t){150, 1500};
+    c->sdp_closed = (fake_bredr_latency_t){100, 300};
+}
+
+int fake_bredr_add(const fake_bredr_controller_t* cfg) {
+    controller_t* c;
+
+    if (controllers_count >= FAKE_BREDR_MAX_CONTROLLERS) {
+        printf("fake_bredr: too many controllers\n");
+        abort();
+    }
+    c = &controllers[controllers_count];
+    c->cfg = *cfg;
+    c->sdp_failures = cfg->sdp_failures;
+    c->sdp_lost = cfg->sdp_lost;
+    c->l2cap_refused = cfg->l2cap_refused;
+    fake_bredr_get_address(controllers_count, c->addr);
+    return controllers_count++;
+}
+
+void fake_bredr_discover(int idx) {
+    controller_t* c = &controllers[idx];
+    uint8_t packet[18 + HID_MAX_NAME_LEN - 1] = {GAP_EVENT_INQUIRY_RESULT, sizeof(packet) - 2};
+    size_t name_len;
+
+    memcpy(&packet[2], c->addr, BD_ADDR_LEN);
+    packet[8] = 1;  // Page scan repetition mode
+    little_endian_store_24(packet, 9, c->cfg.cod);
+    little_endian_store_16(packet, 12, 0x1234);  // Clock offset
+    packet[14] = 1;
+    packet[15] = 200;  // RSSI
+    if (c->cfg.name_in_inquiry) {
+        name_len = strnlen(c->cfg.name, HID_MAX_NAME_LEN - 1);
+        packet[16] = 1;
+        packet[17] = (uint8_t)name_len;
+        memcpy(&packet[18], c->cfg.name, name_len);
+    }
+    uni_bt_bredr_on_gap_inquiry_result(0, packet, sizeof(packet));
+}
+
+void fake_bredr_get_address(int idx, bd_addr_t addr) {
+    const bd_addr_t base = {0x00, 0x1b, 0xdc, 0x0f, 0x00, 0x00};
+
+    bd_addr_copy(addr, base);
+    addr[5] = (uint8_t)idx;
+}
+
+uni_hid_device_t* fake_bredr_get_device(int idx) {
+    if (controllers[idx].deleted)
+        return NULL;
+    return uni_hid_device_get_instance_for_address(controllers[idx].addr);
+}
+
+int fake_bredr_get_sdp_queries(int idx) {
+    return controllers[idx].sdp_queries;
+}
+
+bool fake_bredr_was_deleted(int idx) {
+    return controllers[idx].deleted;
+}
+
+bool fake_bredr_is_sdp_client_busy(void) {
+    return sdp_client.busy;
+}
+
+void fake_bredr_get_stats(fake_bredr_stats_t* out) {
+    *out = stats;
+}
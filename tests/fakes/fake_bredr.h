@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef FAKE_BREDR_H
+#define FAKE_BREDR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <btstack.h>
+
+#include "uni_hid_device.h"
+
+// Emulated BR/EDR controllers, for the tests that run the real uni_bt_bredr.c FSM.
+// It replaces the BTstack GAP, L2CAP and SDP client APIs that uni_bt_bredr.c and uni_bt_sdp.c use, and answers
+// them with the events that BTstack would send, after an emulated latency. Uses the fake_btstack.h run loop.
+//
+// It also replaces uni_hid_device.c, with the subset of it that the connection setup uses.
+//
+// Like BTstack:
+// - Paging a device without an ACL connection: remote name requests, L2CAP channels and SDP queries.
+// - The SDP client supports one query at a time. Otherwise it returns SDP_QUERY_BUSY.
+// - An SDP query can't be cancelled. It finishes once the ACL connection is closed.
+// Two pages at the same time are counted as an overlap: the scheduler must prevent them.
+
+#define FAKE_BREDR_MAX_CONTROLLERS 16
+
+typedef struct {
+    uint32_t min_ms;
+    uint32_t max_ms;
+} fake_bredr_latency_t;
+
+typedef struct {
+    // Sent in the inquiry result if "name_in_inquiry". Otherwise, answered by the remote name request.
+    const char* name;
+    bool name_in_inquiry;
+    uint32_t cod;
+    // Answered by the VID/PID SDP query.
+    uint16_t vendor_id;
+    uint16_t product_id;
+
+    fake_bredr_latency_t page;
+    fake_bredr_latency_t name_request;
+    fake_bredr_latency_t l2cap;
+    fake_bredr_latency_t sdp;
+    // Time to finish a pending SDP query once the ACL connection is closed.
+    fake_bredr_latency_t sdp_closed;
+
+    // Misbehaviors. Each one applies to the first N requests.
+    // SDP queries that finish with an error.
+    uint8_t sdp_failures;
+    // SDP queries that are never answered. They finish once the ACL connection is closed.
+    uint8_t sdp_lost;
+    // L2CAP channels refused for lack of resources.
+    uint8_t l2cap_refused;
+} fake_bredr_controller_t;
+
+typedef struct {
+    // Pages started while another page was in progress.
+    uint32_t page_overlaps;
+    uint32_t pages;
+    uint32_t sdp_busy_replies;
+    // Devices deleted by the connection timeout.
+    uint32_t connection_timeouts;
+    // ACL connections closed by Bluepad32.
+    uint32_t disconnects;
+} fake_bredr_stats_t;
+
+// Removes the controllers and the devices. Must be called after fake_run_loop_reset().
+void fake_bredr_reset(void);
+// A well-behaved controller, with typical latencies.
+void fake_bredr_controller_init(fake_bredr_controller_t* c);
+// Returns the index of the controller. Its address ends with the index.
+int fake_bredr_add(const fake_bredr_controller_t* c);
+// Sends the inquiry result of the controller.
+void fake_bredr_discover(int idx);
+void fake_bredr_get_address(int idx, bd_addr_t addr);
+// Device of the controller, or NULL if it was deleted.
+uni_hid_device_t* fake_bredr_get_device(int idx);
+// SDP queries received by the controller.
+int fake_bredr_get_sdp_queries(int idx);
+// Whether a device was deleted. A deleted device is not "ready", even if its address is reused.
+bool fake_bredr_was_deleted(int idx);
+bool fake_bredr_is_sdp_client_busy(void);
+void fake_bredr_get_stats(fake_bredr_stats_t* stats);
+
+#endif  // FAKE_BREDR_H
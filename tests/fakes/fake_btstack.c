@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#include "fake_btstack.h"
+
+#include <stdio.h>
+
+#include <btstack.h>
+
+// Timers sorted by deadline. Timers with the same deadline run in the order they were added.
+static btstack_linked_item_t* timers;
+// Callbacks from btstack_run_loop_execute_on_main_thread(). They run before the next timer.
+static btstack_linked_item_t* callbacks;
+static uint32_t now_ms;
+static uint32_t random_state = 1;
+
+void fake_run_loop_reset(void) {
+    timers = NULL;
+    callbacks = NULL;
+    now_ms = 0;
+}
+
+uint32_t fake_run_loop_run(uint32_t max_ms) {
+    btstack_timer_source_t* ts;
+    btstack_context_callback_registration_t* cb;
+    uint32_t end = now_ms + max_ms;
+
+    while (true) {
+        if (callbacks) {
+            cb = (btstack_context_callback_registration_t*)callbacks;
+            callbacks = callbacks->next;
+            cb->callback(cb->context);
+            continue;
+        }
+        if (!timers)
+            break;
+        ts = (btstack_timer_source_t*)timers;
+        if ((int32_t)(ts->timeout - end) > 0)
+            break;
+        timers = timers->next;
+        if ((int32_t)(ts->timeout - now_ms) > 0)
+            now_ms = ts->timeout;
+        ts->process(ts);
+    }
+    return now_ms;
+}
+
+void fake_random_seed(uint32_t seed) {
+    random_state = seed ? seed : 1;
+}
+
+uint32_t fake_random_range(uint32_t min, uint32_t max) {
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return min + random_state % (max - min + 1);
+}
+
+// Run loop
+
+uint32_t btstack_run_loop_get_time_ms(void) {
+    return now_ms;
+}
+
+void btstack_run_loop_set_timer(btstack_timer_source_t* ts, uint32_t timeout_in_ms) {
+    ts->timeout = now_ms + timeout_in_ms;
+}
+
+void btstack_run_loop_set_timer_handler(btstack_timer_source_t* ts, void (*process)(btstack_timer_source_t* ts)) {
+    ts->process = process;
+}
+
+void btstack_run_loop_set_timer_context(btstack_timer_source_t* ts, void* context) {
+    ts->context = context;
+}
+
+void* btstack_run_loop_get_timer_context(btstack_timer_source_t* ts) {
+    return ts->context;
+}
+
+void btstack_run_loop_add_timer(btstack_timer_source_t* ts) {
+    btstack_linked_item_t** it;
+
+    // Same as BTstack: adding a timer that is already added is ignored.
+    for (it = &timers; *it; it = &(*it)->next) {
+        if (*it == &ts->item)
+            return;
+    }
+    for (it = &timers; *it; it = &(*it)->next) {
+        if ((int32_t)(ts->timeout - ((btstack_timer_source_t*)*it)->timeout) < 0)
+            break;
+    }
+    ts->item.next = *it;
+    *it = &ts->item;
+}
+
+int btstack_run_loop_remove_timer(btstack_timer_source_t* ts) {
+    for (btstack_linked_item_t** it = &timers; *it; it = &(*it)->next) {
+        if (*it == &ts->item) {
+            *it = ts->item.next;
+            return true;
+        }
+    }
+    return false;
+}
+
+void btstack_run_loop_execute_on_main_thread(btstack_context_callback_registration_t* callback_registration) {
+    btstack_linked_item_t** it;
+
+    for (it = &callbacks; *it; it = &(*it)->next) {
+        if (*it == &callback_registration->item)
+            return;
+    }
+    callback_registration->item.next = NULL;
+    *it = &callback_registration->item;
+}
+
+// Utils
+
+const char* bd_addr_to_str(const bd_addr_t addr) {
+    static char buf[18];
+
+    snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
+    return buf;
+}
+
+int bd_addr_cmp(const bd_addr_t a, const bd_addr_t b) {
+    return memcmp(a, b, BD_ADDR_LEN);
+}
+
+void bd_addr_copy(bd_addr_t dest, const bd_addr_t src) {
+    memcpy(dest, src, BD_ADDR_LEN);
+}
+
+void reverse_bd_addr(const bd_addr_t src, bd_addr_t dest) {
+    for (int i = 0; i < BD_ADDR_LEN; i++)
+        dest[i] = src[BD_ADDR_LEN - 1 - i];
+}
+
+uint16_t little_endian_read_16(const uint8_t* buffer, int position) {
+    return (uint16_t)(buffer[position] | (buffer[position + 1] << 8));
+}
+
+uint32_t little_endian_read_24(const uint8_t* buffer, int position) {
+    return little_endian_read_16(buffer, position) | ((uint32_t)buffer[position + 2] << 16);
+}
+
+void little_endian_store_16(uint8_t* buffer, uint16_t position, uint16_t value) {
+    buffer[position] = value & 0xff;
+    buffer[position + 1] = value >> 8;
+}
+
+void little_endian_store_24(uint8_t* buffer, uint16_t position, uint32_t value) {
+    little_endian_store_16(buffer, position, value & 0xffff);
+    buffer[position + 2] = (value >> 16) & 0xff;
+}
+
+void printf_hexdump(const void* data, int size) {
+    const uint8_t* p = data;
+
+    for (int i = 0; i < size; i++)
+        printf("%02x ", p[i]);
+    printf("\n");
+}
+
+// SDP. Only the data elements used by the VID/PID query are emulated: 16-bit unsigned integers.
+// The other ones are always empty.
+
+void sdp_init(void) {}
+
+uint8_t sdp_register_service(const uint8_t* record) {
+    return ERROR_CODE_SUCCESS;
+}
+
+void device_id_create_sdp_record(uint8_t* service,
+                                 uint32_t service_record_handle,
+                                 uint16_t vendor_id_source,
+                                 uint16_t vendor_id,
+                                 uint16_t product_id,
+                                 uint16_t version) {
+    service[0] = 0;
+}
+
+bool des_iterator_init(des_iterator_t* it, uint8_t* element) {
+    it->element = element;
+    it->pos = 0;
+    it->length = 0;
+    return true;
+}
+
+bool des_iterator_has_more(des_iterator_t* it) {
+    return it->pos < it->length;
+}
+
+de_type_t des_iterator_get_type(des_iterator_t* it) {
+    return DE_NIL;
+}
+
+uint8_t* des_iterator_get_element(des_iterator_t* it) {
+    return it->element + it->pos;
+}
+
+void des_iterator_next(des_iterator_t* it) {
+    it->pos = it->length;
+}
+
+const uint8_t* de_get_string(const uint8_t* element) {
+    return element;
+}
+
+uint32_t de_get_data_size(const uint8_t* header) {
+    return 0;
+}
+
+uint32_t de_get_len(const uint8_t* header) {
+    return 0;
+}
+
+bool de_element_get_uint16(const uint8_t* element, uint16_t* value) {
+    // Type "unsigned integer", size index 1: 2 bytes, big endian.
+    if (element[0] != ((DE_UINT << 3) | 1))
+        return false;
+    *value = (uint16_t)((element[1] << 8) | element[2]);
+    return true;
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+#ifndef FAKE_BTSTACK_H
+#define FAKE_BTSTACK_H
+
+#include <stdint.h>
+
+#include <btstack.h>
+
+// Run loop with virtual time: timers run in deadline order, and the time jumps to the next deadline.
+// Nothing sleeps, so a setup that takes seconds in real life takes microseconds here.
+
+// Removes all the timers, and sets the time back to 0.
+void fake_run_loop_reset(void);
+// Runs the timers and the callbacks until there are none left, or until "max_ms" elapsed.
+// Returns the virtual time.
+uint32_t fake_run_loop_run(uint32_t max_ms);
+
+// Deterministic pseudo-random numbers, so that each run emulates the same controllers.
+void fake_random_seed(uint32_t seed);
+// Returns a number in the range [min, max].
+uint32_t fake_random_range(uint32_t min, uint32_t max);
+
+#endif  // FAKE_BTSTACK_H
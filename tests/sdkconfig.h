@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Configuration used by the tests. Same as the Posix example, unless a test overrides it.
+
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+#define CONFIG_TARGET_POSIX 1
+
+#ifndef CONFIG_BLUEPAD32_MAX_DEVICES
+#define CONFIG_BLUEPAD32_MAX_DEVICES 4
+#endif
+
+// Errors only. Tests print their own results.
+#ifndef CONFIG_BLUEPAD32_LOG_LEVEL
+#define CONFIG_BLUEPAD32_LOG_LEVEL 1
+#endif
+
+#endif  // SDKCONFIG_H
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Command queue stress test.
+// Several producer threads push commands as fast as they can, while a consumer thread plays the role of the
+// BTstack thread: it runs the callbacks registered with btstack_run_loop_execute_on_main_thread().
+//
+// Checks that:
+// - every command is executed exactly once, and in order for each producer
+// - no wakeup is lost: once the producers are done, the consumer drains everything without new pushes
+// - the drain registration is never added while it is still pending
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <btstack.h>
+
+#include "bt/uni_bt_cmd_queue.h"
+
+#define NUM_PRODUCERS 4
+#define CMDS_PER_PRODUCER 200000
+#define DRAIN_TIMEOUT_S 10
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static btstack_context_callback_registration_t* pending;
+static bool consumer_quit;
+
+// Only accessed from the consumer thread.
+static int32_t next_seq[NUM_PRODUCERS];
+static uint32_t executed;
+static uint32_t out_of_order;
+static uint32_t bad_producer;
+
+static uint32_t overflows[NUM_PRODUCERS];
+static int failures;
+
+static void fail(const char* msg) {
+    printf("FAIL: %s\n", msg);
+    __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+}
+
+// BTstack run loop. Only execute_on_main_thread() is used by the queue.
+
+void btstack_run_loop_execute_on_main_thread(btstack_context_callback_registration_t* callback_registration) {
+    pthread_mutex_lock(&lock);
+    if (pending == callback_registration)
+        fail("drain registration added while pending");
+    pending = callback_registration;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static void* consumer(void* arg) {
+    btstack_context_callback_registration_t* cb;
+
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    while (true) {
+        while (!pending && !consumer_quit)
+            pthread_cond_wait(&cond, &lock);
+        if (!pending)
+            break;
+        cb = pending;
+        pending = NULL;
+        // Same as BTstack: the callback runs without the lock, and could be registered again.
+        pthread_mutex_unlock(&lock);
+        cb->callback(cb->context);
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void cmd_handler(const uni_bt_cmd_t* cmd) {
+    int producer = cmd->cmd;
+
+    if (producer >= NUM_PRODUCERS) {
+        bad_producer++;
+        return;
+    }
+    if (cmd->args.value != next_seq[producer])
+        out_of_order++;
+    next_seq[producer] = cmd->args.value + 1;
+    __atomic_store_n(&executed, executed + 1, __ATOMIC_RELEASE);
+}
+
+static void* producer(void* arg) {
+    int id = (int)(intptr_t)arg;
+    uni_bt_cmd_t cmd = {
+        .handler = &cmd_handler,
+        .cmd = id,
+    };
+
+    for (int32_t i = 0; i < CMDS_PER_PRODUCER; i++) {
+        cmd.args.value = i;
+        // Full: let the consumer catch up, and retry.
+        while (!uni_bt_cmd_queue_push(&cmd)) {
+            overflows[id]++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int main(void) {
+    pthread_t consumer_thread;
+    pthread_t producer_threads[NUM_PRODUCERS];
+    uni_bt_cmd_queue_stats_t stats;
+    struct timespec start, now;
+    uint32_t total = NUM_PRODUCERS * CMDS_PER_PRODUCER;
+    uint32_t total_overflows = 0;
+    double elapsed_s;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&consumer_thread, NULL, consumer, NULL);
+    for (int i = 0; i < NUM_PRODUCERS; i++)
+        pthread_create(&producer_threads[i], NULL, producer, (void*)(intptr_t)i);
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        pthread_join(producer_threads[i], NULL);
+        total_overflows += overflows[i];
+    }
+
+    // No more pushes: if a wakeup was lost, the remaining commands are never executed.
+    while (__atomic_load_n(&executed, __ATOMIC_ACQUIRE) < total) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - start.tv_sec > DRAIN_TIMEOUT_S) {
+            fail("commands not drained: lost wakeup");
+            break;
+        }
+        sched_yield();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_s = (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_nsec - start.tv_nsec) / 1e9;
+
+    pthread_mutex_lock(&lock);
+    consumer_quit = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(consumer_thread, NULL);
+
+    uni_bt_cmd_queue_get_stats(&stats);
+    if (executed != total)
+        fail("executed commands != pushed commands");
+    if (out_of_order)
+        fail("commands from the same producer executed out of order");
+    if (bad_producer)
+        fail("corrupted command");
+    if (stats.pushed != total || stats.executed != total)
+        fail("stats don't match");
+    if (stats.overflows != total_overflows)
+        fail("overflow stats don't match");
+
+    printf("%d producers, %u commands in %.2f s: overflows=%u, wakeups=%u, max batch=%u\n", NUM_PRODUCERS,
+           (unsigned int)total, elapsed_s, (unsigned int)stats.overflows, (unsigned int)stats.wakeups,
+           (unsigned int)stats.max_batch);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Scan policy: report jitter of the connected controllers, with and without the policy.
+//
+// Runs the real scan policy with an emulated radio. The BR/EDR periodic inquiry and the BLE scan windows follow the
+// parameters that the policy sets. The connected controllers send a report every REPORT_INTERVAL_MS. A report that
+// is sent while the radio is scanning waits until the current inquiry train or scan window slice ends.
+// The jitter is how much the time between reports differs from REPORT_INTERVAL_MS.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#include "bt/uni_bt_cmd_queue.h"
+#include "bt/uni_bt_conn.h"
+#include "bt/uni_bt_scan_policy.h"
+#include "fake_btstack.h"
+#include "platform/uni_platform.h"
+#include "uni_hid_device.h"
+#include "uni_property.h"
+
+#define REPORT_INTERVAL_MS 10
+// Time that a scan keeps the radio busy before the controller serves the ACL links.
+// An inquiry train, or a slice of a BLE scan window.
+#define SCAN_SLICE_MS 10
+// Seats of the emulated platform. E.g: two joystick ports.
+#define SEATS 2
+#define IDLE_TIMEOUT_S 30
+
+typedef struct {
+    uint32_t reports;
+    uint32_t delayed;
+    uint64_t deviation_sum_ms;
+    uint32_t max_deviation_ms;
+} jitter_t;
+
+static int failures;
+
+static void expect(bool cond, const char* msg) {
+    if (cond)
+        return;
+    printf("FAIL: %s (t=%u ms)\n", msg, btstack_run_loop_get_time_ms());
+    failures++;
+}
+
+// --- Emulated platform
+
+static int connected;
+
+static int get_free_seats(void) {
+    return SEATS - connected;
+}
+
+static struct uni_platform platform = {
+    .name = "test",
+    .get_free_seats = get_free_seats,
+};
+
+struct uni_platform* uni_get_platform(void) {
+    return &platform;
+}
+
+// Only used by the scan policy when the platform doesn't report its seats.
+static uni_hid_device_t devices[CONFIG_BLUEPAD32_MAX_DEVICES];
+
+uni_hid_device_t* uni_hid_device_get_instance_for_idx(int idx) {
+    return &devices[idx];
+}
+
+// --- Properties
+
+static uni_property_value_t properties[UNI_PROPERTY_IDX_COUNT];
+
+void uni_property_set(uni_property_idx_t idx, uni_property_value_t value) {
+    properties[idx] = value;
+}
+
+uni_property_value_t uni_property_get(uni_property_idx_t idx) {
+    return properties[idx];
+}
+
+// --- Emulated radio
+
+static bool inquiry_active;
+static uint16_t inquiry_max_periodic_len;
+static uint16_t inquiry_min_periodic_len;
+static uint8_t inquiry_len;
+static btstack_timer_source_t inquiry_timer;
+
+static bool le_scan_enabled;
+static uint32_t le_scan_start_ms;
+static uint16_t le_scan_interval;
+static uint16_t le_scan_window;
+
+// Periodic inquiry, in 1.28s units: an inquiry of "inquiry_len", every "min-max periodic len".
+static void inquiry_timer_cb(btstack_timer_source_t* ts) {
+    uint32_t period_ms;
+
+    inquiry_active = !inquiry_active;
+    if (inquiry_active) {
+        btstack_run_loop_set_timer(ts, inquiry_len * 1280);
+    } else {
+        period_ms = fake_random_range(inquiry_min_periodic_len, inquiry_max_periodic_len) * 1280;
+        btstack_run_loop_set_timer(ts, period_ms - inquiry_len * 1280);
+    }
+    btstack_run_loop_add_timer(ts);
+}
+
+void uni_bt_bredr_scan_start_with_params(uint16_t max_periodic_len, uint16_t min_periodic_len, uint8_t len) {
+    inquiry_max_periodic_len = max_periodic_len;
+    inquiry_min_periodic_len = min_periodic_len;
+    inquiry_len = len;
+    // Starts with an inquiry.
+    inquiry_active = false;
+    btstack_run_loop_set_timer_handler(&inquiry_timer, inquiry_timer_cb);
+    inquiry_timer_cb(&inquiry_timer);
+}
+
+void uni_bt_bredr_scan_stop(void) {
+    inquiry_active = false;
+    btstack_run_loop_remove_timer(&inquiry_timer);
+}
+
+void uni_bt_le_scan_start_with_params(uint16_t interval, uint16_t window) {
+    le_scan_enabled = true;
+    le_scan_start_ms = btstack_run_loop_get_time_ms();
+    le_scan_interval = interval;
+    le_scan_window = window;
+}
+
+void uni_bt_le_scan_stop(void) {
+    le_scan_enabled = false;
+}
+
+// Default values, in 1.28s units. Same as uni_bt.c.
+int uni_bt_get_gap_inquiry_length(void) {
+    return 3;
+}
+
+int uni_bt_get_gap_max_periodic_length(void) {
+    return 5;
+}
+
+int uni_bt_get_gap_min_periodic_length(void) {
+    return 4;
+}
+
+static bool is_radio_scanning(void) {
+    uint32_t t_us;
+
+    if (inquiry_active)
+        return true;
+    if (!le_scan_enabled)
+        return false;
+    // Interval and window are in 0.625ms units.
+    t_us = (btstack_run_loop_get_time_ms() - le_scan_start_ms) * 1000;
+    return (t_us % (le_scan_interval * 625)) < (uint32_t)le_scan_window * 625;
+}
+
+// --- Connected controllers
+
+static btstack_timer_source_t report_timer;
+static jitter_t jitter;
+static uint32_t last_report_ms;
+static uint32_t measure_from_ms;
+
+static void deliver(uint32_t now_ms) {
+    uint32_t deviation;
+
+    if (now_ms >= measure_from_ms && last_report_ms != 0) {
+        deviation = now_ms - last_report_ms;
+        deviation = deviation > REPORT_INTERVAL_MS ? deviation - REPORT_INTERVAL_MS : REPORT_INTERVAL_MS - deviation;
+        jitter.reports++;
+        if (deviation) {
+            jitter.delayed++;
+            jitter.deviation_sum_ms += deviation;
+            if (deviation > jitter.max_deviation_ms)
+                jitter.max_deviation_ms = deviation;
+        }
+    }
+    last_report_ms = now_ms;
+}
+
+// A report is sent every REPORT_INTERVAL_MS. Reports don't pile up: the next one is sent on schedule.
+static void report_timer_cb(btstack_timer_source_t* ts) {
+    uint32_t delay = 0;
+
+    if (is_radio_scanning())
+        delay = fake_random_range(1, SCAN_SLICE_MS);
+    deliver(btstack_run_loop_get_time_ms() + delay);
+
+    btstack_run_loop_set_timer(ts, REPORT_INTERVAL_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+// --- Scenarios
+
+static void reset(uni_bt_scan_policy_t policy, int connected_controllers) {
+    uni_property_value_t val;
+
+    fake_run_loop_reset();
+    fake_random_seed(0x5ca7);
+    memset(&jitter, 0, sizeof(jitter));
+    last_report_ms = 0;
+    measure_from_ms = 0;
+    connected = connected_controllers;
+
+    val.u8 = policy;
+    uni_property_set(UNI_PROPERTY_IDX_SCAN_POLICY, val);
+    val.u8 = IDLE_TIMEOUT_S;
+    uni_property_set(UNI_PROPERTY_IDX_SCAN_IDLE_TIMEOUT, val);
+
+    btstack_run_loop_set_timer_handler(&report_timer, report_timer_cb);
+    btstack_run_loop_set_timer(&report_timer, REPORT_INTERVAL_MS);
+    btstack_run_loop_add_timer(&report_timer);
+}
+
+// Reports received in [from_ms, to_ms].
+static void run(uni_bt_scan_policy_t policy, int connected_controllers, uint32_t from_ms, uint32_t to_ms,
+                jitter_t* out) {
+    reset(policy, connected_controllers);
+    measure_from_ms = from_ms;
+    uni_bt_scan_policy_start();
+    fake_run_loop_run(to_ms);
+    *out = jitter;
+    uni_bt_scan_policy_stop();
+}
+
+static void print_jitter(const char* name, const jitter_t* j) {
+    printf("%-34s: %5u reports, %5.1f%% delayed, mean %.2f ms, max %2u ms\n", name, j->reports,
+           j->reports ? 100.0 * j->delayed / j->reports : 0.0,
+           j->reports ? (double)j->deviation_sum_ms / j->reports : 0.0, j->max_deviation_ms);
+}
+
+// All the seats are taken: the policy stops scanning.
+static void test_seats_taken(void) {
+    jitter_t always_on;
+    jitter_t adaptive;
+
+    run(UNI_BT_SCAN_POLICY_ALWAYS_ON, SEATS, 5000, 120000, &always_on);
+    run(UNI_BT_SCAN_POLICY_ADAPTIVE, SEATS, 5000, 120000, &adaptive);
+    print_jitter("seats taken, always on", &always_on);
+    print_jitter("seats taken, adaptive", &adaptive);
+
+    expect(always_on.delayed > 0, "always on: scanning didn't delay any report");
+    expect(adaptive.delayed == 0, "adaptive: reports delayed with all the seats taken");
+
+    // Once a seat gets free, it scans again.
+    reset(UNI_BT_SCAN_POLICY_ADAPTIVE, SEATS);
+    uni_bt_scan_policy_start();
+    fake_run_loop_run(5000);
+    expect(uni_bt_scan_policy_get_level() == UNI_BT_SCAN_LEVEL_OFF, "adaptive: scanning with all the seats taken");
+    connected = SEATS - 1;
+    fake_run_loop_run(2000);
+    expect(uni_bt_scan_policy_get_level() != UNI_BT_SCAN_LEVEL_OFF, "adaptive: not scanning with a free seat");
+    uni_bt_scan_policy_stop();
+}
+
+// A seat is free, and nothing new appears: the policy backs off after the idle timeout.
+static void test_idle(void) {
+    jitter_t always_on;
+    jitter_t adaptive;
+    uint32_t from_ms = (IDLE_TIMEOUT_S + 5) * 1000;
+
+    run(UNI_BT_SCAN_POLICY_ALWAYS_ON, SEATS - 1, from_ms, from_ms + 120000, &always_on);
+    run(UNI_BT_SCAN_POLICY_ADAPTIVE, SEATS - 1, from_ms, from_ms + 120000, &adaptive);
+    print_jitter("seat free, idle, always on", &always_on);
+    print_jitter("seat free, idle, adaptive", &adaptive);
+
+    expect(adaptive.delayed * 4 < always_on.delayed, "adaptive: idle backoff doesn't reduce delayed reports");
+    expect(adaptive.deviation_sum_ms * 4 < always_on.deviation_sum_ms, "adaptive: idle backoff doesn't reduce jitter");
+}
+
+static void test_idle_timeout_range(void) {
+    uni_property_value_t val;
+
+    reset(UNI_BT_SCAN_POLICY_ADAPTIVE, 0);
+    uni_bt_scan_policy_set_idle_timeout(255);
+    fake_run_loop_run(0);
+    expect(uni_bt_scan_policy_get_idle_timeout() == 255, "idle timeout 255 not set");
+
+    // Rejected, instead of truncated.
+    uni_bt_scan_policy_set_idle_timeout(256);
+    uni_bt_scan_policy_set_idle_timeout(300);
+    uni_bt_scan_policy_set_idle_timeout(-1);
+    fake_run_loop_run(0);
+    expect(uni_bt_scan_policy_get_idle_timeout() == 255, "invalid idle timeout not rejected");
+
+    val = uni_property_get(UNI_PROPERTY_IDX_SCAN_IDLE_TIMEOUT);
+    expect(val.u8 == 255, "invalid idle timeout stored");
+}
+
+int main(void) {
+    test_seats_taken();
+    test_idle();
+    test_idle_timeout_range();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Connection-setup scheduler benchmark.
+// N controllers are discovered at the same time, and it measures the time until all of them are ready.
+//
+// Runs the real uni_bt_bredr.c FSM, SDP module, connection policy and scheduler, with the emulated controllers of
+// fake_bredr.c. Half of them send their name in the inquiry result, the other half need a remote name request.
+// Fails if two pages overlap, if the SDP client is found busy, or if a device times out.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bt/uni_bt_conn.h"
+#include "fake_bredr.h"
+#include "fake_btstack.h"
+#include "uni_hid_device.h"
+
+#define MAX_DEVICES CONFIG_BLUEPAD32_MAX_DEVICES
+
+static int failures;
+
+static void expect(bool cond, const char* msg, int idx) {
+    if (cond)
+        return;
+    printf("FAIL: %s (controller %d, t=%u ms)\n", msg, idx, btstack_run_loop_get_time_ms());
+    failures++;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(int count, uint32_t seed) {
+    fake_bredr_controller_t cfg;
+    fake_bredr_stats_t stats;
+    uni_hid_device_t* d;
+    uint32_t ready[MAX_DEVICES];
+    uint32_t all_ready_ms = 0;
+    int32_t ms;
+
+    fake_run_loop_reset();
+    fake_random_seed(seed);
+    fake_bredr_reset();
+
+    for (int i = 0; i < count; i++) {
+        fake_bredr_controller_init(&cfg);
+        cfg.name_in_inquiry = (i % 2) == 0;
+        fake_bredr_add(&cfg);
+    }
+    // All of them discovered at the same time.
+    for (int i = 0; i < count; i++)
+        fake_bredr_discover(i);
+    fake_run_loop_run(10 * 60 * 1000);
+
+    for (int i = 0; i < count; i++) {
+        d = fake_bredr_get_device(i);
+        expect(d != NULL && d->conn.state == UNI_BT_CONN_STATE_DEVICE_READY, "device not ready", i);
+        ms = d ? uni_bt_conn_trace_get_state_ms(&d->conn, UNI_BT_CONN_STATE_DEVICE_READY) : -1;
+        ready[i] = ms < 0 ? 0 : (uint32_t)ms;
+        if (ready[i] > all_ready_ms)
+            all_ready_ms = ready[i];
+        expect(d == NULL || (d->vendor_id == cfg.vendor_id && d->product_id == cfg.product_id), "VID/PID not fetched",
+               i);
+    }
+    qsort(ready, count, sizeof(ready[0]), compare_u32);
+
+    fake_bredr_get_stats(&stats);
+    expect(stats.page_overlaps == 0, "two pages at the same time", -1);
+    // The scheduler serializes the queries, and none of them is lost.
+    expect(stats.sdp_busy_replies == 0, "SDP client busy", -1);
+    expect(stats.connection_timeouts == 0, "connection timeout", -1);
+
+    printf("%2d devices: all ready in %5u ms, first ready in %5u ms, median %5u ms, %u pages\n", count,
+           (unsigned int)all_ready_ms, (unsigned int)ready[0], (unsigned int)ready[count / 2],
+           (unsigned int)stats.pages);
+}
+
+int main(void) {
+    // Built once per number of devices. See CMakeLists.txt.
+    run(MAX_DEVICES, 0x5eed);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Connection-setup success rate and time, with misbehaving controllers.
+// Runs the real uni_bt_bredr.c FSM, SDP module, connection policy and scheduler, with the emulated controllers of
+// fake_bredr.c. They are discovered at the same time. Some of them misbehave:
+// - flaky: the first SDP query fails. It is retried.
+// - slow: takes seconds to answer the SDP queries, like the "ThinkGeek 8-bitty Game Controller". It must not time out.
+// - lost: never answers the first SDP query. Same as BTstack, the query can't be cancelled: it finishes once the
+//   connection is closed. The connection is closed, and the query retried. The device must recover.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bt/uni_bt_conn.h"
+#include "bt/uni_bt_conn_policy.h"
+#include "controller/uni_controller_type.h"
+#include "fake_bredr.h"
+#include "fake_btstack.h"
+#include "uni_hid_device.h"
+
+#define MAX_DEVICES CONFIG_BLUEPAD32_MAX_DEVICES
+
+// Same as the iCade 8-Bitty.
+#define SLOW_VENDOR_ID 0x0a5c
+#define SLOW_PRODUCT_ID 0x8502
+
+typedef enum {
+    KIND_NORMAL,
+    KIND_FLAKY,
+    KIND_SLOW,
+    KIND_LOST,
+} kind_t;
+
+static const kind_t kinds[8] = {KIND_NORMAL, KIND_NORMAL, KIND_FLAKY, KIND_NORMAL,
+                                KIND_SLOW,   KIND_LOST,   KIND_NORMAL, KIND_NORMAL};
+
+static int failures;
+
+_Static_assert(MAX_DEVICES <= sizeof(kinds) / sizeof(kinds[0]), "Not enough emulated controllers");
+
+static void expect(bool cond, const char* msg, int idx) {
+    if (cond)
+        return;
+    printf("FAIL: %s (controller %d, t=%u ms)\n", msg, idx, btstack_run_loop_get_time_ms());
+    failures++;
+}
+
+static void add_controller(kind_t kind, int idx) {
+    fake_bredr_controller_t cfg;
+
+    fake_bredr_controller_init(&cfg);
+    cfg.name_in_inquiry = (idx % 2) == 0;
+    switch (kind) {
+        case KIND_FLAKY:
+            cfg.sdp_failures = 1;
+            break;
+        case KIND_SLOW:
+            cfg.vendor_id = SLOW_VENDOR_ID;
+            cfg.product_id = SLOW_PRODUCT_ID;
+            cfg.sdp = (fake_bredr_latency_t){2000, 2800};
+            break;
+        case KIND_LOST:
+            cfg.sdp_lost = 1;
+            break;
+        default:
+            break;
+    }
+    fake_bredr_add(&cfg);
+}
+
+static void run(int count, uint32_t seed) {
+    uni_bt_conn_policy_stats_t stats;
+    fake_bredr_stats_t bredr_stats;
+    uni_hid_device_t* d;
+    int32_t ms;
+    int32_t lost_ready_ms = -1;
+
+    fake_run_loop_reset();
+    fake_random_seed(seed);
+    fake_bredr_reset();
+
+    for (int i = 0; i < count; i++)
+        add_controller(kinds[i], i);
+    for (int i = 0; i < count; i++)
+        fake_bredr_discover(i);
+    fake_run_loop_run(10 * 60 * 1000);
+
+    for (int i = 0; i < count; i++) {
+        d = fake_bredr_get_device(i);
+        expect(!fake_bredr_was_deleted(i), "device deleted", i);
+        expect(d != NULL && d->conn.state == UNI_BT_CONN_STATE_DEVICE_READY, "device not ready", i);
+        if (d == NULL || kinds[i] != KIND_LOST)
+            continue;
+        // Closing the connection aborted the lost query, and the retry queried it again.
+        expect(fake_bredr_get_sdp_queries(i) >= 2, "lost query not retried", i);
+        lost_ready_ms = uni_bt_conn_trace_get_state_ms(&d->conn, UNI_BT_CONN_STATE_DEVICE_READY);
+    }
+    expect(!fake_bredr_is_sdp_client_busy(), "SDP query never finished", -1);
+
+    fake_bredr_get_stats(&bredr_stats);
+    expect(bredr_stats.page_overlaps == 0, "two pages at the same time", -1);
+    expect(bredr_stats.connection_timeouts == 0, "connection timeout", -1);
+    // Only the connection of the lost one.
+    expect(bredr_stats.disconnects == 1, "unexpected disconnects", -1);
+
+    uni_bt_conn_policy_get_stats(&stats);
+    expect(stats.setups_ok == (uint32_t)count, "setups ok stats don't match", -1);
+    expect(stats.setups_failed == 0, "setups failed", -1);
+    // The lost device times out once. Both the lost and the flaky ones recover after one retry.
+    expect(stats.stage_timeouts[UNI_BT_CONN_STAGE_SDP] == 1, "unexpected SDP timeouts", -1);
+    expect(stats.stage_retries[UNI_BT_CONN_STAGE_SDP] == 2, "unexpected SDP retries", -1);
+    expect(stats.stage_recovered[UNI_BT_CONN_STAGE_SDP] == 2, "lost or flaky device didn't recover", -1);
+
+    ms = (int32_t)stats.setup_max_ms;
+    printf("%2d devices: %u ok, %u failed, setup time avg %5u ms, max %5d ms, lost one ready in %5d ms, "
+           "sdp: %u timeouts, %u retries, %u recovered, %u busy\n",
+           count, (unsigned int)stats.setups_ok, (unsigned int)stats.setups_failed, (unsigned int)stats.setup_avg_ms,
+           (int)ms, (int)lost_ready_ms, (unsigned int)stats.stage_timeouts[UNI_BT_CONN_STAGE_SDP],
+           (unsigned int)stats.stage_retries[UNI_BT_CONN_STAGE_SDP],
+           (unsigned int)stats.stage_recovered[UNI_BT_CONN_STAGE_SDP], (unsigned int)bredr_stats.sdp_busy_replies);
+}
+
+// Policies chosen by controller type, or by VID/PID before the controller type is known.
+static void test_families(void) {
+    uni_hid_device_t d;
+    const uni_bt_conn_stage_policy_t* sdp;
+    const uni_bt_conn_stage_policy_t* parser;
+
+    memset(&d, 0, sizeof(d));
+    sdp = uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_SDP);
+    parser = uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_PARSER);
+    expect(parser->max_retries > 0, "default: parser setup not retried", -1);
+
+    d.vendor_id = SLOW_VENDOR_ID;
+    d.product_id = SLOW_PRODUCT_ID;
+    expect(uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_SDP)->timeout_ms > sdp->timeout_ms,
+           "slow SDP: VID/PID not recognized", -1);
+    memset(&d, 0, sizeof(d));
+    d.controller_type = CONTROLLER_TYPE_iCadeController;
+    expect(uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_SDP)->timeout_ms > sdp->timeout_ms,
+           "slow SDP: controller type not recognized", -1);
+
+    // Their parser setup can't be re-run.
+    d.controller_type = CONTROLLER_TYPE_PS4Controller;
+    expect(uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_PARSER)->max_retries == 0, "DS4: parser setup retried", -1);
+    d.controller_type = CONTROLLER_TYPE_SwitchProController;
+    expect(uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_PARSER)->max_retries == 0, "Switch: parser setup retried",
+           -1);
+    expect(uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_PARSER)->timeout_ms > parser->timeout_ms,
+           "Switch: parser deadline too short", -1);
+    // Other stages use the default policy.
+    expect(uni_bt_conn_policy_get(&d, UNI_BT_CONN_STAGE_SDP) == sdp, "Switch: SDP policy not the default one", -1);
+}
+
+int main(void) {
+    test_families();
+    // The stats are global: one run per executable.
+    run(MAX_DEVICES, 0x5eed);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
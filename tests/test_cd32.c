@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Amiga CD32 pad protocol: the output sequence and the timing margins, with the host-side model of the Amiga,
+// uni_cd32_sim_read().
+//
+// Realistic ranges:
+// - ISR latency: from the mode / clock edge until the new level is on the line. The ESP32 GPIO ISR runs from IRAM,
+//   but other ISRs (Bluetooth, timers) might delay it by a few microseconds.
+// - Clock period: the Amiga toggles the clock from the CPU. Each access to the CIA is synced to the E clock
+//   (~1.4us), and it takes a few of them per bit.
+// - The Amiga reads the data line one CIA access before the next clock edge.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uni_cd32.h"
+
+#define MIN_LATENCY_NS 500
+#define MAX_LATENCY_NS 4000
+#define MIN_CLOCK_PERIOD_NS 6000
+#define MAX_CLOCK_PERIOD_NS 20000
+#define CIA_ACCESS_NS 1400
+// Worst margin accepted in the realistic ranges.
+#define MIN_MARGIN_NS 500
+
+static int failures;
+
+static void expect(bool cond, const char* msg, int buttons, const uni_cd32_sim_timing_t* t) {
+    if (cond)
+        return;
+    if (failures < 10)
+        printf("FAIL: %s (buttons=0x%02x, latency=%u ns, period=%u ns, sample=%u ns)\n", msg, buttons,
+               t ? (unsigned int)t->latency_ns : 0, t ? (unsigned int)t->clock_period_ns : 0,
+               t ? (unsigned int)t->sample_ns : 0);
+    failures++;
+}
+
+// 7 buttons, then the ID bits: released, pressed. Level 1 means pressed.
+static uint16_t expected_bits(uint8_t buttons) {
+    return (~buttons & 0x7f) | (1u << 8);
+}
+
+static void test_sequence(void) {
+    uint32_t sequence;
+    uint16_t bits;
+
+    for (int buttons = 0; buttons < 256; buttons++) {
+        expect(uni_cd32_get_sequence(buttons) == expected_bits(buttons), "unexpected sequence", buttons, NULL);
+
+        // Shifted out LSB first. Once it is over, "pressed" forever, like the original pad.
+        sequence = uni_cd32_get_sequence(buttons);
+        bits = 0;
+        for (int i = 0; i < UNI_CD32_BITS; i++)
+            bits |= uni_cd32_shift(&sequence) << i;
+        expect(bits == expected_bits(buttons), "unexpected shifted bits", buttons, NULL);
+        for (int i = 0; i < 4; i++)
+            expect(uni_cd32_shift(&sequence), "not pressed after the sequence", buttons, NULL);
+    }
+}
+
+static void test_margins(void) {
+    uni_cd32_sim_timing_t t;
+    uint16_t read;
+    int32_t margin;
+    int32_t worst = INT32_MAX;
+
+    for (uint32_t latency = MIN_LATENCY_NS; latency <= MAX_LATENCY_NS; latency += 250) {
+        for (uint32_t period = MIN_CLOCK_PERIOD_NS; period <= MAX_CLOCK_PERIOD_NS; period += 500) {
+            t.latency_ns = latency;
+            t.clock_period_ns = period;
+            t.sample_ns = period - CIA_ACCESS_NS;
+            for (int buttons = 0; buttons < 128; buttons++) {
+                margin = uni_cd32_sim_read(buttons, &t, &read);
+                expect(read == expected_bits(buttons), "Amiga read wrong buttons", buttons, &t);
+                if (margin < worst)
+                    worst = margin;
+            }
+        }
+    }
+    expect(worst >= MIN_MARGIN_NS, "margin too small", -1, NULL);
+    printf("latency %u-%u ns, clock period %u-%u ns: worst margin %d ns\n", MIN_LATENCY_NS, MAX_LATENCY_NS,
+           MIN_CLOCK_PERIOD_NS, MAX_CLOCK_PERIOD_NS, (int)worst);
+}
+
+// Out of the margins, the model reads the neighbor bits. Otherwise the margins above would mean nothing.
+static void test_violations(void) {
+    uni_cd32_sim_timing_t t;
+    uint16_t read;
+    uint8_t buttons = 0x55;
+
+    // Setup: sampled before the new level is written. Reads the previous bit, "released" before the first one.
+    t.latency_ns = 3000;
+    t.clock_period_ns = 6000;
+    t.sample_ns = 2000;
+    expect(uni_cd32_sim_read(buttons, &t, &read) < 0, "setup violation not reported", buttons, &t);
+    expect(read == ((expected_bits(buttons) << 1) & 0x1ff), "setup violation: unexpected bits", buttons, &t);
+
+    // Hold: sampled after the next level was written. Reads the next bit, "pressed" after the last one.
+    t.latency_ns = 500;
+    t.clock_period_ns = 6000;
+    t.sample_ns = 7000;
+    expect(uni_cd32_sim_read(buttons, &t, &read) < 0, "hold violation not reported", buttons, &t);
+    expect(read == ((expected_bits(buttons) >> 1) | (1u << 8)), "hold violation: unexpected bits", buttons, &t);
+}
+
+int main(void) {
+    test_sequence();
+    test_margins();
+    test_violations();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
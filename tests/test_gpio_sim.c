@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// GPIO character device backend, against the lines of a gpio-sim chip (Linux kernel GPIO simulator).
+// A simulated chip is created with configfs, its lines are driven with the port and the quadrature generator,
+// and the levels that the kernel sees are read back from sysfs.
+//
+// Needs root, and the gpio-sim module loaded: "modprobe gpio-sim". Skipped (exit 77) otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uni_gpio_hal.h"
+#include "uni_gpio_port.h"
+#include "uni_quadrature_gen.h"
+
+#define SKIP_RETURN_CODE 77
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CONFIGFS_PATH "/sys/kernel/config/gpio-sim/bluepad32-test"
+#define NUM_LINES 8
+// Lines 0-1: quadrature encoder. All of them: port.
+#define GPIO_A 0
+#define GPIO_B 1
+
+static char dev_name[64];
+static char chip_name[64];
+static int failures;
+
+static void expect(bool cond, const char* what, const char* msg) {
+    if (cond)
+        return;
+    printf("FAIL: %s: %s\n", what, msg);
+    failures++;
+}
+
+static bool write_attr(const char* path, const char* value) {
+    FILE* f = fopen(path, "w");
+    bool ok;
+
+    if (f == NULL)
+        return false;
+    ok = fputs(value, f) >= 0;
+    // Errors from the kernel are reported when the file is closed.
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+static bool read_attr(const char* path, char* value, size_t len) {
+    FILE* f = fopen(path, "r");
+    bool ok;
+
+    if (f == NULL)
+        return false;
+    ok = fgets(value, len, f) != NULL;
+    fclose(f);
+    if (ok)
+        value[strcspn(value, "\n")] = 0;
+    return ok;
+}
+
+static void destroy_chip(void) {
+    write_attr(CONFIGFS_PATH "/live", "0");
+    rmdir(CONFIGFS_PATH "/bank0");
+    rmdir(CONFIGFS_PATH);
+}
+
+static bool create_chip(void) {
+    char num_lines[8];
+
+    // Leftover of a previous run.
+    destroy_chip();
+
+    if (mkdir(CONFIGFS_PATH, 0755) != 0) {
+        printf("SKIP: cannot create %s: %s\n", CONFIGFS_PATH, strerror(errno));
+        return false;
+    }
+    snprintf(num_lines, sizeof(num_lines), "%d", NUM_LINES);
+    if (mkdir(CONFIGFS_PATH "/bank0", 0755) != 0 || !write_attr(CONFIGFS_PATH "/bank0/num_lines", num_lines) ||
+        !write_attr(CONFIGFS_PATH "/live", "1") || !read_attr(CONFIGFS_PATH "/dev_name", dev_name, sizeof(dev_name)) ||
+        !read_attr(CONFIGFS_PATH "/bank0/chip_name", chip_name, sizeof(chip_name))) {
+        printf("SKIP: cannot set up the gpio-sim chip\n");
+        destroy_chip();
+        return false;
+    }
+    return true;
+}
+
+// Level of the line, as seen by the kernel. -1 on error.
+static int get_sim_level(int line) {
+    char path[192];
+    char value[8];
+
+    snprintf(path, sizeof(path), "/sys/devices/platform/%s/%s/sim_gpio%d/value", dev_name, chip_name, line);
+    if (!read_attr(path, value, sizeof(value)))
+        return -1;
+    return value[0] == '1';
+}
+
+// Levels of all the lines, as seen by the kernel. Bit N is line N.
+static uint32_t get_sim_levels(void) {
+    uint32_t levels = 0;
+
+    for (int i = 0; i < NUM_LINES; i++) {
+        if (get_sim_level(i) == 1)
+            levels |= 1 << i;
+    }
+    return levels;
+}
+
+static void test_port(void) {
+    static const uint32_t patterns[] = {0x00, 0xff, 0x55, 0xaa, 0x0f, 0xf0, 0x81, 0x00};
+    uni_gpio_port_t port;
+
+    uni_gpio_port_init(&port);
+    for (int i = 0; i < NUM_LINES; i++)
+        uni_gpio_port_add_line(&port, i);
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        uni_gpio_port_write(&port, patterns[i], 0xff);
+        expect(get_sim_levels() == patterns[i], "port", "lines don't match the written levels");
+    }
+
+    // Only the lines in the mask change.
+    uni_gpio_port_write(&port, 0xff, 0x0f);
+    uni_gpio_port_write(&port, 0x00, 0x03);
+    expect(get_sim_levels() == 0x0c, "port", "lines outside the mask changed");
+}
+
+static void test_quadrature(void) {
+    uni_quadrature_gen_t gen;
+    uint8_t sample;
+    int steps = 0;
+
+    uni_gpio_hal_write_mask(0, 0xff);
+    uni_quadrature_gen_init(&gen, GPIO_A, GPIO_B);
+
+    // Forward, and back.
+    for (int pass = 0; pass < 2; pass++) {
+        uni_quadrature_gen_add_motion(&gen, pass ? -10 : 10, UNI_QUADRATURE_GEN_SCALE_ONE, 10000);
+        while (uni_quadrature_gen_step(&gen)) {
+            uni_quadrature_gen_sim_get_samples(&gen, &sample, 1);
+            expect(get_sim_level(GPIO_A) == (sample & 0b01) && get_sim_level(GPIO_B) == !!(sample & 0b10),
+                   "quadrature", "lines don't match the recorded waveform");
+            steps++;
+        }
+    }
+    expect(steps == 20, "quadrature", "unexpected number of steps");
+    // Back to the start.
+    expect(get_sim_levels() == 0, "quadrature", "not back to the initial levels");
+}
+
+int main(void) {
+    char path[80];
+
+    if (!create_chip())
+        return SKIP_RETURN_CODE;
+
+    snprintf(path, sizeof(path), "/dev/%s", chip_name);
+    if (uni_gpio_hal_chardev_open(path, (1ULL << NUM_LINES) - 1) != 0) {
+        printf("FAIL: cannot open %s\n", path);
+        destroy_chip();
+        return EXIT_FAILURE;
+    }
+
+    test_port();
+    test_quadrature();
+
+    uni_gpio_hal_chardev_close();
+    destroy_chip();
+
+    printf("gpio-sim %s (%s): %d changes\n", chip_name, dev_name, uni_gpio_hal_trace_get_count());
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#else  // !__linux__
+
+int main(void) {
+    printf("SKIP: GPIO character devices are only supported in Linux\n");
+    return SKIP_RETURN_CODE;
+}
+
+#endif  // !__linux__
@@ -0,0 +1,330 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Joystick profiles: the built-in ones against the converters they replaced, and the text parser.
+//
+// The converters that predate the profiles are reproduced below, as they were. Both are fed the same random
+// reports, and every line of every joystick must match. The old ones set button2 / button3 to the raw pedal
+// value, and the profiles to 1: lines are compared as booleans, which is how all the consumers use them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "controller/uni_gamepad.h"
+#include "uni_common.h"
+#include "uni_joystick.h"
+#include "uni_joystick_profile.h"
+
+#define REPORTS 200000
+
+static int failures;
+
+static void expect(bool cond, const char* what, const char* msg) {
+    if (cond)
+        return;
+    printf("FAIL: %s: %s\n", what, msg);
+    failures++;
+}
+
+// Only used by the balance board converter of uni_joystick.c.
+uni_balance_board_threshold_t uni_balance_board_get_threshold(void) {
+    return (uni_balance_board_threshold_t){0};
+}
+
+// --- Converters before the profiles
+
+static void old_to_single_joy(const uni_gamepad_t* gp, uni_joystick_t* out_joy) {
+    // Button A is "fire"
+    out_joy->fire |= ((gp->buttons & BUTTON_A) != 0);
+    // Thumb left is "fire"
+    out_joy->fire |= ((gp->buttons & BUTTON_THUMB_L) != 0);
+
+    // Shoulder right is "auto fire"
+    out_joy->auto_fire |= ((gp->buttons & BUTTON_SHOULDER_R) != 0);
+
+    // Dpad
+    if (gp->dpad & DPAD_UP)
+        out_joy->up |= 1;
+    if (gp->dpad & DPAD_DOWN)
+        out_joy->down |= 1;
+    if (gp->dpad & DPAD_RIGHT)
+        out_joy->right |= 1;
+    if (gp->dpad & DPAD_LEFT)
+        out_joy->left |= 1;
+
+    // Axis: X and Y
+    out_joy->left |= (gp->axis_x < -AXIS_THRESHOLD);
+    out_joy->right |= (gp->axis_x > AXIS_THRESHOLD);
+    out_joy->up |= (gp->axis_y < -AXIS_THRESHOLD);
+    out_joy->down |= (gp->axis_y > AXIS_THRESHOLD);
+
+    // 2nd & 3rd buttons
+    out_joy->button2 = (gp->brake >> 2);     // convert from 1024 to 256
+    out_joy->button3 = (gp->throttle >> 2);  // convert from 1024 to 256
+}
+
+static void old_to_single_joy_from_gamepad(const uni_gamepad_t* gp, uni_joystick_t* out_joy, int use_two_buttons) {
+    old_to_single_joy(gp, out_joy);
+
+    if (!use_two_buttons) {
+        // Buttom B is "jump". Good for C64 games
+        out_joy->up |= ((gp->buttons & BUTTON_B) != 0);
+    } else {
+        // Buttom B is second joystick button, as in MSX
+        out_joy->button2 = ((gp->buttons & BUTTON_B) != 0);
+    }
+
+    // 2nd & 3rd buttons
+    out_joy->button2 |= ((gp->buttons & BUTTON_X) != 0);
+    out_joy->button3 |= ((gp->buttons & BUTTON_Y) != 0);
+}
+
+static void old_to_twinstick_from_gamepad(const uni_gamepad_t* gp, uni_joystick_t* out_joy1, uni_joystick_t* out_joy2) {
+    old_to_single_joy(gp, out_joy2);
+
+    out_joy2->button2 |= ((gp->buttons & BUTTON_X) != 0);
+
+    // Button B is "fire"
+    out_joy1->fire |= ((gp->buttons & BUTTON_B) != 0);
+    // Thumb right is "fire"
+    out_joy1->fire |= ((gp->buttons & BUTTON_THUMB_R) != 0);
+
+    out_joy1->button2 |= ((gp->buttons & BUTTON_Y) != 0);
+
+    // Swap "auto fire" in Twin Stick
+    // "left" belongs to joy1 while "right" to joy2.
+    out_joy2->auto_fire = ((gp->buttons & BUTTON_SHOULDER_L) != 0);
+    out_joy1->auto_fire = ((gp->buttons & BUTTON_SHOULDER_R) != 0);
+
+    // Axis: RX and RY
+    out_joy1->left |= (gp->axis_rx < -AXIS_THRESHOLD);
+    out_joy1->right |= (gp->axis_rx > AXIS_THRESHOLD);
+    out_joy1->up |= (gp->axis_ry < -AXIS_THRESHOLD);
+    out_joy1->down |= (gp->axis_ry > AXIS_THRESHOLD);
+}
+
+// --- Random reports
+
+static uint32_t random_state = 0x10c4;
+
+// xorshift32
+static uint32_t random_u32(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+// Half of the values near the threshold, where an off-by-one would show.
+static int32_t random_axis(void) {
+    int32_t v = (int32_t)(random_u32() % 5) - 2 + AXIS_THRESHOLD;
+
+    if (random_u32() & 1)
+        v = (int32_t)(random_u32() % 1024) - 512;
+    return (random_u32() & 1) ? v : -v;
+}
+
+// Same, near 0: any value other than 0-3 was "pressed".
+static int32_t random_pedal(void) {
+    if (random_u32() & 1)
+        return random_u32() % 8;
+    return random_u32() % 1024;
+}
+
+static void random_report(uni_gamepad_t* gp) {
+    memset(gp, 0, sizeof(*gp));
+    gp->buttons = random_u32() & 0x3ff;
+    gp->misc_buttons = random_u32() & 0x0f;
+    gp->dpad = random_u32() & 0x0f;
+    gp->axis_x = random_axis();
+    gp->axis_y = random_axis();
+    gp->axis_rx = random_axis();
+    gp->axis_ry = random_axis();
+    gp->brake = random_pedal();
+    gp->throttle = random_pedal();
+}
+
+static bool same_lines(const uni_joystick_t* a, const uni_joystick_t* b) {
+    return !a->up == !b->up && !a->down == !b->down && !a->left == !b->left && !a->right == !b->right &&
+           !a->fire == !b->fire && !a->button2 == !b->button2 && !a->button3 == !b->button3 &&
+           !a->auto_fire == !b->auto_fire;
+}
+
+static void test_builtin(void) {
+    uni_gamepad_t gp;
+    uni_joystick_t old_joy1, old_joy2, joy1, joy2;
+    int mismatches[UNI_JOYSTICK_PROFILE_BUILTIN_COUNT] = {0};
+
+    for (int i = 0; i < REPORTS; i++) {
+        random_report(&gp);
+
+        for (int two_buttons = 0; two_buttons < 2; two_buttons++) {
+            memset(&old_joy1, 0, sizeof(old_joy1));
+            memset(&joy1, 0, sizeof(joy1));
+            old_to_single_joy_from_gamepad(&gp, &old_joy1, two_buttons);
+            uni_joy_to_single_joy_from_gamepad(&gp, &joy1, two_buttons);
+            if (!same_lines(&old_joy1, &joy1))
+                mismatches[two_buttons ? UNI_JOYSTICK_PROFILE_SINGLE_TWO_BUTTONS : UNI_JOYSTICK_PROFILE_SINGLE]++;
+        }
+
+        memset(&old_joy1, 0, sizeof(old_joy1));
+        memset(&old_joy2, 0, sizeof(old_joy2));
+        memset(&joy1, 0, sizeof(joy1));
+        memset(&joy2, 0, sizeof(joy2));
+        old_to_twinstick_from_gamepad(&gp, &old_joy1, &old_joy2);
+        uni_joy_to_twinstick_from_gamepad(&gp, &joy1, &joy2);
+        if (!same_lines(&old_joy1, &joy1) || !same_lines(&old_joy2, &joy2))
+            mismatches[UNI_JOYSTICK_PROFILE_TWINSTICK]++;
+    }
+
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_BUILTIN_COUNT; i++) {
+        const uni_joystick_profile_t* profile = uni_joystick_profile_get_builtin(i);
+        printf("%-12s: %d reports, %d mismatches\n", profile->name, REPORTS, mismatches[i]);
+        expect(mismatches[i] == 0, profile->name, "differs from the old converter");
+    }
+    expect(uni_joystick_profile_get_builtin(UNI_JOYSTICK_PROFILE_SINGLE)->joys == 1, "normal", "joysticks");
+    expect(uni_joystick_profile_get_builtin(UNI_JOYSTICK_PROFILE_TWINSTICK)->joys == 2, "twinstick", "joysticks");
+}
+
+// --- Parser
+
+typedef struct {
+    const char* text;
+    // -1: invalid.
+    int count;
+    // First rule, if valid.
+    uni_joystick_profile_rule_t rule;
+} parse_case_t;
+
+#define RULE(_source, _index, _joy, _line, _threshold)                                                         \
+    {.source = UNI_JOYSTICK_PROFILE_SOURCE_##_source, .index = (_index), .joy = (_joy),                        \
+     .line = UNI_JOYSTICK_PROFILE_LINE_##_line, .threshold = (_threshold)}
+
+static const parse_case_t parse_cases[] = {
+    {"a:fire", 1, RULE(BUTTON, UNI_GAMEPAD_MAPPINGS_BUTTON_A, 0, FIRE, 0)},
+    {"thumb_r:j2.auto_fire", 1, RULE(BUTTON, UNI_GAMEPAD_MAPPINGS_BUTTON_THUMB_R, 1, AUTO_FIRE, 0)},
+    {"start:button3", 1, RULE(MISC_BUTTON, UNI_GAMEPAD_MAPPINGS_MISC_BUTTON_START, 0, BUTTON3, 0)},
+    {"dpad_left:j2.left", 1, RULE(DPAD, UNI_GAMEPAD_MAPPINGS_DPAD_LEFT, 1, LEFT, 0)},
+    {"x-:left", 1, RULE(AXIS_NEG, UNI_JOYSTICK_PROFILE_AXIS_X, 0, LEFT, 0)},
+    {"throttle+@3:button2", 1, RULE(AXIS_POS, UNI_JOYSTICK_PROFILE_AXIS_THROTTLE, 0, BUTTON2, 3)},
+    {"ry-@32767:j2.up", 1, RULE(AXIS_NEG, UNI_JOYSTICK_PROFILE_AXIS_RY, 1, UP, 32767)},
+    // Empty rules are skipped.
+    {"a:fire,,b:up,", 2, RULE(BUTTON, UNI_GAMEPAD_MAPPINGS_BUTTON_A, 0, FIRE, 0)},
+    {"", 0, {0}},
+    {",", 0, {0}},
+
+    {"a", -1, {0}},
+    {"a:", -1, {0}},
+    {":fire", -1, {0}},
+    {"z:fire", -1, {0}},
+    {"a:jump", -1, {0}},
+    {"a:j3.fire", -1, {0}},
+    {"a:j2.", -1, {0}},
+    {"A:fire", -1, {0}},
+    {"a :fire", -1, {0}},
+    {"a@100:fire", -1, {0}},
+    // "x" alone is button X.
+    {"x:left", 1, RULE(BUTTON, UNI_GAMEPAD_MAPPINGS_BUTTON_X, 0, LEFT, 0)},
+    {"rx:left", -1, {0}},
+    {"z-:left", -1, {0}},
+    {"x-+:left", -1, {0}},
+    {"x-@:left", -1, {0}},
+    {"x-@abc:left", -1, {0}},
+    {"x-@200x:left", -1, {0}},
+    {"x-@ 200:left", -1, {0}},
+    {"x-@-5:left", -1, {0}},
+    {"x-@0:left", -1, {0}},
+    {"x-@32768:left", -1, {0}},
+    {"a:fire,b:bogus", -1, {0}},
+    // Longer than a rule can be.
+    {"a:fire,throttle+@00000000000000000000003:button2", -1, {0}},
+};
+
+static void test_parse(void) {
+    uni_joystick_profile_rule_t rules[UNI_JOYSTICK_PROFILE_MAX_RULES];
+    char text[UNI_JOYSTICK_PROFILE_MAX_RULES * 8 + 8];
+    const parse_case_t* c;
+    int count;
+
+    for (size_t i = 0; i < ARRAY_SIZE(parse_cases); i++) {
+        c = &parse_cases[i];
+        memset(rules, 0xff, sizeof(rules));
+        count = uni_joystick_profile_parse(c->text, rules, ARRAY_SIZE(rules));
+        expect(count == c->count, c->text, "wrong number of rules");
+        if (count > 0 && c->count > 0)
+            expect(memcmp(&rules[0], &c->rule, sizeof(c->rule)) == 0, c->text, "wrong rule");
+    }
+
+    // Max rules, and one more.
+    text[0] = 0;
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_MAX_RULES; i++)
+        strcat(text, "a:fire,");
+    expect(uni_joystick_profile_parse(text, rules, ARRAY_SIZE(rules)) == UNI_JOYSTICK_PROFILE_MAX_RULES, "max rules",
+           "not accepted");
+    strcat(text, "b:up");
+    expect(uni_joystick_profile_parse(text, rules, ARRAY_SIZE(rules)) == -1, "max rules + 1", "accepted");
+
+    printf("parse       : %d cases\n", (int)ARRAY_SIZE(parse_cases) + 2);
+}
+
+// --- Custom profiles
+
+static void test_custom(void) {
+    uni_joystick_profile_rule_t bad = RULE(BUTTON, UNI_GAMEPAD_MAPPINGS_BUTTON_A, 0, FIRE, 0);
+    const uni_joystick_profile_t* profile;
+    uni_gamepad_t gp = {0};
+    uni_joystick_t joy1 = {0};
+    uni_joystick_t joy2 = {0};
+    char name[8];
+
+    expect(uni_joystick_profile_add_custom("mine", "a:up,x-@200:left,rx+:j2.right") == 0, "custom", "not added");
+    profile = uni_joystick_profile_find("mine");
+    expect(profile != NULL && profile->joys == 2, "custom", "not found, or wrong joysticks");
+
+    gp.buttons = BUTTON_A;
+    gp.axis_x = -201;
+    gp.axis_rx = AXIS_THRESHOLD + 1;
+    uni_joystick_profile_apply(profile, &gp, &joy1, &joy2);
+    expect(joy1.up && joy1.left && !joy1.fire && joy2.right && !joy2.left, "custom", "wrong lines");
+    memset(&joy1, 0, sizeof(joy1));
+    gp.axis_x = -200;
+    uni_joystick_profile_apply(profile, &gp, &joy1, NULL);
+    expect(!joy1.left, "custom", "threshold not applied");
+
+    // Invalid rules don't replace the profile in use.
+    bad.line = UNI_JOYSTICK_PROFILE_LINE_COUNT;
+    expect(uni_joystick_profile_add_custom_rules("mine", &bad, 1) != 0, "custom", "invalid rule accepted");
+    profile = uni_joystick_profile_find("mine");
+    expect(profile != NULL && profile->joys == 2 && profile->buttons[0][UNI_JOYSTICK_PROFILE_LINE_UP] != 0, "custom",
+           "replaced by an invalid profile");
+
+    // Nor take a slot.
+    for (int i = 0; i < UNI_JOYSTICK_PROFILE_MAX_CUSTOM * 2; i++) {
+        snprintf(name, sizeof(name), "bad%d", i);
+        uni_joystick_profile_add_custom_rules(name, &bad, 1);
+        expect(uni_joystick_profile_find(name) == NULL, name, "invalid profile added");
+    }
+    for (int i = 1; i < UNI_JOYSTICK_PROFILE_MAX_CUSTOM; i++) {
+        snprintf(name, sizeof(name), "ok%d", i);
+        expect(uni_joystick_profile_add_custom(name, "b:fire") == 0, name, "no free slot left");
+    }
+    expect(uni_joystick_profile_add_custom("full", "b:fire") != 0, "full", "more profiles than slots");
+
+    expect(uni_joystick_profile_add_custom("normal", "b:fire") != 0, "normal", "built-in replaced");
+    expect(uni_joystick_profile_add_custom("", "b:fire") != 0, "empty name", "accepted");
+}
+
+int main(void) {
+    uni_joystick_profile_init();
+    test_builtin();
+    test_parse();
+    test_custom();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
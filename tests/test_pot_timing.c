@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// C64 paddle timing: round-trips every pot value through uni_pot_timing_compute() and the SID model,
+// uni_pot_timing_read(), with the resolution of the Unijoysticle C64 paddle timer (5 ticks per microsecond).
+// Checks the release order of the lines, the pulse widths, and how late a line can be released without reading
+// a different value.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uni_pot_timing.h"
+
+// Same as uni_platform_unijoysticle_c64.c
+#define TICKS_PER_US 5
+#define TICK_NS (1000 / TICKS_PER_US)
+// Lateness that the release must tolerate: the latency of the timer ISR, that spins for the close alarms.
+#define MIN_LATE_MARGIN_NS 600
+
+static int failures;
+
+static void expect(bool cond, const char* msg, int x, int y) {
+    if (cond)
+        return;
+    // Only the first ones, 65536 pairs are checked.
+    if (failures < 10)
+        printf("FAIL: %s (x=%d, y=%d)\n", msg, x, y);
+    failures++;
+}
+
+static uint32_t line_ticks(const uni_pot_timing_schedule_t* s, int line) {
+    return s->lines[0] == line ? s->ticks[0] : s->ticks[1];
+}
+
+// The line is held high for the discharge plus "value" cycles. Rounded up, by less than a tick.
+static bool is_width_valid(uint32_t ticks, int value) {
+    uint64_t width_ns = (uint64_t)ticks * TICK_NS;
+    uint64_t expected_ns = (uint64_t)(UNI_POT_TIMING_DISCHARGE_CYCLES + value) * UNI_POT_TIMING_CYCLE_NS;
+
+    return width_ns >= expected_ns && width_ns < expected_ns + TICK_NS;
+}
+
+// How late the line can be released, and still read "value".
+static uint32_t late_margin_ticks(uint32_t ticks, int value) {
+    uint32_t margin = 0;
+
+    while (uni_pot_timing_read(ticks + margin + 1, TICKS_PER_US) == value)
+        margin++;
+    return margin;
+}
+
+int main(void) {
+    uni_pot_timing_schedule_t s;
+    uint32_t ticks;
+    uint32_t margin;
+    uint32_t min_margin = UINT32_MAX;
+    int values[UNI_POT_TIMING_LINE_MAX];
+
+    for (int x = 0; x < 256; x++) {
+        for (int y = 0; y < 256; y++) {
+            uni_pot_timing_compute(x, y, TICKS_PER_US, &s);
+
+            expect(s.lines[0] != s.lines[1], "a line is released twice", x, y);
+            expect(s.ticks[0] <= s.ticks[1], "lines not in release order", x, y);
+            // Same time: X first.
+            expect(x > y || s.lines[0] == UNI_POT_TIMING_LINE_X, "lower value not released first", x, y);
+
+            values[UNI_POT_TIMING_LINE_X] = x;
+            values[UNI_POT_TIMING_LINE_Y] = y;
+            for (int line = 0; line < UNI_POT_TIMING_LINE_MAX; line++) {
+                ticks = line_ticks(&s, line);
+                expect(uni_pot_timing_read(ticks, TICKS_PER_US) == values[line], "SID reads a different value", x,
+                       y);
+                expect(is_width_valid(ticks, values[line]), "invalid pulse width", x, y);
+                // Not later than needed: one tick earlier reads one less.
+                if (values[line] > 0)
+                    expect(uni_pot_timing_read(ticks - 1, TICKS_PER_US) == values[line] - 1,
+                           "released later than needed", x, y);
+            }
+        }
+    }
+
+    // Same for both lines: it only depends on the value.
+    for (int v = 0; v < 255; v++) {
+        uni_pot_timing_compute(v, v, TICKS_PER_US, &s);
+        margin = late_margin_ticks(s.ticks[0], v);
+        if (margin < min_margin)
+            min_margin = margin;
+    }
+    expect(min_margin * TICK_NS >= MIN_LATE_MARGIN_NS, "release can't be late enough", -1, -1);
+    // 255 is the counter limit: any later release reads 255 too.
+    uni_pot_timing_compute(255, 255, TICKS_PER_US, &s);
+    expect(uni_pot_timing_read(s.ticks[0] * 2, TICKS_PER_US) == 255, "late release of 255 reads less", 255, 255);
+
+    uni_pot_timing_compute(0, 255, TICKS_PER_US, &s);
+    printf("pulse width: %u-%u ticks (%u-%u ns), release can be late by %u ns\n", (unsigned int)s.ticks[0],
+           (unsigned int)s.ticks[1], (unsigned int)(s.ticks[0] * TICK_NS), (unsigned int)(s.ticks[1] * TICK_NS),
+           (unsigned int)(min_margin * TICK_NS));
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Quadrature generator: validates the recorded waveforms.
+// Mouse reports are fed to the generator, and the steps are emitted at the period it returns, in virtual time,
+// like the quadrature timer does. Then the waveform recorded by the generator is validated: only one line
+// changes per step, and the net position is the expected one. The GPIO HAL trace (the changes of the lines
+// themselves) must match it.
+//
+// Reports arrive at a fixed interval, or at a variable one: jittery 1ms USB-like reports, BLE connection events
+// (8-15ms), and idle gaps. The measured report interval, the backlog, and the period are checked too.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uni_gpio_hal.h"
+#include "uni_quadrature_gen.h"
+
+#define GPIO_A 4
+#define GPIO_B 5
+#define SCALE(x) ((uint32_t)((x) * UNI_QUADRATURE_GEN_SCALE_ONE))
+
+typedef struct {
+    const char* name;
+    // Reports
+    int count;
+    uint32_t interval_us;
+    // Motion of each report.
+    int32_t (*delta)(int i);
+    uint32_t scale;
+    // Expected: all the steps emitted before the next report.
+    bool expect_no_backlog;
+    // Optional. Time until report "i + 1". Overrides "interval_us".
+    uint32_t (*interval)(int i);
+    // Optional. Expected range of the measured interval, once it settles.
+    uint32_t min_rate_us;
+    uint32_t max_rate_us;
+    // Optional. Most steps left when a report arrives. Bounds how much the output lags behind.
+    int max_lag_steps;
+} scenario_t;
+
+static int failures;
+static uint32_t random_state;
+
+static void expect(bool cond, const char* scenario, const char* msg) {
+    if (cond)
+        return;
+    printf("FAIL: %s: %s\n", scenario, msg);
+    failures++;
+}
+
+static int32_t delta_steady(int i) {
+    return 5;
+}
+
+static int32_t delta_fraction(int i) {
+    return 1;
+}
+
+static int32_t delta_reversal(int i) {
+    return (i / 10) % 2 ? -40 : 40;
+}
+
+static int32_t delta_burst(int i) {
+    return i == 0 ? 2000 : 0;
+}
+
+static int32_t delta_accel(int i) {
+    // Accelerates, decelerates, and back the other way.
+    return (i < 50) ? i : (i < 100) ? 100 - i : -(i - 100) / 2;
+}
+
+// Xorshift32: same sequence on every run.
+static uint32_t random_range(uint32_t min, uint32_t max) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return min + random_state % (max - min + 1);
+}
+
+// 1ms +/- 300us, like a USB dongle polled by a busy host.
+static uint32_t interval_jitter_1ms(int i) {
+    return random_range(700, 1300);
+}
+
+// BLE connection events: anywhere between 8ms and 15ms.
+static uint32_t interval_ble(int i) {
+    return random_range(8000, 15000);
+}
+
+// 10ms reports, and the mouse stops for 300ms every 40 reports.
+static uint32_t interval_idle_gaps(int i) {
+    return (i % 40) == 39 ? 300000 : 10000;
+}
+
+static const scenario_t scenarios[] = {
+    {.name = "steady", .count = 200, .interval_us = 10000, .delta = delta_steady, .scale = SCALE(1),
+     .expect_no_backlog = true},
+    {.name = "fraction", .count = 200, .interval_us = 10000, .delta = delta_fraction, .scale = SCALE(0.5),
+     .expect_no_backlog = true},
+    {.name = "reversal", .count = 100, .interval_us = 10000, .delta = delta_reversal, .scale = SCALE(1)},
+    {.name = "burst", .count = 10, .interval_us = 10000, .delta = delta_burst, .scale = SCALE(1)},
+    {.name = "accel", .count = 150, .interval_us = 1000, .delta = delta_accel, .scale = SCALE(2)},
+    // The steps of a report are spread over the measured interval, a moving average. A report that arrives earlier
+    // than that finds some steps left, but never more than one report worth of them.
+    {.name = "jitter", .count = 1000, .delta = delta_steady, .scale = SCALE(1), .interval = interval_jitter_1ms,
+     .min_rate_us = 850, .max_rate_us = 1150, .max_lag_steps = 5},
+    {.name = "ble", .count = 1000, .delta = delta_steady, .scale = SCALE(1), .interval = interval_ble,
+     .min_rate_us = 9500, .max_rate_us = 13500, .max_lag_steps = 5},
+    // The gaps are not report intervals: the measured interval stays at 10ms.
+    {.name = "idle", .count = 400, .delta = delta_steady, .scale = SCALE(1), .expect_no_backlog = true,
+     .interval = interval_idle_gaps, .min_rate_us = 10000, .max_rate_us = 10000},
+};
+
+// Validates the samples recorded since the last call. The previous last sample is the first one, so that the
+// transition between the calls is validated too.
+static bool validate_new_samples(const uni_quadrature_gen_t* gen, uint32_t* validated, int32_t* position) {
+    uint8_t samples[UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES];
+    uint32_t new_samples = gen->sim_count - *validated;
+    int count;
+    int32_t moved;
+
+    if (new_samples == 0)
+        return true;
+    count = uni_quadrature_gen_sim_get_samples(gen, samples, new_samples + 1);
+    if ((uint32_t)count != new_samples + 1)
+        return false;
+    moved = uni_quadrature_gen_sim_validate(samples, count);
+    if (moved == INT32_MIN)
+        return false;
+    *position += moved;
+    *validated = gen->sim_count;
+    return true;
+}
+
+static void run(const scenario_t* s) {
+    uni_quadrature_gen_t gen;
+    uni_quadrature_rate_t rate;
+    uint8_t last;
+    int64_t now = 0;
+    int64_t next_step = 0;
+    uint32_t interval_us;
+    uint32_t period_us = 0;
+    uint32_t validated;
+    int32_t position = 0;
+    int64_t total = 0;
+    int backlog_reports = 0;
+    int pending;
+    int max_lag = 0;
+    uint32_t min_rate = UINT32_MAX;
+    uint32_t max_rate = 0;
+    uint32_t next_interval;
+    // Once the measured interval settles: its mean, and the mean of the real ones. Idle gaps excluded.
+    uint64_t rate_sum = 0;
+    uint64_t real_sum = 0;
+    int rate_count = 0;
+    bool valid = true;
+    bool valid_period = true;
+
+    random_state = 0x5eed;
+
+    uni_gpio_hal_set_level(GPIO_A, false);
+    uni_gpio_hal_set_level(GPIO_B, false);
+    uni_gpio_hal_trace_reset();
+    uni_quadrature_gen_init(&gen, GPIO_A, GPIO_B);
+    uni_quadrature_rate_init(&rate);
+    // The initial state: there is nothing to validate yet.
+    validated = gen.sim_count;
+
+    for (int i = 0; i < s->count + 1; i++) {
+        // Steps until the next report, at the period returned by the last one.
+        while (period_us && next_step < now) {
+            if (!uni_quadrature_gen_step(&gen))
+                break;
+            next_step += period_us;
+            // The recorded samples are a ring: validate them before they are overwritten.
+            if (gen.sim_count - validated >= UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES / 2)
+                valid = valid && validate_new_samples(&gen, &validated, &position);
+        }
+        pending = abs(atomic_load(&gen.pending));
+        if (pending != 0)
+            backlog_reports++;
+        // The first reports are still measuring the interval.
+        if (i >= s->count / 4 && pending > max_lag)
+            max_lag = pending;
+        if (i == s->count)
+            break;
+
+        interval_us = uni_quadrature_rate_update(&rate, now);
+        if (i >= s->count / 4) {
+            if (interval_us < min_rate)
+                min_rate = interval_us;
+            if (interval_us > max_rate)
+                max_rate = interval_us;
+        }
+        total += s->delta(i);
+        period_us = uni_quadrature_gen_add_motion(&gen, s->delta(i), s->scale, interval_us);
+        // The backlog fits in the interval, unless the period is already the shortest one.
+        pending = abs(atomic_load(&gen.pending));
+        if (period_us != 0 && period_us != UNI_QUADRATURE_GEN_MIN_STEP_PERIOD_US)
+            valid_period = valid_period && period_us * pending <= interval_us;
+        valid_period = valid_period && (period_us == 0 || period_us >= UNI_QUADRATURE_GEN_MIN_STEP_PERIOD_US);
+        next_step = now;
+        next_interval = s->interval ? s->interval(i) : s->interval_us;
+        if (i >= s->count / 4 && next_interval <= 2 * s->max_rate_us) {
+            rate_sum += interval_us;
+            real_sum += next_interval;
+            rate_count++;
+        }
+        now += next_interval;
+    }
+
+    // Whatever is left.
+    while (uni_quadrature_gen_step(&gen)) {
+        if (gen.sim_count - validated >= UNI_QUADRATURE_GEN_SIM_MAX_SAMPLES / 2)
+            valid = valid && validate_new_samples(&gen, &validated, &position);
+    }
+    valid = valid && validate_new_samples(&gen, &validated, &position);
+
+    expect(valid, s->name, "invalid waveform: both lines changed at once");
+    // Every step is one line change, and nothing else changed the lines.
+    expect(uni_gpio_hal_trace_get_count() == (int)gen.steps, s->name, "GPIO trace doesn't match the steps");
+    uni_quadrature_gen_sim_get_samples(&gen, &last, 1);
+    expect(uni_gpio_hal_get_level(GPIO_A) == (last & 0b01) && uni_gpio_hal_get_level(GPIO_B) == !!(last & 0b10),
+           s->name, "GPIO levels don't match the recorded waveform");
+    // The dropped steps (backlog cap, change of direction) are the only difference.
+    expect(llabs(total * s->scale / UNI_QUADRATURE_GEN_SCALE_ONE - position) <= (int64_t)gen.dropped + 1, s->name,
+           "position doesn't match the motion");
+    expect(valid_period, s->name, "period doesn't spread the backlog over the interval");
+    if (s->expect_no_backlog) {
+        expect(gen.dropped == 0, s->name, "steps dropped");
+        expect(backlog_reports == 0, s->name, "steps not emitted before the next report");
+    }
+    if (s->interval) {
+        expect(gen.dropped == 0, s->name, "steps dropped");
+        expect(max_lag <= s->max_lag_steps, s->name, "too many steps left when the next report arrived");
+        expect(min_rate >= s->min_rate_us && max_rate <= s->max_rate_us, s->name, "measured interval out of range");
+        // Otherwise the steps are spread over a longer time than the reports take, and the backlog grows.
+        expect(rate_count > 0 && llabs((int64_t)rate_sum - (int64_t)real_sum) * 50 <= (int64_t)real_sum, s->name,
+               "measured interval biased by more than 2%");
+    }
+
+    printf("%-8s: %4d reports, motion %6d, position %6d, steps %6u, dropped %4u, backlog at %4d reports (max %3d), "
+           "interval %5u-%5u us\n",
+           s->name, s->count, (int)(total * s->scale / UNI_QUADRATURE_GEN_SCALE_ONE), (int)position,
+           (unsigned int)gen.steps, (unsigned int)gen.dropped, backlog_reports, max_lag,
+           (unsigned int)(max_rate ? min_rate : 0), (unsigned int)max_rate);
+}
+
+int main(void) {
+    FILE* f;
+    long size;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        run(&scenarios[i]);
+
+    // The trace of the last scenario, in VCD format.
+    f = tmpfile();
+    uni_gpio_hal_trace_write_vcd(f);
+    size = ftell(f);
+    fclose(f);
+    expect(size > 0, "vcd", "empty VCD");
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Ricardo Quesada
+// http://retro.moe/unijoysticle2
+
+// Autofire and quadrature mouse paced by uni_rt_timer, in real time, checked from the VCD trace.
+//
+// Runs the real timer thread, GPIO HAL, autofire and Posix quadrature mouse, on two ports wired like the ones of the
+// Posix example. The VCD written by the GPIO HAL is parsed back, and the edges of each line are checked:
+// - Autofire: no edge comes before its deadline, and the lateness doesn't add up: the edges follow the schedule
+//   from the first press.
+// - Quadrature: valid Gray code, the steps spread over the report interval, and only in the lines of its port.
+// How late a timer fires depends on the scheduler: the bounds hold on a loaded machine without SCHED_FIFO.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uni_autofire.h"
+#include "uni_common.h"
+#include "uni_gpio_hal.h"
+#include "uni_gpio_port.h"
+#include "uni_mouse_quadrature.h"
+#include "uni_property.h"
+#include "uni_quadrature_gen.h"
+#include "uni_rt_timer.h"
+
+// Same layout as examples/posix/src/my_retro_port.h: 7 lines per port.
+enum {
+    LINE_UP,
+    LINE_DOWN,
+    LINE_LEFT,
+    LINE_RIGHT,
+    LINE_FIRE,
+    LINE_BUTTON2,
+    LINE_BUTTON3,
+
+    LINE_MAX,
+};
+#define PORTS 2
+#define GPIO(__port, __line) ((__port) * LINE_MAX + (__line))
+
+// Worst lateness allowed for a timer.
+#define MAX_LATE_US 10000
+// Deadlines are in microseconds, and the trace in nanoseconds.
+#define ROUNDING_NS 1000
+
+#define AUTOFIRE_RUN_MS 1000
+
+#define REPORT_INTERVAL_US 10000
+#define REPORTS 50
+// The report interval is measured by then.
+#define SETTLE_REPORTS 10
+
+typedef struct {
+    uint64_t time_ns;
+    uint8_t level;
+} edge_t;
+
+typedef struct {
+    edge_t edges[UNI_GPIO_HAL_TRACE_MAX_EVENTS];
+    int count;
+} line_t;
+
+static line_t lines[PORTS * LINE_MAX];
+static int failures;
+
+static void expect(bool cond, const char* what, const char* msg) {
+    if (cond)
+        return;
+    printf("FAIL: %s: %s\n", what, msg);
+    failures++;
+}
+
+// --- Properties
+
+static uni_property_value_t properties[UNI_PROPERTY_IDX_COUNT];
+
+void uni_property_set(uni_property_idx_t idx, uni_property_value_t value) {
+    properties[idx] = value;
+}
+
+uni_property_value_t uni_property_get(uni_property_idx_t idx) {
+    return properties[idx];
+}
+
+// --- VCD
+
+// Reads back the changes of every line from the VCD of the GPIO HAL. The initial levels ($dumpvars) are skipped.
+static bool parse_vcd(void) {
+    FILE* f = tmpfile();
+    char buf[128];
+    uint64_t time_ns = 0;
+    bool definitions = true;
+    bool dumpvars = false;
+    int gpio;
+
+    memset(lines, 0, sizeof(lines));
+    if (f == NULL)
+        return false;
+    uni_gpio_hal_trace_write_vcd(f);
+    rewind(f);
+
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        buf[strcspn(buf, "\n")] = 0;
+        if (definitions) {
+            definitions = strcmp(buf, "$enddefinitions $end") != 0;
+        } else if (strcmp(buf, "$dumpvars") == 0) {
+            dumpvars = true;
+        } else if (strcmp(buf, "$end") == 0) {
+            dumpvars = false;
+        } else if (buf[0] == '#') {
+            time_ns = strtoull(buf + 1, NULL, 10);
+        } else if (!dumpvars && (buf[0] == '0' || buf[0] == '1') && buf[1] != 0) {
+            gpio = buf[1] - '!';
+            if (gpio < 0 || gpio >= PORTS * LINE_MAX)
+                continue;
+            lines[gpio].edges[lines[gpio].count++] = (edge_t){.time_ns = time_ns, .level = buf[0] - '0'};
+        }
+    }
+    fclose(f);
+    return !definitions;
+}
+
+static void sleep_until(struct timespec* ts, uint32_t delay_us) {
+    ts->tv_nsec += (long)delay_us * 1000;
+    while (ts->tv_nsec >= 1000000000) {
+        ts->tv_nsec -= 1000000000;
+        ts->tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, ts, NULL);
+}
+
+// --- Autofire
+
+// Edge K is due at the press plus the pressed / released time of the previous edges.
+static void check_autofire(const char* what, const line_t* l, uint8_t cps, uint8_t duty) {
+    int64_t period_us = 1000000 / cps;
+    int64_t pressed_us = period_us * duty / 100;
+    int64_t due_ns = 0;
+    int64_t offset_ns;
+    int64_t late_ns;
+    int64_t max_late_ns = 0;
+    int expected = AUTOFIRE_RUN_MS * 1000 / period_us * 2;
+
+    expect(l->count >= expected - 2, what, "edges missing");
+    for (int i = 0; i < l->count; i++) {
+        expect(l->edges[i].level == ((i % 2) == 0), what, "levels don't alternate");
+        offset_ns = (int64_t)(l->edges[i].time_ns - l->edges[0].time_ns);
+        late_ns = offset_ns - due_ns;
+
+        // The last one might be the release of uni_autofire_stop(), which is not scheduled.
+        if (i != l->count - 1 || l->edges[i].level != 0 || late_ns >= 0) {
+            expect(late_ns >= -ROUNDING_NS, what, "edge before its deadline");
+            expect(late_ns <= MAX_LATE_US * 1000, what, "edge too late");
+            if (late_ns > max_late_ns)
+                max_late_ns = late_ns;
+        }
+        due_ns += ((i % 2) == 0 ? pressed_us : period_us - pressed_us) * 1000;
+    }
+    printf("%-20s: %3d edges, max late %5u us\n", what, l->count, (unsigned int)(max_late_ns / 1000));
+}
+
+static void test_autofire(void) {
+    uni_gpio_port_t ports[PORTS];
+    int channels[PORTS];
+    struct timespec ts;
+
+    uni_autofire_init();
+    for (int i = 0; i < PORTS; i++) {
+        uni_gpio_port_init(&ports[i]);
+        for (int j = 0; j < LINE_MAX; j++)
+            uni_gpio_port_add_line(&ports[i], GPIO(i, j));
+        uni_gpio_port_write(&ports[i], 0, BIT(LINE_MAX) - 1);
+        channels[i] = uni_autofire_add_channel(&ports[i], LINE_FIRE);
+    }
+    uni_autofire_set_rate(channels[0], 20, 50);
+    uni_autofire_set_rate(channels[1], 7, 30);
+
+    uni_gpio_hal_trace_reset();
+    uni_autofire_start(channels[0]);
+    uni_autofire_start(channels[1]);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    sleep_until(&ts, AUTOFIRE_RUN_MS * 1000);
+    uni_autofire_stop(channels[0]);
+    uni_autofire_stop(channels[1]);
+
+    expect(parse_vcd(), "autofire", "invalid VCD");
+    check_autofire("autofire A, 20 cps", &lines[GPIO(0, LINE_FIRE)], 20, 50);
+    check_autofire("autofire B, 7 cps", &lines[GPIO(1, LINE_FIRE)], 7, 30);
+    expect(lines[GPIO(0, LINE_FIRE)].count > lines[GPIO(1, LINE_FIRE)].count, "autofire", "rates mixed up");
+    expect(!uni_gpio_hal_get_level(GPIO(0, LINE_FIRE)) && !uni_gpio_hal_get_level(GPIO(1, LINE_FIRE)), "autofire",
+           "fire still pressed after stop");
+}
+
+// --- Quadrature mouse
+
+// Merges the changes of the A and B lines of an encoder, and checks the steps of a steady motion.
+static void check_encoder(const char* what, int gpio_a, int gpio_b, int32_t steps_per_report) {
+    static uint8_t samples[UNI_GPIO_HAL_TRACE_MAX_EVENTS + 1];
+    static uint64_t times[UNI_GPIO_HAL_TRACE_MAX_EVENTS];
+    const line_t* a = &lines[gpio_a];
+    const line_t* b = &lines[gpio_b];
+    int ia = 0;
+    int ib = 0;
+    int count = 0;
+    int32_t position;
+    uint64_t from_ns;
+    uint64_t to_ns;
+    uint64_t min_spacing_ns = UINT64_MAX;
+    int settled = 0;
+    int64_t expected;
+    int64_t period_us = REPORT_INTERVAL_US / steps_per_report;
+
+    // Lines start at phase 0 (A=0, B=0).
+    samples[0] = 0;
+    while (ia < a->count || ib < b->count) {
+        bool take_a = ib >= b->count || (ia < a->count && a->edges[ia].time_ns <= b->edges[ib].time_ns);
+        const edge_t* e = take_a ? &a->edges[ia++] : &b->edges[ib++];
+
+        samples[count + 1] = (samples[count] & (take_a ? 0b10 : 0b01)) | (e->level << (take_a ? 0 : 1));
+        times[count] = e->time_ns;
+        count++;
+    }
+    position = uni_quadrature_gen_sim_validate(samples, count + 1);
+    expect(position != INT32_MIN, what, "invalid Gray code");
+    expect(position == steps_per_report * REPORTS, what, "steps lost");
+
+    // Steady state: once the interval was measured, and before the last report.
+    from_ns = (uint64_t)SETTLE_REPORTS * REPORT_INTERVAL_US * 1000;
+    to_ns = (uint64_t)(REPORTS - 1) * REPORT_INTERVAL_US * 1000;
+    for (int i = 1; i < count; i++) {
+        if (times[i - 1] < from_ns || times[i] > to_ns)
+            continue;
+        settled++;
+        if (times[i] - times[i - 1] < min_spacing_ns)
+            min_spacing_ns = times[i] - times[i - 1];
+    }
+    // Spread over the interval: not in bursts, and all of them emitted in time.
+    expect(settled > 0 && min_spacing_ns >= (uint64_t)period_us * 1000 / 2, what, "steps not spread");
+    expected = (int64_t)(to_ns - from_ns) / (period_us * 1000);
+    expect(llabs(settled - expected) * 10 <= expected, what, "step rate off by more than 10%");
+
+    printf("%-20s: %3d steps, position %4d, period %4u us, min spacing %4u us\n", what, count, (int)position,
+           (unsigned int)period_us, settled > 0 ? (unsigned int)(min_spacing_ns / 1000) : 0);
+}
+
+static void test_quadrature(void) {
+    uni_property_value_t scale = {.f32 = 1.0f};
+    struct timespec ts;
+
+    uni_property_set(UNI_PROPERTY_IDX_MOUSE_SCALE, scale);
+    uni_mouse_quadrature_init(0);
+    for (int i = 0; i < PORTS; i++) {
+        // Amiga pinout, like the Posix example.
+        struct uni_mouse_quadrature_encoder_gpios h = {.a = GPIO(i, LINE_DOWN), .b = GPIO(i, LINE_RIGHT)};
+        struct uni_mouse_quadrature_encoder_gpios v = {.a = GPIO(i, LINE_LEFT), .b = GPIO(i, LINE_UP)};
+        uni_mouse_quadrature_setup_port(i == 0 ? UNI_MOUSE_QUADRATURE_PORT_0 : UNI_MOUSE_QUADRATURE_PORT_1, h, v);
+    }
+
+    uni_gpio_hal_trace_reset();
+    uni_mouse_quadrature_start(UNI_MOUSE_QUADRATURE_PORT_0);
+    uni_mouse_quadrature_start(UNI_MOUSE_QUADRATURE_PORT_1);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (int i = 0; i < REPORTS; i++) {
+        // Port A moves right, port B up.
+        uni_mouse_quadrature_update(UNI_MOUSE_QUADRATURE_PORT_0, 4, 0);
+        uni_mouse_quadrature_update(UNI_MOUSE_QUADRATURE_PORT_1, 0, -2);
+        sleep_until(&ts, REPORT_INTERVAL_US);
+    }
+    // The steps of the last report.
+    sleep_until(&ts, REPORT_INTERVAL_US + MAX_LATE_US);
+    uni_mouse_quadrature_deinit();
+
+    expect(parse_vcd(), "quadrature", "invalid VCD");
+    check_encoder("quadrature A, H", GPIO(0, LINE_DOWN), GPIO(0, LINE_RIGHT), 4);
+    // Delta Y is inverted.
+    check_encoder("quadrature B, V", GPIO(1, LINE_LEFT), GPIO(1, LINE_UP), 2);
+
+    // Each port only moves its own lines.
+    expect(lines[GPIO(0, LINE_LEFT)].count == 0 && lines[GPIO(0, LINE_UP)].count == 0, "quadrature A",
+           "vertical lines moved");
+    expect(lines[GPIO(1, LINE_DOWN)].count == 0 && lines[GPIO(1, LINE_RIGHT)].count == 0, "quadrature B",
+           "horizontal lines moved");
+    for (int i = 0; i < PORTS; i++) {
+        for (int j = LINE_FIRE; j < LINE_MAX; j++)
+            expect(lines[GPIO(i, j)].count == 0, "quadrature", "button lines moved");
+    }
+}
+
+int main(void) {
+    test_autofire();
+    test_quadrature();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
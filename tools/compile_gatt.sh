@@ -1,4 +1,18 @@
 # Call this script everytime that the .gatt file is modified.
 # Instead of compiling the .gatt file at compile time, we do it manually everytime we modify it.
 # Reason: .gatt file does not change that much. We don't want to add more dependencies to projects that use Bluepad32.
+#
+# Requires the external/btstack submodule ("git submodule update --init") and pycryptodome, used to compute
+# the database hash. Don't edit the generated file by hand.
+
+set -e
+
+# Paths are relative to this directory: they are part of the generated header.
+cd "$(dirname "$0")"
+
+if [ ! -f ../external/btstack/tool/compile_gatt.py ]; then
+    echo "BTstack not found. Run: git submodule update --init" >&2
+    exit 1
+fi
+
 python3 ../external/btstack/tool/compile_gatt.py ../src/components/bluepad32/bt/uni_bt_service.gatt ../src/components/bluepad32/include/bt/uni_bt_service.gatt.h